@@ -50,6 +50,7 @@ bool initialize_global_cache_state(
 
     if (!get_cache_state(&state->cache_state, db))
         return false;
+    state->generation = 0;
 
     if (state->cache_state.data_available)
     {
@@ -129,6 +130,16 @@ bool update_global_cache_state(
                 tmp_cache_state.serial_number);
         }
 
+        if (tmp_cache_state.data_available !=
+            state->cache_state.data_available ||
+            tmp_cache_state.session != state->cache_state.session ||
+            (tmp_cache_state.data_available &&
+             tmp_cache_state.serial_number !=
+             state->cache_state.serial_number))
+        {
+            ++state->generation;
+        }
+
         state->cache_state = tmp_cache_state;
     }
     else
@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "db/connect.h"
 #include "lib/rpki-rtr/pdu.h"
@@ -17,6 +18,10 @@ struct cache_state {
 
 struct global_cache_state {
     struct cache_state cache_state;
+
+    // incremented whenever cache_state changes
+    uint64_t generation;
+
     pthread_rwlock_t lock;
 };
 
@@ -34,7 +39,8 @@ bool initialize_global_cache_state(
     dbconn * db);
 
 /**
-   Update the global cache state from the database.
+   Update the global cache state from the database, incrementing its
+   generation if it changed.
 
    @return
        Whether or not the update was successful.
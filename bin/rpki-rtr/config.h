@@ -8,11 +8,39 @@
 
 #define LISTEN_PORT "1234"
 
+// How often to check the database for a new serial number when the
+// notification socket can't be used.
 #define MAIN_LOOP_INTERVAL 5
 
+// How often to check the database anyway when notifications from
+// rpki-rtr-update are being received, in case one was missed.
+#define NOTIFY_FALLBACK_INTERVAL 600
+
+// When RpkiRtrWorkers is more than 1, the supervisor process runs up
+// to MAX_WORKERS worker processes.  It checks on them every
+// WORKER_CHECK_INTERVAL seconds and restarts any that exited, but no
+// sooner than WORKER_RESTART_DELAY seconds after the worker last
+// started, so that one that can't start up doesn't spin.
+#define MAX_WORKERS 64
+#define WORKER_CHECK_INTERVAL 1
+#define WORKER_RESTART_DELAY 5
+
 #define DB_RESPONSE_BUFFER_LENGTH 3
 #define DB_ROWS_PER_RESPONSE 1024
+
+// The db thread pool starts with DB_INITIAL_THREADS threads and grows
+// up to DB_MAX_THREADS when requests are waiting for a thread.  It
+// shrinks back, one thread at a time, after at least half the threads
+// have been idle for DB_POOL_SHRINK_CHECKS checks in a row.  The pool
+// is checked every DB_POOL_CHECK_INTERVAL seconds.
 #define DB_INITIAL_THREADS 8
+#define DB_MAX_THREADS 32
+#define DB_POOL_CHECK_INTERVAL 1
+#define DB_POOL_SHRINK_CHECKS 30
+
+// At most this many Reset Queries are serviced at once; others wait.
+// This keeps enough db threads free for Serial Queries.
+#define DB_MAX_CONCURRENT_RESETS 4
 
 /*
  * Quote from draft-ietf-sidr-rpki-rtr-19, Section 6.2: The cache MUST rate
@@ -20,10 +48,6 @@
  */
 #define CXN_NOTIFY_INTERVAL 60
 
-// How often to check the cache state when more than CXN_NOTIFY_INTERVAL
-// has elapsed without sending a Serial Notify.
-#define CXN_CACHE_STATE_INTERVAL 10
-
 // The largest PDU should be an error report PDU.
 // The second largest is an IPv6 prefix at 32 bytes.
 // Error report PDUs MUST NOT contain other error report PDUs,
@@ -43,6 +43,13 @@ struct run_state {
 
     enum { READY, RESPONDING } state;
 
+    // The router's first PDU other than an Error Report sets the
+    // protocol version for the rest of the connection.  Until then,
+    // protocol_version is RTR_PROTOCOL_VERSION_0 so that any router
+    // can parse a Serial Notify, which it has to ignore anyway.
+    bool version_negotiated;
+    uint8_t protocol_version;
+
     char errorbuf[ERROR_BUF_SIZE];
     char pdustrbuf[PDU_SPRINT_BUFSZ];
 
@@ -67,8 +74,12 @@ struct run_state {
     uint8_t pdu_request_buffer[MAX_QUERY_PDU_LENGTH];
     size_t pdu_request_buffer_length;
 
+    // generation of global_cache_state when it was last copied
+    uint64_t cache_state_generation;
+
+    // Earliest time another Serial Notify may be sent.
     // tv_nsec MUST be zero
-    struct timespec next_cache_state_check_time;
+    struct timespec next_notify_time;
 };
 
 
@@ -87,6 +98,36 @@ static void copy_cache_state(
     }
 
     *cache_state = run_state->global_cache_state->cache_state;
+    run_state->cache_state_generation =
+        run_state->global_cache_state->generation;
+
+    retval = pthread_rwlock_unlock(&run_state->global_cache_state->lock);
+
+    if (retval != 0)
+    {
+        CXN_ERR_LOG(run_state, retval, "pthread_rwlock_unlock()");
+        pthread_exit(NULL);
+    }
+}
+
+
+/** Has the global cache state changed since it was last copied? */
+static bool cache_state_changed(
+    struct run_state *run_state)
+{
+    int retval;
+    bool changed;
+
+    retval = pthread_rwlock_rdlock(&run_state->global_cache_state->lock);
+
+    if (retval != 0)
+    {
+        CXN_ERR_LOG(run_state, retval, "pthread_rwlock_rdlock()");
+        pthread_exit(NULL);
+    }
+
+    changed = run_state->global_cache_state->generation !=
+        run_state->cache_state_generation;
 
     retval = pthread_rwlock_unlock(&run_state->global_cache_state->lock);
 
@@ -96,8 +137,7 @@ static void copy_cache_state(
         pthread_exit(NULL);
     }
 
-    run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_CACHE_STATE_INTERVAL;
+    return changed;
 }
 
 
@@ -136,6 +176,9 @@ static void initialize_run_state(
 
     run_state->state = READY;
 
+    run_state->version_negotiated = false;
+    run_state->protocol_version = RTR_PROTOCOL_VERSION_0;
+
     run_state->db_response_queue = NULL;
     run_state->to_process_queue = NULL;
 
@@ -146,9 +189,8 @@ static void initialize_run_state(
 
     run_state->response = NULL;
 
-    run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_NOTIFY_INTERVAL;
-    run_state->next_cache_state_check_time.tv_nsec = 0;
+    run_state->next_notify_time.tv_sec = time(NULL) + CXN_NOTIFY_INTERVAL;
+    run_state->next_notify_time.tv_nsec = 0;
 
     // The receive buffer is not bounds checked while reading the first
     // PDU_HEADER_LENGTH bytes.
@@ -197,13 +239,29 @@ static void send_pdu(
     }
 }
 
+/**
+   Protocol version for an Error Report about the PDU in the receive
+   buffer.  Before negotiation, that's the PDU's own version if it's
+   supported, or else the highest supported version, as RFC 8210
+   requires for Unsupported Protocol Version errors.
+*/
+static uint8_t error_version(
+    struct run_state *run_state)
+{
+    if (run_state->version_negotiated)
+        return run_state->protocol_version;
+
+    if (run_state->pdu_recv_buffer_length > 0 &&
+        run_state->pdu_recv_buffer[0] <= RTR_PROTOCOL_VERSION)
+        return run_state->pdu_recv_buffer[0];
+
+    return RTR_PROTOCOL_VERSION;
+}
+
 static void send_cache_reset(
     struct run_state *run_state)
 {
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
-    run_state->send_pdu.pduType = PDU_CACHE_RESET;
-    run_state->send_pdu.reserved = 0;
-    run_state->send_pdu.length = PDU_HEADER_LENGTH;
+    fill_pdu_cache_reset(&run_state->send_pdu, run_state->protocol_version);
 
     send_pdu(run_state, &run_state->send_pdu);
 }
@@ -232,16 +290,9 @@ static void send_error(
                             error_text_length);
     }
 
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
-    run_state->send_pdu.pduType = PDU_ERROR_REPORT;
-    run_state->send_pdu.errorCode = code;
-    run_state->send_pdu.length =
-        PDU_HEADER_LENGTH + PDU_ERROR_HEADERS_LENGTH + embedded_pdu_length +
-        error_text_length;
-    run_state->send_pdu.errorData.encapsulatedPDULength = embedded_pdu_length;
-    run_state->send_pdu.errorData.encapsulatedPDU = embedded_pdu;
-    run_state->send_pdu.errorData.errorTextLength = error_text_length;
-    run_state->send_pdu.errorData.errorText = error_text;
+    fill_pdu_error_report(&run_state->send_pdu, error_version(run_state),
+                          code, embedded_pdu_length, embedded_pdu,
+                          error_text_length, error_text);
 
     send_pdu(run_state, &run_state->send_pdu);
 }
@@ -313,7 +364,11 @@ static void log_and_send_parse_error(
     case PDU_UNSUPPORTED_PROTOCOL_VERSION:
         CXN_LOG(run_state, LOG_NOTICE,
                 "received PDU with unsupported protocol version");
-        code = ERR_UNSUPPORTED_VERSION;
+        if (run_state->version_negotiated &&
+            run_state->protocol_version >= RTR_PROTOCOL_VERSION_1)
+            code = ERR_UNEXPECTED_VERSION;
+        else
+            code = ERR_UNSUPPORTED_VERSION;
         break;
     case PDU_UNSUPPORTED_PDU_TYPE:
         CXN_LOG(run_state, LOG_NOTICE,
@@ -348,17 +403,13 @@ static void send_notify(
         pthread_exit(NULL);
     }
 
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
-    run_state->send_pdu.pduType = PDU_SERIAL_NOTIFY;
-    run_state->send_pdu.sessionId = run_state->local_cache_state.session;
-    run_state->send_pdu.length = PDU_HEADER_LENGTH + sizeof(serial_number_t);
-    run_state->send_pdu.serialNumber =
-        run_state->local_cache_state.serial_number;
+    fill_pdu_serial_notify(&run_state->send_pdu, run_state->protocol_version,
+                           run_state->local_cache_state.session,
+                           run_state->local_cache_state.serial_number);
 
     send_pdu(run_state, &run_state->send_pdu);
 
-    run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_NOTIFY_INTERVAL;
+    run_state->next_notify_time.tv_sec = time(NULL) + CXN_NOTIFY_INTERVAL;
 }
 
 
@@ -537,6 +588,7 @@ static void add_db_request(
         pthread_exit(NULL);
     }
 
+    run_state->request.query.protocol_version = run_state->protocol_version;
     run_state->request.response_queue = run_state->db_response_queue;
     run_state->request.response_semaphore = run_state->semaphore;
     run_state->request.cancel_request = false;
@@ -665,6 +717,43 @@ static void handle_pdu(
     }
 }
 
+/**
+   Negotiate the protocol version with the router's first PDU, and
+   make sure every later one uses the same version.
+*/
+static void check_version(
+    struct run_state *run_state,
+    const PDU * pdup)
+{
+    // Replying to an Error Report with another one isn't allowed, and
+    // handle_pdu() closes the connection anyway.
+    if (pdup->pduType == PDU_ERROR_REPORT)
+        return;
+
+    if (!run_state->version_negotiated)
+    {
+        run_state->protocol_version = pdup->protocolVersion;
+        run_state->version_negotiated = true;
+        CXN_LOG(run_state, LOG_DEBUG, "using protocol version %" PRIu8,
+                run_state->protocol_version);
+        return;
+    }
+
+    if (pdup->protocolVersion != run_state->protocol_version)
+    {
+        CXN_LOG(run_state, LOG_NOTICE,
+                "received PDU with protocol version %" PRIu8
+                " after negotiating version %" PRIu8,
+                pdup->protocolVersion, run_state->protocol_version);
+        send_error(run_state,
+                   run_state->protocol_version >= RTR_PROTOCOL_VERSION_1 ?
+                   ERR_UNEXPECTED_VERSION : ERR_UNSUPPORTED_VERSION,
+                   run_state->pdu_recv_buffer,
+                   run_state->pdu_recv_buffer_length, NULL, 0);
+        pthread_exit(NULL);
+    }
+}
+
 static void read_and_handle_pdu(
     struct run_state *run_state)
 {
@@ -676,6 +765,7 @@ static void read_and_handle_pdu(
         CXN_LOG(run_state, LOG_NOTICE,
                 "received a PDU with unsupported feature(s)");
     case PDU_GOOD:
+        check_version(run_state, &run_state->recv_pdu);
         handle_pdu(run_state, &run_state->recv_pdu, true);
         break;
     default:
@@ -841,9 +931,9 @@ static bool wait_on_semaphore(
                                                         // can't send a Notify
                                                         // anyway
     {
-        struct timespec abs_timeout = run_state->next_cache_state_check_time;
+        struct timespec abs_timeout = run_state->next_notify_time;
         abs_timeout.tv_sec += 1;        // make sure we timeout *after* we're
-                                        // ready to check the cache state
+                                        // allowed to send a Notify
                                         // (avoiding boundary issues)
         retval = sem_timedwait(run_state->semaphore, &abs_timeout);
     }
@@ -964,7 +1054,13 @@ static void initialize_data_structures_in_run_state(
 static void connection_main_loop(
     struct run_state *run_state)
 {
-    if (!wait_on_semaphore(run_state, true))
+    // cxnctl wakes this thread when the global cache state changes, so
+    // the only reason to time out is a Serial Notify that had to wait
+    // for CXN_NOTIFY_INTERVAL.
+    bool notify_pending = run_state->state == READY &&
+        cache_state_changed(run_state);
+
+    if (!wait_on_semaphore(run_state, notify_pending))
         pthread_exit(NULL);
 
     run_state->pdu_recv_buffer_length = 0;
@@ -981,7 +1077,8 @@ static void connection_main_loop(
     }
 
     if (run_state->state == READY &&
-        time(NULL) >= run_state->next_cache_state_check_time.tv_sec)
+        time(NULL) >= run_state->next_notify_time.tv_sec &&
+        cache_state_changed(run_state))
     {
         check_global_cache_state(run_state);
     }
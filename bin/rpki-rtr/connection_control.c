@@ -168,6 +168,8 @@ void *connection_control_main(
     int nfds;
 
     bool did_erase;
+    bool wake_all;
+    char wakeup_buf[64];
 
     retval = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
     if (retval != 0)
@@ -187,6 +189,10 @@ void *connection_control_main(
                 nfds = argsp->listen_fds[i] + 1;
         }
 
+        FD_SET(argsp->wakeup_fd, &read_fds);
+        if (argsp->wakeup_fd + 1 > nfds)
+            nfds = argsp->wakeup_fd + 1;
+
         if (!Bag_start_iteration(connections))
         {
             LOG(LOG_ERR, "error in Bag_start_iteration(connections)");
@@ -253,6 +259,15 @@ void *connection_control_main(
             continue;
         }
 
+        // main wrote to the wakeup pipe because the global cache state
+        // changed, so every connection should check it
+        wake_all = FD_ISSET(argsp->wakeup_fd, &read_fds);
+        if (wake_all)
+        {
+            while (read(argsp->wakeup_fd, wakeup_buf, sizeof(wakeup_buf)) > 0)
+                ;
+        }
+
         if (!Bag_start_iteration(connections))
         {
             LOG(LOG_ERR, "error in Bag_start_iteration(connections)");
@@ -271,7 +286,7 @@ void *connection_control_main(
 
             assert(cxn_info != NULL);
 
-            if (FD_ISSET(cxn_info->fd, &read_fds))
+            if (wake_all || FD_ISSET(cxn_info->fd, &read_fds))
             {
                 if (sem_post(cxn_info->semaphore) != 0)
                 {
@@ -13,6 +13,7 @@ struct connection_control_main_args {
     Queue *db_request_queue;
     db_semaphore_t *db_semaphore;
     struct global_cache_state *global_cache_state;
+    int wakeup_fd;              // readable when every cxn should be woken
 };
 void *connection_control_main(
     void *args_voidp);
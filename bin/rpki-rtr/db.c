@@ -9,22 +9,9 @@
 #include "db/clients/rtr.h"
 
 #include "config.h"
+#include "db_scheduler.h"
 #include "signals.h"
 
-
-struct db_request_state {
-    struct db_request *request;
-    void *query_state;
-};
-
-static void initialize_request_state(
-    struct db_request_state *rq,
-    struct db_request *request)
-{
-    rq->request = request;
-    rq->query_state = NULL;
-}
-
 static int start_query(
     struct db_request_state *rq,
     dbconn * db)
@@ -33,10 +20,12 @@ static int start_query(
     {
     case SERIAL_QUERY:
         return db_rtr_serial_query_init(db, &rq->query_state,
+                                        rq->request->query.protocol_version,
                                         rq->request->query.serial_query.
                                         serial);
     case RESET_QUERY:
-        return db_rtr_reset_query_init(db, &rq->query_state);
+        return db_rtr_reset_query_init(db, &rq->query_state,
+                                       rq->request->query.protocol_version);
     default:
         LOG(LOG_ERR, "got unexpected query type");
         return -1;              // TODO: check if this is a good error code
@@ -90,16 +79,17 @@ static void stop_query(
 
 struct run_state {
     db_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    Bag *db_currently_processing;
+    struct db_scheduler *scheduler;
     dbconn *db;
 
     char errorbuf[ERROR_BUF_SIZE];
 
-    struct db_request *request;
     struct db_request_state *request_state;
 
     struct db_response *response;
+
+    // set when the scheduler asked this thread to exit
+    bool retiring;
 };
 
 static void initialize_run_state(
@@ -108,24 +98,21 @@ static void initialize_run_state(
 {
     const struct db_main_args *args = (const struct db_main_args *)args_voidp;
 
-    if (args == NULL ||
-        args->semaphore == NULL ||
-        args->db_request_queue == NULL ||
-        args->db_currently_processing == NULL)
+    if (args == NULL || args->semaphore == NULL || args->scheduler == NULL)
     {
         LOG(LOG_ERR, "db thread called with NULL argument");
         pthread_exit(NULL);
     }
 
     run_state->semaphore = args->semaphore;
-    run_state->db_request_queue = args->db_request_queue;
-    run_state->db_currently_processing = args->db_currently_processing;
+    run_state->scheduler = args->scheduler;
     run_state->db = NULL;
 
-    run_state->request = NULL;
     run_state->request_state = NULL;
 
     run_state->response = NULL;
+
+    run_state->retiring = false;
 }
 
 
@@ -194,7 +181,8 @@ static void send_error(
 
     run_state->response->is_done = true;
 
-    run_state->response->PDUs[0].protocolVersion = RTR_PROTOCOL_VERSION;
+    run_state->response->PDUs[0].protocolVersion =
+        run_state->request_state->request->query.protocol_version;
     run_state->response->PDUs[0].pduType = PDU_ERROR_REPORT;
     run_state->response->PDUs[0].errorCode = error_code;
     run_state->response->PDUs[0].length =
@@ -219,14 +207,23 @@ static void wait_on_semaphore(
 }
 
 
+/** Give run_state->request_state back to the scheduler. */
+static void finish_step(
+    struct run_state *run_state,
+    bool done)
+{
+    db_scheduler_put(run_state->scheduler, run_state->request_state, done);
+    run_state->request_state = NULL;
+}
+
+
 /**
 	Service run_state->request_state for exactly one step.
 
-	If the request can't be finished, request_state gets put (back) in db_currently_processing.
+	Afterwards, the request is given back to the scheduler, which frees it if it's finished.
 */
 static void service_request(
-    struct run_state *run_state,
-    bool is_new_request)
+    struct run_state *run_state)
 {
     if (run_state->request_state->request->cancel_request)
     {
@@ -234,12 +231,11 @@ static void service_request(
 
         send_empty_response(run_state);
 
-        free(run_state->request_state);
-        run_state->request_state = NULL;
+        finish_step(run_state, true);
         return;
     }
 
-    if (is_new_request)
+    if (!run_state->request_state->started)
     {
         int retval = start_query(run_state->request_state, run_state->db);
         // TODO: check for specific error codes
@@ -247,10 +243,10 @@ static void service_request(
         {
             LOG(LOG_ERR, "error in start_query (error code %d)", retval);
             send_error(run_state, ERR_INTERNAL_ERROR);
-            free(run_state->request_state);
-            run_state->request_state = NULL;
+            finish_step(run_state, true);
             return;
         }
+        run_state->request_state->started = true;
     }
 
     allocate_response(run_state, 0);    // 0 because query_get_next() will
@@ -283,165 +279,26 @@ static void service_request(
         // TODO: check for specific error codes
         LOG(LOG_ERR, "error in query_get_next (error code %zd)", retval);
         send_error(run_state, ERR_INTERNAL_ERROR);
-        free(run_state->request_state);
-        run_state->request_state = NULL;
+        finish_step(run_state, true);
         return;
     }
 
     send_response(run_state);
 
-    if (is_done)
-    {
-        free(run_state->request_state);
-        run_state->request_state = NULL;
-    }
-    else
-    {
-        if (!Bag_add
-            (run_state->db_currently_processing,
-             (void *)run_state->request_state))
-        {
-            LOG(LOG_ERR,
-                "can't add a request state to the currently processing bag");
-            stop_query(run_state->request_state, run_state->db);
-            send_error(run_state, ERR_INTERNAL_ERROR);
-            free(run_state->request_state);
-            run_state->request_state = NULL;
-            return;
-        }
-
-        run_state->request_state = NULL;
-
-        /*
-         * NOTE: after putting the request back in db_currently_processing
-         * db_semaphore should be incremented to prevent problems in the below
-         * case:
-         *
-         * 1. DB Thread 1: take CXN Thread 1's request out of
-         * db_currently_processing and start servicing it 2. CXN Thread 1:
-         * take a previous response out if its response queue and increment
-         * db_semaphore 3. DB Thread 2: decrement db_semaphore, do nothing
-         * because it can't see CXN Thread 1's request because DB Thread 1 has
-         * it 4. DB Thread 1: finish servicing CXN Thread 1's request and put
-         * it back in db_currently_processing
-         */
-
-        if (sem_post(run_state->semaphore) != 0)
-        {
-            ERR_LOG(errno, run_state->errorbuf, "sem_post()");
-        }
-    }
-}
-
-
-// Postcondition: run_state->request_state is non-NULL iff there is a request
-// to service
-static void find_existing_request_to_service(
-    struct run_state *run_state)
-{
-    Bag_iterator it;
-    bool did_erase;
-
-    if (!Bag_start_iteration(run_state->db_currently_processing))
-    {
-        LOG(LOG_ERR,
-            "error in Bag_start_iteration(run_state->db_currently_processing)");
-        pthread_exit(NULL);
-    }
-    for (it = Bag_begin(run_state->db_currently_processing);
-         it != Bag_end(run_state->db_currently_processing);
-         (void)(did_erase
-                || (it =
-                    Bag_iterator_next(run_state->db_currently_processing,
-                                      it))))
-    {
-        did_erase = false;
-
-        run_state->request_state =
-            (struct db_request_state *)Bag_get(run_state->
-                                               db_currently_processing, it);
-
-        if (run_state->request_state == NULL)
-        {
-            LOG(LOG_ERR, "got NULL request state");
-            it = Bag_erase(run_state->db_currently_processing, it);
-            did_erase = true;
-            continue;
-        }
-
-        if (run_state->request_state->request->cancel_request ||
-            Queue_size(run_state->request_state->request->response_queue) <
-            DB_RESPONSE_BUFFER_LENGTH)
-        {
-            it = Bag_erase(run_state->db_currently_processing, it);
-            did_erase = true;
-            if (!Bag_stop_iteration(run_state->db_currently_processing))
-            {
-                LOG(LOG_ERR,
-                    "error in Bag_stop_iteration(run_state->db_currently_processing)");
-                pthread_exit(NULL);
-            }
-            return;
-        }
-    }
-    if (!Bag_stop_iteration(run_state->db_currently_processing))
-    {
-        LOG(LOG_ERR,
-            "error in Bag_stop_iteration(run_state->db_currently_processing)");
-        pthread_exit(NULL);
-    }
-
-    // if control reaches here, there are no existing requests to service
-    run_state->request_state = NULL;
+    finish_step(run_state, is_done);
 }
 
-static bool try_service_existing_request(
-    struct run_state *run_state)
-{
-    find_existing_request_to_service(run_state);
 
-    if (run_state->request_state == NULL)
-    {
-        return false;
-    }
-    else
-    {
-        service_request(run_state, false);
-        return true;
-    }
-}
-
-
-static bool try_service_new_request(
+static void try_service_request(
     struct run_state *run_state)
 {
-    if (!Queue_trypop
-        (run_state->db_request_queue, (void **)&run_state->request))
-        return false;
-
-    run_state->request_state = malloc(sizeof(struct db_request_state));
-    if (run_state->request_state == NULL)
+    if (!db_scheduler_get(run_state->scheduler, &run_state->request_state))
     {
-        LOG(LOG_ERR, "can't allocate memory for request state");
         pthread_exit(NULL);
     }
 
-    initialize_request_state(run_state->request_state, run_state->request);
-    run_state->request = NULL;
-
-    service_request(run_state, true);
-
-    return true;
-}
-
-
-static void try_service_request(
-    struct run_state *run_state)
-{
-    if (try_service_existing_request(run_state))
-        return;
-    if (try_service_new_request(run_state))
-        return;
+    if (run_state->request_state != NULL)
+        service_request(run_state);
 }
 
 
@@ -453,13 +310,20 @@ static void db_main_loop(
 
     wait_on_semaphore(run_state);
 
-    if (run_state->request != NULL ||
-        run_state->request_state != NULL || run_state->response != NULL)
+    if (run_state->request_state != NULL || run_state->response != NULL)
     {
         LOG(LOG_ERR, "got non-NULL state variable that should be NULL");
         pthread_exit(NULL);
     }
 
+    // Only a thread that isn't servicing a request gets here, so this
+    // never retires a busy thread.
+    if (db_scheduler_should_retire(run_state->scheduler))
+    {
+        run_state->retiring = true;
+        pthread_exit(NULL);
+    }
+
     retval = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
     if (retval != 0)
     {
@@ -489,9 +353,13 @@ static void cleanup(
         db_thread_close();
     }
 
+    // last, so that the main thread can join this one without waiting
+    if (run_state->retiring)
+        db_scheduler_retired(run_state->scheduler, pthread_self());
+
     /*
-     * Unfortunately there doesn't seem to be a better option for request,
-     * request_state, and response than letting their memory be potentially
+     * Unfortunately there doesn't seem to be a better option for
+     * request_state and response than letting their memory be potentially
      * lost. This is mitigated by making the thread not cancelable when their
      * values are non-null.
      */
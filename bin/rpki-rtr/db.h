@@ -13,6 +13,7 @@
 
 struct db_query {
     enum { SERIAL_QUERY, RESET_QUERY } type;
+    uint8_t protocol_version;   // version negotiated with the router
     union {
         struct {
             serial_number_t serial;
@@ -38,12 +39,13 @@ struct db_response {
     bool is_done;
 };
 
+struct db_scheduler;
+
 // memory is handled entirely by the main thread, db threads must not free()
 // these
 struct db_main_args {
     db_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    Bag *db_currently_processing;
+    struct db_scheduler *scheduler;
 };
 void *db_main(
     void *args_voidp);
@@ -0,0 +1,392 @@
+#include "db_scheduler.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "util/logging.h"
+
+#include "config.h"
+
+
+struct request_list {
+    struct db_request_state *head;
+    struct db_request_state *tail;
+    size_t length;
+};
+
+struct db_scheduler {
+    Queue *db_request_queue;
+    db_semaphore_t *db_semaphore;
+
+    pthread_mutex_t lock;
+
+    struct request_list serial_queries;
+    struct request_list resets;         // running or allowed to start
+    struct request_list waiting_resets; // waiting for a free slot
+
+    size_t reset_slots_used;
+    size_t checked_out;
+
+    // db threads asked to exit that haven't yet noticed, and ones that
+    // have exited but haven't been joined
+    size_t retire_requests;
+    size_t num_retired;
+    pthread_t retired[DB_MAX_THREADS];
+
+    // allocated ahead of time so that a request is never popped off
+    // db_request_queue without somewhere to put it
+    struct db_request_state *spare;
+};
+
+
+static void list_append(
+    struct request_list *list,
+    struct db_request_state *rq)
+{
+    rq->next = NULL;
+    rq->prev = list->tail;
+    if (list->tail != NULL)
+        list->tail->next = rq;
+    else
+        list->head = rq;
+    list->tail = rq;
+    ++list->length;
+}
+
+static void list_remove(
+    struct request_list *list,
+    struct db_request_state *rq)
+{
+    if (rq->prev != NULL)
+        rq->prev->next = rq->next;
+    else
+        list->head = rq->next;
+    if (rq->next != NULL)
+        rq->next->prev = rq->prev;
+    else
+        list->tail = rq->prev;
+    rq->prev = rq->next = NULL;
+    --list->length;
+}
+
+static void list_free(
+    struct request_list *list)
+{
+    struct db_request_state *rq,
+       *next;
+
+    for (rq = list->head; rq != NULL; rq = next)
+    {
+        next = rq->next;
+        free(rq);
+    }
+    list->head = list->tail = NULL;
+    list->length = 0;
+}
+
+
+/** Whether a step on rq would do anything useful right now. */
+static bool runnable(
+    const struct db_request_state *rq)
+{
+    return !rq->started ||
+        rq->request->cancel_request ||
+        Queue_size(rq->request->response_queue) < DB_RESPONSE_BUFFER_LENGTH;
+}
+
+static struct db_request_state *find_canceled(
+    struct request_list *list)
+{
+    struct db_request_state *rq;
+
+    for (rq = list->head; rq != NULL; rq = rq->next)
+    {
+        if (rq->request->cancel_request)
+            return rq;
+    }
+    return NULL;
+}
+
+static struct db_request_state *find_runnable(
+    struct request_list *list)
+{
+    struct db_request_state *rq;
+
+    for (rq = list->head; rq != NULL; rq = rq->next)
+    {
+        if (runnable(rq))
+            return rq;
+    }
+    return NULL;
+}
+
+
+/** Move new requests from db_request_queue to the scheduler's lists. */
+static bool take_new_requests(
+    struct db_scheduler *scheduler)
+{
+    struct db_request *request;
+
+    while (true)
+    {
+        if (scheduler->spare == NULL)
+        {
+            scheduler->spare = malloc(sizeof(*scheduler->spare));
+            if (scheduler->spare == NULL)
+            {
+                LOG(LOG_ERR, "can't allocate memory for request state");
+                return false;
+            }
+        }
+
+        if (!Queue_trypop(scheduler->db_request_queue, (void **)&request))
+            return true;
+
+        struct db_request_state *rq = scheduler->spare;
+        scheduler->spare = NULL;
+
+        rq->request = request;
+        rq->query_state = NULL;
+        rq->started = false;
+        rq->holds_reset_slot = false;
+
+        if (request->query.type == RESET_QUERY)
+            list_append(&scheduler->waiting_resets, rq);
+        else
+            list_append(&scheduler->serial_queries, rq);
+    }
+}
+
+
+struct db_scheduler *db_scheduler_new(
+    Queue *db_request_queue,
+    db_semaphore_t *db_semaphore)
+{
+    struct db_scheduler *scheduler = calloc(1, sizeof(*scheduler));
+    int retval;
+
+    if (scheduler == NULL)
+        return NULL;
+
+    retval = pthread_mutex_init(&scheduler->lock, NULL);
+    if (retval != 0)
+    {
+        char errorbuf[ERROR_BUF_SIZE];
+        ERR_LOG(retval, errorbuf, "pthread_mutex_init()");
+        free(scheduler);
+        return NULL;
+    }
+
+    scheduler->db_request_queue = db_request_queue;
+    scheduler->db_semaphore = db_semaphore;
+
+    return scheduler;
+}
+
+void db_scheduler_free(
+    struct db_scheduler *scheduler)
+{
+    if (scheduler == NULL)
+        return;
+
+    if (scheduler->checked_out != 0)
+    {
+        LOG(LOG_ERR, "freeing the db scheduler with %zu requests in use",
+            scheduler->checked_out);
+    }
+
+    // The queries' database state belongs to db threads' connections,
+    // which are gone by now.
+    list_free(&scheduler->serial_queries);
+    list_free(&scheduler->resets);
+    list_free(&scheduler->waiting_resets);
+    free(scheduler->spare);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler);
+}
+
+bool db_scheduler_get(
+    struct db_scheduler *scheduler,
+    struct db_request_state **rqp)
+{
+    struct db_request_state *rq = NULL;
+    struct request_list *list = NULL;
+    bool ret;
+
+    pthread_mutex_lock(&scheduler->lock);
+
+    ret = take_new_requests(scheduler);
+
+    // Start waiting resets while there are free slots.  They join the
+    // end of the rotation.
+    while (scheduler->reset_slots_used < DB_MAX_CONCURRENT_RESETS &&
+           (rq = scheduler->waiting_resets.head) != NULL)
+    {
+        list_remove(&scheduler->waiting_resets, rq);
+        rq->holds_reset_slot = true;
+        ++scheduler->reset_slots_used;
+        list_append(&scheduler->resets, rq);
+    }
+    rq = NULL;
+
+    if ((rq = find_canceled(&scheduler->serial_queries)) != NULL)
+        list = &scheduler->serial_queries;
+    else if ((rq = find_canceled(&scheduler->resets)) != NULL)
+        list = &scheduler->resets;
+    else if ((rq = find_canceled(&scheduler->waiting_resets)) != NULL)
+        list = &scheduler->waiting_resets;
+    else if ((rq = find_runnable(&scheduler->serial_queries)) != NULL)
+        list = &scheduler->serial_queries;
+    else if ((rq = find_runnable(&scheduler->resets)) != NULL)
+        list = &scheduler->resets;
+
+    if (rq != NULL)
+    {
+        list_remove(list, rq);
+        ++scheduler->checked_out;
+    }
+
+    pthread_mutex_unlock(&scheduler->lock);
+
+    *rqp = rq;
+    return ret;
+}
+
+void db_scheduler_put(
+    struct db_scheduler *scheduler,
+    struct db_request_state *rq,
+    bool done)
+{
+    bool post;
+
+    pthread_mutex_lock(&scheduler->lock);
+
+    --scheduler->checked_out;
+
+    if (done)
+    {
+        // Let the next waiting reset start.  It doesn't have a pending
+        // increment of db_semaphore of its own: that was used up by
+        // whichever db thread found it couldn't start yet.
+        post = rq->holds_reset_slot &&
+            scheduler->waiting_resets.length > 0;
+        if (rq->holds_reset_slot)
+            --scheduler->reset_slots_used;
+        free(rq);
+    }
+    else
+    {
+        // Going to the back of the list is what makes running resets
+        // take turns.
+        if (rq->holds_reset_slot)
+            list_append(&scheduler->resets, rq);
+        else
+            list_append(&scheduler->serial_queries, rq);
+
+        /*
+         * Another db thread might have been woken for this request
+         * while it was checked out and found nothing to do, so make
+         * sure some thread looks at it again.
+         */
+        post = true;
+    }
+
+    pthread_mutex_unlock(&scheduler->lock);
+
+    if (post && sem_post(scheduler->db_semaphore) != 0)
+    {
+        char errorbuf[ERROR_BUF_SIZE];
+        ERR_LOG(errno, errorbuf, "sem_post()");
+    }
+}
+
+void db_scheduler_load(
+    struct db_scheduler *scheduler,
+    size_t *busyp,
+    size_t *runnablep)
+{
+    struct db_request_state *rq;
+    size_t count = 0;
+    size_t free_slots;
+
+    pthread_mutex_lock(&scheduler->lock);
+
+    for (rq = scheduler->serial_queries.head; rq != NULL; rq = rq->next)
+        count += runnable(rq);
+    for (rq = scheduler->resets.head; rq != NULL; rq = rq->next)
+        count += runnable(rq);
+
+    free_slots = DB_MAX_CONCURRENT_RESETS > scheduler->reset_slots_used ?
+        DB_MAX_CONCURRENT_RESETS - scheduler->reset_slots_used : 0;
+    count += scheduler->waiting_resets.length < free_slots ?
+        scheduler->waiting_resets.length : free_slots;
+
+    // requests not yet taken from db_request_queue
+    count += Queue_size(scheduler->db_request_queue);
+
+    *busyp = scheduler->checked_out;
+    *runnablep = count;
+
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+void db_scheduler_retire(
+    struct db_scheduler *scheduler)
+{
+    pthread_mutex_lock(&scheduler->lock);
+    ++scheduler->retire_requests;
+    pthread_mutex_unlock(&scheduler->lock);
+
+    // wake an idle db thread to take the request
+    if (sem_post(scheduler->db_semaphore) != 0)
+    {
+        char errorbuf[ERROR_BUF_SIZE];
+        ERR_LOG(errno, errorbuf, "sem_post()");
+    }
+}
+
+bool db_scheduler_should_retire(
+    struct db_scheduler *scheduler)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->retire_requests > 0)
+    {
+        --scheduler->retire_requests;
+        ret = true;
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+
+    return ret;
+}
+
+void db_scheduler_retired(
+    struct db_scheduler *scheduler,
+    pthread_t thread)
+{
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->num_retired < DB_MAX_THREADS)
+        scheduler->retired[scheduler->num_retired++] = thread;
+    else
+        LOG(LOG_ERR, "too many retired db threads");
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+bool db_scheduler_reap(
+    struct db_scheduler *scheduler,
+    pthread_t *threadp)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->num_retired > 0)
+    {
+        *threadp = scheduler->retired[--scheduler->num_retired];
+        ret = true;
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+
+    return ret;
+}
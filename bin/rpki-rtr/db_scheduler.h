@@ -0,0 +1,122 @@
+#ifndef _RTR_DB_SCHEDULER_H
+#define _RTR_DB_SCHEDULER_H
+
+// Decides which request the db threads work on next.
+//
+// cxn threads still push new requests onto db_request_queue and
+// increment db_semaphore.  Each time a db thread decrements
+// db_semaphore, it asks the scheduler for one request to service for
+// one step (one response of at most DB_ROWS_PER_RESPONSE rows) and
+// then gives it back.  In order of preference, the scheduler picks:
+//
+//   1. canceled requests, which are cheap to finish;
+//   2. Serial Queries, oldest first, so that routers that are already
+//      mostly in sync are never stuck behind full dumps;
+//   3. Reset Queries, round-robin, so that they all make progress at
+//      the same rate.  At most DB_MAX_CONCURRENT_RESETS are running at
+//      once; the rest wait, in order, for one of those to finish.
+//
+// A running request whose cxn hasn't yet consumed its earlier
+// responses is skipped until it has.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "util/queue.h"
+
+#include "db.h"
+#include "semaphores.h"
+
+
+struct db_request_state {
+    struct db_request *request;
+    void *query_state;
+    bool started;               // whether the query has been started
+
+    // used only by the scheduler
+    bool holds_reset_slot;
+    struct db_request_state *prev;
+    struct db_request_state *next;
+};
+
+struct db_scheduler;
+
+struct db_scheduler *db_scheduler_new(
+    Queue *db_request_queue,
+    db_semaphore_t *db_semaphore);
+
+/** The scheduler must not have any requests checked out. */
+void db_scheduler_free(
+    struct db_scheduler *scheduler);
+
+/**
+   Check out the request to service next.
+
+   @param[out] rqp
+       Set to the request, or NULL if there's nothing to do now.
+       A non-NULL request must be returned with db_scheduler_put().
+   @return
+       false if out of memory.
+*/
+bool db_scheduler_get(
+    struct db_scheduler *scheduler,
+    struct db_request_state **rqp);
+
+/**
+   Return a request checked out by db_scheduler_get().  If @p done,
+   the request is finished and its state is freed; otherwise it's
+   scheduled again.
+*/
+void db_scheduler_put(
+    struct db_scheduler *scheduler,
+    struct db_request_state *rq,
+    bool done);
+
+/**
+   Get a snapshot of the load on the db threads, for sizing the pool.
+
+   @param[out] busyp
+       Number of requests checked out, i.e. db threads doing work.
+   @param[out] runnablep
+       Number of requests that could be serviced right now.
+*/
+void db_scheduler_load(
+    struct db_scheduler *scheduler,
+    size_t *busyp,
+    size_t *runnablep);
+
+/**
+   Ask one idle db thread to exit.  The first db thread to find it
+   has nothing to service takes the request, so a thread that is busy
+   with a query is never the one retired.
+*/
+void db_scheduler_retire(
+    struct db_scheduler *scheduler);
+
+/**
+   Called by a db thread before it looks for work.
+
+   @return
+       true if the thread should exit; it must then call
+       db_scheduler_retired() once it's done cleaning up.
+*/
+bool db_scheduler_should_retire(
+    struct db_scheduler *scheduler);
+
+/** Record that @p thread has finished and can be joined. */
+void db_scheduler_retired(
+    struct db_scheduler *scheduler,
+    pthread_t thread);
+
+/**
+   Take one thread recorded by db_scheduler_retired(), without waiting.
+
+   @return
+       false if there is none.
+*/
+bool db_scheduler_reap(
+    struct db_scheduler *scheduler,
+    pthread_t *threadp);
+
+#endif
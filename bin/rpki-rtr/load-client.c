@@ -0,0 +1,991 @@
+/************************
+ * Load generator for rpki-rtr-daemon
+ *
+ * Opens many RPKI-Router sessions at once, runs a mix of Reset Queries
+ * and Serial Queries on each of them, checks that every response is a
+ * well-formed PDU sequence, and reports throughput and latency.  All
+ * sessions are driven from one thread with non-blocking sockets, so the
+ * client isn't what limits the number of sessions.
+ *
+ * Each session starts with a Reset Query.  After that, each query is a
+ * Serial Query (from the serial number in the last End of Data, or the
+ * one given with -S) with the chance given by -s, and a Reset Query
+ * otherwise.  A Cache Reset makes the session's next query a Reset
+ * Query.
+ *
+ * Results are printed one per line as "name value", so they can be
+ * compared between runs.  Latencies are in milliseconds, from sending a
+ * query to receiving the first PDU of the response ("first_pdu") and to
+ * receiving its End of Data ("end_of_data").
+ ***********************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "util/logging.h"
+
+#include "rpki-rtr/pdu.h"
+
+
+// Each session buffers at most this much of a response.  rpki-rtr-daemon
+// never sends a PDU anywhere near this long.
+#define READ_BUFFER_SIZE 8192
+
+// Only this many failed sessions are described on stderr; the rest are
+// just counted.
+#define MAX_REPORTED_FAILURES 10
+
+
+enum query_kind {
+    QUERY_RESET,
+    QUERY_SERIAL,
+    NUM_QUERY_KINDS
+};
+
+static const char *const query_kind_names[NUM_QUERY_KINDS] = {
+    "reset_query",
+    "serial_query",
+};
+
+enum session_state {
+    SESSION_CONNECTING,
+    SESSION_IDLE,               // between queries
+    SESSION_WAITING,            // query sent, no response yet
+    SESSION_RECEIVING,          // got Cache Response, waiting for End of Data
+    SESSION_DONE
+};
+
+struct session {
+    int fd;
+    enum session_state state;
+
+    // the latest End of Data, valid if have_data is true
+    bool have_data;
+    session_id_t session_id;
+    serial_number_t serial;
+
+    // the query in progress
+    enum query_kind kind;
+    session_id_t query_session_id;
+    uint64_t query_sent;        // ns
+    uint8_t query[MAX_QUERY_PDU_LENGTH];
+    size_t query_length;
+    size_t query_written;
+
+    // when to send the next query, in state SESSION_IDLE
+    uint64_t next_query;
+
+    size_t queries_done;
+    uint64_t connect_started;   // ns
+
+    uint8_t buffer[READ_BUFFER_SIZE];
+    size_t buffered;
+};
+
+struct latencies {
+    uint64_t *ns;
+    size_t count;
+    size_t capacity;
+};
+
+struct options {
+    const char *host;
+    const char *port;
+    size_t num_sessions;
+    size_t queries_per_session; // 0 for no limit
+    unsigned int duration;      // seconds, 0 for no limit
+    unsigned int serial_percent;
+    bool fixed_serial_given;
+    serial_number_t fixed_serial;
+    uint8_t version;
+    unsigned int think_time;    // ms between queries on a session
+    unsigned int query_timeout; // seconds
+    unsigned int seed;
+};
+
+struct stats {
+    size_t queries[NUM_QUERY_KINDS];
+    size_t cache_resets;
+    size_t serial_notifies;
+    size_t pdus;
+    size_t prefixes;
+    size_t router_keys;
+    size_t sessions_failed;
+    uint64_t bytes;
+
+    struct latencies connect;
+    struct latencies first_pdu[NUM_QUERY_KINDS];
+    struct latencies end_of_data[NUM_QUERY_KINDS];
+};
+
+
+static struct options options;
+static struct stats stats;
+
+
+static uint64_t now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static bool latencies_add(
+    struct latencies *latencies,
+    uint64_t ns)
+{
+    if (latencies->count >= latencies->capacity)
+    {
+        size_t capacity =
+            latencies->capacity == 0 ? 1024 : latencies->capacity * 2;
+        uint64_t *new_ns = realloc(latencies->ns, capacity * sizeof(*new_ns));
+        if (new_ns == NULL)
+            return false;
+        latencies->ns = new_ns;
+        latencies->capacity = capacity;
+    }
+
+    latencies->ns[latencies->count++] = ns;
+    return true;
+}
+
+static int compare_uint64(
+    const void *a,
+    const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/** Print the count and percentiles of latencies as name_count etc. */
+static void latencies_print(
+    const char *name,
+    struct latencies *latencies)
+{
+    static const struct {
+        const char *suffix;
+        unsigned int per_thousand;
+    } percentiles[] = {
+        {"p50", 500},
+        {"p90", 900},
+        {"p99", 990},
+        {"p999", 999},
+    };
+    size_t i;
+    size_t index;
+
+    printf("%s_count %zu\n", name, latencies->count);
+    if (latencies->count == 0)
+        return;
+
+    qsort(latencies->ns, latencies->count, sizeof(*latencies->ns),
+          compare_uint64);
+
+    for (i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i)
+    {
+        // nearest rank
+        index = (latencies->count * percentiles[i].per_thousand + 999) / 1000;
+        if (index > 0)
+            --index;
+        printf("%s_ms_%s %.3f\n", name, percentiles[i].suffix,
+               latencies->ns[index] / 1e6);
+    }
+    printf("%s_ms_max %.3f\n", name,
+           latencies->ns[latencies->count - 1] / 1e6);
+}
+
+
+static void session_close(
+    struct session *session)
+{
+    if (session->fd >= 0)
+    {
+        close(session->fd);
+        session->fd = -1;
+    }
+    session->state = SESSION_DONE;
+}
+
+static void session_fail(
+    struct session *sessions,
+    struct session *session,
+    const char *format,
+    ...)
+    WARN_PRINTF(3, 4);
+
+static void session_fail(
+    struct session *sessions,
+    struct session *session,
+    const char *format,
+    ...)
+{
+    va_list ap;
+
+    if (stats.sessions_failed < MAX_REPORTED_FAILURES)
+    {
+        fprintf(stderr, "session %zu: ", (size_t)(session - sessions));
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        fputc('\n', stderr);
+    }
+    else if (stats.sessions_failed == MAX_REPORTED_FAILURES)
+    {
+        fputs("(not reporting any more failed sessions)\n", stderr);
+    }
+
+    ++stats.sessions_failed;
+    session_close(session);
+}
+
+
+static bool session_start(
+    struct session *sessions,
+    struct session *session,
+    const struct addrinfo *addr)
+{
+    session->have_data = false;
+    session->queries_done = 0;
+    session->buffered = 0;
+
+    session->fd = socket(addr->ai_family, addr->ai_socktype,
+                         addr->ai_protocol);
+    if (session->fd < 0)
+    {
+        session->state = SESSION_CONNECTING;
+        session_fail(sessions, session, "socket(): %s", strerror(errno));
+        return false;
+    }
+
+    session->state = SESSION_CONNECTING;
+    session->connect_started = now_ns();
+
+    if (fcntl(session->fd, F_SETFL, O_NONBLOCK) != 0)
+    {
+        session_fail(sessions, session, "fcntl(): %s", strerror(errno));
+        return false;
+    }
+
+    if (connect(session->fd, addr->ai_addr, addr->ai_addrlen) != 0 &&
+        errno != EINPROGRESS)
+    {
+        session_fail(sessions, session, "connect(): %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+
+static void session_write(
+    struct session *sessions,
+    struct session *session)
+{
+    ssize_t retval;
+
+    retval = write(session->fd, session->query + session->query_written,
+                   session->query_length - session->query_written);
+    if (retval < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            session_fail(sessions, session, "write(): %s", strerror(errno));
+        return;
+    }
+
+    session->query_written += retval;
+}
+
+
+/** Send the session's next query, or as much of it as can be sent now. */
+static bool session_query(
+    struct session *sessions,
+    struct session *session)
+{
+    PDU pdu;
+    ssize_t length;
+
+    if (session->have_data &&
+        (unsigned int)(random() % 100) < options.serial_percent)
+    {
+        session->kind = QUERY_SERIAL;
+        session->query_session_id = session->session_id;
+        fill_pdu_serial_query(&pdu, options.version, session->session_id,
+                              options.fixed_serial_given ?
+                              options.fixed_serial : session->serial);
+    }
+    else
+    {
+        session->kind = QUERY_RESET;
+        fill_pdu_reset_query(&pdu, options.version);
+    }
+
+    length = dump_pdu(session->query, sizeof(session->query), &pdu);
+    if (length < 0)
+    {
+        session_fail(sessions, session, "can't dump query PDU");
+        return false;
+    }
+
+    session->query_length = length;
+    session->query_written = 0;
+    session->query_sent = now_ns();
+    session->state = SESSION_WAITING;
+
+    session_write(sessions, session);
+    return session->state != SESSION_DONE;
+}
+
+
+/** The current query got its whole response. */
+static void session_query_done(
+    struct session *session,
+    uint64_t now)
+{
+    ++stats.queries[session->kind];
+    ++session->queries_done;
+
+    if (options.queries_per_session != 0 &&
+        session->queries_done >= options.queries_per_session)
+    {
+        session_close(session);
+        return;
+    }
+
+    session->state = SESSION_IDLE;
+    session->next_query = now + (uint64_t)options.think_time * 1000000;
+}
+
+
+/**
+    Check one PDU from the server against what the session expects.
+
+    @return
+        Whether the PDU was acceptable.  If not, the session has been
+        failed.
+*/
+static bool session_handle_pdu(
+    struct session *sessions,
+    struct session *session,
+    const PDU * pdu,
+    uint64_t now)
+{
+    char sprint_buffer[PDU_SPRINT_BUFSZ];
+
+    ++stats.pdus;
+
+    // The daemon sends a Serial Notify in version 0 if it comes before
+    // the version is negotiated.
+    if (pdu->protocolVersion != options.version &&
+        !(pdu->pduType == PDU_SERIAL_NOTIFY && !session->have_data &&
+          session->state != SESSION_RECEIVING))
+    {
+        pdu_sprint(pdu, sprint_buffer);
+        session_fail(sessions, session, "unexpected version: %s",
+                     sprint_buffer);
+        return false;
+    }
+
+    if (pdu->pduType == PDU_SERIAL_NOTIFY)
+    {
+        ++stats.serial_notifies;
+        return true;
+    }
+
+    if (pdu->pduType == PDU_ERROR_REPORT)
+    {
+        pdu_sprint(pdu, sprint_buffer);
+        session_fail(sessions, session, "received %s", sprint_buffer);
+        return false;
+    }
+
+    if (session->state == SESSION_WAITING)
+    {
+        if (!latencies_add(&stats.first_pdu[session->kind],
+                           now - session->query_sent))
+        {
+            session_fail(sessions, session, "out of memory");
+            return false;
+        }
+
+        switch (pdu->pduType)
+        {
+        case PDU_CACHE_RESPONSE:
+            if (session->kind == QUERY_SERIAL &&
+                pdu->sessionId != session->query_session_id)
+            {
+                session_fail(sessions, session,
+                             "Cache Response for session %" PRISESSION
+                             " to a Serial Query for session %" PRISESSION,
+                             pdu->sessionId, session->query_session_id);
+                return false;
+            }
+            session->session_id = pdu->sessionId;
+            session->state = SESSION_RECEIVING;
+            return true;
+
+        case PDU_CACHE_RESET:
+            if (session->kind != QUERY_SERIAL)
+            {
+                session_fail(sessions, session,
+                             "Cache Reset in response to a Reset Query");
+                return false;
+            }
+            ++stats.cache_resets;
+            session->have_data = false;
+            session_query_done(session, now);
+            return true;
+
+        default:
+            break;
+        }
+    }
+    else if (session->state == SESSION_RECEIVING)
+    {
+        switch (pdu->pduType)
+        {
+        case PDU_IPV4_PREFIX:
+        case PDU_IPV6_PREFIX:
+            // ip4PrefixData.flags and ip6PrefixData.flags are at the
+            // same place
+            if (session->kind == QUERY_RESET &&
+                !(pdu->ip4PrefixData.flags & FLAG_WITHDRAW_ANNOUNCE))
+            {
+                pdu_sprint(pdu, sprint_buffer);
+                session_fail(sessions, session,
+                             "withdrawal in response to a Reset Query: %s",
+                             sprint_buffer);
+                return false;
+            }
+            ++stats.prefixes;
+            return true;
+
+        case PDU_ROUTER_KEY:
+            if (session->kind == QUERY_RESET &&
+                !(pdu->routerKeyHeader.flags & FLAG_WITHDRAW_ANNOUNCE))
+            {
+                pdu_sprint(pdu, sprint_buffer);
+                session_fail(sessions, session,
+                             "withdrawal in response to a Reset Query: %s",
+                             sprint_buffer);
+                return false;
+            }
+            ++stats.router_keys;
+            return true;
+
+        case PDU_END_OF_DATA:
+            if (pdu->sessionId != session->session_id)
+            {
+                session_fail(sessions, session,
+                             "End of Data for session %" PRISESSION
+                             " after Cache Response for session %"
+                             PRISESSION, pdu->sessionId,
+                             session->session_id);
+                return false;
+            }
+            if (!latencies_add(&stats.end_of_data[session->kind],
+                               now - session->query_sent))
+            {
+                session_fail(sessions, session, "out of memory");
+                return false;
+            }
+            session->have_data = true;
+            session->serial = pdu->endOfData.serialNumber;
+            session_query_done(session, now);
+            return true;
+
+        default:
+            break;
+        }
+    }
+
+    pdu_sprint(pdu, sprint_buffer);
+    session_fail(sessions, session, "unexpected PDU: %s", sprint_buffer);
+    return false;
+}
+
+
+static void session_read(
+    struct session *sessions,
+    struct session *session,
+    uint64_t now)
+{
+    PDU pdu;
+    ssize_t retval;
+    size_t offset = 0;
+
+    retval = read(session->fd, session->buffer + session->buffered,
+                  sizeof(session->buffer) - session->buffered);
+    if (retval < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            session_fail(sessions, session, "read(): %s", strerror(errno));
+        return;
+    }
+    else if (retval == 0)
+    {
+        session_fail(sessions, session, "server closed the connection");
+        return;
+    }
+
+    stats.bytes += retval;
+    session->buffered += retval;
+
+    while (session->state != SESSION_DONE && offset < session->buffered)
+    {
+        switch (parse_pdu(session->buffer + offset,
+                          session->buffered - offset, &pdu))
+        {
+        case PDU_GOOD:
+        case PDU_WARNING:
+            if (!session_handle_pdu(sessions, session, &pdu, now))
+                return;
+            offset += pdu.length;
+            break;
+
+        case PDU_TRUNCATED:
+            if (session->buffered - offset >= PDU_HEADER_LENGTH &&
+                pdu.length > sizeof(session->buffer))
+            {
+                session_fail(sessions, session,
+                             "received %" PRIu32 "-byte PDU (maximum size "
+                             "is %zu)", pdu.length, sizeof(session->buffer));
+                return;
+            }
+            goto done;
+
+        default:
+            session_fail(sessions, session, "received invalid PDU");
+            return;
+        }
+    }
+
+done:
+    if (session->state != SESSION_DONE)
+    {
+        memmove(session->buffer, session->buffer + offset,
+                session->buffered - offset);
+        session->buffered -= offset;
+    }
+}
+
+
+static void session_connected(
+    struct session *sessions,
+    struct session *session,
+    uint64_t now)
+{
+    int error;
+    socklen_t len = sizeof(error);
+
+    if (getsockopt(session->fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+    {
+        session_fail(sessions, session, "getsockopt(): %s", strerror(errno));
+        return;
+    }
+    if (error != 0)
+    {
+        session_fail(sessions, session, "connect(): %s", strerror(error));
+        return;
+    }
+
+    if (!latencies_add(&stats.connect, now - session->connect_started))
+    {
+        session_fail(sessions, session, "out of memory");
+        return;
+    }
+
+    session_query(sessions, session);
+}
+
+
+/** Make sure there are enough file descriptors for every session. */
+static bool raise_fd_limit(
+    size_t num_sessions)
+{
+    struct rlimit limit;
+    rlim_t needed = num_sessions + 16;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    {
+        perror("getrlimit()");
+        return false;
+    }
+
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed)
+    {
+        if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < needed)
+        {
+            fprintf(stderr, "%zu sessions need %lu file descriptors, but the "
+                    "limit is %lu\n", num_sessions, (unsigned long)needed,
+                    (unsigned long)limit.rlim_max);
+            return false;
+        }
+        limit.rlim_cur = needed;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+        {
+            perror("setrlimit()");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void print_results(
+    uint64_t elapsed)
+{
+    double seconds = elapsed / 1e9;
+    size_t total_queries = 0;
+    size_t i;
+    char name[64];
+
+    for (i = 0; i < NUM_QUERY_KINDS; ++i)
+        total_queries += stats.queries[i];
+
+    printf("sessions %zu\n", options.num_sessions);
+    printf("sessions_failed %zu\n", stats.sessions_failed);
+    printf("elapsed_s %.3f\n", seconds);
+    printf("queries %zu\n", total_queries);
+    for (i = 0; i < NUM_QUERY_KINDS; ++i)
+        printf("%s %zu\n", query_kind_names[i], stats.queries[i]);
+    printf("cache_resets %zu\n", stats.cache_resets);
+    printf("serial_notifies %zu\n", stats.serial_notifies);
+    printf("pdus %zu\n", stats.pdus);
+    printf("prefixes %zu\n", stats.prefixes);
+    printf("router_keys %zu\n", stats.router_keys);
+    printf("bytes %" PRIu64 "\n", stats.bytes);
+    if (seconds > 0)
+    {
+        printf("queries_per_s %.1f\n", total_queries / seconds);
+        printf("pdus_per_s %.1f\n", stats.pdus / seconds);
+        printf("mbytes_per_s %.3f\n", stats.bytes / seconds / 1e6);
+    }
+
+    latencies_print("connect", &stats.connect);
+    for (i = 0; i < NUM_QUERY_KINDS; ++i)
+    {
+        snprintf(name, sizeof(name), "%s_first_pdu", query_kind_names[i]);
+        latencies_print(name, &stats.first_pdu[i]);
+        snprintf(name, sizeof(name), "%s_end_of_data", query_kind_names[i]);
+        latencies_print(name, &stats.end_of_data[i]);
+    }
+}
+
+
+static int run(
+    void)
+{
+    struct addrinfo hints,
+       *addr;
+    struct session *sessions;
+    struct pollfd *pfds;
+    size_t *pfd_sessions;
+    size_t num_pfds;
+    size_t i;
+    int retval;
+    int timeout;
+    uint64_t start,
+        now,
+        deadline,
+        wake;
+    bool stopping = false;
+    bool active;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    retval = getaddrinfo(options.host, options.port, &hints, &addr);
+    if (retval != 0)
+    {
+        fprintf(stderr, "getaddrinfo(): %s\n", gai_strerror(retval));
+        return EXIT_FAILURE;
+    }
+
+    sessions = calloc(options.num_sessions, sizeof(*sessions));
+    pfds = calloc(options.num_sessions, sizeof(*pfds));
+    pfd_sessions = calloc(options.num_sessions, sizeof(*pfd_sessions));
+    if (sessions == NULL || pfds == NULL || pfd_sessions == NULL)
+    {
+        fputs("out of memory\n", stderr);
+        free(sessions);
+        free(pfds);
+        free(pfd_sessions);
+        freeaddrinfo(addr);
+        return EXIT_FAILURE;
+    }
+
+    srandom(options.seed);
+
+    start = now_ns();
+    deadline = options.duration == 0 ? UINT64_MAX :
+        start + (uint64_t)options.duration * 1000000000;
+
+    for (i = 0; i < options.num_sessions; ++i)
+        session_start(sessions, &sessions[i], addr);
+
+    freeaddrinfo(addr);
+
+    while (true)
+    {
+        now = now_ns();
+        if (now >= deadline)
+            stopping = true;
+
+        // Start queries that are due, and find out when the next one is.
+        wake = stopping ? UINT64_MAX : deadline;
+        num_pfds = 0;
+        active = false;
+        for (i = 0; i < options.num_sessions; ++i)
+        {
+            struct session *session = &sessions[i];
+
+            if (session->state == SESSION_IDLE)
+            {
+                if (stopping)
+                {
+                    session_close(session);
+                    continue;
+                }
+                if (session->next_query <= now)
+                {
+                    if (!session_query(sessions, session))
+                        continue;
+                }
+                else if (session->next_query < wake)
+                {
+                    wake = session->next_query;
+                }
+            }
+
+            if (session->state == SESSION_WAITING ||
+                session->state == SESSION_RECEIVING)
+            {
+                uint64_t query_deadline = session->query_sent +
+                    (uint64_t)options.query_timeout * 1000000000;
+                if (now >= query_deadline)
+                {
+                    session_fail(sessions, session,
+                                 "no End of Data after %u seconds",
+                                 options.query_timeout);
+                    continue;
+                }
+                if (query_deadline < wake)
+                    wake = query_deadline;
+            }
+
+            if (session->state == SESSION_DONE)
+                continue;
+
+            active = true;
+            pfds[num_pfds].fd = session->fd;
+            pfds[num_pfds].events = POLLIN;
+            if (session->state == SESSION_CONNECTING ||
+                (session->state == SESSION_WAITING &&
+                 session->query_written < session->query_length))
+            {
+                pfds[num_pfds].events |= POLLOUT;
+            }
+            pfds[num_pfds].revents = 0;
+            pfd_sessions[num_pfds] = i;
+            ++num_pfds;
+        }
+
+        if (!active)
+            break;
+
+        if (wake == UINT64_MAX)
+            timeout = -1;
+        else if (wake <= now)
+            timeout = 0;
+        else
+            timeout = (wake - now + 999999) / 1000000;
+
+        retval = poll(pfds, num_pfds, timeout);
+        if (retval < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll()");
+            break;
+        }
+
+        now = now_ns();
+        for (i = 0; i < num_pfds && retval > 0; ++i)
+        {
+            struct session *session = &sessions[pfd_sessions[i]];
+
+            if (pfds[i].revents == 0)
+                continue;
+            --retval;
+
+            if (session->state == SESSION_CONNECTING)
+            {
+                session_connected(sessions, session, now);
+                continue;
+            }
+
+            if (pfds[i].revents & POLLOUT)
+                session_write(sessions, session);
+
+            if (session->state != SESSION_DONE &&
+                (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                session_read(sessions, session, now);
+            }
+        }
+    }
+
+    print_results(now_ns() - start);
+
+    for (i = 0; i < options.num_sessions; ++i)
+        session_close(&sessions[i]);
+    free(sessions);
+    free(pfds);
+    free(pfd_sessions);
+
+    return stats.sessions_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+static void usage(
+    const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <host> <port>\n"
+            "\n"
+            "Options:\n"
+            "    -c <sessions>  Number of concurrent sessions (default 100).\n"
+            "    -n <queries>   Queries per session, 0 for no limit (default 10).\n"
+            "    -d <seconds>   Stop starting queries after this long, 0 for no\n"
+            "                   limit (default 0).  Either -n or -d must limit\n"
+            "                   the run.\n"
+            "    -s <percent>   Chance that a query after the first is a Serial\n"
+            "                   Query (default 90).\n"
+            "    -S <serial>    Serial number for Serial Queries (default: the\n"
+            "                   one from the session's last End of Data).\n"
+            "    -v <version>   Protocol version (default %d).\n"
+            "    -w <ms>        Time between queries on a session (default 0).\n"
+            "    -t <seconds>   Fail a session whose query takes longer than\n"
+            "                   this (default 60).\n"
+            "    -r <seed>      Seed for choosing queries (default 1).\n",
+            argv0, RTR_PROTOCOL_VERSION);
+}
+
+static bool parse_unsigned(
+    const char *arg,
+    unsigned long max,
+    unsigned long *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtoul(arg, &end, 10);
+    return errno == 0 && *arg != '\0' && *arg != '-' && *end == '\0' &&
+        *value <= max;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    unsigned long value;
+    int c;
+    bool ok = true;
+
+    OPEN_LOG("rtr-load-client", LOG_USER);
+
+    options.num_sessions = 100;
+    options.queries_per_session = 10;
+    options.duration = 0;
+    options.serial_percent = 90;
+    options.fixed_serial_given = false;
+    options.version = RTR_PROTOCOL_VERSION;
+    options.think_time = 0;
+    options.query_timeout = 60;
+    options.seed = 1;
+
+    while ((c = getopt(argc, argv, "c:n:d:s:S:v:w:t:r:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            ok = ok && parse_unsigned(optarg, 1000000, &value) && value > 0;
+            options.num_sessions = value;
+            break;
+        case 'n':
+            ok = ok && parse_unsigned(optarg, SIZE_MAX, &value);
+            options.queries_per_session = value;
+            break;
+        case 'd':
+            ok = ok && parse_unsigned(optarg, 1000000, &value);
+            options.duration = value;
+            break;
+        case 's':
+            ok = ok && parse_unsigned(optarg, 100, &value);
+            options.serial_percent = value;
+            break;
+        case 'S':
+            ok = ok && parse_unsigned(optarg, UINT32_MAX, &value);
+            options.fixed_serial_given = true;
+            options.fixed_serial = value;
+            break;
+        case 'v':
+            ok = ok && parse_unsigned(optarg, RTR_PROTOCOL_VERSION, &value);
+            options.version = value;
+            break;
+        case 'w':
+            ok = ok && parse_unsigned(optarg, 1000000, &value);
+            options.think_time = value;
+            break;
+        case 't':
+            ok = ok && parse_unsigned(optarg, 1000000, &value) && value > 0;
+            options.query_timeout = value;
+            break;
+        case 'r':
+            ok = ok && parse_unsigned(optarg, UINT_MAX, &value);
+            options.seed = value;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            ok = false;
+            break;
+        }
+    }
+
+    if (!ok || argc - optind != 2 ||
+        (options.queries_per_session == 0 && options.duration == 0))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    options.host = argv[optind];
+    options.port = argv[optind + 1];
+
+    if (!raise_fd_limit(options.num_sessions))
+        return EXIT_FAILURE;
+
+    return run();
+}
@@ -11,18 +11,26 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <netdb.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
 
+#include "util/async_log.h"
 #include "util/bag.h"
 #include "util/queue.h"
 #include "util/logging.h"
 #include "config/config.h"
 #include "db/connect.h"
+#include "rpki-rtr/notify.h"
 
 #include "cache_state.h"
 #include "config.h"
 #include "signals.h"
 
 #include "db.h"
+#include "db_scheduler.h"
 #include "connection_control.h"
 
 
@@ -48,11 +56,21 @@ struct run_state {
 
     bool config_loaded;
 
+    // whether this is a worker process started by the supervisor
+    bool is_worker;
+
     size_t listen_fds_initialized;
     int listen_fds[MAX_LISTENING_SOCKETS];
 
+    // receives notifications from rpki-rtr-update (or, in a worker,
+    // from the supervisor), -1 if not in use
+    int notify_fd;
+
+    // written to by main to make cxnctl wake up every cxn
+    int wakeup_fds[2];
+
     Queue *db_request_queue;
-    Bag *db_currently_processing;
+    struct db_scheduler *db_scheduler;
 
     db_semaphore_t * db_semaphore;
 
@@ -66,6 +84,12 @@ struct run_state {
 
     Bag *db_threads;
 
+    // consecutive pool checks that found the db threads underused
+    unsigned int db_idle_checks;
+
+    // db threads asked to exit that haven't been joined yet
+    size_t db_retiring;
+
     bool connection_control_thread_initialized;
     pthread_t connection_control_thread;
 
@@ -81,10 +105,17 @@ static void initialize_run_state(
 {
     run_state->log_opened = false;
 
+    run_state->is_worker = false;
+
     run_state->listen_fds_initialized = 0;
 
+    run_state->notify_fd = -1;
+
+    run_state->wakeup_fds[0] = -1;
+    run_state->wakeup_fds[1] = -1;
+
     run_state->db_request_queue = NULL;
-    run_state->db_currently_processing = NULL;
+    run_state->db_scheduler = NULL;
 
     run_state->db_semaphore = SEM_FAILED;
 
@@ -97,14 +128,24 @@ static void initialize_run_state(
 
     run_state->db_threads = NULL;
 
+    run_state->db_idle_checks = 0;
+
+    run_state->db_retiring = 0;
+
     run_state->connection_control_thread_initialized = false;
 }
 
 
+/**
+    Bind and listen on every address for node and service.  If
+    reuse_port is true, other processes can bind the same addresses, and
+    the kernel spreads incoming connections across all of them.
+*/
 static void make_listen_sockets(
     struct run_state *run_state,
     const char *node,
-    const char *service)
+    const char *service,
+    bool reuse_port)
 {
     int retval;
     struct addrinfo hints,
@@ -168,6 +209,24 @@ static void make_listen_sockets(
             }
         }
 
+#ifdef SO_REUSEPORT
+        if (reuse_port)
+        {
+            int optval = true;
+            if (setsockopt
+                (run_state->listen_fds[run_state->listen_fds_initialized - 1],
+                 SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) != 0)
+            {
+                ERR_LOG(errno, errorbuf, "setsockopt(SO_REUSEPORT)");
+                freeaddrinfo(res);
+                exit_code = EXIT_FAILURE;
+                pthread_exit(NULL);
+            }
+        }
+#else
+        (void)reuse_port;
+#endif
+
         retval = getnameinfo(resp->ai_addr, resp->ai_addrlen,
                              listen_host, sizeof(listen_host),
                              listen_serv, sizeof(listen_serv),
@@ -334,11 +393,120 @@ static void cancel_all_db_threads(
 }
 
 
+/**
+    Join the db threads that have exited after db_scheduler_retire().
+    Threads record themselves only once they're done, so this doesn't
+    wait on a thread that's still working.
+*/
+static void reap_db_threads(
+    struct run_state *run_state)
+{
+    Bag_iterator it;
+    pthread_t *thread;
+    pthread_t retired;
+    int retval;
+
+    while (db_scheduler_reap(run_state->db_scheduler, &retired))
+    {
+        block_signals();
+
+        if (!Bag_start_iteration(run_state->db_threads))
+        {
+            LOG(LOG_ERR, "error in Bag_start_iteration(db_threads)");
+            unblock_signals();
+            return;
+        }
+
+        for (it = Bag_begin(run_state->db_threads);
+             it != Bag_end(run_state->db_threads);
+             it = Bag_iterator_next(run_state->db_threads, it))
+        {
+            thread = Bag_get(run_state->db_threads, it);
+            if (thread != NULL && pthread_equal(*thread, retired))
+                break;
+        }
+
+        if (it != Bag_end(run_state->db_threads))
+        {
+            retval = pthread_join(*thread, NULL);
+            if (retval != 0)
+            {
+                ERR_LOG(retval, errorbuf, "pthread_join()");
+            }
+
+            Bag_erase(run_state->db_threads, it);
+            free((void *)thread);
+        }
+        else
+        {
+            LOG(LOG_ERR, "retired db thread isn't in db_threads");
+        }
+
+        Bag_stop_iteration(run_state->db_threads);  // return value doesn't
+                                                    // really matter here
+
+        unblock_signals();
+
+        if (run_state->db_retiring > 0)
+            --run_state->db_retiring;
+    }
+}
+
+
+/**
+    Add a db thread if requests are waiting for one, or remove one if
+    the pool has been mostly idle for a while.
+*/
+static void adjust_db_threads(
+    struct run_state *run_state)
+{
+    size_t num_threads;
+    size_t busy,
+        runnable;
+
+    reap_db_threads(run_state);
+    num_threads = Bag_size(run_state->db_threads) - run_state->db_retiring;
+
+    db_scheduler_load(run_state->db_scheduler, &busy, &runnable);
+
+    if (busy + runnable > num_threads && num_threads < DB_MAX_THREADS)
+    {
+        run_state->db_idle_checks = 0;
+        if (create_db_thread(run_state))
+        {
+            LOG(LOG_INFO, "added a db thread (now %zu, %zu busy, "
+                "%zu requests waiting)", num_threads + 1, busy, runnable);
+        }
+        else
+        {
+            LOG(LOG_WARNING, "can't add a db thread");
+        }
+    }
+    else if (busy + runnable <= num_threads / 2 &&
+             num_threads > DB_INITIAL_THREADS)
+    {
+        if (++run_state->db_idle_checks >= DB_POOL_SHRINK_CHECKS)
+        {
+            run_state->db_idle_checks = 0;
+            db_scheduler_retire(run_state->db_scheduler);
+            ++run_state->db_retiring;
+            LOG(LOG_INFO, "retiring an idle db thread (now %zu)",
+                num_threads - 1);
+        }
+    }
+    else
+    {
+        run_state->db_idle_checks = 0;
+    }
+}
+
+
 static void cleanup(
     void *run_state_voidp)
 {
     struct run_state *run_state = (struct run_state *)run_state_voidp;
     int retval;
+    int i;
 
     if (run_state->connection_control_thread_initialized)
     {
@@ -420,10 +588,10 @@ static void cleanup(
         run_state->db_semaphore = SEM_FAILED;
     }
 
-    if (run_state->db_currently_processing != NULL)
+    if (run_state->db_scheduler != NULL)
     {
-        Bag_free(run_state->db_currently_processing);
-        run_state->db_currently_processing = NULL;
+        db_scheduler_free(run_state->db_scheduler);
+        run_state->db_scheduler = NULL;
     }
 
     if (run_state->db_request_queue != NULL)
@@ -432,6 +600,23 @@ static void cleanup(
         run_state->db_request_queue = NULL;
     }
 
+    for (i = 0; i < 2; ++i)
+    {
+        if (run_state->wakeup_fds[i] >= 0 &&
+            close(run_state->wakeup_fds[i]) != 0)
+            ERR_LOG(errno, errorbuf, "close()");
+        run_state->wakeup_fds[i] = -1;
+    }
+
+    if (run_state->notify_fd >= 0)
+    {
+        // a worker's notify_fd isn't bound to the socket path
+        rtr_notify_close(run_state->notify_fd,
+                         run_state->is_worker ? NULL :
+                         CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+        run_state->notify_fd = -1;
+    }
+
     for (; run_state->listen_fds_initialized > 0;
          --run_state->listen_fds_initialized)
     {
@@ -459,12 +644,20 @@ static void cleanup(
 }
 
 
-static void startup(
-    struct run_state *run_state)
+/** Start buffering log messages if LogBufferSize is set. */
+static void start_log_buffer(
+    void)
 {
-    int retval,
-        i;
+    if (CONFIG_LOG_BUFFER_SIZE_get() > 0 &&
+        !async_log_start(CONFIG_LOG_BUFFER_SIZE_get()))
+    {
+        LOG(LOG_WARNING, "can't buffer log messages, logging synchronously");
+    }
+}
 
+static void load_config(
+    struct run_state *run_state)
+{
     block_signals();
     OPEN_LOG(RTR_LOG_IDENT, RTR_LOG_FACILITY);
     run_state->log_opened = true;
@@ -478,9 +671,59 @@ static void startup(
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
+
+    // check before listening, not when the db threads start
+    if (!db_backend_supported())
+    {
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+
+    // db threads put these in version 1 End of Data PDUs without
+    // checking them.
+    if (CONFIG_RPKI_RTR_REFRESH_INTERVAL_get() > UINT32_MAX ||
+        CONFIG_RPKI_RTR_RETRY_INTERVAL_get() > UINT32_MAX ||
+        CONFIG_RPKI_RTR_EXPIRE_INTERVAL_get() > UINT32_MAX ||
+        !rtr_intervals_valid(CONFIG_RPKI_RTR_REFRESH_INTERVAL_get(),
+                             CONFIG_RPKI_RTR_RETRY_INTERVAL_get(),
+                             CONFIG_RPKI_RTR_EXPIRE_INTERVAL_get()))
+    {
+        LOG(LOG_ERR, "invalid RpkiRtrRefreshInterval, RpkiRtrRetryInterval, "
+            "or RpkiRtrExpireInterval (see RFC 8210, Section 6)");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+
+    if (CONFIG_RPKI_RTR_WORKERS_get() < 1 ||
+        CONFIG_RPKI_RTR_WORKERS_get() > MAX_WORKERS)
+    {
+        LOG(LOG_ERR, "RpkiRtrWorkers must be between 1 and %d",
+            MAX_WORKERS);
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+#ifndef SO_REUSEPORT
+    if (CONFIG_RPKI_RTR_WORKERS_get() > 1)
+    {
+        LOG(LOG_ERR, "RpkiRtrWorkers can't be more than 1 on this system "
+            "because it doesn't support SO_REUSEPORT");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+#endif
+
+    start_log_buffer();
     unblock_signals();
+}
 
-    make_listen_sockets(run_state, NULL, LISTEN_PORT);
+
+static void startup(
+    struct run_state *run_state)
+{
+    int retval,
+        i;
+
+    make_listen_sockets(run_state, NULL, LISTEN_PORT, run_state->is_worker);
 
     if (run_state->listen_fds_initialized <= 0)
     {
@@ -490,21 +733,48 @@ static void startup(
         pthread_exit(NULL);
     }
 
+    // A worker's notify_fd was set up by the supervisor, which has been
+    // listening since before the worker started.
+    if (!run_state->is_worker)
+    {
+        block_signals();
+        // This must be done before the cache state is first read so
+        // that no update can be missed between the two.
+        run_state->notify_fd =
+            rtr_notify_listen(CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+        if (run_state->notify_fd < 0)
+        {
+            ERR_LOG(errno, errorbuf,
+                    "can't listen for notifications on %s, "
+                    "polling the database every %d seconds instead",
+                    CONFIG_RPKI_RTR_NOTIFY_SOCKET_get(), MAIN_LOOP_INTERVAL);
+        }
+        unblock_signals();
+    }
+
     block_signals();
-    run_state->db_request_queue = Queue_new(true);
-    if (run_state->db_request_queue == NULL)
+    if (pipe(run_state->wakeup_fds) != 0)
     {
-        LOG(LOG_ERR, "can't create db_request_queue");
+        ERR_LOG(errno, errorbuf, "pipe()");
+        run_state->wakeup_fds[0] = -1;
+        run_state->wakeup_fds[1] = -1;
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    if (fcntl(run_state->wakeup_fds[0], F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(run_state->wakeup_fds[1], F_SETFL, O_NONBLOCK) != 0)
+    {
+        ERR_LOG(errno, errorbuf, "fcntl() on wakeup pipe");
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
     unblock_signals();
 
     block_signals();
-    run_state->db_currently_processing = Bag_new(true);
-    if (run_state->db_currently_processing == NULL)
+    run_state->db_request_queue = Queue_new(true);
+    if (run_state->db_request_queue == NULL)
     {
-        LOG(LOG_ERR, "can't create db_currently_processing");
+        LOG(LOG_ERR, "can't create db_request_queue");
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
@@ -520,6 +790,18 @@ static void startup(
     }
     unblock_signals();
 
+    block_signals();
+    run_state->db_scheduler =
+        db_scheduler_new(run_state->db_request_queue,
+                         run_state->db_semaphore);
+    if (run_state->db_scheduler == NULL)
+    {
+        LOG(LOG_ERR, "can't create db_scheduler");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    unblock_signals();
+
     block_signals();
     if (!db_init())
     {
@@ -567,9 +849,7 @@ static void startup(
     unblock_signals();
 
     run_state->db_main_args.semaphore = run_state->db_semaphore;
-    run_state->db_main_args.db_request_queue = run_state->db_request_queue;
-    run_state->db_main_args.db_currently_processing =
-        run_state->db_currently_processing;
+    run_state->db_main_args.scheduler = run_state->db_scheduler;
 
     for (i = 0; i < DB_INITIAL_THREADS; ++i)
     {
@@ -591,6 +871,8 @@ static void startup(
         run_state->db_semaphore;
     run_state->connection_control_main_args.global_cache_state =
         &run_state->global_cache_state;
+    run_state->connection_control_main_args.wakeup_fd =
+        run_state->wakeup_fds[0];
 
     block_signals();
     retval = pthread_create(&run_state->connection_control_thread, NULL,
@@ -608,6 +890,462 @@ static void startup(
 }
 
 
+/**
+    Wait until it's time to check the database for a new serial number
+    (because rpki-rtr-update said there is one, or because too long has
+    passed without hearing from it) or to check the size of the db
+    thread pool, whichever comes first.
+
+    @return
+        Whether it's time to check the database.
+*/
+static bool wait_for_update(
+    struct run_state *run_state,
+    time_t *next_check)
+{
+    struct pollfd pfd;
+    time_t now;
+    int timeout;
+    int retval;
+
+    now = time(NULL);
+    if (now >= *next_check)
+    {
+        *next_check = now + (run_state->notify_fd < 0 ?
+                             MAIN_LOOP_INTERVAL : NOTIFY_FALLBACK_INTERVAL);
+        return true;
+    }
+
+    timeout = *next_check - now;
+    if (timeout > DB_POOL_CHECK_INTERVAL)
+        timeout = DB_POOL_CHECK_INTERVAL;
+
+    if (run_state->notify_fd < 0)
+    {
+        sleep(timeout);
+        return false;
+    }
+
+    pfd.fd = run_state->notify_fd;
+    pfd.events = POLLIN;
+    retval = poll(&pfd, 1, timeout * 1000);
+    if (retval < 0)
+    {
+        ERR_LOG(errno, errorbuf, "poll()");
+        sleep(timeout);
+        return false;
+    }
+    else if (retval == 0)
+    {
+        return false;
+    }
+
+    // Several notifications in a row need only one check.
+    block_signals();
+    if (rtr_notify_drain(run_state->notify_fd) < 0)
+    {
+        ERR_LOG(errno, errorbuf, "recv() on notification socket");
+    }
+    unblock_signals();
+
+    *next_check = time(NULL) + NOTIFY_FALLBACK_INTERVAL;
+    return true;
+}
+
+
+/** Make every cxn thread look at the new global cache state. */
+static void wake_connections(
+    struct run_state *run_state)
+{
+    static const char byte = 0;
+
+    // If the pipe is full, cxnctl hasn't woken up for an earlier write
+    // yet and will see the new state when it does.
+    if (write(run_state->wakeup_fds[1], &byte, 1) < 0 &&
+        errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        ERR_LOG(errno, errorbuf, "write() to wakeup pipe");
+    }
+}
+
+
+struct worker {
+    // -1 if not running
+    pid_t pid;
+
+    // the supervisor's end of the socket pair that passes notifications
+    // on to the worker, -1 if not in use
+    int notify_fd;
+
+    time_t started;
+
+    // when to start the worker again if it isn't running
+    time_t restart_at;
+};
+
+struct supervisor_state {
+    struct run_state *run_state;
+
+    // receives notifications from rpki-rtr-update, -1 if not in use
+    int notify_fd;
+
+    size_t num_workers;
+    struct worker *workers;
+};
+
+
+/**
+    Close the supervisor's file descriptors without cleaning up what
+    they refer to, for a newly forked worker.
+*/
+static void close_supervisor_fds(
+    struct supervisor_state *sup)
+{
+    size_t i;
+
+    if (sup->notify_fd >= 0)
+    {
+        close(sup->notify_fd);
+        sup->notify_fd = -1;
+    }
+
+    for (i = 0; i < sup->num_workers; ++i)
+    {
+        if (sup->workers[i].notify_fd >= 0)
+        {
+            close(sup->workers[i].notify_fd);
+            sup->workers[i].notify_fd = -1;
+        }
+    }
+}
+
+
+/**
+    Fork a worker process.  In the worker, this sets up run_state for a
+    worker's startup() and leaves the supervisor's state alone except
+    for closing its file descriptors.
+
+    @return
+        Whether this is now the worker process.
+*/
+static bool start_worker(
+    struct supervisor_state *sup,
+    size_t index)
+{
+    struct worker *worker = &sup->workers[index];
+    int fds[2] = { -1, -1 };
+    pid_t pid;
+
+    block_signals();
+
+    worker->restart_at = time(NULL) + WORKER_RESTART_DELAY;
+
+    if (sup->notify_fd >= 0)
+    {
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0)
+        {
+            ERR_LOG(errno, errorbuf, "socketpair() for worker %zu", index);
+            unblock_signals();
+            return false;
+        }
+        if (fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0 ||
+            fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0)
+        {
+            ERR_LOG(errno, errorbuf, "fcntl() on worker %zu's notify socket",
+                    index);
+            close(fds[0]);
+            close(fds[1]);
+            unblock_signals();
+            return false;
+        }
+    }
+
+    pid = fork();
+    if (pid < 0)
+    {
+        ERR_LOG(errno, errorbuf, "fork() for worker %zu", index);
+        if (fds[0] >= 0)
+        {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        unblock_signals();
+        return false;
+    }
+    else if (pid == 0)
+    {
+        if (fds[0] >= 0)
+            close(fds[0]);
+        close_supervisor_fds(sup);
+        sup->run_state->is_worker = true;
+        sup->run_state->notify_fd = fds[1];
+        // the log buffer's thread wasn't copied by fork()
+        start_log_buffer();
+        unblock_signals();
+        return true;
+    }
+
+    if (fds[1] >= 0)
+        close(fds[1]);
+    worker->pid = pid;
+    worker->notify_fd = fds[0];
+    worker->started = time(NULL);
+    LOG(LOG_INFO, "started worker %zu (pid %ld)", index, (long)pid);
+
+    unblock_signals();
+
+    return false;
+}
+
+
+/** Note which workers exited and when to restart them. */
+static void reap_workers(
+    struct supervisor_state *sup)
+{
+    pid_t pid;
+    int status;
+    size_t i;
+    time_t now;
+
+    block_signals();
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (i = 0; i < sup->num_workers; ++i)
+        {
+            if (sup->workers[i].pid == pid)
+                break;
+        }
+        if (i >= sup->num_workers)
+            continue;
+
+        if (WIFEXITED(status))
+        {
+            LOG(LOG_ERR, "worker %zu (pid %ld) exited with status %d",
+                i, (long)pid, WEXITSTATUS(status));
+        }
+        else if (WIFSIGNALED(status))
+        {
+            LOG(LOG_ERR, "worker %zu (pid %ld) was killed by signal %d",
+                i, (long)pid, WTERMSIG(status));
+        }
+
+        if (sup->workers[i].notify_fd >= 0)
+        {
+            close(sup->workers[i].notify_fd);
+            sup->workers[i].notify_fd = -1;
+        }
+        sup->workers[i].pid = -1;
+
+        // A worker that ran for a while can be restarted right away.
+        now = time(NULL);
+        sup->workers[i].restart_at =
+            sup->workers[i].started + WORKER_RESTART_DELAY;
+        if (sup->workers[i].restart_at < now)
+            sup->workers[i].restart_at = now;
+    }
+
+    unblock_signals();
+}
+
+
+/**
+    Wait up to WORKER_CHECK_INTERVAL seconds for a notification from
+    rpki-rtr-update, and pass any on to every worker.
+*/
+static void forward_notifications(
+    struct supervisor_state *sup)
+{
+    static const char byte = 0;
+    struct pollfd pfd;
+    int retval;
+    size_t i;
+
+    if (sup->notify_fd < 0)
+    {
+        sleep(WORKER_CHECK_INTERVAL);
+        return;
+    }
+
+    pfd.fd = sup->notify_fd;
+    pfd.events = POLLIN;
+    retval = poll(&pfd, 1, WORKER_CHECK_INTERVAL * 1000);
+    if (retval < 0)
+    {
+        ERR_LOG(errno, errorbuf, "poll()");
+        sleep(WORKER_CHECK_INTERVAL);
+        return;
+    }
+    else if (retval == 0)
+    {
+        return;
+    }
+
+    block_signals();
+
+    // Workers only count notifications, so several in a row can be
+    // passed on as one.
+    if (rtr_notify_drain(sup->notify_fd) < 0)
+    {
+        ERR_LOG(errno, errorbuf, "recv() on notification socket");
+    }
+
+    for (i = 0; i < sup->num_workers; ++i)
+    {
+        // If the worker's queue is full, it hasn't read an earlier
+        // notification yet, which is all this one would tell it.
+        if (sup->workers[i].notify_fd >= 0 &&
+            send(sup->workers[i].notify_fd, &byte, 1, MSG_DONTWAIT) < 0 &&
+            errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            ERR_LOG(errno, errorbuf, "send() to worker %zu", i);
+        }
+    }
+
+    unblock_signals();
+}
+
+
+static void supervisor_cleanup(
+    void *sup_voidp)
+{
+    struct supervisor_state *sup = (struct supervisor_state *)sup_voidp;
+    size_t i;
+
+    if (sup->workers != NULL)
+    {
+        LOG(LOG_NOTICE, "Stopping workers...");
+
+        for (i = 0; i < sup->num_workers; ++i)
+        {
+            if (sup->workers[i].pid > 0 &&
+                kill(sup->workers[i].pid, SIGTERM) != 0)
+            {
+                ERR_LOG(errno, errorbuf, "kill(%ld)",
+                        (long)sup->workers[i].pid);
+            }
+        }
+
+        for (i = 0; i < sup->num_workers; ++i)
+        {
+            if (sup->workers[i].pid <= 0)
+                continue;
+
+            while (waitpid(sup->workers[i].pid, NULL, 0) < 0)
+            {
+                if (errno != EINTR)
+                {
+                    ERR_LOG(errno, errorbuf, "waitpid(%ld)",
+                            (long)sup->workers[i].pid);
+                    break;
+                }
+            }
+            sup->workers[i].pid = -1;
+
+            if (sup->workers[i].notify_fd >= 0)
+            {
+                close(sup->workers[i].notify_fd);
+                sup->workers[i].notify_fd = -1;
+            }
+        }
+
+        free(sup->workers);
+        sup->workers = NULL;
+
+        LOG(LOG_NOTICE, "... done stopping workers");
+    }
+
+    if (sup->notify_fd >= 0)
+    {
+        rtr_notify_close(sup->notify_fd,
+                         CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+        sup->notify_fd = -1;
+    }
+
+    // cleanup() runs next and finishes shutting down.
+}
+
+
+/**
+    Run RpkiRtrWorkers worker processes, restarting any that exit,
+    until a signal stops the supervisor.  Each worker is a whole daemon
+    of its own: listening sockets (bound with SO_REUSEPORT so that the
+    kernel spreads connections across workers), database connections,
+    and threads.  All workers read the same data from the database, so
+    the only thing the supervisor shares with them is notifications from
+    rpki-rtr-update, which it passes on to each one.
+
+    This returns only in a newly started worker.
+*/
+static void run_supervisor(
+    struct run_state *run_state)
+{
+    struct supervisor_state sup;
+    bool is_worker = false;
+    size_t i;
+    time_t now;
+
+    sup.run_state = run_state;
+    sup.notify_fd = -1;
+    sup.num_workers = CONFIG_RPKI_RTR_WORKERS_get();
+    sup.workers = NULL;
+
+    pthread_cleanup_push(supervisor_cleanup, &sup);
+
+    block_signals();
+    sup.workers = calloc(sup.num_workers, sizeof(*sup.workers));
+    if (sup.workers == NULL)
+    {
+        LOG(LOG_ERR, "can't allocate memory for workers");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    for (i = 0; i < sup.num_workers; ++i)
+    {
+        sup.workers[i].pid = -1;
+        sup.workers[i].notify_fd = -1;
+        sup.workers[i].restart_at = 0;
+    }
+    unblock_signals();
+
+    block_signals();
+    // Listening here instead of in each worker means no notification
+    // is lost while a worker is restarting.
+    sup.notify_fd = rtr_notify_listen(CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+    if (sup.notify_fd < 0)
+    {
+        ERR_LOG(errno, errorbuf,
+                "can't listen for notifications on %s, "
+                "workers will poll the database every %d seconds instead",
+                CONFIG_RPKI_RTR_NOTIFY_SOCKET_get(), MAIN_LOOP_INTERVAL);
+    }
+    unblock_signals();
+
+    LOG(LOG_NOTICE, "starting %zu workers", sup.num_workers);
+
+    while (true)
+    {
+        now = time(NULL);
+        for (i = 0; i < sup.num_workers && !is_worker; ++i)
+        {
+            if (sup.workers[i].pid < 0 && now >= sup.workers[i].restart_at)
+                is_worker = start_worker(&sup, i);
+        }
+        if (is_worker)
+            break;
+
+        forward_notifications(&sup);
+        reap_workers(&sup);
+    }
+
+    // only a worker gets here
+    free(sup.workers);
+    sup.workers = NULL;
+
+    pthread_cleanup_pop(0);
+}
+
+
 int main(
     int argc,
     char **argv)
@@ -616,27 +1354,45 @@ int main(
     (void)argv;
 
     struct run_state run_state;
+    uint64_t generation;
+    time_t next_check;
     initialize_run_state(&run_state);
 
     pthread_cleanup_push(cleanup, &run_state);
 
     handle_signals(signal_handler);
 
+    load_config(&run_state);
+
+    if (CONFIG_RPKI_RTR_WORKERS_get() > 1)
+        run_supervisor(&run_state);
+
     startup(&run_state);
 
+    // the cache state was just read by startup()
+    next_check = time(NULL) + (run_state.notify_fd < 0 ?
+                               MAIN_LOOP_INTERVAL : NOTIFY_FALLBACK_INTERVAL);
+
     while (true)
     {
-        sleep(MAIN_LOOP_INTERVAL);
-
-        // TODO: Check the load on the database threads, adding or removing
-        // threads as needed.
+        if (!wait_for_update(&run_state, &next_check))
+        {
+            adjust_db_threads(&run_state);
+            continue;
+        }
 
         block_signals();
+        // main is the only writer, so no lock is needed to read this
+        generation = run_state.global_cache_state.generation;
         if (!update_global_cache_state
             (&run_state.global_cache_state, run_state.db))
         {
             LOG(LOG_NOTICE, "error updating global cache state");
         }
+        else if (run_state.global_cache_state.generation != generation)
+        {
+            wake_connections(&run_state);
+        }
         unblock_signals();
     }
 
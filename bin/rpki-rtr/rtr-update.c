@@ -6,6 +6,7 @@
 #include "db/connect.h"
 #include "db/clients/rtr.h"
 #include "config/config.h"
+#include "rpki-rtr/notify.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -13,6 +14,7 @@
 #include <limits.h>
 #include <inttypes.h>
 #include <time.h>
+#include <errno.h>
 
 
 int main(
@@ -203,6 +205,26 @@ int main(
             ret = EXIT_FAILURE;
             goto done;
         }
+
+        // Tell rpki-rtr-daemon right away instead of waiting for it to
+        // notice.  Not being able to is not an error: the daemon might
+        // just not be running.
+        if (!rtr_notify_send(CONFIG_RPKI_RTR_NOTIFY_SOCKET_get(),
+                             current_serial))
+        {
+            if (errno == ENOENT || errno == ECONNREFUSED)
+            {
+                LOG(LOG_DEBUG, "rpki-rtr-daemon isn't listening on %s",
+                    CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+            }
+            else
+            {
+                char errorbuf[ERROR_BUF_SIZE];
+                ERR_LOG(errno, errorbuf,
+                        "can't notify rpki-rtr-daemon on %s",
+                        CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+            }
+        }
     }
     else
     {
@@ -20,7 +20,11 @@
 #define DELIM " \t\n\r"
 
 #define MAX_PDU_SIZE 65536
-#define LINEBUF_SIZE 128
+#define LINEBUF_SIZE 512
+
+
+// protocol version of the PDUs that write mode outputs
+static uint8_t write_version = RTR_PROTOCOL_VERSION_0;
 
 
 // all the arguments a command (for sending) can take
@@ -34,6 +38,9 @@ enum command_argument {
     ARG_IPv6,
     ARG_AS_NUMBER,
     ARG_ERROR_CODE,
+    ARG_ROUTER_KEY_FLAGS,
+    ARG_SKI,
+    ARG_SPKI,
     ARG_END                     // special argument to indicate the end of the
                                 // argument list
 };
@@ -61,6 +68,12 @@ static const char *arg_name(
         return "AS number";
     case ARG_ERROR_CODE:
         return "error code";
+    case ARG_ROUTER_KEY_FLAGS:
+        return "router key flags";
+    case ARG_SKI:
+        return "SKI in hex";
+    case ARG_SPKI:
+        return "SPKI in hex";
     default:
         return NULL;
     }
@@ -93,6 +106,9 @@ static void cmd_end_of_data(
 static void cmd_cache_reset(
     const struct command *command,
     char const *const *args);
+static void cmd_router_key(
+    const struct command *command,
+    char const *const *args);
 static void cmd_error_report(
     const struct command *command,
     char const *const *args);
@@ -120,6 +136,8 @@ static const struct command commands[] = {
       ARG_AS_NUMBER, ARG_END}},
     {"end_of_data", cmd_end_of_data, {ARG_SESSION, ARG_SERIAL, ARG_END}},
     {"cache_reset", cmd_cache_reset, {ARG_END}},
+    {"router_key", cmd_router_key,
+     {ARG_ROUTER_KEY_FLAGS, ARG_SKI, ARG_AS_NUMBER, ARG_SPKI, ARG_END}},
     {"error_report", cmd_error_report, {ARG_ERROR_CODE, ARG_END}},
     {NULL, NULL, {ARG_END}}
 };
@@ -157,8 +175,9 @@ static void do_help(
     fprintf(stderr, "    %s [-h | --help]             Print this help text.\n",
             argv0);
     fprintf(stderr,
-            "    %s write                     Convert human-readable commands to PDUs.\n",
-            argv0);
+            "    %s write [<version>]         Convert human-readable commands to PDUs\n"
+            "                                 of the given protocol version (default %d).\n",
+            argv0, RTR_PROTOCOL_VERSION_0);
     fprintf(stderr,
             "    %s client <host> <port>      Connect to rtrd, reading PDUs from stdin and\n"
             "                                 writing human-readable PDUs to stdout.\n",
@@ -178,8 +197,37 @@ static void do_help(
     {
         command_print_usage_signature(stderr, &commands[i], "    ", "\n");
     }
+    fprintf(stderr, "\n");
+    fprintf(stderr,
+            "In version 1 and later, end_of_data uses the default intervals from RFC 8210.\n");
+}
+
+/** Decode exactly length bytes of hex from arg_string. */
+static bool _command_get_arg_hex(
+    const char *arg_string,
+    uint8_t * arg_value,
+    size_t length)
+{
+    size_t i;
+
+    if (strlen(arg_string) != 2 * length)
+        return false;
+
+    for (i = 0; i < length; ++i)
+    {
+        if (sscanf(arg_string + 2 * i, "%2" SCNx8, &arg_value[i]) != 1)
+            return false;
+    }
+
+    return true;
 }
 
+// binary data of variable length, given in hex
+struct hex_arg {
+    uint32_t length;
+    uint8_t value[LINEBUF_SIZE / 2];
+};
+
 static inline bool _command_get_arg_sscanf(
     const char *arg_string,
     const char *format,
@@ -241,6 +289,23 @@ static bool command_get_arg(
         ret = _command_get_arg_sscanf(arg_string, "%" SCNu16, arg_value);
         goto done;
 
+    case ARG_ROUTER_KEY_FLAGS:
+        ret = _command_get_arg_sscanf(arg_string, "%" SCNu8, arg_value);
+        goto done;
+
+    case ARG_SKI:
+        ret = _command_get_arg_hex(arg_string, arg_value, RTR_SKI_LENGTH);
+        goto done;
+
+    case ARG_SPKI:
+        {
+            struct hex_arg *hex = arg_value;
+            hex->length = strlen(arg_string) / 2;
+            ret = hex->length <= sizeof(hex->value) &&
+                _command_get_arg_hex(arg_string, hex->value, hex->length);
+        }
+        goto done;
+
     default:
         ret = false;
         goto done;
@@ -298,7 +363,7 @@ static void cmd_serial_notify(
         return;
 
     PDU pdu;
-    fill_pdu_serial_notify(&pdu, session, serial);
+    fill_pdu_serial_notify(&pdu, write_version, session, serial);
 
     send_pdu(&pdu);
 }
@@ -316,7 +381,7 @@ static void cmd_serial_query(
         return;
 
     PDU pdu;
-    fill_pdu_serial_query(&pdu, session, serial);
+    fill_pdu_serial_query(&pdu, write_version, session, serial);
 
     send_pdu(&pdu);
 }
@@ -329,7 +394,7 @@ static void cmd_reset_query(
     (void)args;
 
     PDU pdu;
-    fill_pdu_reset_query(&pdu);
+    fill_pdu_reset_query(&pdu, write_version);
 
     send_pdu(&pdu);
 }
@@ -344,7 +409,7 @@ static void cmd_cache_response(
         return;
 
     PDU pdu;
-    fill_pdu_cache_response(&pdu, session);
+    fill_pdu_cache_response(&pdu, write_version, session);
 
     send_pdu(&pdu);
 }
@@ -371,7 +436,8 @@ static void cmd_ipv4_prefix(
         return;
 
     PDU pdu;
-    fill_pdu_ipv4_prefix(&pdu, flags, prefix_length, max_length, &prefix, asn);
+    fill_pdu_ipv4_prefix(&pdu, write_version, flags, prefix_length,
+                         max_length, &prefix, asn);
 
     send_pdu(&pdu);
 }
@@ -398,7 +464,8 @@ static void cmd_ipv6_prefix(
         return;
 
     PDU pdu;
-    fill_pdu_ipv6_prefix(&pdu, flags, prefix_length, max_length, &prefix, asn);
+    fill_pdu_ipv6_prefix(&pdu, write_version, flags, prefix_length,
+                         max_length, &prefix, asn);
 
     send_pdu(&pdu);
 }
@@ -416,7 +483,10 @@ static void cmd_end_of_data(
         return;
 
     PDU pdu;
-    fill_pdu_end_of_data(&pdu, session, serial);
+    fill_pdu_end_of_data(&pdu, write_version, session, serial,
+                         RTR_REFRESH_INTERVAL_DEFAULT,
+                         RTR_RETRY_INTERVAL_DEFAULT,
+                         RTR_EXPIRE_INTERVAL_DEFAULT);
 
     send_pdu(&pdu);
 }
@@ -429,26 +499,47 @@ static void cmd_cache_reset(
     (void)args;
 
     PDU pdu;
-    fill_pdu_cache_reset(&pdu);
+    fill_pdu_cache_reset(&pdu, write_version);
 
     send_pdu(&pdu);
 }
 
-static void cmd_error_report(
+static void cmd_router_key(
     const struct command *command,
     char const *const *args)
 {
+    uint8_t flags;
+    uint8_t ski[RTR_SKI_LENGTH];
+    as_number_t asn;
+    struct hex_arg spki;
+
+    if (!command_get_arg(command, args, 0, &flags))
+        return;
+    if (!command_get_arg(command, args, 1, ski))
+        return;
+    if (!command_get_arg(command, args, 2, &asn))
+        return;
+    if (!command_get_arg(command, args, 3, &spki))
+        return;
+
     PDU pdu;
+    fill_pdu_router_key(&pdu, write_version, flags, ski, asn, spki.length,
+                        spki.value);
+
+    send_pdu(&pdu);
+}
 
-    pdu.protocolVersion = RTR_PROTOCOL_VERSION;
-    if (!command_get_arg(command, args, 0, &pdu.errorCode))
+static void cmd_error_report(
+    const struct command *command,
+    char const *const *args)
+{
+    error_code_t code;
+
+    if (!command_get_arg(command, args, 0, &code))
         return;
-    pdu.pduType = PDU_ERROR_REPORT;
-    pdu.length = PDU_HEADER_LENGTH + PDU_ERROR_HEADERS_LENGTH;
-    pdu.errorData.encapsulatedPDULength = 0;
-    pdu.errorData.encapsulatedPDU = NULL;
-    pdu.errorData.errorTextLength = 0;
-    pdu.errorData.errorText = NULL;
+
+    PDU pdu;
+    fill_pdu_error_report(&pdu, write_version, code, 0, NULL, 0, NULL);
 
     send_pdu(&pdu);
 }
@@ -673,6 +764,7 @@ static int do_client(
                 case PDU_CACHE_RESPONSE:
                 case PDU_IPV4_PREFIX:
                 case PDU_IPV6_PREFIX:
+                case PDU_ROUTER_KEY:
                     break;
 
                     // expected PDU types that do end a response
@@ -751,6 +843,17 @@ int main(
     {
         return do_write();
     }
+    else if (argc == 3 && strcmp(argv[1], "write") == 0)
+    {
+        // Any version is allowed, to test how the server handles
+        // unsupported ones.
+        if (sscanf(argv[2], "%" SCNu8, &write_version) != 1)
+        {
+            do_help(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return do_write();
+    }
     else if (argc == 4 && strcmp(argv[1], "client") == 0)
     {
         return do_client(argv[2], argv[3], false);
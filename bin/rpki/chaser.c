@@ -29,6 +29,7 @@ static size_t num_uris = 0;
 static size_t const TS_LEN = 20;        // "0000-00-00 00:00:00" plus '\0'
 static char *timestamp_curr;
 static char const *const RSYNC_SCHEME = "rsync://";
+static char const *const RRDP_SCHEME = "https://";
 
 
 /**=============================================================================
@@ -504,6 +505,206 @@ static int handle_uri_string(
     return 0;
 }
 
+/**=============================================================================
+ * @ret
+ *     1 if the URI has no characters that synchronize or rrdp_fetch.py
+ *     would have to quote, 0 otherwise.
+------------------------------------------------------------------------------*/
+static int is_plain_uri(
+    char const *str)
+{
+    char const bad_chars[] = " \"#$&'(),;<>?\\^`{|}![]*";
+    size_t i;
+
+    for (i = 0; '\0' != str[i]; i++)
+    {
+        if (' ' > str[i] || '~' < str[i] || NULL != strchr(bad_chars, str[i]))
+            return 0;
+    }
+    return i > 0;
+}
+
+/**=============================================================================
+ * For the -r option: given the SIA of a certificate, append a
+ * "notification-uri rsync-uri" pair to uris[] for each combination of
+ * RRDP notification URI and caRepository directory in it.  The SIA
+ * doesn't keep the access methods, so https URIs are taken as
+ * notification URIs and rsync URIs ending in '/' as repositories.
+ *
+ * @note
+ *     caller frees param "in"
+------------------------------------------------------------------------------*/
+static int handle_rrdp_sia(
+    char const *in)
+{
+    size_t const DST_SZ = DB_URI_LEN + 1;
+    char scrubbed_str[DST_SZ];
+    char *copy;
+    char *notify;
+    char *repo;
+    char *pair;
+    char *save1;
+    char *save2;
+    size_t len;
+    int ret = 0;
+
+    copy = strdup(in);
+    if (!copy)
+        return ERR_CHASER_OOM;
+    for (notify = strtok_r(copy, ";", &save1); notify != NULL && ret == 0;
+         notify = strtok_r(NULL, ";", &save1))
+    {
+        if (strncasecmp(RRDP_SCHEME, notify, strlen(RRDP_SCHEME)))
+            continue;
+        if (!is_plain_uri(notify))
+        {
+            scrub_for_print(scrubbed_str, notify, DST_SZ, NULL, "");
+            LOG(LOG_WARNING, "invalid rrdp uri, dropping:  \"%s\"",
+                scrubbed_str);
+            continue;
+        }
+
+        // strtok_r() on a second copy, since the outer loop is using
+        // the first one
+        char *copy2 = strdup(in);
+        if (!copy2)
+        {
+            ret = ERR_CHASER_OOM;
+            break;
+        }
+        for (repo = strtok_r(copy2, ";", &save2); repo != NULL;
+             repo = strtok_r(NULL, ";", &save2))
+        {
+            len = strlen(repo);
+            if (strncasecmp(RSYNC_SCHEME, repo, strlen(RSYNC_SCHEME)) ||
+                len <= strlen(RSYNC_SCHEME) + 1 || repo[len - 1] != '/')
+                continue;
+            if (!is_plain_uri(repo) || strstr(repo, "/../") != NULL)
+            {
+                scrub_for_print(scrubbed_str, repo, DST_SZ, NULL, "");
+                LOG(LOG_WARNING, "invalid rsync uri, dropping:  \"%s\"",
+                    scrubbed_str);
+                continue;
+            }
+            repo[len - 1] = '\0';
+            pair = malloc(strlen(notify) + 1 + len);
+            if (!pair)
+            {
+                ret = ERR_CHASER_OOM;
+                break;
+            }
+            sprintf(pair, "%s %s%s", notify, RSYNC_SCHEME,
+                    repo + strlen(RSYNC_SCHEME));
+            ret = append_uri(pair);
+            free(pair);
+            if (ret)
+                break;
+        }
+        free(copy2);
+    }
+    free(copy);
+    return ret;
+}
+
+/**=============================================================================
+ * For the -e option: given "seconds dirname" from the database, append
+ * "authority/module/path/ seconds" to uris[] if dirname is in the
+ * local cache.
+ *
+ * @ret
+ *     0 on success, ERR_CHASER_OOM if out of memory
+------------------------------------------------------------------------------*/
+static int handle_next_update(
+    char const *in)
+{
+    size_t const DST_SZ = DB_URI_LEN + 1;
+    char scrubbed_str[DST_SZ];
+    char const *cache_dir = CONFIG_RPKI_CACHE_DIR_get();
+    size_t cache_dir_len = strlen(cache_dir);
+    char const *dir;
+    char *line;
+    long long seconds;
+    int consumed;
+    int ret;
+
+    if (sscanf(in, "%lld %n", &seconds, &consumed) < 1)
+    {
+        LOG(LOG_WARNING, "bad next update from db, dropping");
+        return 0;
+    }
+    dir = in + consumed;
+
+    while (cache_dir_len > 0 && cache_dir[cache_dir_len - 1] == '/')
+        cache_dir_len--;
+    if (strncmp(dir, cache_dir, cache_dir_len) || dir[cache_dir_len] != '/')
+        return 0;               // e.g. a trust anchor outside the cache
+    dir += cache_dir_len + 1;
+
+    if (!is_plain_uri(dir) || strlen(dir) > DB_URI_LEN)
+    {
+        scrub_for_print(scrubbed_str, dir, DST_SZ, NULL, "");
+        LOG(LOG_WARNING, "invalid directory, dropping:  \"%s\"",
+            scrubbed_str);
+        return 0;
+    }
+
+    line = malloc(strlen(dir) + 32);
+    if (!line)
+        return ERR_CHASER_OOM;
+    sprintf(line, "%s%s %lld", dir,
+            dir[strlen(dir) - 1] == '/' ? "" : "/", seconds);
+    ret = append_uri(line);
+    free(line);
+    return ret;
+}
+
+/**=============================================================================
+------------------------------------------------------------------------------*/
+static int query_next_update(
+    dbconn * db)
+{
+    char **results = NULL;
+    int64_t num_malloced = 0;
+    int64_t num_results;
+    int64_t i;
+    int ret;
+
+    num_results = db_chaser_read_next_update(db, &results, &num_malloced);
+    if (-1 == num_results)
+    {
+        return -1;
+    }
+    else if (ERR_CHASER_OOM == num_results)
+    {
+        return ERR_CHASER_OOM;
+    }
+    else
+    {
+        LOG(LOG_DEBUG,
+            "read %" PRIi64 " next update lines from db;  %" PRIi64
+            " were null", num_malloced, num_malloced - num_results);
+        for (i = 0; i < num_results; i++)
+        {
+            ret = handle_next_update(results[i]);
+            free(results[i]);
+            results[i] = NULL;
+            if (ERR_CHASER_OOM == ret)
+            {
+                for (++i; i < num_results; ++i)
+                {
+                    free(results[i]);
+                }
+                free(results);
+                return ret;
+            }
+        }
+        if (results)
+            free(results);
+    }
+
+    return 0;
+}
+
 /**=============================================================================
 ------------------------------------------------------------------------------*/
 static int query_aia(
@@ -606,7 +807,8 @@ static int query_crldp(
 ------------------------------------------------------------------------------*/
 static int query_sia(
     dbconn * db,
-    unsigned int chase_not_yet_validated)
+    unsigned int chase_not_yet_validated,
+    int rrdp)
 {
     char **results = NULL;
     int64_t num_malloced = 0;
@@ -631,7 +833,10 @@ static int query_sia(
             num_malloced, num_malloced - num_results);
         for (i = 0; i < num_results; i++)
         {
-            ret = handle_uri_string(results[i]);
+            if (rrdp)
+                ret = handle_rrdp_sia(results[i]);
+            else
+                ret = handle_uri_string(results[i]);
             free(results[i]);
             results[i] = NULL;
             if (ERR_CHASER_OOM == ret)
@@ -692,6 +897,16 @@ static int printUsage(
     fprintf(stderr,
             "  -d seconds   chase CRLs where 'next update < seconds'"
             "  (default:  chase all CRLs)\n");
+    fprintf(stderr,
+            "  -e           print \"rsync-uri seconds\" for each directory,"
+            " where seconds\n"
+            "               is how soon its first manifest or CRL expires,"
+            " instead of\n"
+            "               the uris to fetch\n");
+    fprintf(stderr,
+            "  -r           print \"notification-uri rsync-uri\" pairs for"
+            " repositories\n"
+            "               that publish with RRDP, instead of rsync uris\n");
     fprintf(stderr,
             "  -s           delimit output with newlines"
             "  (default:  null byte)\n");
@@ -717,6 +932,8 @@ int main(
     size_t num_seconds = 0;
     unsigned int chase_not_yet_validated = 0;
     int skip_database = 0;
+    int rrdp = 0;
+    int next_update = 0;
     int ret;
     int consumed;
 
@@ -729,7 +946,7 @@ int main(
 
     // parse the command-line flags
     int ch;
-    while ((ch = getopt(argc, argv, "ad:styh")) != -1)
+    while ((ch = getopt(argc, argv, "ad:erstyh")) != -1)
     {
         switch (ch)
         {
@@ -746,6 +963,12 @@ int main(
                 return EXIT_FAILURE;
             }
             break;
+        case 'e':
+            next_update = 1;
+            break;
+        case 'r':
+            rrdp = 1;
+            break;
         case 's':
             output_delimiter = '\n';
             break;
@@ -777,8 +1000,8 @@ int main(
         return -1;
     }
 
-    // get configured extra URIs
-    for (i = 0;
+    // get configured extra URIs; these are rsync only
+    for (i = 0; !rrdp && !next_update &&
          i < config_get_length(CONFIG_RPKI_EXTRA_PUBLICATION_POINTS);
          ++i)
     {
@@ -833,7 +1056,15 @@ int main(
     int db_ok = 1;
     if (query_read_timestamp(db))
         db_ok = 0;
-    if (db_ok)
+    if (db_ok && next_update)
+    {
+        ret = query_next_update(db);
+        if (ERR_CHASER_OOM == ret)
+            return -1;
+        if (-1 == ret)
+            db_ok = 0;
+    }
+    if (db_ok && !rrdp && !next_update)
     {
         ret = query_crldp(db, restrict_crls_by_next_update, num_seconds);
         if (ERR_CHASER_OOM == ret)
@@ -841,7 +1072,7 @@ int main(
         if (-1 == ret)
             db_ok = 0;
     }
-    if (db_ok && chase_aia)
+    if (db_ok && chase_aia && !rrdp && !next_update)
     {
         ret = query_aia(db);
         if (ERR_CHASER_OOM == ret)
@@ -849,9 +1080,9 @@ int main(
         if (-1 == ret)
             db_ok = 0;
     }
-    if (db_ok)
+    if (db_ok && !next_update)
     {
-        ret = query_sia(db, chase_not_yet_validated);
+        ret = query_sia(db, chase_not_yet_validated, rrdp);
         if (ERR_CHASER_OOM == ret)
             return -1;
         if (-1 == ret)
@@ -878,12 +1109,14 @@ int main(
     // sort uris[]
     qsort(uris, num_uris, sizeof(char *), compare_str_p);
 
-    // remove subsumed entries from uris[]
+    // remove subsumed entries from uris[], or in RRDP and next update
+    // modes, duplicates
     size_t lo,
         hi;
     for (lo = 0, hi = 1; hi < num_uris; hi++)
     {
-        if (is_subsumed(uris[lo], uris[hi]))
+        if (rrdp || next_update ? strcmp(uris[lo], uris[hi]) == 0 :
+            is_subsumed(uris[lo], uris[hi]))
         {
             free(uris[hi]);
             uris[hi] = NULL;
@@ -926,7 +1159,7 @@ int main(
     LOG(LOG_DEBUG, "outputting %zu rsync uris", num_uris);
     for (i = 0; i < num_uris; i++)
     {
-        fprintf(stdout, "%s%s", RSYNC_SCHEME, uris[i]);
+        fprintf(stdout, "%s%s", rrdp ? "" : RSYNC_SCHEME, uris[i]);
         putchar(output_delimiter);
     }
 
@@ -70,21 +70,19 @@ handleIfStale(
     ssize_t cnt)
 {
     UNREFERENCED_PARAMETER(s);
+    char where[WHERESTR_SIZE] = "";
     /** @bug magic constant */
-    char msg[600];
-    char escaped_aki[2 * strlen(theAKI) + 1];
-    char escaped_issuer[2 * strlen(theIssuer) + 1];
+    char msg[WHERESTR_SIZE + 128];
     if (cnt > 0)
         return 0;               // exists another crl that is current
-    mysql_escape_string(escaped_aki, theAKI, strlen(theAKI));
-    mysql_escape_string(escaped_issuer, theIssuer, strlen(theIssuer));
+    where_append_keyid(where, "aki", theAKI);
+    where_append(where, " and ");
+    where_append_hashed(where, "issuer", theIssuer);
+    addFlagTest(where, SCM_FLAG_STALECRL, 0, 1);
+    addFlagTest(where, SCM_FLAG_CA, 1, 1);
     xsnprintf(msg, sizeof(msg),
-              "update %s set flags = flags + %d where aki=\"%s\" and issuer=\"%s\"",
-              certTable->tabname, SCM_FLAG_STALECRL, escaped_aki,
-              escaped_issuer);
-    addFlagTest(msg, SCM_FLAG_STALECRL, 0, 1);
-    addFlagTest(msg, SCM_FLAG_CA, 1, 1);
-    xsnprintf(msg + strlen(msg), sizeof(msg) - strlen(msg), ";");
+              "update %s set flags = flags + %d where %s;",
+              certTable->tabname, SCM_FLAG_STALECRL, where);
     return statementscm_no_data(conp, msg);
 }
 
@@ -137,13 +135,11 @@ countCurrentCRLs(
         /** @bug ignores error code without explanation */
         addcolsrchscm(cntSrch, "local_id", SQL_C_ULONG, 8);
     }
-    char escaped_aki[2 * strlen(theAKI) + 1];
-    char escaped_issuer[2 * strlen(theIssuer) + 1];
-    mysql_escape_string(escaped_aki, theAKI, strlen(theAKI));
-    mysql_escape_string(escaped_issuer, theIssuer, strlen(theIssuer));
-    xsnprintf(cntSrch->wherestr, WHERESTR_SIZE,
-              "issuer=\"%s\" and aki=\"%s\" and next_upd>=\"%s\"",
-              escaped_issuer, escaped_aki, currTimestamp);
+    cntSrch->wherestr[0] = 0;
+    where_append_hashed(cntSrch->wherestr, "issuer", theIssuer);
+    where_append(cntSrch->wherestr, " and ");
+    where_append_keyid(cntSrch->wherestr, "aki", theAKI);
+    where_append(cntSrch->wherestr, " and next_upd>=\"%s\"", currTimestamp);
     return searchscm(conp, crlTable, cntSrch, countHandler, NULL,
                      SCM_SRCH_DOCOUNT, NULL);
 }
@@ -168,9 +164,8 @@ handleStaleMan2(
     char escaped_files[2 * strlen(files) + 1];
     mysql_escape_string(escaped_files, files, strlen(files));
     xsnprintf(staleManStmt, sizeof(staleManStmt),
-              "update %s set flags=flags+%d where (flags%%%d)<%d and \"%s\" regexp binary filename;",
-              tab->tabname, SCM_FLAG_STALEMAN,
-              2 * SCM_FLAG_STALEMAN, SCM_FLAG_STALEMAN, escaped_files);
+              "update %s set flags=flags+%d where is_staleman=FALSE and \"%s\" regexp binary filename;",
+              tab->tabname, SCM_FLAG_STALEMAN, escaped_files);
     return statementscm_no_data(conp, staleManStmt);
 }
 
@@ -204,9 +199,8 @@ handleFreshMan2(
     char escaped_files[2 * strlen(files) + 1];
     mysql_escape_string(escaped_files, files, strlen(files));
     xsnprintf(staleManStmt, sizeof(staleManStmt),
-              "update %s set flags=flags-%d where (flags%%%d)>=%d and \"%s\" regexp binary filename;",
-              tab->tabname, SCM_FLAG_STALEMAN,
-              2 * SCM_FLAG_STALEMAN, SCM_FLAG_STALEMAN, escaped_files);
+              "update %s set flags=flags-%d where is_staleman=TRUE and \"%s\" regexp binary filename;",
+              tab->tabname, SCM_FLAG_STALEMAN, escaped_files);
     return statementscm_no_data(conp, staleManStmt);
 }
 
@@ -278,6 +272,15 @@ int main(
         exit(EXIT_FAILURE);
     }
 
+    // invalidate any snapshot of the loader's state
+    status = bump_db_generation(scmp, connect);
+    if (status != 0)
+    {
+        fprintf(stderr, "Error updating the database generation: %s\n",
+                err2string(status));
+        exit(EXIT_FAILURE);
+    }
+
     // check for expired certs
     /** @bug ignores error code without explanation */
     certificate_validity(scmp, connect);
@@ -466,6 +469,16 @@ int main(
         exit(EXIT_FAILURE);
     }
 
+    // the stale CRL and manifest states may have changed above, so
+    // propagate them down the chains
+    status = update_effective_validity(scmp, connect);
+    if (status < 0)
+    {
+        fprintf(stderr, "Error updating effective validity: %s\n",
+                err2string(status));
+        exit(EXIT_FAILURE);
+    }
+
     config_unload();
     CLOSE_LOG();
     return 0;
@@ -0,0 +1,1689 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include "rpki/err.h"
+#include "rpki/myssl.h"
+#include "rpki/sqhl.h"
+#include "rpki/cms/roa_utils.h"
+#include "rpki-object/certificate.h"
+#include "rpki-object/resources.h"
+#include "config/config.h"
+#include "util/logging.h"
+#include "util/queue.h"
+#include "util/sha256.h"
+#include "util/stringutils.h"
+
+/****************
+ * Validate the local RPKI cache without the database.
+ *
+ * Starting from the configured TALs, walk RPKICacheDir top-down: each
+ * CA's manifest names its CRL, child certificates, and ROAs, and each
+ * valid child CA is queued to be processed the same way.  All objects
+ * are checked in memory with the same profile checks as the loader
+ * (rescert_profile_chk(), crl_profile_chk(), manifestValidate(),
+ * roaValidate()), and CAs are processed by a pool of threads.
+ *
+ * The resulting VRPs are written as CSV and/or in a compact binary
+ * form:
+ *
+ *   header   8 bytes  "RPSTVRP1"
+ *            4 bytes  number of records
+ *   record  24 bytes  AS number (4), address family (1, 4 or 6),
+ *                     prefix length (1), max length (1), zero (1),
+ *                     address (16, IPv4 in the first 4 bytes)
+ *
+ * Integers are in network byte order.  Records are sorted by family,
+ * address, prefix length, max length, and AS number, with duplicates
+ * removed.
+ **************/
+
+#define VRP_FILE_MAGIC "RPSTVRP1"
+#define VRP_RECORD_SIZE 24
+
+/*
+ * Bound on the depth of the CA tree, to stop certificate loops
+ */
+#define MAX_DEPTH 32
+
+struct tal {
+    /** @brief TAL file name without directory or ".tal" */
+    char *name;
+    /** @brief local path of the trust anchor certificate */
+    char *cert_path;
+    /** @brief DER subjectPublicKeyInfo from the TAL */
+    unsigned char *spki;
+    int spki_len;
+};
+
+struct vrp {
+    uint32_t asn;
+    uint8_t family_length;      /* 4 or 16 */
+    uint8_t prefix_length;
+    uint8_t max_length;
+    uint8_t addr[16];
+    unsigned int ta;
+};
+
+struct vrp_list {
+    struct vrp *v;
+    size_t len;
+    size_t cap;
+};
+
+enum {
+    KIND_CERT,
+    KIND_CRL,
+    KIND_MANIFEST,
+    KIND_ROA,
+    NUM_KINDS
+};
+
+static const char *const kind_names[NUM_KINDS] = {
+    [KIND_CERT] = "certificates",
+    [KIND_CRL] = "CRLs",
+    [KIND_MANIFEST] = "manifests",
+    [KIND_ROA] = "ROAs",
+};
+
+/*
+ * A CA whose publication point is still to be processed.  The CA
+ * certificate itself has already been validated.
+ */
+struct ca_task {
+    char *cert_path;
+    struct resource_set resources;
+    unsigned int ta;
+    unsigned int depth;
+};
+
+struct worker {
+    pthread_t thread;
+    struct vrp_list vrps;
+    size_t valid[NUM_KINDS];
+    size_t invalid[NUM_KINDS];
+    bool failed;
+};
+
+/*
+ * Revoked serial numbers of a CRL, sorted for bsearch()
+ */
+struct serial {
+    uint8_t len;
+    uint8_t v[20];
+};
+
+struct revoked {
+    struct serial *v;
+    size_t len;
+};
+
+/*
+ * Shared work queue.  busy counts the tasks being processed; the
+ * walk is over when the queue is empty and nothing is busy.
+ */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static Queue *pending = NULL;
+static size_t busy = 0;
+
+static char *cache_dir = NULL;
+static struct tal *tals = NULL;
+static size_t num_tals = 0;
+static bool allow_stale_crl;
+static bool allow_stale_manifest;
+static bool allow_not_yet;
+static bool allow_no_manifest;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+/*
+ * OpenSSL before 1.1.0 needs the application to provide locking
+ */
+static pthread_mutex_t *ssl_locks = NULL;
+
+static void ssl_locking_callback(
+    int mode,
+    int n,
+    const char *file,
+    int line)
+{
+    (void)file;
+    (void)line;
+    if (mode & CRYPTO_LOCK)
+        pthread_mutex_lock(&ssl_locks[n]);
+    else
+        pthread_mutex_unlock(&ssl_locks[n]);
+}
+
+static unsigned long ssl_id_callback(
+    void)
+{
+    return (unsigned long)pthread_self();
+}
+
+static bool ssl_threads_init(
+    void)
+{
+    int i;
+
+    ssl_locks = calloc(CRYPTO_num_locks(), sizeof(*ssl_locks));
+    if (ssl_locks == NULL)
+        return false;
+    for (i = 0; i < CRYPTO_num_locks(); i++)
+        pthread_mutex_init(&ssl_locks[i], NULL);
+    CRYPTO_set_id_callback(&ssl_id_callback);
+    CRYPTO_set_locking_callback(&ssl_locking_callback);
+    return true;
+}
+#else
+static bool ssl_threads_init(
+    void)
+{
+    return true;
+}
+#endif
+
+static void usage(
+    const char *progname)
+{
+    fprintf(stderr,
+            "Usage: %s [-j threads] [-c csv_file] [-b binary_file]\n"
+            "\n"
+            "Validate the RPKI cache in memory, starting from the\n"
+            "configured TALs, and write the resulting VRPs.  The\n"
+            "database is not used.  At least one of -c and -b is\n"
+            "required; \"-\" means standard output.\n"
+            "\n"
+            "  -j threads  number of worker threads (default: one per CPU)\n"
+            "  -c file     write the VRPs as CSV\n"
+            "  -b file     write the VRPs in binary form\n"
+            "  -h          show this help\n",
+            progname);
+}
+
+static bool vrp_list_add(
+    struct vrp_list *list,
+    const struct vrp *vrp)
+{
+    if (list->len == list->cap)
+    {
+        size_t cap = list->cap ? 2 * list->cap : 1024;
+        struct vrp *v = realloc(list->v, cap * sizeof(*v));
+        if (v == NULL)
+            return false;
+        list->v = v;
+        list->cap = cap;
+    }
+    list->v[list->len++] = *vrp;
+    return true;
+}
+
+/*
+ * Map an rsync URI to its location in the cache.  prefix is inserted
+ * between the cache directory and the host name.
+ */
+static char *uri_to_path(
+    const char *uri,
+    const char *prefix)
+{
+    char *path;
+    size_t len;
+
+    if (strncasecmp(uri, RSYNC_PREFIX, strlen(RSYNC_PREFIX)) != 0)
+        return NULL;
+    uri += strlen(RSYNC_PREFIX);
+    if (uri[0] == '\0' || strstr(uri, "..") != NULL)
+        return NULL;
+    len = strlen(cache_dir) + strlen(prefix) + strlen(uri) + 3;
+    path = malloc(len);
+    if (path == NULL)
+        return NULL;
+    if (prefix[0] != '\0')
+        xsnprintf(path, len, "%s/%s/%s", cache_dir, prefix, uri);
+    else
+        xsnprintf(path, len, "%s/%s", cache_dir, uri);
+    return path;
+}
+
+static char *path_join(
+    const char *dir,
+    const char *name)
+{
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = malloc(len);
+
+    if (path != NULL)
+        xsnprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+static bool ends_with(
+    const char *s,
+    const char *suffix)
+{
+    size_t slen = strlen(s);
+    size_t suffixlen = strlen(suffix);
+
+    return slen >= suffixlen &&
+        strcasecmp(s + slen - suffixlen, suffix) == 0;
+}
+
+/*
+ * Parse a TAL: optional comment lines, one or more URIs, a blank
+ * line (RFC 7730; older TALs have a single URI and no blank line),
+ * then the base64 subjectPublicKeyInfo.
+ */
+static bool read_tal(
+    const char *path,
+    struct tal *tal)
+{
+    FILE *fp;
+    char line[1024];
+    char *uri = NULL;
+    char *b64 = NULL;
+    size_t b64len = 0;
+    bool in_key = false;
+    bool ret = false;
+    const char *base;
+    size_t len;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        LOG(LOG_ERR, "can't open TAL %s: %s", path, strerror(errno));
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                           line[len - 1] == ' ' || line[len - 1] == '\t'))
+            line[--len] = '\0';
+        if (!in_key && line[0] == '#')
+            continue;
+        if (!in_key && len == 0)
+        {
+            if (uri != NULL)
+                in_key = true;
+            continue;
+        }
+        if (!in_key && strchr(line, ':') != NULL)
+        {
+            if (uri == NULL &&
+                strncasecmp(line, RSYNC_PREFIX, strlen(RSYNC_PREFIX)) == 0)
+            {
+                uri = strdup(line);
+                if (uri == NULL)
+                    goto done;
+            }
+            continue;
+        }
+        in_key = true;
+        char *tmp = realloc(b64, b64len + len + 1);
+        if (tmp == NULL)
+            goto done;
+        b64 = tmp;
+        memcpy(b64 + b64len, line, len + 1);
+        b64len += len;
+    }
+    if (uri == NULL || b64len == 0 || b64len % 4 != 0)
+    {
+        LOG(LOG_ERR, "TAL %s has no rsync URI or no key", path);
+        goto done;
+    }
+    tal->spki = malloc(b64len / 4 * 3);
+    if (tal->spki == NULL)
+        goto done;
+    tal->spki_len = EVP_DecodeBlock(tal->spki, (unsigned char *)b64,
+                                    (int)b64len);
+    if (tal->spki_len < 0)
+    {
+        LOG(LOG_ERR, "TAL %s has an invalid key", path);
+        goto done;
+    }
+    // EVP_DecodeBlock() doesn't account for padding
+    if (b64[b64len - 1] == '=')
+        tal->spki_len--;
+    if (b64[b64len - 2] == '=')
+        tal->spki_len--;
+    tal->cert_path = uri_to_path(uri, "trustanchors");
+    if (tal->cert_path == NULL)
+    {
+        LOG(LOG_ERR, "TAL %s has an unusable URI %s", path, uri);
+        goto done;
+    }
+    base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    tal->name = strdup(base);
+    if (tal->name == NULL)
+        goto done;
+    if (ends_with(tal->name, ".tal"))
+        tal->name[strlen(tal->name) - 4] = '\0';
+    ret = true;
+done:
+    fclose(fp);
+    free(uri);
+    free(b64);
+    return ret;
+}
+
+static X509 *certificate_to_x509(
+    struct Certificate *certp)
+{
+    int lth = size_casn(&certp->self);
+    unsigned char *buf;
+    const unsigned char *p;
+    X509 *x;
+
+    if (lth <= 0)
+        return NULL;
+    buf = malloc(lth);
+    if (buf == NULL)
+        return NULL;
+    if (encode_casn(&certp->self, buf) != lth)
+    {
+        free(buf);
+        return NULL;
+    }
+    p = buf;
+    x = d2i_X509(NULL, &p, lth);
+    free(buf);
+    return x;
+}
+
+static int read_validity_date(
+    struct CertificateValidityDate *cvdp,
+    int64_t *datep)
+{
+    if (size_casn(&cvdp->utcTime) == 0)
+        return read_casn_time(&cvdp->generalTime, datep);
+    return read_casn_time(&cvdp->utcTime, datep);
+}
+
+static int cmp_serial(
+    const void *a,
+    const void *b)
+{
+    const struct serial *sa = a;
+    const struct serial *sb = b;
+
+    if (sa->len != sb->len)
+        return (sa->len < sb->len) ? -1 : 1;
+    return memcmp(sa->v, sb->v, sa->len);
+}
+
+static bool read_serial(
+    struct casn *casnp,
+    struct serial *sn)
+{
+    int lth = vsize_casn(casnp);
+
+    if (lth <= 0 || lth > (int)sizeof(sn->v))
+        return false;
+    memset(sn, 0, sizeof(*sn));
+    sn->len = (uint8_t)lth;
+    return read_casn(casnp, sn->v) == lth;
+}
+
+static bool is_revoked(
+    const struct revoked *crl,
+    struct Certificate *certp)
+{
+    struct serial sn;
+
+    // an unreadable serial number can't be matched, and the profile
+    // check has already rejected it
+    if (!read_serial(&certp->toBeSigned.serialNumber, &sn))
+        return false;
+    return bsearch(&sn, crl->v, crl->len, sizeof(*crl->v),
+                   &cmp_serial) != NULL;
+}
+
+/*
+ * Checks common to CA and EE certificates: profile, signature by the
+ * issuer, validity dates, revocation, and resources.  On success, the
+ * certificate's resources, with inheritance resolved, are stored in
+ * *resources, which the caller must free.
+ */
+static err_code
+check_cert(
+    struct Certificate *certp,
+    int ct,
+    struct Certificate *issuerp,
+    const struct resource_set *issuer_resources,
+    const struct revoked *crl,
+    struct resource_set *resources)
+{
+    X509 *x;
+    int64_t not_before;
+    int64_t not_after;
+    int64_t now = (int64_t)time(NULL);
+    err_code sta;
+
+    resource_set_init(resources);
+    x = certificate_to_x509(certp);
+    if (x == NULL)
+        return ERR_SCM_BADCERT;
+    sta = rescert_profile_chk(x, certp, ct);
+    X509_free(x);
+    if (sta < 0)
+        return sta;
+    if (!check_cert_signature(certp, issuerp))
+        return ERR_SCM_INVALSIG;
+    if (read_validity_date(&certp->toBeSigned.validity.notBefore,
+                           &not_before) < 0 ||
+        read_validity_date(&certp->toBeSigned.validity.notAfter,
+                           &not_after) < 0)
+        return ERR_SCM_BADDATES;
+    if (not_after < now)
+        return ERR_SCM_EXPIRED;
+    if (not_before > now && !allow_not_yet)
+        return ERR_SCM_NOTYET;
+    if (crl != NULL && is_revoked(crl, certp))
+        return ERR_SCM_REVOKED;
+    if (!resource_set_from_cert(resources, certp))
+        return ERR_SCM_INVALIPB;
+    if (issuer_resources != NULL)
+    {
+        if (!resource_set_inherit(resources, issuer_resources))
+            return ERR_SCM_NOMEM;
+        if (!resource_set_contains(issuer_resources, resources))
+            return ERR_SCM_OVERCLAIM;
+    }
+    return 0;
+}
+
+/*
+ * Validate a CA's CRL and collect its revoked serial numbers.
+ */
+static err_code
+check_crl(
+    const char *path,
+    struct Certificate *cap,
+    struct revoked *revoked)
+{
+    struct CertificateRevocationList crl;
+    struct CRLEntry *entryp;
+    int64_t next_update;
+    err_code sta = 0;
+    size_t n;
+
+    revoked->v = NULL;
+    revoked->len = 0;
+    CertificateRevocationList(&crl, 0);
+    if (get_casn_file(&crl.self, path, 0) < 0)
+    {
+        sta = ERR_SCM_BADCRL;
+        goto done;
+    }
+    if ((sta = crl_profile_chk(&crl)) < 0)
+        goto done;
+    if (diff_casn(&crl.toBeSigned.issuer.self, &cap->toBeSigned.subject.self))
+    {
+        sta = ERR_SCM_BADCRL;
+        goto done;
+    }
+    if (!check_signature(&crl.toBeSigned.self, cap, &crl.signature))
+    {
+        sta = ERR_SCM_INVALSIG;
+        goto done;
+    }
+    if (read_casn_time(&crl.toBeSigned.nextUpdate.self, &next_update) < 0)
+    {
+        sta = ERR_SCM_BADDATES;
+        goto done;
+    }
+    if (next_update < (int64_t)time(NULL) && !allow_stale_crl)
+    {
+        sta = ERR_SCM_STALECRL;
+        goto done;
+    }
+    n = num_items(&crl.toBeSigned.revokedCertificates.self);
+    if (n > 0)
+    {
+        revoked->v = calloc(n, sizeof(*revoked->v));
+        if (revoked->v == NULL)
+        {
+            sta = ERR_SCM_NOMEM;
+            goto done;
+        }
+    }
+    for (entryp = (struct CRLEntry *)member_casn(
+             &crl.toBeSigned.revokedCertificates.self, 0);
+         entryp != NULL && revoked->len < n;
+         entryp = (struct CRLEntry *)next_of(&entryp->self))
+    {
+        if (!read_serial(&entryp->userCertificate,
+                         &revoked->v[revoked->len]))
+        {
+            sta = ERR_SCM_BADREVSNUM;
+            goto done;
+        }
+        revoked->len++;
+    }
+    qsort(revoked->v, revoked->len, sizeof(*revoked->v), &cmp_serial);
+done:
+    delete_casn(&crl.self);
+    if (sta < 0)
+    {
+        free(revoked->v);
+        revoked->v = NULL;
+        revoked->len = 0;
+    }
+    return sta;
+}
+
+/*
+ * Read the caRepository and rpkiManifest URIs of a CA certificate and
+ * map them into the cache.
+ */
+static err_code
+read_sia(
+    struct Certificate *certp,
+    char **repo_dir,
+    char **mft_path)
+{
+    struct Extension *extp;
+    struct AccessDescription *adp;
+    char uri[PATH_MAX];
+    int lth;
+
+    *repo_dir = NULL;
+    *mft_path = NULL;
+    extp = find_extension(&certp->toBeSigned.extensions,
+                          id_pe_subjectInfoAccess, false);
+    if (extp == NULL)
+        return ERR_SCM_NOSIA;
+    for (adp = (struct AccessDescription *)member_casn(
+             &extp->extnValue.subjectInfoAccess.self, 0);
+         adp != NULL; adp = (struct AccessDescription *)next_of(&adp->self))
+    {
+        char **target;
+
+        if (!diff_objid(&adp->accessMethod, id_ad_caRepository))
+            target = repo_dir;
+        else if (!diff_objid(&adp->accessMethod, id_ad_rpkiManifest))
+            target = mft_path;
+        else
+            continue;
+        lth = vsize_casn((struct casn *)&adp->accessLocation.url);
+        if (*target != NULL || lth <= 0 || lth >= (int)sizeof(uri))
+            continue;
+        read_casn((struct casn *)&adp->accessLocation.url, (uchar *)uri);
+        uri[lth] = '\0';
+        *target = uri_to_path(uri, "");
+    }
+    if (*repo_dir == NULL || *mft_path == NULL)
+    {
+        free(*repo_dir);
+        free(*mft_path);
+        *repo_dir = NULL;
+        *mft_path = NULL;
+        return ERR_SCM_BADSIA;
+    }
+    return 0;
+}
+
+/*
+ * A file of a publication point and, if it was listed on the
+ * manifest, its FileAndHash entry.
+ */
+struct pp_file {
+    char *name;
+    struct FileAndHash *fahp;
+    bool hashed;                // digest is the hash of the file
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+};
+
+struct pp_files {
+    struct pp_file *v;
+    size_t len;
+    size_t cap;
+};
+
+static bool pp_files_add(
+    struct pp_files *files,
+    const char *name,
+    struct FileAndHash *fahp)
+{
+    if (strchr(name, '/') != NULL || strcmp(name, "..") == 0)
+        return true;            // never leave the publication point
+    if (files->len == files->cap)
+    {
+        size_t cap = files->cap ? 2 * files->cap : 64;
+        struct pp_file *v = realloc(files->v, cap * sizeof(*v));
+        if (v == NULL)
+            return false;
+        files->v = v;
+        files->cap = cap;
+    }
+    files->v[files->len].name = strdup(name);
+    if (files->v[files->len].name == NULL)
+        return false;
+    files->v[files->len].fahp = fahp;
+    files->v[files->len].hashed = false;
+    files->len++;
+    return true;
+}
+
+static void pp_files_free(
+    struct pp_files *files)
+{
+    size_t i;
+
+    for (i = 0; i < files->len; i++)
+        free(files->v[i].name);
+    free(files->v);
+    files->v = NULL;
+    files->len = files->cap = 0;
+}
+
+static bool list_manifest(
+    struct CMS *mftp,
+    struct pp_files *files)
+{
+    struct Manifest *manifest =
+        &mftp->content.signedData.encapContentInfo.eContent.manifest;
+    struct FileAndHash *fahp;
+    char name[PATH_MAX];
+    int lth;
+
+    for (fahp = (struct FileAndHash *)member_casn(&manifest->fileList.self,
+                                                  0);
+         fahp != NULL; fahp = (struct FileAndHash *)next_of(&fahp->self))
+    {
+        lth = vsize_casn(&fahp->file);
+        if (lth <= 0 || lth >= (int)sizeof(name))
+            continue;
+        read_casn(&fahp->file, (uchar *)name);
+        name[lth] = '\0';
+        if (!pp_files_add(files, name, fahp))
+            return false;
+    }
+    return true;
+}
+
+static bool list_directory(
+    const char *dir,
+    struct pp_files *files)
+{
+    DIR *dp;
+    struct dirent *dep;
+    bool ret = true;
+
+    dp = opendir(dir);
+    if (dp == NULL)
+        return true;            // nothing was fetched
+    while (ret && (dep = readdir(dp)) != NULL)
+    {
+        if (dep->d_name[0] != '.')
+            ret = pp_files_add(files, dep->d_name, NULL);
+    }
+    closedir(dp);
+    return ret;
+}
+
+/*
+ * Read a whole file.  Returns NULL if it can't be read, with errno
+ * set to ENOMEM if that was the reason.
+ */
+static uint8_t *read_whole_file(
+    const char *path,
+    size_t *lenp)
+{
+    struct stat st;
+    uint8_t *buf;
+    size_t len = 0;
+    ssize_t n;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || (buf = malloc(st.st_size + 1)) == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    while (len < (size_t)st.st_size &&
+           (n = read(fd, buf + len, st.st_size - len)) > 0)
+        len += n;
+    close(fd);
+    if (len != (size_t)st.st_size)
+    {
+        free(buf);
+        errno = EIO;
+        return NULL;
+    }
+    *lenp = len;
+    return buf;
+}
+
+/*
+ * Hash every file listed on the manifest, a batch at a time, so that
+ * the hash engine can work on several files at once.  Files that
+ * can't be read are left unhashed and fail later in check_hash().
+ */
+#define HASH_BATCH 64
+
+static err_code hash_files(
+    const char *dir,
+    struct pp_files *files)
+{
+    struct sha256_job jobs[HASH_BATCH];
+    struct pp_file *batch[HASH_BATCH];
+    size_t i = 0;
+    size_t n, j;
+    err_code sta = 0;
+
+    while (i < files->len && sta == 0)
+    {
+        for (n = 0; n < HASH_BATCH && i < files->len; i++)
+        {
+            char *path;
+
+            if (files->v[i].fahp == NULL)
+                continue;
+            path = path_join(dir, files->v[i].name);
+            if (path == NULL)
+            {
+                sta = ERR_SCM_NOMEM;
+                break;
+            }
+            jobs[n].data = read_whole_file(path, &jobs[n].len);
+            free(path);
+            if (jobs[n].data == NULL)
+            {
+                if (errno == ENOMEM)
+                {
+                    sta = ERR_SCM_NOMEM;
+                    break;
+                }
+                continue;
+            }
+            batch[n++] = &files->v[i];
+        }
+        if (sta == 0)
+            sha256_batch(jobs, n);
+        for (j = 0; j < n; j++)
+        {
+            if (sta == 0)
+            {
+                memcpy(batch[j]->digest, jobs[j].digest,
+                       SHA256_DIGEST_LENGTH);
+                batch[j]->hashed = true;
+            }
+            free((void *)jobs[j].data);
+        }
+    }
+    return sta;
+}
+
+/*
+ * If the file was listed on the manifest, check its hash.
+ */
+static err_code
+check_hash(
+    const char *path,
+    const struct pp_file *file)
+{
+    int fd;
+    int ret;
+
+    if (file->fahp == NULL)
+        return 0;
+    if (file->hashed)
+    {
+        ret = check_fileAndHash(file->fahp, -1, (uchar *)file->digest,
+                                SHA256_DIGEST_LENGTH, 0);
+        return (ret < 0) ? (err_code)ret : 0;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return ERR_SCM_BADFILE;
+    ret = check_fileAndHash(file->fahp, fd, NULL, 0, 0);
+    close(fd);
+    return (ret < 0) ? (err_code)ret : 0;
+}
+
+static void log_invalid(
+    const char *path,
+    err_code sta)
+{
+    LOG(LOG_INFO, "%s: %s", path, err2string(sta));
+}
+
+static bool queue_task(
+    struct ca_task *task)
+{
+    bool ret;
+
+    pthread_mutex_lock(&queue_lock);
+    ret = Queue_push(pending, task);
+    if (ret)
+        pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return ret;
+}
+
+static void free_task(
+    struct ca_task *task)
+{
+    if (task == NULL)
+        return;
+    free(task->cert_path);
+    resource_set_free(&task->resources);
+    free(task);
+}
+
+/*
+ * Validate a child CA certificate and queue its publication point.
+ * Certificates that aren't CA certificates (e.g. router certificates)
+ * are skipped.
+ */
+static err_code
+process_child_cert(
+    struct worker *w,
+    const struct ca_task *parent,
+    struct Certificate *cap,
+    const struct revoked *crl,
+    const char *path)
+{
+    struct Certificate cert;
+    struct ca_task *task = NULL;
+    struct Extension *extp;
+    err_code sta;
+
+    Certificate(&cert, 0);
+    if (get_casn_file(&cert.self, path, 0) < 0)
+    {
+        sta = ERR_SCM_BADCERT;
+        goto done;
+    }
+    extp = find_extension(&cert.toBeSigned.extensions, id_basicConstraints,
+                          false);
+    if (extp == NULL || size_casn(&extp->extnValue.basicConstraints.cA) == 0)
+    {
+        sta = 0;
+        goto done;
+    }
+    if (parent->depth + 1 >= MAX_DEPTH)
+    {
+        LOG(LOG_WARNING, "%s: CA tree too deep", path);
+        sta = ERR_SCM_NOTVALID;
+        goto done;
+    }
+    task = calloc(1, sizeof(*task));
+    if (task == NULL)
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    task->cert_path = strdup(path);
+    task->ta = parent->ta;
+    task->depth = parent->depth + 1;
+    resource_set_init(&task->resources);
+    if (task->cert_path == NULL)
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    sta = check_cert(&cert, CA_CERT, cap, &parent->resources, crl,
+                     &task->resources);
+    if (sta < 0)
+        goto done;
+    if (!queue_task(task))
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    task = NULL;
+done:
+    free_task(task);
+    delete_casn(&cert.self);
+    if (sta < 0)
+    {
+        w->invalid[KIND_CERT]++;
+        log_invalid(path, sta);
+    }
+    else
+        w->valid[KIND_CERT]++;
+    return (sta == ERR_SCM_NOMEM) ? sta : 0;
+}
+
+/*
+ * Check the EE certificate of a signed object.
+ */
+static err_code
+check_ee(
+    struct CMS *cmsp,
+    const struct ca_task *parent,
+    struct Certificate *cap,
+    const struct revoked *crl)
+{
+    struct Certificate *eep;
+    struct resource_set resources;
+    err_code sta;
+
+    eep = (struct Certificate *)member_casn(
+        &cmsp->content.signedData.certificates.self, 0);
+    if (eep == NULL)
+        return ERR_SCM_BADNUMCERTS;
+    sta = check_cert(eep, EE_CERT, cap, &parent->resources, crl, &resources);
+    resource_set_free(&resources);
+    return sta;
+}
+
+static err_code
+process_roa(
+    struct worker *w,
+    const struct ca_task *parent,
+    struct Certificate *cap,
+    const struct revoked *crl,
+    const char *path)
+{
+    struct CMS roa;
+    struct roa_prefix *prefixes = NULL;
+    ssize_t nprefixes;
+    struct vrp vrp;
+    err_code sta;
+    ssize_t i;
+
+    CMS(&roa, 0);
+    if (get_casn_file(&roa.self, path, 0) < 0)
+    {
+        sta = ERR_SCM_INVALASN;
+        goto done;
+    }
+    if ((sta = roaValidate(&roa)) < 0 ||
+        (sta = roaValidate2(&roa)) < 0 ||
+        (sta = check_ee(&roa, parent, cap, crl)) < 0)
+        goto done;
+    nprefixes = roaGetPrefixes(&roa, &prefixes);
+    if (nprefixes < 0)
+    {
+        sta = ERR_SCM_INVALIPB;
+        goto done;
+    }
+    memset(&vrp, 0, sizeof(vrp));
+    vrp.asn = roaAS_ID(&roa);
+    vrp.ta = parent->ta;
+    for (i = 0; i < nprefixes; i++)
+    {
+        vrp.family_length = prefixes[i].prefix_family_length;
+        memcpy(vrp.addr, prefixes[i].prefix, sizeof(vrp.addr));
+        vrp.prefix_length = prefixes[i].prefix_length;
+        vrp.max_length = prefixes[i].prefix_max_length;
+        if (!vrp_list_add(&w->vrps, &vrp))
+        {
+            sta = ERR_SCM_NOMEM;
+            goto done;
+        }
+    }
+done:
+    free(prefixes);
+    delete_casn(&roa.self);
+    if (sta < 0)
+    {
+        w->invalid[KIND_ROA]++;
+        log_invalid(path, sta);
+    }
+    else
+        w->valid[KIND_ROA]++;
+    return (sta == ERR_SCM_NOMEM) ? sta : 0;
+}
+
+/*
+ * Process one CA's publication point: its manifest and CRL first,
+ * then the child certificates and ROAs.
+ */
+static err_code
+process_ca(
+    struct worker *w,
+    struct ca_task *task)
+{
+    struct Certificate ca;
+    struct CMS mft;
+    struct pp_files files = {NULL, 0, 0};
+    struct revoked crl = {NULL, 0};
+    bool have_crl = false;
+    bool mft_ok = false;
+    char *repo_dir = NULL;
+    char *mft_path = NULL;
+    char *mft_dir = NULL;
+    char *slash;
+    const char *dir;
+    char *path;
+    int stale = 0;
+    err_code sta = 0;
+    size_t i;
+
+    Certificate(&ca, 0);
+    CMS(&mft, 0);
+    if (get_casn_file(&ca.self, task->cert_path, 0) < 0)
+    {
+        log_invalid(task->cert_path, ERR_SCM_BADCERT);
+        goto done;
+    }
+    if ((sta = read_sia(&ca, &repo_dir, &mft_path)) < 0)
+    {
+        log_invalid(task->cert_path, sta);
+        sta = 0;
+        goto done;
+    }
+
+    // read the manifest; its EE certificate is checked once the CRL
+    // is known
+    if (get_casn_file(&mft.self, mft_path, 0) < 0)
+        sta = ERR_SCM_INVALMAN;
+    else if ((sta = manifestValidate(&mft, &stale)) == 0 && stale &&
+             !allow_stale_manifest)
+        sta = ERR_SCM_STALEMAN;
+    if (sta == 0)
+    {
+        mft_ok = true;
+        mft_dir = strdup(mft_path);
+        if (mft_dir == NULL)
+        {
+            sta = ERR_SCM_NOMEM;
+            goto done;
+        }
+        slash = strrchr(mft_dir, '/');
+        if (slash != NULL)
+            *slash = '\0';
+        if (!list_manifest(&mft, &files))
+        {
+            sta = ERR_SCM_NOMEM;
+            goto done;
+        }
+    }
+    else
+    {
+        log_invalid(mft_path, sta);
+        sta = 0;
+    }
+
+    // list the directory instead if the manifest is unusable
+    for (;;)
+    {
+        if (!mft_ok)
+        {
+            pp_files_free(&files);
+            if (!allow_no_manifest)
+                goto done;
+            if (!list_directory(repo_dir, &files))
+            {
+                sta = ERR_SCM_NOMEM;
+                goto done;
+            }
+        }
+        dir = mft_ok ? mft_dir : repo_dir;
+        if (mft_ok && (sta = hash_files(dir, &files)) < 0)
+            goto done;
+
+        for (i = 0; !have_crl && i < files.len; i++)
+        {
+            if (!ends_with(files.v[i].name, ".crl"))
+                continue;
+            path = path_join(dir, files.v[i].name);
+            if (path == NULL)
+            {
+                sta = ERR_SCM_NOMEM;
+                goto done;
+            }
+            if ((sta = check_hash(path, &files.v[i])) == 0)
+                sta = check_crl(path, &ca, &crl);
+            if (sta == ERR_SCM_NOMEM)
+            {
+                free(path);
+                goto done;
+            }
+            if (sta < 0)
+            {
+                w->invalid[KIND_CRL]++;
+                log_invalid(path, sta);
+            }
+            else
+            {
+                w->valid[KIND_CRL]++;
+                have_crl = true;
+            }
+            free(path);
+        }
+        sta = 0;
+        if (!have_crl)
+        {
+            LOG(LOG_INFO, "%s: no valid CRL", repo_dir);
+            goto done;
+        }
+        if (!mft_ok)
+            break;
+        if ((sta = check_ee(&mft, task, &ca, &crl)) == 0)
+            break;
+        log_invalid(mft_path, sta);
+        sta = 0;
+        mft_ok = false;
+    }
+    if (mft_ok)
+        w->valid[KIND_MANIFEST]++;
+    else
+        w->invalid[KIND_MANIFEST]++;
+
+    for (i = 0; i < files.len; i++)
+    {
+        bool is_cert = ends_with(files.v[i].name, ".cer");
+        bool is_roa = ends_with(files.v[i].name, ".roa");
+
+        if (!is_cert && !is_roa)
+            continue;
+        path = path_join(dir, files.v[i].name);
+        if (path == NULL)
+        {
+            sta = ERR_SCM_NOMEM;
+            goto done;
+        }
+        if ((sta = check_hash(path, &files.v[i])) < 0)
+        {
+            w->invalid[is_cert ? KIND_CERT : KIND_ROA]++;
+            log_invalid(path, sta);
+            sta = 0;
+        }
+        else if (is_cert)
+            sta = process_child_cert(w, task, &ca, &crl, path);
+        else
+            sta = process_roa(w, task, &ca, &crl, path);
+        free(path);
+        if (sta < 0)
+            goto done;
+    }
+
+done:
+    pp_files_free(&files);
+    free(crl.v);
+    free(repo_dir);
+    free(mft_path);
+    free(mft_dir);
+    delete_casn(&mft.self);
+    delete_casn(&ca.self);
+    return sta;
+}
+
+/*
+ * Validate a trust anchor and queue its publication point.
+ */
+static err_code
+process_ta(
+    unsigned int ta)
+{
+    struct Certificate cert;
+    struct ca_task *task = NULL;
+    unsigned char *spki = NULL;
+    int lth;
+    int afi;
+    err_code sta;
+
+    Certificate(&cert, 0);
+    if (get_casn_file(&cert.self, tals[ta].cert_path, 0) < 0)
+    {
+        sta = ERR_SCM_BADCERT;
+        goto done;
+    }
+    lth = size_casn(&cert.toBeSigned.subjectPublicKeyInfo.self);
+    spki = (lth > 0) ? malloc(lth) : NULL;
+    if (spki == NULL)
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    encode_casn(&cert.toBeSigned.subjectPublicKeyInfo.self, spki);
+    if (lth != tals[ta].spki_len || memcmp(spki, tals[ta].spki, lth) != 0)
+    {
+        sta = ERR_SCM_TALKEY;
+        goto done;
+    }
+    task = calloc(1, sizeof(*task));
+    if (task == NULL)
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    task->ta = ta;
+    resource_set_init(&task->resources);
+    task->cert_path = strdup(tals[ta].cert_path);
+    if (task->cert_path == NULL)
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    // self-signed, with no issuer resources to check against
+    if ((sta = check_cert(&cert, TA_CERT, &cert, NULL, NULL,
+                          &task->resources)) < 0)
+        goto done;
+    for (afi = 0; afi < RESOURCE_NUM_AFI; afi++)
+    {
+        if (task->resources.ip[afi].inherit)
+            sta = ERR_SCM_TAINHERIT;
+    }
+    if (task->resources.as.inherit)
+        sta = ERR_SCM_TAINHERIT;
+    if (sta < 0)
+        goto done;
+    if (!queue_task(task))
+    {
+        sta = ERR_SCM_NOMEM;
+        goto done;
+    }
+    task = NULL;
+done:
+    free_task(task);
+    free(spki);
+    delete_casn(&cert.self);
+    if (sta < 0)
+        LOG(LOG_ERR, "trust anchor %s (%s): %s", tals[ta].cert_path,
+            tals[ta].name, err2string(sta));
+    return sta;
+}
+
+static void *worker_main(
+    void *arg)
+{
+    struct worker *w = arg;
+    struct ca_task *task;
+    void *data;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (Queue_size(pending) == 0 && busy > 0)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        if (!Queue_trypop(pending, &data))
+        {
+            // nothing queued and nothing in progress: done
+            pthread_cond_broadcast(&queue_cond);
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        busy++;
+        pthread_mutex_unlock(&queue_lock);
+
+        task = data;
+        if (!w->failed && process_ca(w, task) < 0)
+        {
+            LOG(LOG_ERR, "out of memory");
+            w->failed = true;
+        }
+        free_task(task);
+
+        pthread_mutex_lock(&queue_lock);
+        busy--;
+        if (busy == 0 && Queue_size(pending) == 0)
+            pthread_cond_broadcast(&queue_cond);
+        pthread_mutex_unlock(&queue_lock);
+    }
+    return NULL;
+}
+
+static int cmp_vrp(
+    const void *a,
+    const void *b)
+{
+    const struct vrp *va = a;
+    const struct vrp *vb = b;
+    int c;
+
+    if (va->family_length != vb->family_length)
+        return (va->family_length < vb->family_length) ? -1 : 1;
+    if ((c = memcmp(va->addr, vb->addr, sizeof(va->addr))) != 0)
+        return c;
+    if (va->prefix_length != vb->prefix_length)
+        return (va->prefix_length < vb->prefix_length) ? -1 : 1;
+    if (va->max_length != vb->max_length)
+        return (va->max_length < vb->max_length) ? -1 : 1;
+    if (va->asn != vb->asn)
+        return (va->asn < vb->asn) ? -1 : 1;
+    if (va->ta != vb->ta)
+        return (va->ta < vb->ta) ? -1 : 1;
+    return 0;
+}
+
+static FILE *open_output(
+    const char *path,
+    char **tmp_path)
+{
+    size_t len;
+    FILE *fp;
+
+    *tmp_path = NULL;
+    if (strcmp(path, "-") == 0)
+        return stdout;
+    len = strlen(path) + sizeof(".tmp");
+    *tmp_path = malloc(len);
+    if (*tmp_path == NULL)
+        return NULL;
+    xsnprintf(*tmp_path, len, "%s.tmp", path);
+    fp = fopen(*tmp_path, "w");
+    if (fp == NULL)
+    {
+        LOG(LOG_ERR, "can't open %s: %s", *tmp_path, strerror(errno));
+        free(*tmp_path);
+        *tmp_path = NULL;
+    }
+    return fp;
+}
+
+/*
+ * Finish writing an output file, replacing path with it only if
+ * everything was written.
+ */
+static bool close_output(
+    FILE *fp,
+    const char *path,
+    char *tmp_path,
+    bool ok)
+{
+    if (fp == stdout)
+        return fflush(fp) == 0 && ok;
+    ok = (fclose(fp) == 0) && ok;
+    if (ok && rename(tmp_path, path) != 0)
+    {
+        LOG(LOG_ERR, "can't rename %s to %s: %s", tmp_path, path,
+            strerror(errno));
+        ok = false;
+    }
+    if (!ok)
+        unlink(tmp_path);
+    free(tmp_path);
+    return ok;
+}
+
+static bool write_csv(
+    const char *path,
+    const struct vrp_list *vrps)
+{
+    char *tmp_path;
+    char addr[INET6_ADDRSTRLEN];
+    FILE *fp;
+    size_t i;
+    bool ok = true;
+
+    fp = open_output(path, &tmp_path);
+    if (fp == NULL)
+        return false;
+    ok = fprintf(fp, "ASN,IP Prefix,Max Length,Trust Anchor\n") > 0;
+    for (i = 0; ok && i < vrps->len; i++)
+    {
+        const struct vrp *v = &vrps->v[i];
+
+        if (i > 0 && cmp_vrp(v, &vrps->v[i - 1]) == 0)
+            continue;
+        inet_ntop(v->family_length == 4 ? AF_INET : AF_INET6, v->addr,
+                  addr, sizeof(addr));
+        ok = fprintf(fp, "AS%" PRIu32 ",%s/%u,%u,%s\n", v->asn, addr,
+                     v->prefix_length, v->max_length, tals[v->ta].name) > 0;
+    }
+    return close_output(fp, path, tmp_path, ok);
+}
+
+static bool write_binary(
+    const char *path,
+    const struct vrp_list *vrps)
+{
+    char *tmp_path;
+    unsigned char rec[VRP_RECORD_SIZE];
+    uint32_t n;
+    size_t count = 0;
+    size_t i;
+    FILE *fp;
+    bool ok;
+
+    // records differing only in trust anchor are written once
+    for (i = 0; i < vrps->len; i++)
+    {
+        if (i == 0 || vrps->v[i].family_length != vrps->v[i - 1].family_length ||
+            memcmp(vrps->v[i].addr, vrps->v[i - 1].addr, 16) != 0 ||
+            vrps->v[i].prefix_length != vrps->v[i - 1].prefix_length ||
+            vrps->v[i].max_length != vrps->v[i - 1].max_length ||
+            vrps->v[i].asn != vrps->v[i - 1].asn)
+            count++;
+    }
+    if (count > UINT32_MAX)
+        return false;
+    fp = open_output(path, &tmp_path);
+    if (fp == NULL)
+        return false;
+    n = htonl((uint32_t)count);
+    ok = fwrite(VRP_FILE_MAGIC, 8, 1, fp) == 1 &&
+        fwrite(&n, sizeof(n), 1, fp) == 1;
+    for (i = 0; ok && i < vrps->len; i++)
+    {
+        const struct vrp *v = &vrps->v[i];
+
+        if (i > 0 && v->family_length == vrps->v[i - 1].family_length &&
+            memcmp(v->addr, vrps->v[i - 1].addr, 16) == 0 &&
+            v->prefix_length == vrps->v[i - 1].prefix_length &&
+            v->max_length == vrps->v[i - 1].max_length &&
+            v->asn == vrps->v[i - 1].asn)
+            continue;
+        n = htonl(v->asn);
+        memcpy(rec, &n, sizeof(n));
+        rec[4] = (v->family_length == 4) ? 4 : 6;
+        rec[5] = v->prefix_length;
+        rec[6] = v->max_length;
+        rec[7] = 0;
+        memcpy(&rec[8], v->addr, 16);
+        ok = fwrite(rec, sizeof(rec), 1, fp) == 1;
+    }
+    return close_output(fp, path, tmp_path, ok);
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    const char *csv_path = NULL;
+    const char *bin_path = NULL;
+    long nthreads = 0;
+    struct worker *workers = NULL;
+    struct vrp_list all = {NULL, 0, 0};
+    size_t valid[NUM_KINDS] = {0};
+    size_t invalid[NUM_KINDS] = {0};
+    int ret = EXIT_SUCCESS;
+    size_t len;
+    size_t i;
+    long t;
+    int k;
+    int c;
+
+    OPEN_LOG("offline-validate", LOG_USER);
+    while ((c = getopt(argc, argv, "hj:c:b:")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'j':
+            nthreads = strtol(optarg, NULL, 10);
+            if (nthreads <= 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            csv_path = optarg;
+            break;
+        case 'b':
+            bin_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc || (csv_path == NULL && bin_path == NULL))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (nthreads == 0)
+    {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads <= 0)
+            nthreads = 1;
+    }
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't initialize configuration");
+        return EXIT_FAILURE;
+    }
+    allow_stale_crl = CONFIG_RPKI_ALLOW_STALE_CRL_get();
+    allow_stale_manifest = CONFIG_RPKI_ALLOW_STALE_MANIFEST_get();
+    allow_not_yet = CONFIG_RPKI_ALLOW_NOT_YET_get();
+    allow_no_manifest = CONFIG_RPKI_ALLOW_NO_MANIFEST_get();
+    cache_dir = strdup(CONFIG_RPKI_CACHE_DIR_get());
+    pending = Queue_new(false);
+    if (cache_dir == NULL || pending == NULL || !ssl_threads_init())
+    {
+        LOG(LOG_ERR, "out of memory");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    len = strlen(cache_dir);
+    while (len > 1 && cache_dir[len - 1] == '/')
+        cache_dir[--len] = '\0';
+
+    len = config_get_length(CONFIG_TRUST_ANCHOR_LOCATORS);
+    tals = calloc(len ? len : 1, sizeof(*tals));
+    if (tals == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    for (i = 0; i < len; i++)
+    {
+        if (!read_tal(CONFIG_TRUST_ANCHOR_LOCATORS_get(i), &tals[num_tals]))
+        {
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        if (process_ta(num_tals) == ERR_SCM_NOMEM)
+        {
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+        num_tals++;
+    }
+
+    workers = calloc(nthreads, sizeof(*workers));
+    if (workers == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    for (t = 0; t < nthreads; t++)
+    {
+        if (pthread_create(&workers[t].thread, NULL, &worker_main,
+                           &workers[t]) != 0)
+        {
+            LOG(LOG_ERR, "can't create thread");
+            // the threads already started will finish the walk
+            if (t == 0)
+            {
+                ret = EXIT_FAILURE;
+                goto done;
+            }
+            nthreads = t;
+            break;
+        }
+    }
+    for (t = 0; t < nthreads; t++)
+        pthread_join(workers[t].thread, NULL);
+
+    for (t = 0; t < nthreads; t++)
+    {
+        if (workers[t].failed)
+            ret = EXIT_FAILURE;
+        for (k = 0; k < NUM_KINDS; k++)
+        {
+            valid[k] += workers[t].valid[k];
+            invalid[k] += workers[t].invalid[k];
+        }
+        for (i = 0; i < workers[t].vrps.len; i++)
+        {
+            if (!vrp_list_add(&all, &workers[t].vrps.v[i]))
+            {
+                LOG(LOG_ERR, "out of memory");
+                ret = EXIT_FAILURE;
+                goto done;
+            }
+        }
+        free(workers[t].vrps.v);
+        workers[t].vrps.v = NULL;
+    }
+    if (ret != EXIT_SUCCESS)
+        goto done;
+    qsort(all.v, all.len, sizeof(*all.v), &cmp_vrp);
+
+    for (k = 0; k < NUM_KINDS; k++)
+        LOG(LOG_NOTICE, "%zu valid and %zu invalid %s", valid[k],
+            invalid[k], kind_names[k]);
+    LOG(LOG_NOTICE, "%zu VRPs from %zu trust anchors", all.len, num_tals);
+
+    if (csv_path != NULL && !write_csv(csv_path, &all))
+    {
+        LOG(LOG_ERR, "error writing %s", csv_path);
+        ret = EXIT_FAILURE;
+    }
+    if (bin_path != NULL && !write_binary(bin_path, &all))
+    {
+        LOG(LOG_ERR, "error writing %s", bin_path);
+        ret = EXIT_FAILURE;
+    }
+
+done:
+    if (workers != NULL)
+    {
+        for (t = 0; t < nthreads; t++)
+            free(workers[t].vrps.v);
+        free(workers);
+    }
+    free(all.v);
+    if (pending != NULL)
+    {
+        void *data;
+
+        while (Queue_trypop(pending, &data))
+            free_task(data);
+        Queue_free(pending);
+    }
+    for (i = 0; i < num_tals; i++)
+    {
+        free(tals[i].name);
+        free(tals[i].cert_path);
+        free(tals[i].spki);
+    }
+    free(tals);
+    free(cache_dir);
+    config_unload();
+    CLOSE_LOG();
+    return ret;
+}
@@ -45,6 +45,7 @@ static QueryField *globalFields[MAX_VALS];      /* to pass into handleResults */
 static int useLabels,
     multiline,
     validate,
+    chainsCurrent,
     valIndex;
 static char *objectType;
 static int isROA = 0,
@@ -85,7 +86,7 @@ handleResults(
     int i;
 
     UNREFERENCED_PARAMETER(numLine);
-    if (validate)
+    if (validate && !chainsCurrent)
     {
         if (!checkValidity
             ((isROA || isManifest || isGBR
@@ -183,7 +184,7 @@ doQuery(
     scmtab *table = NULL;
     scmsrcha srch;
     scmsrch srch1[MAX_VALS];
-    char whereStr[MAX_CONDS * 20];
+    char whereStr[WHERESTR_SIZE];
     char errMsg[1024];
     int srchFlags = SCM_SRCH_DOVALUE_ALWAYS;
     unsigned long blah = 0;
@@ -193,7 +194,7 @@ doQuery(
     QueryField *field;
     QueryField *field2;
     char *name;
-    int maxW = MAX_CONDS * 20;
+    int maxW = WHERESTR_SIZE - 1;
 
     (void)setbuf(stdout, NULL);
     scmp = initscm();
@@ -203,6 +204,13 @@ doQuery(
     connection->mystat.tabname = objectType;
     table = findtablescm(scmp, tableName(objectType));
     checkErr(table == NULL, "Cannot find table %s\n", objectType);
+    if (validate)
+    {
+        status = check_effective_validity(scmp, connection, &chainsCurrent);
+        checkErr(status < 0, "Cannot check effective validity: %s\n",
+                 err2string(status));
+        connection->mystat.tabname = objectType;
+    }
 
     /*
      * set up where clause, i.e. the filter
@@ -277,7 +285,20 @@ doQuery(
 
     if (validate)
     {
+        char chainok[WHERESTR_SIZE];
+
         addQueryFlagTests(whereStr, srch.wherestr != NULL);
+        // the rest of the chain was checked by the loader, see
+        // update_effective_validity(), unless it used another policy,
+        // in which case handleResults() checks it
+        if (chainsCurrent)
+        {
+            status = effective_validity_predicate(chainok, sizeof(chainok));
+            checkErr(status < 0, "Cannot get the current time: %s\n",
+                     err2string(status));
+            strncat(whereStr, " AND ", maxW - strlen(whereStr));
+            strncat(whereStr, chainok, maxW - strlen(whereStr));
+        }
         srch.wherestr = whereStr;
     }
     /*
@@ -308,7 +329,7 @@ doQuery(
         }
     }
     globalFields[i] = NULL;
-    if (validate)
+    if (validate && !chainsCurrent)
     {
         valIndex = srch.nused;
         if (isROA || isManifest || isCRL || isGBR)
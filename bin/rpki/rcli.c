@@ -7,7 +7,9 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <time.h>
 #include <netdb.h>
 #include <inttypes.h>
@@ -28,7 +30,11 @@
 #include "rpki/myssl.h"
 #include "rpki/cms/roa_utils.h"
 #include "rpki/err.h"
+#include "rpki/loadqueue.h"
+#include "rpki/loadstate.h"
+#include "rpki/perf.h"
 #include "config/config.h"
+#include "util/async_log.h"
 #include "util/logging.h"
 #include "util/macros.h"
 #include "util/stringutils.h"
@@ -264,9 +270,36 @@ static void usage(
         printf("  -y         force operation: do not ask for confirmation\n");
     (void)printf("  -a         allow expired certificates\n");
     (void)printf("  -s         do stricter profile checks\n");
+    (void)printf("  -V         recompute the effective validity of all objects\n");
     (void)printf("  -h         display usage and exit\n");
 }
 
+/*
+ * Bring the materialized chain state up to date after a batch of
+ * additions and deletions.
+ */
+
+static err_code refresh_validity(
+    scm *scmp,
+    scmcon *conp)
+{
+    err_code sta;
+
+    sta = update_effective_validity(scmp, conp);
+    if (sta < 0)
+    {
+        LOG(LOG_ERR, "Could not update effective validity: %s (%s)",
+            err2string(sta), err2name(sta));
+        if (sta == ERR_SCM_SQL)
+        {
+            char *ne = geterrorscm(conp);
+            if (ne != NULL && ne[0] != 0)
+                LOG(LOG_ERR, "\t%s", ne);
+        }
+    }
+    return sta;
+}
+
 /*
  * Ask a yes or no question. Returns 1 for yes, 0 for no, -1 for error.
  */
@@ -377,50 +410,174 @@ static char *afterwhite(
     return (run);
 }
 
-static char *hdir = NULL;
+/*
+ * Publish the loader's stage timings to LogDir so that they can be
+ * inspected while a long-running session is in progress.  If
+ * interval is zero the file is rewritten unconditionally, otherwise
+ * only if at least interval seconds have passed since the last
+ * periodic write.
+ */
+
+#define PERF_STATS_FILE "loader-stats"
+#define PERF_STATS_INTERVAL 10
+
+static void write_perf_stats(
+    time_t interval)
+{
+    char path[PATH_MAX];
+    int ret;
+
+    ret = snprintf(path, sizeof(path), "%s/%s", CONFIG_LOG_DIR_get(),
+                   PERF_STATS_FILE);
+    if (ret < 0 || (size_t)ret >= sizeof(path))
+    {
+        LOG(LOG_WARNING, "Path to %s is too long", PERF_STATS_FILE);
+        return;
+    }
+    if (interval == 0)
+        ret = perf_write(path);
+    else
+        ret = perf_write_periodic(path, interval);
+    if (ret != 0)
+        LOG(LOG_WARNING, "Could not write %s: %s", path, strerror(errno));
+}
+
+/*
+ * Warm restart.  The loader's in-memory state is reloaded from
+ * LoaderStateFile at startup if the database has not changed since
+ * the file was written, and checkpointed back after each batch of
+ * changes.  Before the first change of a batch the database
+ * generation is incremented, so if the loader dies mid-batch the
+ * old snapshot no longer matches and the next loader starts cold.
+ */
+
+static unsigned int db_generation;
+static char db_id[64];
+static int changes_begun = 0;
+
+static void restore_loader_state(
+    scm *scmp,
+    scmcon *conp)
+{
+    const char *path = CONFIG_LOADER_STATE_FILE_get();
+    err_code sta;
+
+    sta = get_db_generation(scmp, conp, &db_generation, db_id,
+                            sizeof(db_id));
+    if (sta < 0)
+    {
+        LOG(LOG_WARNING, "Cannot read the database generation: %s (%s)",
+            err2string(sta), err2name(sta));
+        return;
+    }
+    if (loadstate_load(path, db_id, db_generation) == 0)
+    {
+        LOG(LOG_INFO, "Loaded loader state from %s (%zu directories)",
+            path, loadstate_dir_count());
+        return;
+    }
+    // start cold, but with every known directory
+    sta = preload_dirs(scmp, conp);
+    if (sta < 0)
+    {
+        LOG(LOG_WARNING, "Cannot preload directories: %s (%s)",
+            err2string(sta), err2name(sta));
+        loadstate_clear();
+    }
+}
 
 static err_code
-aur(
+begin_changes(
     scm *scmp,
-    scmcon *conp,
-    char what,
-    char *valu)
+    scmcon *conp)
 {
-    char *outdir;
-    char *outfile;
-    char *outfull;
     err_code sta;
-    int trusted = 0;
 
-    sta = splitdf(hdir, NULL, valu, &outdir, &outfile, &outfull);
-    if (sta != 0)
+    if (changes_begun)
+        return 0;
+    sta = bump_db_generation(scmp, conp);
+    if (sta == 0)
+        sta = get_db_generation(scmp, conp, &db_generation, db_id,
+                                sizeof(db_id));
+    if (sta < 0)
     {
-        LOG(LOG_ERR, "Error loading file %s/%s: %s (%s)",
-            hdir, valu, err2string(sta), err2name(sta));
-        free((void *)outdir);
-        free((void *)outfile);
-        free((void *)outfull);
+        LOG(LOG_ERR, "Cannot update the database generation: %s (%s)",
+            err2string(sta), err2name(sta));
         return sta;
     }
+    changes_begun = 1;
+    return 0;
+}
+
+static void checkpoint_loader_state(
+    void)
+{
+    const char *path = CONFIG_LOADER_STATE_FILE_get();
+
+    if (!changes_begun)
+        return;
+    if (loadstate_save(path, db_id, db_generation) != 0)
+        LOG(LOG_WARNING, "Could not write %s: %s", path, strerror(errno));
+    changes_begun = 0;
+}
+
+static char *hdir = NULL;
+
+/*
+ * Objects are handed to add_object() through a load queue so that
+ * issuers are loaded before the objects they issued.  This is the
+ * maximum number of add/update requests buffered at once.
+ */
+
+#define LOAD_QUEUE_MAX_PENDING 4096
+
+struct aur_context {
+    scm *scmp;
+    scmcon *conp;
+    err_code sta;               /* status of the most recent operation */
+};
+
+static load_queue_func aur;
+static err_code
+aur(
+    void *ctx,
+    char what,
+    char *outdir,
+    char *outfile,
+    char *outfull,
+    struct Certificate *certp)
+{
+    struct aur_context *actx = ctx;
+    err_code sta = 0;
+    int trusted = 0;
+
     switch (what)
     {
     case 'a':
-        sta = add_object(scmp, conp, outfile, outdir, outfull, trusted);
+        sta = add_object(actx->scmp, actx->conp, outfile, outdir, outfull,
+                         trusted, certp);
         break;
     case 'r':
-        sta = delete_object(scmp, conp, outfile, outdir, outfull, 0);
+        sta = delete_object(actx->scmp, actx->conp, outfile, outdir, outfull,
+                            0);
         break;
     case 'u':
         /** @bug ignores error code without explanation */
-        (void)delete_object(scmp, conp, outfile, outdir, outfull, 0);
-        sta = add_object(scmp, conp, outfile, outdir, outfull, trusted);
+        (void)delete_object(actx->scmp, actx->conp, outfile, outdir, outfull,
+                            0);
+        sta = add_object(actx->scmp, actx->conp, outfile, outdir, outfull,
+                         trusted, certp);
         break;
     default:
         break;
     }
-    free((void *)outdir);
-    free((void *)outfile);
-    free((void *)outfull);
+    if (sta < 0)
+        LOG(LOG_ERR, "Status of %s was %s (%s)",
+            outfull, err2name(sta), err2string(sta));
+    else
+        LOG(LOG_DEBUG, "Status of %s was %d", outfull, sta);
+    actx->sta = sta;
+    write_perf_stats(PERF_STATS_INTERVAL);
     return (sta);
 }
 
@@ -579,12 +736,17 @@ sockline(
     char c;
     int done = 0;
     err_code sta = 0;
+    struct aur_context actx = {scmp, conp, 0};
+    struct load_queue *queue;
 
+    queue = load_queue_new(LOAD_QUEUE_MAX_PENDING, &aur, &actx);
+    if (queue == NULL)
+        return ERR_SCM_NOMEM;
     for (done = 0; !done;)
     {
         sta = sock1line(s, &left, &ptr);
         if (sta != 0)
-            return sta;
+            break;
         if (ptr == NULL)
             continue;
         LOG(LOG_DEBUG, "Sockline: %s", ptr);
@@ -619,32 +781,17 @@ sockline(
         case 'a':
         case 'A':              /* add */
             LOG(LOG_INFO, "AUR add request: %s", valu);
-            sta = aur(scmp, conp, 'a', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'a', hdir, valu);
             break;
         case 'u':
         case 'U':              /* update */
             LOG(LOG_INFO, "AUR update request: %s", valu);
-            sta = aur(scmp, conp, 'u', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'u', hdir, valu);
             break;
         case 'r':
         case 'R':              /* remove */
             LOG(LOG_INFO, "AUR remove request: %s", valu);
-            sta = aur(scmp, conp, 'r', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'r', hdir, valu);
             break;
         case 'l':
         case 'L':              /* link */
@@ -669,16 +816,19 @@ sockline(
             break;
         case 's':
         case 'S':              /* save */
+            load_queue_flush(queue);
             /** @bug ignores error code without explanation */
             (void)saveState(conp, scmp);
             break;
         case 'v':
         case 'V':              /* restore */
+            load_queue_flush(queue);
             /** @bug ignores error code without explanation */
             (void)restoreState(conp, scmp);
             break;
         case 'y':
         case 'Y':              /* synchronize */
+            load_queue_flush(queue);
             if (write(s, "Y", 1) != 1)
                 abort();
             break;
@@ -690,7 +840,11 @@ sockline(
         }
         free((void *)ptr);
     }
+    load_queue_flush(queue);
+    load_queue_free(queue);
     free((void *)left);
+    if (sta >= 0)
+        sta = actx.sta;
     return (sta);
 }
 
@@ -705,7 +859,12 @@ fileline(
     char c;
     int done = 0;
     err_code sta = 0;
+    struct aur_context actx = {scmp, conp, 0};
+    struct load_queue *queue;
 
+    queue = load_queue_new(LOAD_QUEUE_MAX_PENDING, &aur, &actx);
+    if (queue == NULL)
+        return ERR_SCM_NOMEM;
     for (done = 0; !done;)
     {
         if (fgets(ptr, 1023, s) == NULL)
@@ -744,32 +903,17 @@ fileline(
         case 'a':
         case 'A':              /* add */
             LOG(LOG_INFO, "AUR add request: %s", valu);
-            sta = aur(scmp, conp, 'a', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'a', hdir, valu);
             break;
         case 'u':
         case 'U':              /* update */
             LOG(LOG_INFO, "AUR update request: %s", valu);
-            sta = aur(scmp, conp, 'u', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'u', hdir, valu);
             break;
         case 'r':
         case 'R':              /* remove */
             LOG(LOG_INFO, "AUR remove request: %s", valu);
-            sta = aur(scmp, conp, 'r', valu);
-            if (sta < 0)
-                LOG(LOG_ERR, "Status was %s (%s)",
-                    err2name(sta), err2string(sta));
-            else
-                LOG(LOG_DEBUG, "Status was %d", sta);
+            sta = load_queue_push(queue, 'r', hdir, valu);
             break;
         case 'l':
         case 'L':              /* link */
@@ -794,11 +938,13 @@ fileline(
             break;
         case 's':
         case 'S':              /* save */
+            load_queue_flush(queue);
             /** @bug ignores error code without explanation */
             (void)saveState(conp, scmp);
             break;
         case 'v':
         case 'V':              /* restore */
+            load_queue_flush(queue);
             /** @bug ignores error code without explanation */
             (void)restoreState(conp, scmp);
             break;
@@ -812,6 +958,10 @@ fileline(
             break;
         }
     }
+    load_queue_flush(queue);
+    load_queue_free(queue);
+    if (sta >= 0)
+        sta = actx.sta;
     return (sta);
 }
 
@@ -828,6 +978,7 @@ fileline(
 // -w port operate in wrapper mode using the given socket port
 // -p with -w indicates to run perpetually, e.g. as a daemon
 // -z run from file list instead of port
+// -V recompute the effective validity of all objects
 
 int main(
     int argc,
@@ -858,6 +1009,7 @@ int main(
     int trusted = 0;
     int force = 0;
     int allowex = 0;
+    int do_validity = 0;
     err_code sta = 0;
     int s;
     int c;
@@ -868,7 +1020,7 @@ int main(
         usage();
         return (1);
     }
-    while ((c = getopt(argc, argv, "t:xyhad:f:F:lLwz:pm:c:s")) != EOF)
+    while ((c = getopt(argc, argv, "t:xyhad:f:F:lLwz:pm:c:sV")) != EOF)
     {
         switch (c)
         {
@@ -917,6 +1069,9 @@ int main(
             strict_profile_checks = 1;  // global from myssl.c
             strict_profile_checks_cms = 1;      // global from roa_validate.c
             break;
+        case 'V':
+            do_validity++;
+            break;
         default:
             (void)fprintf(stderr, "Invalid option '%c'\n", c);
             usage();
@@ -930,8 +1085,8 @@ int main(
         usage();
         return (1);
     }
-    if ((do_create + do_delete + do_sockopts + do_fileopts) == 0 &&
-        thefile == 0 && thedelfile == 0 && use_filelist == 0)
+    if ((do_create + do_delete + do_sockopts + do_fileopts + do_validity) == 0
+        && thefile == 0 && thedelfile == 0 && use_filelist == 0)
     {
         (void)printf("You need to specify at least one operation "
                      "(e.g. -f file).\n");
@@ -944,6 +1099,11 @@ int main(
         LOG(LOG_ERR, "can't load configuration");
         exit(EXIT_FAILURE);
     }
+    if (CONFIG_LOG_BUFFER_SIZE_get() > 0 &&
+        !async_log_start(CONFIG_LOG_BUFFER_SIZE_get()))
+    {
+        LOG(LOG_WARNING, "can't buffer log messages, logging synchronously");
+    }
     if (force == 0)
     {
         if (do_delete > 0)
@@ -1084,7 +1244,11 @@ int main(
     {
         LOG(LOG_INFO, "Top level repository directory is %s", tdir);
         tdirlen = strlen(tdir);
+        restore_loader_state(scmp, realconp);
     }
+    if (((use_filelist + do_validity) > 0 || thefile != NULL ||
+         thedelfile != NULL) && sta == 0)
+        sta = begin_changes(scmp, realconp);
     /*
      * Setup for actual SSL operations
      */
@@ -1122,7 +1286,7 @@ int main(
                 LOG(LOG_INFO, "Attempting add: %s", outfile);
                 setallowexpired(allowex);
                 sta = add_object(scmp, realconp, outfile, outdir, outfull,
-                                 trusted);
+                                 trusted, NULL);
                 if (sta < 0)
                 {
                     LOG(LOG_ERR,
@@ -1151,6 +1315,7 @@ int main(
         size_t len = 0;
         ssize_t read;
         err_code status;
+        struct split_path split;
 
         setallowexpired(allowex);
         while ((read = getline(&line, &len, stdin)) != -1)
@@ -1165,25 +1330,25 @@ int main(
                 continue;
 
             // Split directory and file components of path
-            status = splitdf(NULL, NULL, line, &outdir, &outfile, &outfull);
+            status = splitdf_r(NULL, NULL, line, &split);
             if (status != 0)
             {
                 LOG(LOG_ERR, "%s (%s)", err2string(status), err2name(status));
                 continue;
             }
 
-            LOG(LOG_INFO, "Attempting add: %s", outfile);
+            LOG(LOG_INFO, "Attempting add: %s", split.file);
 
             // Warn if file not within repository directory
-            if (strncmp(tdir, outdir, tdirlen) != 0)
+            if (strncmp(tdir, split.dir, tdirlen) != 0)
                 LOG(LOG_WARNING, "%s is not in the repository", line);
 
             // Add
-            status = add_object(scmp, realconp, outfile, outdir, outfull,
-                                trusted);
+            status = add_object(scmp, realconp, split.file, split.dir,
+                                split.full, trusted, NULL);
             if (status == 0)
             {
-                LOG(LOG_INFO, "Add succeeded: %s", outfile);
+                LOG(LOG_INFO, "Add succeeded: %s", split.file);
             }
             else
             {
@@ -1196,9 +1361,7 @@ int main(
                         LOG(LOG_ERR, "\t%s", ne);
                 }
             }
-            free((void *)outdir);
-            free((void *)outfile);
-            free((void *)outfull);
+            write_perf_stats(PERF_STATS_INTERVAL);
         }
 
         free(line);
@@ -1231,6 +1394,13 @@ int main(
         else
             LOG(LOG_ERR, "Error: %s (%s)", err2string(sta), err2name(sta));
     }
+    if (((use_filelist + do_validity) > 0 || thefile != NULL ||
+         thedelfile != NULL) && sta == 0)
+        sta = refresh_validity(scmp, realconp);
+    if (use_filelist > 0 || thefile != NULL || thedelfile != NULL)
+        write_perf_stats(0);
+    if (sta == 0)
+        checkpoint_loader_state();
     if ((do_sockopts + do_fileopts) > 0 && sta == 0)
     {
         int protos = (-1);
@@ -1262,9 +1432,16 @@ int main(
                 {
                     makesock_failures = 0;
                     FLUSH_LOG();
+                    sta = begin_changes(scmp, realconp);
                     /** @bug ignores error code without explanation */
-                    sta = sockline(scmp, realconp, s);
+                    if (sta == 0)
+                        sta = sockline(scmp, realconp, s);
                     LOG(LOG_INFO, "Socket connection closed");
+                    if (sta == 0)
+                        sta = refresh_validity(scmp, realconp);
+                    write_perf_stats(0);
+                    if (sta == 0)
+                        checkpoint_loader_state();
                     FLUSH_LOG();
                     (void)close(s);
                 }
@@ -1275,7 +1452,14 @@ int main(
                 {
                     LOG(LOG_DEBUG, "Opening stdin");
                     sfile = stdin;
-                    sta = fileline(scmp, realconp, sfile);
+                    sta = begin_changes(scmp, realconp);
+                    if (sta == 0)
+                        sta = fileline(scmp, realconp, sfile);
+                    if (sta == 0)
+                        sta = refresh_validity(scmp, realconp);
+                    write_perf_stats(0);
+                    if (sta == 0)
+                        checkpoint_loader_state();
                 }
                 else
                 {
@@ -1285,8 +1469,15 @@ int main(
                         LOG(LOG_ERR, "Could not open cmdfile");
                     else
                     {
-                        sta = fileline(scmp, realconp, sfile);
+                        sta = begin_changes(scmp, realconp);
+                        if (sta == 0)
+                            sta = fileline(scmp, realconp, sfile);
                         LOG(LOG_DEBUG, "Cmdfile closed");
+                        if (sta == 0)
+                            sta = refresh_validity(scmp, realconp);
+                        write_perf_stats(0);
+                        if (sta == 0)
+                            checkpoint_loader_state();
                         (void)fclose(sfile);
                     }
                 }
@@ -0,0 +1,800 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ftw.h>
+#include <getopt.h>
+
+#include "rpki/scm.h"
+#include "rpki/scmf.h"
+#include "rpki/sqhl.h"
+#include "rpki/err.h"
+#include "rpki/myssl.h"
+#include "rpki/querySupport.h"
+#include "config/config.h"
+#include "util/logging.h"
+#include "util/stringutils.h"
+
+/****************
+ * Summarize the objects in the RPKI cache: the number of validated,
+ * status-unknown, and invalid objects of each type, and the number of
+ * accepted objects under each trust anchor.
+ *
+ * The cache directory is walked once, and each object table is read
+ * with a single query.  Objects are classified by comparing the sorted
+ * lists of files and database rows.
+ **************/
+
+/*
+ * Maximum number of file name extensions for one type of object
+ */
+#define MAX_EXTENSIONS 2
+
+struct path_list {
+    char **paths;
+    size_t len;
+    size_t cap;
+};
+
+/*
+ * Everything known about one type of object
+ */
+struct object_type {
+    /** @brief name of the table in the schema */
+    const char *table;
+    /** @brief section heading */
+    const char *heading;
+    /** @brief used in "Total %s files" */
+    const char *noun;
+    /** @brief used in "Validated %s" */
+    const char *plural;
+    /** @brief used in "%s in the database but not found ..." */
+    const char *capitalized;
+    /** @brief file name extensions, without the dot */
+    const char *extensions[MAX_EXTENSIONS];
+    /** @brief files of this type in the cache directory */
+    struct path_list files;
+    /** @brief database rows that pass the query client's tests */
+    struct path_list accepted;
+    /** @brief database rows that do not */
+    struct path_list unaccepted;
+};
+
+enum {
+    TYPE_CERT,
+    TYPE_CRL,
+    TYPE_ROA,
+    TYPE_MANIFEST,
+    TYPE_GBR,
+    NUM_TYPES
+};
+
+static struct object_type types[NUM_TYPES] = {
+    [TYPE_CERT] = {
+        "certificate", "Certificate", "cert", "certs", "Certs",
+        {"cer"},
+    },
+    [TYPE_CRL] = {
+        "crl", "CRL", "crl", "crls", "CRLs",
+        {"crl"},
+    },
+    [TYPE_ROA] = {
+        "roa", "ROA", "roa", "roas", "ROAs",
+        {"roa"},
+    },
+    [TYPE_MANIFEST] = {
+        "manifest", "Manifest", "manifest", "manifests", "Manifests",
+        {"mft", "mnf"},
+    },
+    [TYPE_GBR] = {
+        "ghostbusters", "Ghostbusters", "ghostbusters", "ghostbusters",
+        "Ghostbusters",
+        {"gbr"},
+    },
+};
+
+/*
+ * Counts of the objects descended from one trust anchor
+ */
+struct ta_summary {
+    unsigned int ta_id;
+    char *path;
+    size_t accepted[NUM_TYPES];
+    size_t unaccepted[NUM_TYPES];
+};
+
+static struct ta_summary *tas = NULL;
+static size_t num_tas = 0;
+/* objects whose chain does not reach a trust anchor */
+static struct ta_summary unanchored;
+
+static char *repo_path = NULL;
+static size_t repo_path_len = 0;
+static char *ee_prefix = NULL;
+
+static void path_list_add(
+    struct path_list *list,
+    const char *path)
+{
+    if (list->len == list->cap)
+    {
+        size_t cap = list->cap ? 2 * list->cap : 1024;
+        char **paths = realloc(list->paths, cap * sizeof(*paths));
+        if (paths == NULL)
+        {
+            LOG(LOG_ERR, "out of memory");
+            exit(EXIT_FAILURE);
+        }
+        list->paths = paths;
+        list->cap = cap;
+    }
+    list->paths[list->len] = strdup(path);
+    if (list->paths[list->len] == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        exit(EXIT_FAILURE);
+    }
+    list->len++;
+}
+
+static void path_list_free(
+    struct path_list *list)
+{
+    for (size_t i = 0; i < list->len; ++i)
+        free(list->paths[i]);
+    free(list->paths);
+    list->paths = NULL;
+    list->len = list->cap = 0;
+}
+
+static int compare_paths(
+    const void *a,
+    const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void path_list_sort(
+    struct path_list *list)
+{
+    qsort(list->paths, list->len, sizeof(*list->paths), &compare_paths);
+}
+
+/*
+ * The list must be sorted.
+ */
+static int path_list_contains(
+    const struct path_list *list,
+    const char *path)
+{
+    return bsearch(&path, list->paths, list->len, sizeof(*list->paths),
+                   &compare_paths) != NULL;
+}
+
+static int in_repo_path(
+    const char *path)
+{
+    return strncmp(path, repo_path, repo_path_len) == 0 &&
+        path[repo_path_len] == '/';
+}
+
+static struct ta_summary *find_ta(
+    unsigned int ta_id)
+{
+    for (size_t i = 0; i < num_tas; ++i)
+    {
+        if (tas[i].ta_id == ta_id)
+            return &tas[i];
+    }
+    struct ta_summary *grown = realloc(tas, (num_tas + 1) * sizeof(*tas));
+    if (grown == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        exit(EXIT_FAILURE);
+    }
+    tas = grown;
+    memset(&tas[num_tas], 0, sizeof(tas[num_tas]));
+    tas[num_tas].ta_id = ta_id;
+    return &tas[num_tas++];
+}
+
+/**
+ * @brief
+ *     nftw() callback that files each object under its type
+ */
+static int scan_file(
+    const char *fpath,
+    const struct stat *sb,
+    int typeflag,
+    struct FTW *ftwbuf)
+{
+    const char *ext;
+
+    (void)sb;
+    (void)ftwbuf;
+    if (typeflag != FTW_F)
+        return 0;
+    ext = strrchr(fpath, '.');
+    if (ext == NULL)
+        return 0;
+    ext++;
+    for (size_t i = 0; i < NUM_TYPES; ++i)
+    {
+        for (size_t j = 0; j < MAX_EXTENSIONS; ++j)
+        {
+            if (types[i].extensions[j] != NULL &&
+                strcmp(ext, types[i].extensions[j]) == 0)
+            {
+                path_list_add(&types[i].files, fpath);
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * columns of the per-table search, in order
+ */
+static char dirname_val[DNAMESIZE];
+static char filename_val[FNAMESIZE];
+static unsigned int flags_val;
+static unsigned int eff_valid_val;
+static unsigned int ta_id_val;
+static char eff_valto_val[48];
+static char keyid_val[SKISIZE];
+
+/*
+ * the time this run started, in the database's own format, for
+ * comparison with eff_valto
+ */
+static char *now;
+
+/*
+ * whether eff_valid and eff_valto were computed under this
+ * configuration's policy; if not, chains are checked with
+ * checkValidity()
+ */
+static int chains_current;
+static scm *schema;
+static unsigned int local_id_val;
+static unsigned int is_trusted_val;
+
+/**
+ * @brief
+ *     callback for the search of one object table
+ */
+static sqlvaluefunc handleObject;
+err_code
+handleObject(
+    scmcon *conp,
+    scmsrcha *s,
+    ssize_t numLine)
+{
+    size_t type = (struct object_type *)s->context - types;
+    char path[DNAMESIZE + FNAMESIZE + 1];
+    struct ta_summary *summary;
+    int accepted;
+
+    UNREFERENCED_PARAMETER(numLine);
+    xsnprintf(path, sizeof(path), "%s/%s", dirname_val, filename_val);
+    accepted = queryFlagsAccepted(flags_val);
+    if (accepted && chains_current)
+        accepted = eff_valid_val && s->vec[5].avalsize != SQL_NULL_DATA &&
+            strcmp(eff_valto_val, now) > 0;
+    else if (accepted)
+        accepted = checkValidity(type == TYPE_CERT ? NULL : keyid_val,
+                                 local_id_val, schema, conp);
+    path_list_add(accepted ? &types[type].accepted : &types[type].unaccepted,
+                  path);
+    if (s->vec[4].avalsize == SQL_NULL_DATA)
+        summary = &unanchored;
+    else
+        summary = find_ta(ta_id_val);
+    if (accepted)
+        summary->accepted[type]++;
+    else
+        summary->unaccepted[type]++;
+    if (type == TYPE_CERT && is_trusted_val)
+    {
+        summary = find_ta(local_id_val);
+        if (summary->path == NULL)
+            summary->path = strdup(path);
+    }
+    return 0;
+}
+
+static err_code
+readTable(
+    scm *scmp,
+    scmcon *conp,
+    struct object_type *type)
+{
+    scmtab *table;
+    err_code sta;
+
+    table = findtablescm(scmp, type->table);
+    checkErr(table == NULL, "Cannot find table %s", type->table);
+    scmsrch srch1[] = {
+        {
+            .colno = 1,
+            .sqltype = SQL_C_CHAR,
+            .colname = "dirname",
+            .valptr = dirname_val,
+            .valsize = sizeof(dirname_val),
+        },
+        {
+            .colno = 2,
+            .sqltype = SQL_C_CHAR,
+            .colname = "filename",
+            .valptr = filename_val,
+            .valsize = sizeof(filename_val),
+        },
+        {
+            .colno = 3,
+            .sqltype = SQL_C_ULONG,
+            .colname = "flags",
+            .valptr = &flags_val,
+            .valsize = sizeof(flags_val),
+        },
+        {
+            .colno = 4,
+            .sqltype = SQL_C_ULONG,
+            .colname = "eff_valid",
+            .valptr = &eff_valid_val,
+            .valsize = sizeof(eff_valid_val),
+        },
+        {
+            .colno = 5,
+            .sqltype = SQL_C_ULONG,
+            .colname = "ta_id",
+            .valptr = &ta_id_val,
+            .valsize = sizeof(ta_id_val),
+        },
+        {
+            .colno = 6,
+            .sqltype = SQL_C_CHAR,
+            .colname = "eff_valto",
+            .valptr = eff_valto_val,
+            .valsize = sizeof(eff_valto_val),
+        },
+        {
+            .colno = 7,
+            .sqltype = SQL_C_CHAR,
+            // the key identifier of the certificate that signed it
+            .colname = (type == &types[TYPE_CRL]) ? "aki" : "ski",
+            .valptr = keyid_val,
+            .valsize = sizeof(keyid_val),
+        },
+        {
+            .colno = 8,
+            .sqltype = SQL_C_ULONG,
+            .colname = "local_id",
+            .valptr = &local_id_val,
+            .valsize = sizeof(local_id_val),
+        },
+        {
+            .colno = 9,
+            .sqltype = SQL_C_ULONG,
+            .colname = "is_trusted",
+            .valptr = &is_trusted_val,
+            .valsize = sizeof(is_trusted_val),
+        },
+    };
+    scmsrcha srch = {
+        .vec = srch1,
+        .sname = NULL,
+        .ntot = ELTS(srch1),
+        // only certificates have is_trusted
+        .nused = (type == &types[TYPE_CERT]) ? ELTS(srch1) : ELTS(srch1) - 1,
+        .vald = 0,
+        .where = NULL,
+        .wherestr = NULL,
+        .context = type,
+    };
+    is_trusted_val = 0;
+    sta = searchscm(conp, table, &srch, NULL, &handleObject,
+                    SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
+    if (sta == ERR_SCM_NODATA)
+        sta = 0;
+    return sta;
+}
+
+static size_t count_outside(
+    const struct path_list *list)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < list->len; ++i)
+    {
+        if (!in_repo_path(list->paths[i]))
+            n++;
+    }
+    return n;
+}
+
+static void print_paths(
+    const char *title,
+    const char **paths,
+    size_t len)
+{
+    if (len == 0)
+        return;
+    printf("\n%s:\n", title);
+    for (size_t i = 0; i < len; ++i)
+        printf("%s\n", paths[i]);
+}
+
+/*
+ * Print the section of the report for one type of object.  The
+ * type's lists are sorted as a side effect.
+ */
+static void
+reportType(
+    struct object_type *type,
+    int verbose)
+{
+    size_t ndb = type->accepted.len + type->unaccepted.len;
+    const char **invalid = malloc((type->files.len + 1) * sizeof(*invalid));
+    const char **outside = malloc((ndb + 1) * sizeof(*outside));
+    size_t ninvalid = 0;
+    size_t noutside = 0;
+    char title[128];
+
+    if (invalid == NULL || outside == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        exit(EXIT_FAILURE);
+    }
+    path_list_sort(&type->files);
+    path_list_sort(&type->accepted);
+    path_list_sort(&type->unaccepted);
+    for (size_t i = 0; i < type->files.len; ++i)
+    {
+        const char *f = type->files.paths[i];
+        if (!path_list_contains(&type->accepted, f) &&
+            !path_list_contains(&type->unaccepted, f))
+            invalid[ninvalid++] = f;
+    }
+
+    printf("\n");
+    printf("-------------------------------------------------------------"
+           "------------------\n");
+    printf("%s Information:\n", type->heading);
+    printf("-------------------------------------------------------------"
+           "------------------\n");
+    if (type == &types[TYPE_CERT])
+    {
+        size_t nee = 0;
+        for (size_t i = 0; i < type->files.len; ++i)
+        {
+            if (strncmp(type->files.paths[i], ee_prefix,
+                        strlen(ee_prefix)) == 0)
+                nee++;
+        }
+        printf("CA cert files: %zu\n", type->files.len - nee);
+        printf("EE cert files: %zu\n", nee);
+    }
+    printf("Total %s files: %zu\n", type->noun, type->files.len);
+
+    if (count_outside(&type->accepted))
+        fprintf(stderr, "Warning: Found validated file outside of "
+                "repository path.  Counts will be wrong.\n");
+    if (count_outside(&type->unaccepted))
+        fprintf(stderr, "Warning: Found file of unknown validity outside of "
+                "repository path.  Counts will be wrong.\n");
+    printf("Validated %s: %zu\n", type->plural, type->accepted.len);
+    printf("Status-unknown %s: %zu\n", type->plural, type->unaccepted.len);
+    printf("Invalid or duplicate %s: %zu\n", type->plural, ninvalid);
+
+    if (verbose)
+    {
+        // merge the two sorted database lists, keeping rows whose
+        // file was not found in the cache
+        size_t a = 0;
+        size_t u = 0;
+        while (a < type->accepted.len || u < type->unaccepted.len)
+        {
+            const char *next;
+            if (u == type->unaccepted.len ||
+                (a < type->accepted.len &&
+                 strcmp(type->accepted.paths[a],
+                        type->unaccepted.paths[u]) <= 0))
+                next = type->accepted.paths[a++];
+            else
+                next = type->unaccepted.paths[u++];
+            if (!path_list_contains(&type->files, next))
+                outside[noutside++] = next;
+        }
+        xsnprintf(title, sizeof(title), "Validated %s", type->plural);
+        print_paths(title, (const char **)type->accepted.paths,
+                    type->accepted.len);
+        xsnprintf(title, sizeof(title), "Status-unknown %s", type->plural);
+        print_paths(title, (const char **)type->unaccepted.paths,
+                    type->unaccepted.len);
+        xsnprintf(title, sizeof(title), "Invalid or duplicate %s",
+                  type->plural);
+        print_paths(title, invalid, ninvalid);
+        xsnprintf(title, sizeof(title), "%s in the database but not found "
+                  "in local repository path", type->capitalized);
+        print_paths(title, outside, noutside);
+    }
+    fflush(stdout);
+    free(invalid);
+    free(outside);
+}
+
+static void
+reportTrustAnchors(
+    void)
+{
+    printf("\n");
+    printf("-------------------------------------------------------------"
+           "------------------\n");
+    printf("Trust Anchor Information:\n");
+    printf("-------------------------------------------------------------"
+           "------------------\n");
+    for (size_t i = 0; i <= num_tas; ++i)
+    {
+        const struct ta_summary *ta = (i < num_tas) ? &tas[i] : &unanchored;
+        size_t total = 0;
+        for (size_t t = 0; t < NUM_TYPES; ++t)
+            total += ta->accepted[t] + ta->unaccepted[t];
+        if (total == 0)
+            continue;
+        if (i == num_tas)
+            printf("\nNot descended from a trust anchor:\n");
+        else if (ta->path != NULL)
+            printf("\n%s:\n", ta->path);
+        else
+            printf("\nTrust anchor %u:\n", ta->ta_id);
+        for (size_t t = 0; t < NUM_TYPES; ++t)
+            printf("    %s: %zu validated, %zu status-unknown\n",
+                   types[t].plural, ta->accepted[t], ta->unaccepted[t]);
+    }
+}
+
+/*
+ * Print the rsync URIs of accepted (or not accepted) objects, as
+ * sorted across all types.  EE certificates are left out because they
+ * are not separately published.
+ */
+static void
+listURIs(
+    int accepted)
+{
+    const char **uris = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+
+    for (size_t t = 0; t < NUM_TYPES; ++t)
+    {
+        struct object_type *type = &types[t];
+        path_list_sort(&type->accepted);
+        path_list_sort(&type->unaccepted);
+        const struct path_list *lists[2] = {NULL, NULL};
+        if (accepted)
+        {
+            lists[0] = &type->accepted;
+        }
+        else
+        {
+            lists[0] = &type->unaccepted;
+            lists[1] = &type->files;    // filtered below
+        }
+        for (size_t l = 0; l < 2 && lists[l] != NULL; ++l)
+        {
+            for (size_t i = 0; i < lists[l]->len; ++i)
+            {
+                const char *path = lists[l]->paths[i];
+                if (lists[l] == &type->files &&
+                    (path_list_contains(&type->accepted, path) ||
+                     path_list_contains(&type->unaccepted, path)))
+                    continue;
+                if (t == TYPE_CERT &&
+                    strncmp(path, ee_prefix, strlen(ee_prefix)) == 0)
+                    continue;
+                if (len == cap)
+                {
+                    cap = cap ? 2 * cap : 1024;
+                    const char **grown = realloc(uris, cap * sizeof(*uris));
+                    if (grown == NULL)
+                    {
+                        LOG(LOG_ERR, "out of memory");
+                        exit(EXIT_FAILURE);
+                    }
+                    uris = grown;
+                }
+                uris[len++] = path;
+            }
+        }
+    }
+    qsort(uris, len, sizeof(*uris), &compare_paths);
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (strncmp(uris[i], repo_path, repo_path_len) == 0)
+            printf("rsync:/%s\n", uris[i] + repo_path_len);
+    }
+    free(uris);
+}
+
+static void usage(
+    const char *progname)
+{
+    printf("Usage: %s [options]\n", progname);
+    printf("\n");
+    printf("Show a summary of objects in the RPKI cache. This includes the\n");
+    printf("number of valid, invalid, and unknown-state objects of each\n");
+    printf("type, and the number of objects under each trust anchor.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -h, --help               show this help message and exit\n");
+    printf("  -v, --verbose            output lists of valid/invalid/unknown\n");
+    printf("                           objects in addition to counts\n");
+    printf("  -a, --list-accepted      list accepted objects\n");
+    printf("  -n, --list-not-accepted  list not-accepted objects\n");
+}
+
+static const struct option long_options[] = {
+    {"help", no_argument, NULL, 'h'},
+    {"verbose", no_argument, NULL, 'v'},
+    {"list-accepted", no_argument, NULL, 'a'},
+    {"list-not-accepted", no_argument, NULL, 'n'},
+    {NULL, 0, NULL, 0}
+};
+
+int main(
+    int argc,
+    char **argv)
+{
+    scm *scmp = NULL;
+    scmcon *conp = NULL;
+    char errMsg[1024];
+    int verbose = 0;
+    int listAccepted = 0;
+    int listNotAccepted = 0;
+    int ret = EXIT_SUCCESS;
+    err_code sta;
+    int c;
+
+    OPEN_LOG("results", LOG_USER);
+    while ((c = getopt_long(argc, argv, "hvan", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'a':
+            listAccepted = 1;
+            break;
+        case 'n':
+            listNotAccepted = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (verbose + listAccepted + listNotAccepted > 1)
+    {
+        fprintf(stderr, "only one option supported\n");
+        return EXIT_FAILURE;
+    }
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't initialize configuration");
+        return EXIT_FAILURE;
+    }
+
+    repo_path = strdup(CONFIG_RPKI_CACHE_DIR_get());
+    if (repo_path == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    repo_path_len = strlen(repo_path);
+    while (repo_path_len > 0 && repo_path[repo_path_len - 1] == '/')
+        repo_path[--repo_path_len] = '\0';
+    ee_prefix = malloc(repo_path_len + sizeof("/EEcertificates/"));
+    if (ee_prefix == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    sprintf(ee_prefix, "%s/EEcertificates/", repo_path);
+    if (!listAccepted && !listNotAccepted)
+        printf("Using local repository path: %s\n", repo_path);
+    if (access(repo_path, F_OK) != 0)
+        fprintf(stderr, "Local repository does not exist (%s)\n", repo_path);
+    else if (nftw(repo_path, &scan_file, 64, FTW_PHYS) != 0)
+    {
+        LOG(LOG_ERR, "error while scanning %s", repo_path);
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+
+    scmp = initscm();
+    if (scmp == NULL)
+    {
+        LOG(LOG_ERR, "Cannot initialize database schema");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    conp = connectscm(scmp->dsn, errMsg, sizeof(errMsg));
+    if (conp == NULL)
+    {
+        LOG(LOG_ERR, "Cannot connect to database: %s", errMsg);
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    schema = scmp;
+    sta = check_effective_validity(scmp, conp, &chains_current);
+    if (sta < 0)
+    {
+        LOG(LOG_ERR, "Cannot check effective validity: %s",
+            err2string(sta));
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+    now = LocalTimeToDBTime(&sta);
+    if (now == NULL)
+    {
+        LOG(LOG_ERR, "Cannot get the current time: %s", err2string(sta));
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+
+    for (size_t t = 0; t < NUM_TYPES; ++t)
+    {
+        conp->mystat.tabname = (char *)types[t].table;
+        sta = readTable(scmp, conp, &types[t]);
+        if (sta < 0)
+        {
+            LOG(LOG_ERR, "Error reading %s table: %s", types[t].table,
+                err2string(sta));
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+        if (!listAccepted && !listNotAccepted)
+            reportType(&types[t], verbose);
+    }
+
+    if (listAccepted || listNotAccepted)
+        listURIs(listAccepted);
+    else
+    {
+        reportTrustAnchors();
+        if (!verbose)
+            printf("\nHint: to see lists of valid/unknown/invalid objects, "
+                   "run with -v.\n");
+    }
+
+done:
+    for (size_t t = 0; t < NUM_TYPES; ++t)
+    {
+        path_list_free(&types[t].files);
+        path_list_free(&types[t].accepted);
+        path_list_free(&types[t].unaccepted);
+    }
+    for (size_t i = 0; i < num_tas; ++i)
+        free(tas[i].path);
+    free(tas);
+    free(ee_prefix);
+    free(repo_path);
+    free(now);
+    if (conp != NULL)
+        disconnectscm(conp);
+    if (scmp != NULL)
+        freescm(scmp);
+    config_unload();
+    CLOSE_LOG();
+    return ret;
+}
@@ -56,7 +56,7 @@ static struct casn_errors {
     {0, "Undefined error"},
 };
 
-struct casn_err_struct casn_err_struct;
+__thread struct casn_err_struct casn_err_struct;
 
 /* char_table masks are:
     numeric       1              ' ' = ia5 only,
@@ -42,7 +42,11 @@ struct casn_err_struct {
     struct casn *casnp;
 };
 
-extern struct casn_err_struct casn_err_struct;
+/*
+ * Details of the last error reported by this thread.  Objects are
+ * decoded on several threads at once, so each thread keeps its own.
+ */
+extern __thread struct casn_err_struct casn_err_struct;
 
 /**
  * @brief
@@ -107,7 +111,85 @@ diff_casn_time(
 int
 diff_objid(
     struct casn *fr_casnp,
-    const char *objidp);
+    const char *objidp);        // can return -2 (error)!
+
+/**
+ * @brief
+ *     compare an OID with already-encoded content octets
+ *
+ * Cheaper than diff_objid() when the same constant is compared many
+ * times; encode it once with encode_objid().
+ *
+ * @return 0 if equal, -1 or 1 if different, -2 on error
+ */
+int
+diff_objid_der(
+    struct casn *casnp,
+    const uchar *der,
+    size_t lth);
+
+// largest encoded OID handled by the fast comparison paths
+#define CASN_OBJID_DER_MAX 64
+
+/**
+ * @brief
+ *     encode a dotted-decimal OID string as DER content octets
+ *
+ * @return the number of octets written to @p to, or -1 if the string
+ *     is malformed or doesn't fit in @p tolen octets
+ */
+int
+encode_objid(
+    const char *objid,
+    uchar *to,
+    size_t tolen);
+
+struct objid_table_entry {
+    uchar der[CASN_OBJID_DER_MAX];
+    size_t lth;                 // 0 for an empty slot
+    int index;
+};
+
+/**
+ * @brief
+ *     hash table mapping encoded OIDs to their index in a list
+ *
+ * Lets a caller dispatch on an OID (e.g. an extension's extnID) with
+ * one hash and one comparison instead of a diff_objid() per
+ * candidate.
+ */
+struct objid_table {
+    struct objid_table_entry *slots;
+    size_t size;
+};
+
+/**
+ * @brief
+ *     build a table from @p num dotted-decimal OID strings
+ *
+ * objid_table_find() returns the position of a matching OID in
+ * @p objids.
+ *
+ * @return 0 on success, -1 if out of memory or an OID is malformed
+ */
+int
+objid_table_init(
+    struct objid_table *table,
+    const char *const *objids,
+    size_t num);
+
+void
+objid_table_free(
+    struct objid_table *table);
+
+/**
+ * @return the index of the OID in @p casnp, -1 if it isn't in the
+ *     table, or -2 on error
+ */
+int
+objid_table_find(
+    const struct objid_table *table,
+    struct casn *casnp);
 
 int
 dump_casn(
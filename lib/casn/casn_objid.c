@@ -13,11 +13,17 @@ Cambridge, Ma. 02138
 617-873-3000
 *****************************************************************************/
 
+#include <limits.h>
+
 #include "casn.h"
 #include "casn_private.h"
 #include "util/stringutils.h"
 
-int diff_objid(
+/*
+ * Compare by converting the OID to a dotted string.  Used only when
+ * the constant can't be encoded for diff_objid_der().
+ */
+static int _diff_objid_str(
     struct casn *casnp,
     const char *objid)
 {
@@ -81,6 +87,204 @@ int diff_objid(
     return ansr;
 }
 
+int encode_objid(
+    const char *objid,
+    uchar *to,
+    size_t tolen)
+{
+    const char *c = objid;
+    ulong first = 0;
+    ulong val;
+    ulong tmp;
+    size_t lth = 0;
+    int narc;
+    int siz;
+    int i;
+
+    for (narc = 0; *c; narc++)
+    {
+        if (*c < '0' || *c > '9')
+            return -1;
+        for (val = 0; *c >= '0' && *c <= '9'; c++)
+        {
+            if (val > (ULONG_MAX - 9) / 10)
+                return -1;
+            val = val * 10 + (ulong)(*c - '0');
+        }
+        if (*c == '.' && c[1])
+            c++;
+        else if (*c)
+            return -1;
+        // the first two arcs share one subidentifier
+        if (narc == 0)
+        {
+            if (val > 2)
+                return -1;
+            first = val;
+            continue;
+        }
+        if (narc == 1)
+        {
+            if ((first < 2 && val >= 40) || val > ULONG_MAX - 80)
+                return -1;
+            val += first * 40;
+        }
+        for (tmp = val >> 7, siz = 1; tmp; tmp >>= 7)
+            siz++;
+        if (lth + siz > tolen)
+            return -1;
+        for (i = siz; i--; val >>= 7)
+            to[lth + i] = (uchar)(val & 0x7F) | ((i == siz - 1) ? 0 : 0x80);
+        lth += siz;
+    }
+    return (narc < 2) ? -1 : (int)lth;
+}
+
+int diff_objid_der(
+    struct casn *casnp,
+    const uchar *der,
+    size_t lth)
+{
+    int ansr;
+
+    if (_clear_error(casnp) < 0)
+        return -2;
+    if (casnp->type != ASN_OBJ_ID)
+    {
+        _casn_obj_err(casnp, ASN_TYPE_ERR);
+        return -2;
+    }
+    if (casnp->tag == ASN_NOTYPE && _check_enum(&casnp) <= 0)
+        return -2;
+    if (!casnp->lth)
+        return -2;
+    if ((ansr = memcmp(casnp->startp, der,
+                       (casnp->lth < lth) ? casnp->lth : lth)) == 0)
+    {
+        if (casnp->lth == lth)
+            return 0;
+        return (casnp->lth < lth) ? -1 : 1;
+    }
+    return (ansr < 0) ? -1 : 1;
+}
+
+int diff_objid(
+    struct casn *casnp,
+    const char *objid)
+{
+    uchar der[CASN_OBJID_DER_MAX];
+    int lth;
+
+    /*
+     * Encode the constant, which is cheap and needs no allocation,
+     * and compare content octets.  Only fall back to comparing
+     * dotted strings if the constant can't be encoded or the object
+     * isn't a plain OID.
+     */
+    if (casnp->type == ASN_OBJ_ID &&
+        (lth = encode_objid(objid, der, sizeof(der))) > 0)
+        return diff_objid_der(casnp, der, lth);
+    return _diff_objid_str(casnp, objid);
+}
+
+/*
+ * Open-addressed hash table of encoded OIDs.  The number of slots is
+ * a power of two at least twice the number of entries, so probe
+ * sequences stay short and an empty slot always ends a search.
+ */
+static uint32_t objid_hash(
+    const uchar *der,
+    size_t lth)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+
+    while (lth--)
+    {
+        h ^= *der++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int objid_table_init(
+    struct objid_table *table,
+    const char *const *objids,
+    size_t num)
+{
+    struct objid_table_entry *entp;
+    uchar der[CASN_OBJID_DER_MAX];
+    size_t i;
+    size_t slot;
+    int lth;
+
+    table->slots = NULL;
+    for (table->size = 4; table->size < num * 2; table->size <<= 1);
+    table->slots = calloc(table->size, sizeof(*table->slots));
+    if (!table->slots)
+        return -1;
+    for (i = 0; i < num; i++)
+    {
+        if ((lth = encode_objid(objids[i], der, sizeof(der))) <= 0)
+        {
+            objid_table_free(table);
+            return -1;
+        }
+        for (slot = objid_hash(der, lth) & (table->size - 1);
+             (entp = &table->slots[slot])->lth;
+             slot = (slot + 1) & (table->size - 1))
+        {
+            // keep the first of any duplicates
+            if (entp->lth == (size_t)lth && !memcmp(entp->der, der, lth))
+                break;
+        }
+        if (entp->lth)
+            continue;
+        memcpy(entp->der, der, lth);
+        entp->lth = lth;
+        entp->index = i;
+    }
+    return 0;
+}
+
+void objid_table_free(
+    struct objid_table *table)
+{
+    free(table->slots);
+    table->slots = NULL;
+    table->size = 0;
+}
+
+int objid_table_find(
+    const struct objid_table *table,
+    struct casn *casnp)
+{
+    const struct objid_table_entry *entp;
+    size_t slot;
+
+    if (_clear_error(casnp) < 0)
+        return -2;
+    if (casnp->type != ASN_OBJ_ID)
+    {
+        _casn_obj_err(casnp, ASN_TYPE_ERR);
+        return -2;
+    }
+    if (casnp->tag == ASN_NOTYPE && _check_enum(&casnp) <= 0)
+        return -2;
+    if (!casnp->lth)
+        return -2;
+    if (!table->size)
+        return -1;
+    for (slot = objid_hash(casnp->startp, casnp->lth) & (table->size - 1);
+         (entp = &table->slots[slot])->lth;
+         slot = (slot + 1) & (table->size - 1))
+    {
+        if (entp->lth == casnp->lth &&
+            !memcmp(entp->der, casnp->startp, casnp->lth))
+            return entp->index;
+    }
+    return -1;
+}
+
 int read_objid(
     struct casn *casnp,
     char *to,
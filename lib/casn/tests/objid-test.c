@@ -0,0 +1,121 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "test/unittest.h"
+
+static bool test_encode_objid(
+    void)
+{
+    static const uchar rsadsi[] = {0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d};
+    static const uchar ipaddr[] = {0x2b, 0x06, 0x01, 0x05, 0x05, 0x07,
+                                   0x01, 0x07};
+    static const uchar joint[] = {0x88, 0x37, 0x00};
+    uchar der[CASN_OBJID_DER_MAX];
+
+    TEST(int, "%d", encode_objid("1.2.840.113549", der, sizeof(der)), ==,
+         (int)sizeof(rsadsi));
+    TEST_BOOL(memcmp(der, rsadsi, sizeof(rsadsi)) == 0, true);
+
+    TEST(int, "%d", encode_objid("1.3.6.1.5.5.7.1.7", der, sizeof(der)), ==,
+         (int)sizeof(ipaddr));
+    TEST_BOOL(memcmp(der, ipaddr, sizeof(ipaddr)) == 0, true);
+
+    // arc 2 allows a second arc of 40 or more
+    TEST(int, "%d", encode_objid("2.999.0", der, sizeof(der)), ==,
+         (int)sizeof(joint));
+    TEST_BOOL(memcmp(der, joint, sizeof(joint)) == 0, true);
+
+    TEST(int, "%d", encode_objid("", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1.2.", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1..2", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1.2a", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("3.1", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1.40", der, sizeof(der)), ==, -1);
+    TEST(int, "%d", encode_objid("1.2.840.113549", der, 5), ==, -1);
+
+    return true;
+}
+
+static bool test_diff_objid(
+    void)
+{
+    struct casn oid;
+    uchar der[CASN_OBJID_DER_MAX];
+    int lth;
+
+    simple_constructor(&oid, 0, ASN_OBJ_ID);
+
+    // unfilled
+    TEST(int, "%d", diff_objid(&oid, "1.3.6.1.5.5.7.1.7"), ==, -2);
+
+    write_objid(&oid, "1.3.6.1.5.5.7.1.7");
+    TEST(int, "%d", diff_objid(&oid, "1.3.6.1.5.5.7.1.7"), ==, 0);
+    TEST_BOOL(diff_objid(&oid, "1.3.6.1.5.5.7.1.8") != 0, true);
+    TEST_BOOL(diff_objid(&oid, "1.3.6.1.5.5.7.1") != 0, true);
+    TEST_BOOL(diff_objid(&oid, "1.3.6.1.5.5.7.1.7.1") != 0, true);
+
+    lth = encode_objid("1.3.6.1.5.5.7.1.7", der, sizeof(der));
+    TEST(int, "%d", diff_objid_der(&oid, der, lth), ==, 0);
+    TEST_BOOL(diff_objid_der(&oid, der, lth - 1) != 0, true);
+
+    // malformed constants fall back to the string comparison
+    TEST_BOOL(diff_objid(&oid, "1.3.6.x") != 0, true);
+
+    delete_casn(&oid);
+    return true;
+}
+
+static bool test_objid_table(
+    void)
+{
+    static const char *const oids[] = {
+        "2.5.29.19",
+        "2.5.29.14",
+        "2.5.29.35",
+        "1.3.6.1.5.5.7.1.7",
+        "1.3.6.1.5.5.7.1.8",
+        "2.5.29.14",            // duplicate; the first one wins
+    };
+    struct objid_table table;
+    struct casn oid;
+    size_t i;
+
+    TEST(int, "%d", objid_table_init(&table, oids,
+                                     sizeof(oids) / sizeof(oids[0])), ==, 0);
+    simple_constructor(&oid, 0, ASN_OBJ_ID);
+
+    TEST(int, "%d", objid_table_find(&table, &oid), ==, -2);
+
+    for (i = 0; i < sizeof(oids) / sizeof(oids[0]) - 1; i++)
+    {
+        write_objid(&oid, oids[i]);
+        TEST(int, "%d", objid_table_find(&table, &oid), ==, (int)i);
+    }
+
+    write_objid(&oid, "2.5.29.15");
+    TEST(int, "%d", objid_table_find(&table, &oid), ==, -1);
+
+    delete_casn(&oid);
+    objid_table_free(&table);
+
+    const char *bad[] = {"1.2.3", "not.an.oid"};
+    TEST(int, "%d", objid_table_init(&table, bad, 2), ==, -1);
+    TEST_BOOL(table.slots == NULL, true);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_encode_objid())
+        return EXIT_FAILURE;
+    if (!test_diff_objid())
+        return EXIT_FAILURE;
+    if (!test_objid_table())
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -14,6 +14,18 @@
 #include "util/stringutils.h"
 
 
+static int database_backend_value_odbc = DATABASE_BACKEND_ODBC;
+static int database_backend_value_mysql = DATABASE_BACKEND_MYSQL;
+static int database_backend_value_embedded = DATABASE_BACKEND_EMBEDDED;
+static struct config_type_enum_usr_arg_item
+    config_type_enum_arg_database_backend[] = {
+    {"odbc", &database_backend_value_odbc},
+    {"mysql", &database_backend_value_mysql},
+    {"embedded", &database_backend_value_embedded},
+    {NULL, NULL},
+};
+
+
 /** All available config options */
 static const struct config_option config_options[] = {
     // CONFIG_RPKI_PORT
@@ -67,6 +79,26 @@ static const struct config_option config_options[] = {
      NULL, NULL,
      NULL},
 
+    // CONFIG_DATABASE_BACKEND
+    {
+     "DatabaseBackend",
+     false,
+     config_type_enum_converter, config_type_enum_arg_database_backend,
+     NULL, NULL,
+     config_type_enum_free,
+     NULL, NULL,
+     "odbc"},
+
+    // CONFIG_DATABASE_DIR
+    {
+     "DatabaseDir",
+     false,
+     config_type_path_converter, NULL,
+     config_type_path_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "\"" PKGVARLIBDIR "\""},
+
     // CONFIG_TRUST_ANCHOR_LOCATORS
     {
      "TrustAnchorLocators",
@@ -279,6 +311,144 @@ static const struct config_option config_options[] = {
      free,
      NULL, NULL,
      "\"" PKGVARLIBDIR "/statistics\""},
+
+    // CONFIG_LOADER_STATE_FILE
+    {
+     "LoaderStateFile",
+     false,
+     config_type_path_converter, NULL,
+     config_type_path_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "\"" PKGVARLIBDIR "/loader-state\""},
+
+    // CONFIG_RPKI_RTR_NOTIFY_SOCKET
+    {
+     "RpkiRtrNotifySocket",
+     false,
+     config_type_path_converter, NULL,
+     config_type_path_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "\"" PKGVARLIBDIR "/rpki-rtr-notify\""},
+
+    // CONFIG_RPKI_RTR_REFRESH_INTERVAL
+    {
+     "RpkiRtrRefreshInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "3600"},
+
+    // CONFIG_RPKI_RTR_RETRY_INTERVAL
+    {
+     "RpkiRtrRetryInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "600"},
+
+    // CONFIG_RPKI_RTR_EXPIRE_INTERVAL
+    {
+     "RpkiRtrExpireInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "7200"},
+
+    // CONFIG_RPKI_RTR_WORKERS
+    {
+     "RpkiRtrWorkers",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "1"},
+
+    // CONFIG_RRDP_ENABLED
+    {
+     "RRDPEnabled",
+     false,
+     config_type_bool_converter, NULL,
+     config_type_bool_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "yes"},
+
+    // CONFIG_RRDP_STATE_FILE
+    {
+     "RRDPStateFile",
+     false,
+     config_type_path_converter, NULL,
+     config_type_path_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "\"" PKGVARLIBDIR "/rrdp-state\""},
+
+    // CONFIG_FETCH_HISTORY_FILE
+    {
+     "FetchHistoryFile",
+     false,
+     config_type_path_converter, NULL,
+     config_type_path_converter_inverse, NULL,
+     free,
+     NULL, NULL,
+     "\"" PKGVARLIBDIR "/fetch-history\""},
+
+    // CONFIG_FETCH_MIN_INTERVAL
+    {
+     "FetchMinInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "900"},
+
+    // CONFIG_FETCH_MAX_INTERVAL
+    {
+     "FetchMaxInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "14400"},
+
+    // CONFIG_FETCH_EXPIRY_MARGIN
+    {
+     "FetchExpiryMargin",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "7200"},
+
+    // CONFIG_LOG_BUFFER_SIZE
+    {
+     "LogBufferSize",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     config_type_sscanf_converter_inverse,
+     &config_type_sscanf_inverse_arg_size_t,
+     free,
+     NULL, NULL,
+     "0"},
 };
 
 
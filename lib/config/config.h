@@ -59,12 +59,22 @@
 */
 
 
+/** Values of CONFIG_DATABASE_BACKEND. */
+enum database_backend {
+    DATABASE_BACKEND_ODBC,
+    DATABASE_BACKEND_MYSQL,
+    DATABASE_BACKEND_EMBEDDED,
+};
+
+
 enum config_key {
     CONFIG_RPKI_PORT,
     CONFIG_DATABASE,
     CONFIG_DATABASE_USER,
     CONFIG_DATABASE_PASSWORD,
     CONFIG_DATABASE_DSN,
+    CONFIG_DATABASE_BACKEND,
+    CONFIG_DATABASE_DIR,
     CONFIG_TRUST_ANCHOR_LOCATORS,
     CONFIG_LOG_LEVEL,
     CONFIG_DOWNLOAD_CONCURRENCY,
@@ -86,6 +96,19 @@ enum config_key {
     CONFIG_LOG_DIR,
     CONFIG_LOG_RETENTION,
     CONFIG_RPKI_STATISTICS_DIR,
+    CONFIG_LOADER_STATE_FILE,
+    CONFIG_RPKI_RTR_NOTIFY_SOCKET,
+    CONFIG_RPKI_RTR_REFRESH_INTERVAL,
+    CONFIG_RPKI_RTR_RETRY_INTERVAL,
+    CONFIG_RPKI_RTR_EXPIRE_INTERVAL,
+    CONFIG_RPKI_RTR_WORKERS,
+    CONFIG_RRDP_ENABLED,
+    CONFIG_RRDP_STATE_FILE,
+    CONFIG_FETCH_HISTORY_FILE,
+    CONFIG_FETCH_MIN_INTERVAL,
+    CONFIG_FETCH_MAX_INTERVAL,
+    CONFIG_FETCH_EXPIRY_MARGIN,
+    CONFIG_LOG_BUFFER_SIZE,
 
     CONFIG_NUM_OPTIONS
 };
@@ -116,6 +139,8 @@ CONFIG_GET_HELPER(CONFIG_DATABASE, char)
 CONFIG_GET_HELPER(CONFIG_DATABASE_USER, char)
 CONFIG_GET_HELPER(CONFIG_DATABASE_PASSWORD, char)
 CONFIG_GET_HELPER(CONFIG_DATABASE_DSN, char)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_DATABASE_BACKEND, int)
+CONFIG_GET_HELPER(CONFIG_DATABASE_DIR, char)
 CONFIG_GET_ARRAY_HELPER(CONFIG_TRUST_ANCHOR_LOCATORS, char)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_LOG_LEVEL, int)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_DOWNLOAD_CONCURRENCY, size_t)
@@ -136,6 +161,19 @@ CONFIG_GET_HELPER(CONFIG_RPKI_CACHE_DIR, char)
 CONFIG_GET_HELPER(CONFIG_LOG_DIR, char)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_LOG_RETENTION, size_t)
 CONFIG_GET_HELPER(CONFIG_RPKI_STATISTICS_DIR, char)
+CONFIG_GET_HELPER(CONFIG_LOADER_STATE_FILE, char)
+CONFIG_GET_HELPER(CONFIG_RPKI_RTR_NOTIFY_SOCKET, char)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_REFRESH_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_RETRY_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_EXPIRE_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_WORKERS, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RRDP_ENABLED, bool)
+CONFIG_GET_HELPER(CONFIG_RRDP_STATE_FILE, char)
+CONFIG_GET_HELPER(CONFIG_FETCH_HISTORY_FILE, char)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_FETCH_MIN_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_FETCH_MAX_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_FETCH_EXPIRY_MARGIN, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_LOG_BUFFER_SIZE, size_t)
 
 
 
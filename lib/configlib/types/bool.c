@@ -86,3 +86,27 @@ bool config_type_bool_converter(
 
     return true;
 }
+
+char * config_type_bool_converter_inverse(
+    void *usr_arg,
+    void *input)
+{
+    char *ret;
+
+    (void)usr_arg;
+
+    if (input == NULL)
+    {
+        LOG(LOG_ERR, "can't print a NULL boolean");
+        return NULL;
+    }
+
+    ret = strdup(*((bool *)input) ? "yes" : "no");
+    if (ret == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return NULL;
+    }
+
+    return ret;
+}
@@ -9,4 +9,8 @@ bool config_type_bool_converter(
     const char *input,
     void **data);
 
+char * config_type_bool_converter_inverse(
+    void *usr_arg,
+    void *input);
+
 #endif
@@ -13,7 +13,6 @@
 #include "db/db-internal.h"
 #include "util/logging.h"
 #include "db/prep-stmt.h"
-#include "rpki/db_constants.h"
 #include "db/util.h"
 #include "util/stringutils.h"
 
@@ -406,29 +405,22 @@ int64_t db_chaser_read_sia(
     stmt = conn->stmts[DB_CLIENT_TYPE_CHASER][DB_PSTMT_CHASER_GET_SIA];
     uint64_t num_rows;
     uint64_t num_rows_used = 0;
-    unsigned int flag;
+    unsigned char min_valid;
     int ret;
 
     if (chase_invalid)
     {
-        flag = 0;
+        min_valid = 0;
     }
     else
     {
-        flag = SCM_FLAG_VALID;
+        min_valid = 1;
     }
     MYSQL_BIND bind_in[] = {
-        // the flag
+        // the lowest acceptable value of is_valid
         {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &flag,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        // the same flag
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &flag,
+            .buffer_type = MYSQL_TYPE_TINY,
+            .buffer = &min_valid,
             .is_unsigned = (my_bool)1,
             .is_null = (my_bool *)0,
         },
@@ -553,3 +545,126 @@ int64_t db_chaser_read_sia(
 
     return num_rows_used;
 }
+
+/**=============================================================================
+------------------------------------------------------------------------------*/
+int64_t db_chaser_read_next_update(
+    dbconn *conn,
+    char ***results,
+    int64_t *num_malloced)
+{
+    MYSQL_STMT *stmt;
+    stmt = conn->stmts[DB_CLIENT_TYPE_CHASER][DB_PSTMT_CHASER_GET_NEXT_UPDATE];
+    uint64_t num_rows;
+    uint64_t num_rows_used = 0;
+    int ret;
+
+    if (wrap_mysql_stmt_execute(conn, stmt, "mysql_stmt_execute() failed"))
+    {
+        return -1;
+    }
+
+    my_bool is_null;
+    ulong length;
+    // the seconds, a space, and the dirname.  rpki_dir.dirname is a
+    // VARCHAR(4096)
+    char line[4096 + 32];
+    MYSQL_BIND bind_out[] = {
+        {
+            .buffer_type = MYSQL_TYPE_VAR_STRING,
+            .buffer = line,
+            .buffer_length = sizeof(line),
+            .is_null = &is_null,
+            .length = &length,
+        },
+    };
+
+    if (mysql_stmt_bind_result(stmt, bind_out))
+    {
+        LOG(LOG_ERR, "mysql_stmt_bind_result() failed");
+        LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+            mysql_stmt_error(stmt));
+        mysql_stmt_free_result(stmt);
+        return -1;
+    }
+
+    if (mysql_stmt_store_result(stmt))
+    {
+        LOG(LOG_ERR, "mysql_stmt_store_result() failed");
+        LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+            mysql_stmt_error(stmt));
+        mysql_stmt_free_result(stmt);
+        return -1;
+    }
+
+    num_rows = mysql_stmt_num_rows(stmt);
+    *num_malloced = num_rows;
+    if (num_rows == 0)
+    {
+        LOG(LOG_DEBUG, "got zero results");
+        mysql_stmt_free_result(stmt);
+        *results = NULL;
+        return 0;
+    }
+
+    *results = malloc(num_rows * sizeof(char *));
+    if (!(*results))
+    {
+        LOG(LOG_ERR, "out of memory");
+        mysql_stmt_free_result(stmt);
+        return ERR_CHASER_OOM;
+    }
+
+    uint64_t i;
+    char *tmp;
+    for (i = 0; i < num_rows; i++)
+    {
+        ret = mysql_stmt_fetch(stmt);
+        if (ret == MYSQL_NO_DATA)
+        {
+            LOG(LOG_WARNING, "got mysql_no_data");
+            continue;
+        }
+        else if (ret == MYSQL_DATA_TRUNCATED)
+        {
+            LOG(LOG_WARNING, "got mysql_data_truncated");
+            continue;
+        }
+        else if (ret == 1)
+        {
+            LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+                mysql_stmt_error(stmt));
+            mysql_stmt_free_result(stmt);
+            for (i = 0; i < num_rows_used; i++)
+            {
+                free((*results)[i]);
+            }
+            free(*results);
+            return -1;
+        }
+        if (is_null)
+        {
+            continue;
+        }
+        tmp = malloc((length + 1) * sizeof(char));
+        if (!tmp)
+        {
+            LOG(LOG_ERR, "out of memory");
+            mysql_stmt_free_result(stmt);
+            for (i = 0; i < num_rows_used; i++)
+            {
+                free((*results)[i]);
+            }
+            free(*results);
+            return ERR_CHASER_OOM;
+        }
+        memcpy(tmp, line, length);
+        *(tmp + length) = '\0';
+        (*results)[num_rows_used] = tmp;
+        num_rows_used++;
+    }
+
+    mysql_stmt_free_result(stmt);
+
+    return num_rows_used;
+}
@@ -88,5 +88,24 @@ int64_t db_chaser_read_sia(
     int64_t * num_malloced,
     unsigned int chase_invalid);
 
+/**=============================================================================
+ * @brief Get how soon each directory's manifests and CRLs expire.
+ *
+ * @param conn an opaque pointer to a db connection
+ * @param[out] results Strings of the form "seconds dirname", where
+ *     seconds is the (possibly negative) number of seconds until the
+ *     earliest next update of a manifest or CRL in the local directory
+ *     dirname.  Caller frees these.
+ * @param[out] num_malloced number of pointers malloced in results
+ *
+ * @ret number of results filled on success
+ *     -1 on failure
+ *      ERR_CHASER_OOM if out of memory
+------------------------------------------------------------------------------*/
+int64_t db_chaser_read_next_update(
+    dbconn * conn,
+    char ***results,
+    int64_t * num_malloced);
+
 
 #endif
@@ -81,6 +81,11 @@ struct query_state {
         @brief The session_id number.
     */
     uint16_t session;
+
+    /**
+        @brief RPKI-Router protocol version of the PDUs to create.
+    */
+    uint8_t version;
 };
 
 
@@ -547,6 +552,7 @@ static int readSerNumAsCurrent(
 /**=============================================================================
  * @param[out] pdu PDU to fill in.
  * @param[in] asn AS number.
+ * @param[in] version Protocol version of the PDU.
  * @param[in] prefix_data Raw prefix.
  * @param[in] prefix_data_length Length of @p prefix_data. This must be either
  *    4 (IPv4) or 16 (IPv6).
@@ -557,6 +563,7 @@ static int readSerNumAsCurrent(
 ------------------------------------------------------------------------------*/
 static int fillPduIpPrefix(
     PDU * pdu,
+    uint8_t version,
     uint32_t asn,
     uint8_t const * prefix_data,
     size_t prefix_data_length,
@@ -572,13 +579,13 @@ static int fillPduIpPrefix(
     {
         case 4:
             memcpy(&in_addr.s_addr, prefix_data, prefix_data_length);
-            fill_pdu_ipv4_prefix(pdu, flags, prefix_length,
+            fill_pdu_ipv4_prefix(pdu, version, flags, prefix_length,
                 prefix_max_length, &in_addr, asn);
             break;
 
         case 16:
             memcpy(&in6_addr.s6_addr, prefix_data, prefix_data_length);
-            fill_pdu_ipv6_prefix(pdu, flags, prefix_length,
+            fill_pdu_ipv6_prefix(pdu, version, flags, prefix_length,
                 prefix_max_length, &in6_addr, asn);
             break;
 
@@ -590,12 +597,32 @@ static int fillPduIpPrefix(
 }
 
 
+/**=============================================================================
+ * @brief Fill in an End of Data PDU.
+ *
+ * For version 1 and later, the timing parameters come from the
+ * configuration, which rpki-rtr-daemon checks when it starts.
+------------------------------------------------------------------------------*/
+static void fillPduEndOfData(
+    PDU * pdu,
+    uint8_t version,
+    session_id_t session,
+    serial_number_t serial)
+{
+    fill_pdu_end_of_data(pdu, version, session, serial,
+                         (uint32_t)CONFIG_RPKI_RTR_REFRESH_INTERVAL_get(),
+                         (uint32_t)CONFIG_RPKI_RTR_RETRY_INTERVAL_get(),
+                         (uint32_t)CONFIG_RPKI_RTR_EXPIRE_INTERVAL_get());
+}
+
+
 /**=============================================================================
  * @pre All rows in rtr_update are valid.
 ------------------------------------------------------------------------------*/
 int db_rtr_serial_query_init(
     dbconn * conn,
     void **query_state,
+    uint8_t version,
     serial_number_t serial)
 {
     struct query_state *state = NULL;
@@ -614,6 +641,7 @@ int db_rtr_serial_query_init(
     state->data_sent = 0;
     state->no_new_data = 0;
     state->not_ready = 0;
+    state->version = version;
     *query_state = (void *)state;
 
 
@@ -702,8 +730,8 @@ static int serial_query_pre_query(
     if (state->not_ready)
     {
         LOG(LOG_DEBUG, "no data is available to send to routers");
-        fill_pdu_error_report(&((*_pdus)[(*num_pdus)++]), ERR_NO_DATA, 0, NULL,
-                              0, NULL);
+        fill_pdu_error_report(&((*_pdus)[(*num_pdus)++]), state->version,
+                              ERR_NO_DATA, 0, NULL, 0, NULL);
         LOG(LOG_DEBUG, "returning %zu PDUs", *num_pdus);
         return 1;
     }
@@ -711,7 +739,7 @@ static int serial_query_pre_query(
     if (state->bad_ser_num)
     {
         LOG(LOG_DEBUG, "can't update the router from the given serial number");
-        fill_pdu_cache_reset(&((*_pdus)[(*num_pdus)++]));
+        fill_pdu_cache_reset(&((*_pdus)[(*num_pdus)++]), state->version);
         LOG(LOG_DEBUG, "returning %zu PDUs", *num_pdus);
         return 1;
     }
@@ -726,17 +754,19 @@ static int serial_query_pre_query(
     {
         LOG(LOG_DEBUG,
             "no new data for the router from the given serial number");
-        fill_pdu_cache_response(&((*_pdus)[(*num_pdus)++]), state->session);
-        LOG(LOG_DEBUG, "calling fill_pdu_end_of_data()");
-        fill_pdu_end_of_data(&((*_pdus)[(*num_pdus)++]), state->session,
-                             state->ser_num);
+        fill_pdu_cache_response(&((*_pdus)[(*num_pdus)++]), state->version,
+                                state->session);
+        LOG(LOG_DEBUG, "calling fillPduEndOfData()");
+        fillPduEndOfData(&((*_pdus)[(*num_pdus)++]), state->version,
+                         state->session, state->ser_num);
         LOG(LOG_DEBUG, "returning %zu PDUs", *num_pdus);
         return 1;
     }
 
     if (!state->data_sent)
     {
-        fill_pdu_cache_response(&((*_pdus)[(*num_pdus)++]), state->session);
+        fill_pdu_cache_response(&((*_pdus)[(*num_pdus)++]), state->version,
+                                state->session);
         state->data_sent = 1;
     }
 
@@ -892,6 +922,7 @@ static int serial_query_do_query(
     {
         if (fillPduIpPrefix(
             &((*_pdus)[*num_pdus]),
+            state->version,
             db_asn,
             db_prefix, db_prefix_family_length,
             db_prefix_length, db_prefix_max_length,
@@ -955,8 +986,8 @@ static int serial_query_post_query(
     else if (ret == GET_SERNUM_NONE || prev_was_null)
     {
         LOG(LOG_INFO, "serial number became invalid after creating PDUs");
-        fill_pdu_error_report(&((*_pdus)[(*num_pdus)++]), ERR_NO_DATA, 0, NULL,
-                              0, NULL);
+        fill_pdu_error_report(&((*_pdus)[(*num_pdus)++]), state->version,
+                              ERR_NO_DATA, 0, NULL, 0, NULL);
         return 0;
     }
 
@@ -971,9 +1002,9 @@ static int serial_query_post_query(
     }
     else if (ret == GET_SERNUM_NONE)
     {                           // db has no sn for this sn_prev
-        LOG(LOG_DEBUG, "calling fill_pdu_end_of_data()");
-        fill_pdu_end_of_data(&((*_pdus)[(*num_pdus)++]), state->session,
-                             state->ser_num);
+        LOG(LOG_DEBUG, "calling fillPduEndOfData()");
+        fillPduEndOfData(&((*_pdus)[(*num_pdus)++]), state->version,
+                         state->session, state->ser_num);
         return 0;
     }
 
@@ -981,9 +1012,9 @@ static int serial_query_post_query(
     // which should be unaffected by this error.
     LOG(LOG_ERR,
         "error while looking for next serial number.  still sending pdus");
-    LOG(LOG_DEBUG, "calling fill_pdu_end_of_data()");
-    fill_pdu_end_of_data(&((*_pdus)[(*num_pdus)++]), state->session,
-                         state->ser_num);
+    LOG(LOG_DEBUG, "calling fillPduEndOfData()");
+    fillPduEndOfData(&((*_pdus)[(*num_pdus)++]), state->version,
+                     state->session, state->ser_num);
     return 0;
 }
 
@@ -1071,7 +1102,8 @@ void db_rtr_serial_query_close(
 ------------------------------------------------------------------------------*/
 int db_rtr_reset_query_init(
     dbconn * conn,
-    void **query_state)
+    void **query_state,
+    uint8_t version)
 {
     struct query_state *state = NULL;
     int ret = 0;
@@ -1088,6 +1120,7 @@ int db_rtr_reset_query_init(
     state->data_sent = 0;
     state->no_new_data = 0;
     state->not_ready = 0;
+    state->version = version;
     *query_state = (void *)state;
 
     ret = db_rtr_get_latest_sernum(conn, &state->ser_num);
@@ -1160,8 +1193,8 @@ ssize_t db_rtr_reset_query_get_next(
     if (state->not_ready)
     {
         LOG(LOG_DEBUG, "no data is available to send to routers");
-        fill_pdu_error_report(&((*_pdus)[num_pdus++]), ERR_NO_DATA, 0, NULL, 0,
-                              NULL);
+        fill_pdu_error_report(&((*_pdus)[num_pdus++]), state->version,
+                              ERR_NO_DATA, 0, NULL, 0, NULL);
         LOG(LOG_DEBUG, "returning %zu PDUs", num_pdus);
         return num_pdus;
     }
@@ -1176,7 +1209,8 @@ ssize_t db_rtr_reset_query_get_next(
 
     if (!state->data_sent)
     {
-        fill_pdu_cache_response(&((*_pdus)[num_pdus++]), session);
+        fill_pdu_cache_response(&((*_pdus)[num_pdus++]), state->version,
+                                session);
         state->data_sent = 1;
     }
 
@@ -1319,6 +1353,7 @@ ssize_t db_rtr_reset_query_get_next(
     {
         if (fillPduIpPrefix(
             &((*_pdus)[num_pdus]),
+            state->version,
             db_asn,
             db_prefix, db_prefix_family_length,
             db_prefix_length, db_prefix_max_length,
@@ -1364,8 +1399,9 @@ ssize_t db_rtr_reset_query_get_next(
     // contain
     // a withdrawal, which must not be sent during a Cache Response.
 
-    LOG(LOG_DEBUG, "calling fill_pdu_end_of_data()");
-    fill_pdu_end_of_data(&((*_pdus)[num_pdus++]), session, state->ser_num);
+    LOG(LOG_DEBUG, "calling fillPduEndOfData()");
+    fillPduEndOfData(&((*_pdus)[num_pdus++]), state->version, session,
+                     state->ser_num);
     mysql_stmt_free_result(stmt);
     LOG(LOG_DEBUG, "returning %zu PDUs", num_pdus);
     return num_pdus;
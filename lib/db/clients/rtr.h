@@ -28,12 +28,15 @@ int db_rtr_get_latest_sernum(
 	@param query_state A return parameter for an opaque data type that
 		stores the information needed by serialQueryGetNext() to
 		return the next set of rows.
+	@param version The RPKI-Router protocol version of the PDUs that
+		the query returns.
 	@param serial The serial number to start the query after.
 	@return 0 on success or an error code on failure.
 */
 int db_rtr_serial_query_init(
     dbconn * conn,
     void **query_state,
+    uint8_t version,
     serial_number_t serial);
 
 /**
@@ -80,7 +83,8 @@ void db_rtr_serial_query_close(
 // of parameters and return values
 int db_rtr_reset_query_init(
     dbconn * conn,
-    void **query_state);
+    void **query_state,
+    uint8_t version);
 
 ssize_t db_rtr_reset_query_get_next(
     dbconn * conn,
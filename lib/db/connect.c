@@ -15,12 +15,34 @@
 #include "prep-stmt.h"
 
 
+/*==============================================================================
+------------------------------------------------------------------------------*/
+bool db_backend_supported(
+    )
+{
+    if (CONFIG_DATABASE_BACKEND_get() == DATABASE_BACKEND_EMBEDDED)
+    {
+        LOG(LOG_ERR, "DatabaseBackend embedded is not supported by this "
+            "program, which needs the MySQL server; set DatabaseBackend "
+            "to odbc or mysql");
+        return false;
+    }
+
+    return true;
+}
+
+
 /*==============================================================================
 ------------------------------------------------------------------------------*/
 bool db_init(
     )
 {
-    int ret = mysql_library_init(0, NULL, NULL);
+    int ret;
+
+    if (!db_backend_supported())
+        return false;
+
+    ret = mysql_library_init(0, NULL, NULL);
 
     if (ret)
         LOG(LOG_ERR, "could not initialize mysql library");
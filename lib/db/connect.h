@@ -32,11 +32,25 @@ typedef struct _dbconn dbconn;
  *     db_thread_close()                 - per thread
  *     db_close()                        - per program
  *
- * @ret true if initialization succeeds.
+ * @ret true if initialization succeeds.  Fails if the configured
+ *      DatabaseBackend is one this library can't talk to; see
+ *      db_backend_supported().
 ------------------------------------------------------------------------------*/
 bool db_init(
     );
 
+/**=============================================================================
+ * This library only talks to the MySQL server.  Programs built on it
+ * call this right after loading the configuration so that they refuse
+ * to start, rather than use a different database than the rest of the
+ * installation, when DatabaseBackend is "embedded".  Logs the reason on
+ * failure.
+ *
+ * @ret true if the configured DatabaseBackend is usable.
+------------------------------------------------------------------------------*/
+bool db_backend_supported(
+    );
+
 void db_close(
     );
 
@@ -79,7 +79,7 @@ static const char *_queries_rtr[] = {
     "from rpki_roa "
     "join rpki_roa_prefix on "
     "    rpki_roa_prefix.roa_local_id = rpki_roa.local_id "
-    "where " FLAG_TESTS_EXPRESSION("rpki_roa.flags"),
+    "where " FLAG_TESTS_EXPRESSION("rpki_roa"),
 
     // DB_PSTMT_RTR_INSERT_INCREMENTAL
     "insert into rtr_incremental "
@@ -144,12 +144,12 @@ static const char *_queries_chaser[] = {
 
     // DB_PSTMT_CHASER_GET_CRLDP
     "select crldp from rpki_cert left join rpki_crl "
-        " on rpki_cert.aki = rpki_crl.aki "
+        " on rpki_cert.aki_bin = rpki_crl.aki_bin "
         " where rpki_crl.next_upd < TIMESTAMPADD(SECOND, ?, ?)",
 
     // DB_PSTMT_CHASER_GET_SIA
     "select sia from rpki_cert "
-        " where flags & ? = ?",  // either SCM_FLAG_VALID, or 0
+        " where is_valid >= ?",  // 1 to require SCM_FLAG_VALID, or 0
 
     // DB_PSTMT_CHASER_GET_AIA
     //
@@ -164,7 +164,21 @@ static const char *_queries_chaser[] = {
     //     should cover everything
     //   - it doesn't limit the potential for abuse
     "select aia, aki from rpki_cert "
-        " where aki not in (select ski from rpki_cert)",
+        " where aki_bin not in"
+        " (select ski_bin from rpki_cert where ski_bin is not null)",
+
+    // DB_PSTMT_CHASER_GET_NEXT_UPDATE
+    //
+    // for each directory, the number of seconds until its first
+    // manifest or CRL is due to be replaced, followed by the
+    // directory.  next_upd is stored in GMT.
+    "select concat(timestampdiff(second, utc_timestamp(), min(u.next_upd)),"
+        " ' ', rpki_dir.dirname)"
+        " from (select dir_id, next_upd from rpki_manifest"
+        "       union all"
+        "       select dir_id, next_upd from rpki_crl) as u"
+        " join rpki_dir on rpki_dir.dir_id = u.dir_id"
+        " group by rpki_dir.dir_id, rpki_dir.dirname",
 
     NULL
 };
@@ -42,7 +42,8 @@ enum prep_stmts_chaser {
     DB_PSTMT_CHASER_GET_TIME,
     DB_PSTMT_CHASER_GET_CRLDP,
     DB_PSTMT_CHASER_GET_SIA,
-    DB_PSTMT_CHASER_GET_AIA
+    DB_PSTMT_CHASER_GET_AIA,
+    DB_PSTMT_CHASER_GET_NEXT_UPDATE
 };
 
 
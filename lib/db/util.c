@@ -187,19 +187,54 @@ void flag_tests_add_tests_by_mask(
 
 void flag_tests_bind(
     MYSQL_BIND *parameters,
-    struct flag_tests const *tests)
+    struct flag_tests *tests)
 {
-    parameters[0] = (MYSQL_BIND){
-        .buffer_type = MYSQL_TYPE_LONGLONG,
-        .buffer = (void *)&tests->mask,
-        .is_unsigned = (my_bool)1,
-        .is_null = (my_bool *)0,
+    // NOTE: This must be kept in the same order as
+    // FLAG_TESTS_EXPRESSION.
+    static const unsigned long long state_flags[FLAG_TESTS_STATES] = {
+        SCM_FLAG_VALID,
+        SCM_FLAG_STALECRL,
+        SCM_FLAG_STALEMAN,
+        SCM_FLAG_NOTYET,
+        SCM_FLAG_ONMAN,
     };
+    unsigned long long untestable = tests->mask;
+    size_t i;
 
-    parameters[1] = (MYSQL_BIND){
-        .buffer_type = MYSQL_TYPE_LONGLONG,
-        .buffer = (void *)&tests->result,
-        .is_unsigned = (my_bool)1,
-        .is_null = (my_bool *)0,
-    };
+    for (i = 0; i < FLAG_TESTS_STATES; ++i)
+    {
+        if (tests->mask & state_flags[i])
+        {
+            // the column must equal the required value
+            tests->bounds[i][0] = tests->bounds[i][1] =
+                (tests->result & state_flags[i]) ? 1 : 0;
+        }
+        else
+        {
+            // any value will do
+            tests->bounds[i][0] = 0;
+            tests->bounds[i][1] = 1;
+        }
+        untestable &= ~state_flags[i];
+
+        parameters[2 * i] = (MYSQL_BIND){
+            .buffer_type = MYSQL_TYPE_TINY,
+            .buffer = &tests->bounds[i][0],
+            .is_unsigned = (my_bool)1,
+            .is_null = (my_bool *)0,
+        };
+
+        parameters[2 * i + 1] = (MYSQL_BIND){
+            .buffer_type = MYSQL_TYPE_TINY,
+            .buffer = &tests->bounds[i][1],
+            .is_unsigned = (my_bool)1,
+            .is_null = (my_bool *)0,
+        };
+    }
+
+    if (untestable)
+    {
+        LOG(LOG_WARNING, "ignoring tests on flags without a state column: "
+            "0x%llx", untestable);
+    }
 }
@@ -25,18 +25,32 @@ int getStringByFieldname(
     char field_name[]);
 
 /**
- * @brief Parameterized SQL expression to test a field containing
- *     binary flags.
+ * @brief Parameterized SQL expression to test the state columns of
+ *     an object table.
  *
- * @param[in] field Name of the SQL field to test.
+ * The state columns are generated from the flags column (see
+ * SCM_COLDEFS_STATE in rpki/scmmain.h).  Each one is constrained to
+ * a range of boolean values, so the expression is sargable and the
+ * composite state index can be used whichever tests are in effect.
+ *
+ * @param[in] table Name (or alias) of the table to test.
  */
-#define FLAG_TESTS_EXPRESSION(field) \
-    "(" field " & ? = ?)"
+#define FLAG_TESTS_EXPRESSION(table) \
+    "(" table ".is_valid BETWEEN ? AND ?" \
+    " AND " table ".is_stalecrl BETWEEN ? AND ?" \
+    " AND " table ".is_staleman BETWEEN ? AND ?" \
+    " AND " table ".is_notyet BETWEEN ? AND ?" \
+    " AND " table ".is_onman BETWEEN ? AND ?)"
+
+/**
+ * @brief Number of state columns tested by #FLAG_TESTS_EXPRESSION.
+ */
+#define FLAG_TESTS_STATES 5
 
 /**
  * @brief Number of parameters introduced by #FLAG_TESTS_EXPRESSION.
  */
-#define FLAG_TESTS_PARAMETERS 2
+#define FLAG_TESTS_PARAMETERS (2 * FLAG_TESTS_STATES)
 
 /**
  * @brief Structure to describe multiple binary flag tests.
@@ -52,6 +66,14 @@ struct flag_tests
      * @brief Result required when ANDing the field with #mask.
      */
     unsigned long long result;
+
+    /**
+     * @brief Lower and upper bound for each state column, in the
+     *     order they appear in #FLAG_TESTS_EXPRESSION.
+     *
+     * This is derived from #mask and #result by flag_tests_bind().
+     */
+    unsigned char bounds[FLAG_TESTS_STATES][2];
 };
 
 /**
@@ -100,11 +122,16 @@ void flag_tests_add_tests_by_mask(
  * The query being bound must contain #FLAG_TESTS_EXPRESSION, and
  * @p parameters must point into the input binding array at the point
  * where #FLAG_TESTS_EXPRESSION starts. #FLAG_TESTS_PARAMETERS
- * parameters will be written to the binding array.
+ * parameters will be written to the binding array.  The parameters
+ * refer to storage in @p tests, which must stay alive until the
+ * statement has been executed.
+ *
+ * Only flags that have a state column in #FLAG_TESTS_EXPRESSION can
+ * be tested; tests on any other flag are logged and ignored.
  */
 void flag_tests_bind(
     MYSQL_BIND *parameters,
-    struct flag_tests const *tests);
+    struct flag_tests *tests);
 
 
 #endif                          // _DB_UTIL_H
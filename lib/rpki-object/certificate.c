@@ -14,10 +14,14 @@ struct Extension *find_extension(
     bool create)
 {
     struct Extension *extp;
+    uchar der[CASN_OBJID_DER_MAX];
+    // encode the OID once rather than once per extension
+    int lth = encode_objid(oid, der, sizeof(der));
     /** @bug error code ignored without explanation */
-    for (extp = (struct Extension *)member_casn(&extsp->self, 0);
+    for (extp = (lth > 0) ?
+         (struct Extension *)member_casn(&extsp->self, 0) : NULL;
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, oid);
+         extp && diff_objid_der(&extp->extnID, der, lth);
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (!extp && create)
@@ -0,0 +1,630 @@
+#include "rpki-object/resources.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpki-object/certificate.h"
+
+
+/*
+ * Helpers for 128-bit big-endian addresses
+ */
+
+static int addr_cmp(
+    const uint8_t a[RESOURCE_ADDR_LEN],
+    const uint8_t b[RESOURCE_ADDR_LEN])
+{
+    return memcmp(a, b, RESOURCE_ADDR_LEN);
+}
+
+/** Increment an address.  @return false if it wrapped around. */
+static bool addr_succ(
+    uint8_t a[RESOURCE_ADDR_LEN])
+{
+    int i;
+    for (i = RESOURCE_ADDR_LEN - 1; i >= 0; --i)
+    {
+        if (++a[i] != 0)
+            return true;
+    }
+    return false;
+}
+
+/** Decrement an address.  @return false if it wrapped around. */
+static bool addr_pred(
+    uint8_t a[RESOURCE_ADDR_LEN])
+{
+    int i;
+    for (i = RESOURCE_ADDR_LEN - 1; i >= 0; --i)
+    {
+        if (a[i]-- != 0)
+            return true;
+    }
+    return false;
+}
+
+/** @return true iff an interval starting at lo can be merged into one
+ *  ending at hi (i.e., lo <= hi + 1) */
+static bool addr_touches(
+    const uint8_t hi[RESOURCE_ADDR_LEN],
+    const uint8_t lo[RESOURCE_ADDR_LEN])
+{
+    uint8_t next[RESOURCE_ADDR_LEN];
+    memcpy(next, hi, RESOURCE_ADDR_LEN);
+    return !addr_succ(next) || addr_cmp(lo, next) <= 0;
+}
+
+
+void resource_set_init(
+    struct resource_set *set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+void resource_set_free(
+    struct resource_set *set)
+{
+    int afi;
+    for (afi = 0; afi < RESOURCE_NUM_AFI; ++afi)
+        free(set->ip[afi].v);
+    free(set->as.v);
+    resource_set_init(set);
+}
+
+bool ip_set_add(
+    struct ip_set *set,
+    const uint8_t lo[RESOURCE_ADDR_LEN],
+    const uint8_t hi[RESOURCE_ADDR_LEN])
+{
+    if (set->len == set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : 8;
+        struct ip_interval *v = realloc(set->v, cap * sizeof(*v));
+        if (v == NULL)
+            return false;
+        set->v = v;
+        set->cap = cap;
+    }
+    memcpy(set->v[set->len].lo, lo, RESOURCE_ADDR_LEN);
+    memcpy(set->v[set->len].hi, hi, RESOURCE_ADDR_LEN);
+    set->len++;
+    return true;
+}
+
+bool as_set_add(
+    struct as_set *set,
+    uint32_t lo,
+    uint32_t hi)
+{
+    if (set->len == set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : 8;
+        struct as_interval *v = realloc(set->v, cap * sizeof(*v));
+        if (v == NULL)
+            return false;
+        set->v = v;
+        set->cap = cap;
+    }
+    set->v[set->len].lo = lo;
+    set->v[set->len].hi = hi;
+    set->len++;
+    return true;
+}
+
+static int ip_interval_cmp(
+    const void *a_voidp,
+    const void *b_voidp)
+{
+    const struct ip_interval *a = a_voidp;
+    const struct ip_interval *b = b_voidp;
+    int ret = addr_cmp(a->lo, b->lo);
+    return ret != 0 ? ret : addr_cmp(a->hi, b->hi);
+}
+
+static int as_interval_cmp(
+    const void *a_voidp,
+    const void *b_voidp)
+{
+    const struct as_interval *a = a_voidp;
+    const struct as_interval *b = b_voidp;
+    if (a->lo != b->lo)
+        return a->lo < b->lo ? -1 : 1;
+    if (a->hi != b->hi)
+        return a->hi < b->hi ? -1 : 1;
+    return 0;
+}
+
+void ip_set_normalize(
+    struct ip_set *set)
+{
+    size_t i;
+    size_t out = 0;
+
+    if (set->len < 2)
+        return;
+    qsort(set->v, set->len, sizeof(set->v[0]), ip_interval_cmp);
+    for (i = 1; i < set->len; ++i)
+    {
+        struct ip_interval *prev = &set->v[out];
+        if (addr_touches(prev->hi, set->v[i].lo))
+        {
+            if (addr_cmp(set->v[i].hi, prev->hi) > 0)
+                memcpy(prev->hi, set->v[i].hi, RESOURCE_ADDR_LEN);
+        }
+        else
+        {
+            set->v[++out] = set->v[i];
+        }
+    }
+    set->len = out + 1;
+}
+
+void as_set_normalize(
+    struct as_set *set)
+{
+    size_t i;
+    size_t out = 0;
+
+    if (set->len < 2)
+        return;
+    qsort(set->v, set->len, sizeof(set->v[0]), as_interval_cmp);
+    for (i = 1; i < set->len; ++i)
+    {
+        struct as_interval *prev = &set->v[out];
+        if ((uint64_t)set->v[i].lo <= (uint64_t)prev->hi + 1)
+        {
+            if (set->v[i].hi > prev->hi)
+                prev->hi = set->v[i].hi;
+        }
+        else
+        {
+            set->v[++out] = set->v[i];
+        }
+    }
+    set->len = out + 1;
+}
+
+void resource_set_normalize(
+    struct resource_set *set)
+{
+    int afi;
+    for (afi = 0; afi < RESOURCE_NUM_AFI; ++afi)
+        ip_set_normalize(&set->ip[afi]);
+    as_set_normalize(&set->as);
+}
+
+bool ip_set_contains_interval(
+    const struct ip_set *set,
+    const uint8_t lo[RESOURCE_ADDR_LEN],
+    const uint8_t hi[RESOURCE_ADDR_LEN])
+{
+    size_t first = 0;
+    size_t last = set->len;
+
+    // find the last interval whose lower bound is <= lo
+    while (first < last)
+    {
+        size_t mid = first + (last - first) / 2;
+        if (addr_cmp(set->v[mid].lo, lo) <= 0)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    if (first == 0)
+        return false;
+    return addr_cmp(hi, set->v[first - 1].hi) <= 0;
+}
+
+bool as_set_contains_interval(
+    const struct as_set *set,
+    uint32_t lo,
+    uint32_t hi)
+{
+    size_t first = 0;
+    size_t last = set->len;
+
+    while (first < last)
+    {
+        size_t mid = first + (last - first) / 2;
+        if (set->v[mid].lo <= lo)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    if (first == 0)
+        return false;
+    return hi <= set->v[first - 1].hi;
+}
+
+bool ip_set_contains(
+    const struct ip_set *outer,
+    const struct ip_set *inner)
+{
+    size_t i;
+    size_t j = 0;
+
+    for (i = 0; i < inner->len; ++i)
+    {
+        while (j < outer->len &&
+               addr_cmp(outer->v[j].hi, inner->v[i].lo) < 0)
+            ++j;
+        if (j == outer->len ||
+            addr_cmp(outer->v[j].lo, inner->v[i].lo) > 0 ||
+            addr_cmp(outer->v[j].hi, inner->v[i].hi) < 0)
+            return false;
+    }
+    return true;
+}
+
+bool as_set_contains(
+    const struct as_set *outer,
+    const struct as_set *inner)
+{
+    size_t i;
+    size_t j = 0;
+
+    for (i = 0; i < inner->len; ++i)
+    {
+        while (j < outer->len && outer->v[j].hi < inner->v[i].lo)
+            ++j;
+        if (j == outer->len || outer->v[j].lo > inner->v[i].lo ||
+            outer->v[j].hi < inner->v[i].hi)
+            return false;
+    }
+    return true;
+}
+
+bool resource_set_contains(
+    const struct resource_set *outer,
+    const struct resource_set *inner)
+{
+    int afi;
+    for (afi = 0; afi < RESOURCE_NUM_AFI; ++afi)
+    {
+        if (!ip_set_contains(&outer->ip[afi], &inner->ip[afi]))
+            return false;
+    }
+    return as_set_contains(&outer->as, &inner->as);
+}
+
+bool ip_set_intersect(
+    const struct ip_set *a,
+    const struct ip_set *b,
+    struct ip_set *out)
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    out->len = 0;
+    while (i < a->len && j < b->len)
+    {
+        const uint8_t *lo = addr_cmp(a->v[i].lo, b->v[j].lo) > 0 ?
+            a->v[i].lo : b->v[j].lo;
+        const uint8_t *hi = addr_cmp(a->v[i].hi, b->v[j].hi) < 0 ?
+            a->v[i].hi : b->v[j].hi;
+        if (addr_cmp(lo, hi) <= 0 && !ip_set_add(out, lo, hi))
+            return false;
+        if (addr_cmp(a->v[i].hi, b->v[j].hi) < 0)
+            ++i;
+        else
+            ++j;
+    }
+    return true;
+}
+
+bool as_set_intersect(
+    const struct as_set *a,
+    const struct as_set *b,
+    struct as_set *out)
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    out->len = 0;
+    while (i < a->len && j < b->len)
+    {
+        uint32_t lo = a->v[i].lo > b->v[j].lo ? a->v[i].lo : b->v[j].lo;
+        uint32_t hi = a->v[i].hi < b->v[j].hi ? a->v[i].hi : b->v[j].hi;
+        if (lo <= hi && !as_set_add(out, lo, hi))
+            return false;
+        if (a->v[i].hi < b->v[j].hi)
+            ++i;
+        else
+            ++j;
+    }
+    return true;
+}
+
+bool ip_set_subtract(
+    const struct ip_set *a,
+    const struct ip_set *b,
+    struct ip_set *out)
+{
+    size_t i;
+    size_t j = 0;
+    uint8_t cur[RESOURCE_ADDR_LEN];
+    uint8_t end[RESOURCE_ADDR_LEN];
+
+    out->len = 0;
+    for (i = 0; i < a->len; ++i)
+    {
+        bool covered = false;
+        memcpy(cur, a->v[i].lo, RESOURCE_ADDR_LEN);
+        while (j < b->len && addr_cmp(b->v[j].hi, cur) < 0)
+            ++j;
+        while (j < b->len && addr_cmp(b->v[j].lo, a->v[i].hi) <= 0)
+        {
+            if (addr_cmp(b->v[j].lo, cur) > 0)
+            {
+                memcpy(end, b->v[j].lo, RESOURCE_ADDR_LEN);
+                addr_pred(end);
+                if (!ip_set_add(out, cur, end))
+                    return false;
+            }
+            if (addr_cmp(b->v[j].hi, a->v[i].hi) >= 0)
+            {
+                // b->v[j] may also cover the next interval of a
+                covered = true;
+                break;
+            }
+            memcpy(cur, b->v[j].hi, RESOURCE_ADDR_LEN);
+            addr_succ(cur);
+            ++j;
+        }
+        if (!covered && !ip_set_add(out, cur, a->v[i].hi))
+            return false;
+    }
+    return true;
+}
+
+bool as_set_subtract(
+    const struct as_set *a,
+    const struct as_set *b,
+    struct as_set *out)
+{
+    size_t i;
+    size_t j = 0;
+
+    out->len = 0;
+    for (i = 0; i < a->len; ++i)
+    {
+        bool covered = false;
+        uint32_t cur = a->v[i].lo;
+        while (j < b->len && b->v[j].hi < cur)
+            ++j;
+        while (j < b->len && b->v[j].lo <= a->v[i].hi)
+        {
+            if (b->v[j].lo > cur && !as_set_add(out, cur, b->v[j].lo - 1))
+                return false;
+            if (b->v[j].hi >= a->v[i].hi)
+            {
+                covered = true;
+                break;
+            }
+            cur = b->v[j].hi + 1;
+            ++j;
+        }
+        if (!covered && !as_set_add(out, cur, a->v[i].hi))
+            return false;
+    }
+    return true;
+}
+
+bool resource_set_inherit(
+    struct resource_set *child,
+    const struct resource_set *parent)
+{
+    int afi;
+    size_t i;
+
+    for (afi = 0; afi < RESOURCE_NUM_AFI; ++afi)
+    {
+        struct ip_set *set = &child->ip[afi];
+        if (!set->inherit)
+            continue;
+        set->len = 0;
+        for (i = 0; i < parent->ip[afi].len; ++i)
+        {
+            if (!ip_set_add(set, parent->ip[afi].v[i].lo,
+                            parent->ip[afi].v[i].hi))
+                return false;
+        }
+        set->inherit = false;
+    }
+    if (child->as.inherit)
+    {
+        child->as.len = 0;
+        for (i = 0; i < parent->as.len; ++i)
+        {
+            if (!as_set_add(&child->as, parent->as.v[i].lo,
+                            parent->as.v[i].hi))
+                return false;
+        }
+        child->as.inherit = false;
+    }
+    return true;
+}
+
+
+/*
+ * Conversion from the ASN.1 structures
+ */
+
+/** @return the family of an addressFamily field, or -1 if it is not
+ *  plain IPv4 or IPv6 (no SAFI) */
+static int read_afi(
+    struct casn *familyp)
+{
+    uint8_t buf[2];
+
+    if (vsize_casn(familyp) != (int)sizeof(buf) ||
+        read_casn(familyp, buf) != (int)sizeof(buf) || buf[0] != 0)
+        return -1;
+    if (buf[1] == 1)
+        return RESOURCE_AFI_IPV4;
+    if (buf[1] == 2)
+        return RESOURCE_AFI_IPV6;
+    return -1;
+}
+
+/**
+ * Convert an address BIT STRING to the lowest (upper == false) or
+ * highest (upper == true) address it covers.
+ */
+static bool read_bound(
+    struct casn *bitsp,
+    int afi,
+    bool upper,
+    uint8_t out[RESOURCE_ADDR_LEN])
+{
+    uint8_t buf[1 + RESOURCE_ADDR_LEN];
+    int addrlen = afi == RESOURCE_AFI_IPV4 ? 4 : 16;
+    int lth = vsize_casn(bitsp);
+    int unused;
+
+    if (lth < 1 || lth > 1 + addrlen || read_casn(bitsp, buf) != lth)
+        return false;
+    unused = buf[0];
+    if (unused > 7 || (lth == 1 && unused != 0))
+        return false;
+    --lth;
+    memset(out, upper ? 0xFF : 0, RESOURCE_ADDR_LEN);
+    memcpy(out, &buf[1], lth);
+    if (lth > 0)
+    {
+        if (upper)
+            out[lth - 1] |= (uint8_t)(0xFF >> (8 - unused));
+        else
+            out[lth - 1] &= (uint8_t)(0xFF << unused);
+    }
+    return true;
+}
+
+static bool read_asnum(
+    struct casn *nump,
+    uint32_t *out)
+{
+    intmax_t val;
+
+    if (read_casn_num_max(nump, &val) < 0 || val < 0 || val > UINT32_MAX)
+        return false;
+    *out = (uint32_t)val;
+    return true;
+}
+
+bool resource_set_from_cert(
+    struct resource_set *set,
+    struct Certificate *cert)
+{
+    struct Extension *extp;
+    uint8_t lo[RESOURCE_ADDR_LEN];
+    uint8_t hi[RESOURCE_ADDR_LEN];
+
+    extp = find_extension(&cert->toBeSigned.extensions, id_pe_ipAddrBlock,
+                          false);
+    if (extp)
+    {
+        struct IPAddressFamilyA *familyp;
+        for (familyp = (struct IPAddressFamilyA *)
+             member_casn(&extp->extnValue.ipAddressBlock.self, 0);
+             familyp != NULL;
+             familyp = (struct IPAddressFamilyA *)next_of(&familyp->self))
+        {
+            int afi = read_afi(&familyp->addressFamily);
+            if (afi < 0)
+                return false;
+            if (size_casn(&familyp->ipAddressChoice.inherit) > 0)
+            {
+                set->ip[afi].inherit = true;
+                continue;
+            }
+            struct IPAddressOrRangeA *aorp;
+            for (aorp = (struct IPAddressOrRangeA *)
+                 member_casn(&familyp->ipAddressChoice.addressesOrRanges.self,
+                             0);
+                 aorp != NULL;
+                 aorp = (struct IPAddressOrRangeA *)next_of(&aorp->self))
+            {
+                bool ok;
+                if (size_casn(&aorp->addressRange.self) > 0)
+                    ok = read_bound(&aorp->addressRange.min, afi, false, lo) &&
+                        read_bound(&aorp->addressRange.max, afi, true, hi);
+                else
+                    ok = read_bound(&aorp->addressPrefix, afi, false, lo) &&
+                        read_bound(&aorp->addressPrefix, afi, true, hi);
+                if (!ok || addr_cmp(lo, hi) > 0 ||
+                    !ip_set_add(&set->ip[afi], lo, hi))
+                    return false;
+            }
+        }
+    }
+
+    extp = find_extension(&cert->toBeSigned.extensions,
+                          id_pe_autonomousSysNum, false);
+    if (extp)
+    {
+        struct ASIdentifierChoiceA *asnump =
+            &extp->extnValue.autonomousSysNum.asnum;
+        if (size_casn(&asnump->inherit) > 0)
+        {
+            set->as.inherit = true;
+        }
+        else
+        {
+            struct ASNumberOrRangeA *aorp;
+            for (aorp = (struct ASNumberOrRangeA *)
+                 member_casn(&asnump->asNumbersOrRanges.self, 0);
+                 aorp != NULL;
+                 aorp = (struct ASNumberOrRangeA *)next_of(&aorp->self))
+            {
+                uint32_t aslo;
+                uint32_t ashi;
+                bool ok;
+                if (size_casn(&aorp->range.self) > 0)
+                    ok = read_asnum(&aorp->range.min, &aslo) &&
+                        read_asnum(&aorp->range.max, &ashi);
+                else
+                {
+                    ok = read_asnum(&aorp->num, &aslo);
+                    ashi = aslo;
+                }
+                if (!ok || aslo > ashi || !as_set_add(&set->as, aslo, ashi))
+                    return false;
+            }
+        }
+    }
+
+    resource_set_normalize(set);
+    return true;
+}
+
+bool resource_set_add_roa(
+    struct resource_set *set,
+    struct ROAIPAddrBlocks *blocks)
+{
+    struct ROAIPAddressFamily *familyp;
+    uint8_t lo[RESOURCE_ADDR_LEN];
+    uint8_t hi[RESOURCE_ADDR_LEN];
+
+    for (familyp = (struct ROAIPAddressFamily *)member_casn(&blocks->self, 0);
+         familyp != NULL;
+         familyp = (struct ROAIPAddressFamily *)next_of(&familyp->self))
+    {
+        int afi = read_afi(&familyp->addressFamily);
+        if (afi < 0)
+            return false;
+        struct ROAIPAddress *addrp;
+        for (addrp = (struct ROAIPAddress *)
+             member_casn(&familyp->addresses.self, 0);
+             addrp != NULL;
+             addrp = (struct ROAIPAddress *)next_of(&addrp->self))
+        {
+            if (!read_bound(&addrp->address, afi, false, lo) ||
+                !read_bound(&addrp->address, afi, true, hi) ||
+                !ip_set_add(&set->ip[afi], lo, hi))
+                return false;
+        }
+    }
+    resource_set_normalize(set);
+    return true;
+}
@@ -0,0 +1,199 @@
+#ifndef _LIB_RPKI_OBJECT_RESOURCES_H
+#define _LIB_RPKI_OBJECT_RESOURCES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rpki-asn1/certificate.h"
+#include "rpki-asn1/roa.h"
+
+/**
+ * Compact in-memory form of a set of RFC 3779 resources.
+ *
+ * Each set is a sorted array of disjoint, non-adjacent closed
+ * intervals, so containment checks are a binary search (single
+ * interval) or a linear merge (whole set) instead of a walk over the
+ * casn tree.  Addresses of both families are stored as 16-byte
+ * big-endian values; IPv4 addresses occupy the first four bytes,
+ * with the remaining bytes all 0 in a lower bound and all 1 in an
+ * upper bound.
+ */
+
+#define RESOURCE_ADDR_LEN 16
+
+enum resource_afi {
+    RESOURCE_AFI_IPV4,
+    RESOURCE_AFI_IPV6,
+    RESOURCE_NUM_AFI
+};
+
+struct ip_interval {
+    uint8_t lo[RESOURCE_ADDR_LEN];
+    uint8_t hi[RESOURCE_ADDR_LEN];
+};
+
+struct as_interval {
+    uint32_t lo;
+    uint32_t hi;
+};
+
+struct ip_set {
+    struct ip_interval *v;
+    size_t len;
+    size_t cap;
+    /** the family was present and marked inherit */
+    bool inherit;
+};
+
+struct as_set {
+    struct as_interval *v;
+    size_t len;
+    size_t cap;
+    /** the AS numbers were present and marked inherit */
+    bool inherit;
+};
+
+struct resource_set {
+    struct ip_set ip[RESOURCE_NUM_AFI];
+    struct as_set as;
+};
+
+/** Initialize an empty resource set. */
+void resource_set_init(
+    struct resource_set *set);
+
+/** Free the memory held by a resource set and make it empty. */
+void resource_set_free(
+    struct resource_set *set);
+
+/**
+ * Add an interval to an IP set.  Call ip_set_normalize() after the
+ * last addition and before any query.
+ *
+ * @return false if out of memory
+ */
+bool ip_set_add(
+    struct ip_set *set,
+    const uint8_t lo[RESOURCE_ADDR_LEN],
+    const uint8_t hi[RESOURCE_ADDR_LEN]);
+
+/**
+ * Add an interval to an AS set.  Call as_set_normalize() after the
+ * last addition and before any query.
+ *
+ * @return false if out of memory
+ */
+bool as_set_add(
+    struct as_set *set,
+    uint32_t lo,
+    uint32_t hi);
+
+/** Sort the intervals and merge overlapping or adjacent ones. */
+void ip_set_normalize(
+    struct ip_set *set);
+
+/** Sort the intervals and merge overlapping or adjacent ones. */
+void as_set_normalize(
+    struct as_set *set);
+
+/** Normalize every family of a resource set. */
+void resource_set_normalize(
+    struct resource_set *set);
+
+/** @return true iff [lo, hi] is entirely within the set */
+bool ip_set_contains_interval(
+    const struct ip_set *set,
+    const uint8_t lo[RESOURCE_ADDR_LEN],
+    const uint8_t hi[RESOURCE_ADDR_LEN]);
+
+/** @return true iff [lo, hi] is entirely within the set */
+bool as_set_contains_interval(
+    const struct as_set *set,
+    uint32_t lo,
+    uint32_t hi);
+
+/** @return true iff every address in inner is also in outer */
+bool ip_set_contains(
+    const struct ip_set *outer,
+    const struct ip_set *inner);
+
+/** @return true iff every AS number in inner is also in outer */
+bool as_set_contains(
+    const struct as_set *outer,
+    const struct as_set *inner);
+
+/**
+ * @return true iff every resource in inner is also in outer.  The
+ *         inherit flags are not considered; resolve them first with
+ *         resource_set_inherit().
+ */
+bool resource_set_contains(
+    const struct resource_set *outer,
+    const struct resource_set *inner);
+
+/**
+ * Set out to the intersection of a and b.  out must be initialized
+ * and is overwritten.
+ *
+ * @return false if out of memory
+ */
+bool ip_set_intersect(
+    const struct ip_set *a,
+    const struct ip_set *b,
+    struct ip_set *out);
+
+/** AS number counterpart of ip_set_intersect(). */
+bool as_set_intersect(
+    const struct as_set *a,
+    const struct as_set *b,
+    struct as_set *out);
+
+/**
+ * Set out to the addresses in a that are not in b.  out must be
+ * initialized and is overwritten.
+ *
+ * @return false if out of memory
+ */
+bool ip_set_subtract(
+    const struct ip_set *a,
+    const struct ip_set *b,
+    struct ip_set *out);
+
+/** AS number counterpart of ip_set_subtract(). */
+bool as_set_subtract(
+    const struct as_set *a,
+    const struct as_set *b,
+    struct as_set *out);
+
+/**
+ * Replace every family of child that is marked inherit with a copy of
+ * the corresponding family of parent, which must already be resolved.
+ *
+ * @return false if out of memory
+ */
+bool resource_set_inherit(
+    struct resource_set *child,
+    const struct resource_set *parent);
+
+/**
+ * Build the resource set of a certificate from its IP address and AS
+ * number extensions.  set must be initialized and empty.
+ *
+ * @return false if the extensions are malformed or out of memory
+ */
+bool resource_set_from_cert(
+    struct resource_set *set,
+    struct Certificate *cert);
+
+/**
+ * Add the prefixes listed in a ROA to a resource set and normalize
+ * it.
+ *
+ * @return false if the prefixes are malformed or out of memory
+ */
+bool resource_set_add_roa(
+    struct resource_set *set,
+    struct ROAIPAddrBlocks *blocks);
+
+#endif
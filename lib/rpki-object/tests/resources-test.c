@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpki-object/resources.h"
+#include "test/unittest.h"
+
+static void make_addr(
+    uint8_t addr[RESOURCE_ADDR_LEN],
+    uint8_t last)
+{
+    memset(addr, 0, RESOURCE_ADDR_LEN);
+    addr[RESOURCE_ADDR_LEN - 1] = last;
+}
+
+static bool add_ip(
+    struct ip_set *set,
+    uint8_t lo,
+    uint8_t hi)
+{
+    uint8_t lobuf[RESOURCE_ADDR_LEN];
+    uint8_t hibuf[RESOURCE_ADDR_LEN];
+    make_addr(lobuf, lo);
+    make_addr(hibuf, hi);
+    return ip_set_add(set, lobuf, hibuf);
+}
+
+static bool ip_contains(
+    const struct ip_set *set,
+    uint8_t lo,
+    uint8_t hi)
+{
+    uint8_t lobuf[RESOURCE_ADDR_LEN];
+    uint8_t hibuf[RESOURCE_ADDR_LEN];
+    make_addr(lobuf, lo);
+    make_addr(hibuf, hi);
+    return ip_set_contains_interval(set, lobuf, hibuf);
+}
+
+static bool test_as_normalize(
+    void)
+{
+    struct resource_set set;
+    resource_set_init(&set);
+
+    TEST_BOOL(as_set_add(&set.as, 20, 30), true);
+    TEST_BOOL(as_set_add(&set.as, 1, 5), true);
+    TEST_BOOL(as_set_add(&set.as, 6, 10), true);      // adjacent to [1,5]
+    TEST_BOOL(as_set_add(&set.as, 25, 40), true);     // overlaps [20,30]
+    TEST_BOOL(as_set_add(&set.as, 100, 100), true);
+    TEST_BOOL(as_set_add(&set.as, 4294967295U, 4294967295U), true);
+    TEST_BOOL(as_set_add(&set.as, 4294967290U, 4294967294U), true);
+    as_set_normalize(&set.as);
+
+    TEST(size_t, "%zu", set.as.len, ==, 4);
+    TEST(uint32_t, "%u", set.as.v[0].lo, ==, 1);
+    TEST(uint32_t, "%u", set.as.v[0].hi, ==, 10);
+    TEST(uint32_t, "%u", set.as.v[1].lo, ==, 20);
+    TEST(uint32_t, "%u", set.as.v[1].hi, ==, 40);
+    TEST(uint32_t, "%u", set.as.v[2].lo, ==, 100);
+    TEST(uint32_t, "%u", set.as.v[3].lo, ==, 4294967290U);
+    TEST(uint32_t, "%u", set.as.v[3].hi, ==, 4294967295U);
+
+    TEST_BOOL(as_set_contains_interval(&set.as, 1, 10), true);
+    TEST_BOOL(as_set_contains_interval(&set.as, 3, 3), true);
+    TEST_BOOL(as_set_contains_interval(&set.as, 9, 20), false);
+    TEST_BOOL(as_set_contains_interval(&set.as, 0, 0), false);
+    TEST_BOOL(as_set_contains_interval(&set.as, 41, 41), false);
+    TEST_BOOL(as_set_contains_interval(&set.as, 4294967295U, 4294967295U),
+              true);
+
+    resource_set_free(&set);
+    return true;
+}
+
+static bool test_as_set_ops(
+    void)
+{
+    struct as_set a = {NULL, 0, 0, false};
+    struct as_set b = {NULL, 0, 0, false};
+    struct as_set out = {NULL, 0, 0, false};
+
+    TEST_BOOL(as_set_add(&a, 10, 20), true);
+    TEST_BOOL(as_set_add(&a, 30, 40), true);
+    TEST_BOOL(as_set_add(&b, 15, 35), true);
+    as_set_normalize(&a);
+    as_set_normalize(&b);
+
+    TEST_BOOL(as_set_contains(&a, &b), false);
+    TEST_BOOL(as_set_contains(&a, &a), true);
+
+    TEST_BOOL(as_set_intersect(&a, &b, &out), true);
+    TEST(size_t, "%zu", out.len, ==, 2);
+    TEST(uint32_t, "%u", out.v[0].lo, ==, 15);
+    TEST(uint32_t, "%u", out.v[0].hi, ==, 20);
+    TEST(uint32_t, "%u", out.v[1].lo, ==, 30);
+    TEST(uint32_t, "%u", out.v[1].hi, ==, 35);
+    TEST_BOOL(as_set_contains(&a, &out), true);
+    TEST_BOOL(as_set_contains(&b, &out), true);
+
+    TEST_BOOL(as_set_subtract(&a, &b, &out), true);
+    TEST(size_t, "%zu", out.len, ==, 2);
+    TEST(uint32_t, "%u", out.v[0].lo, ==, 10);
+    TEST(uint32_t, "%u", out.v[0].hi, ==, 14);
+    TEST(uint32_t, "%u", out.v[1].lo, ==, 36);
+    TEST(uint32_t, "%u", out.v[1].hi, ==, 40);
+
+    TEST_BOOL(as_set_subtract(&b, &a, &out), true);
+    TEST(size_t, "%zu", out.len, ==, 1);
+    TEST(uint32_t, "%u", out.v[0].lo, ==, 21);
+    TEST(uint32_t, "%u", out.v[0].hi, ==, 29);
+
+    TEST_BOOL(as_set_subtract(&a, &a, &out), true);
+    TEST(size_t, "%zu", out.len, ==, 0);
+
+    free(a.v);
+    free(b.v);
+    free(out.v);
+    return true;
+}
+
+static bool test_ip_set_ops(
+    void)
+{
+    struct resource_set outer;
+    struct resource_set inner;
+    struct ip_set out = {NULL, 0, 0, false};
+    uint8_t max[RESOURCE_ADDR_LEN];
+
+    resource_set_init(&outer);
+    resource_set_init(&inner);
+
+    TEST_BOOL(add_ip(&outer.ip[RESOURCE_AFI_IPV6], 0x10, 0x1f), true);
+    TEST_BOOL(add_ip(&outer.ip[RESOURCE_AFI_IPV6], 0x20, 0x2f), true);
+    TEST_BOOL(add_ip(&outer.ip[RESOURCE_AFI_IPV6], 0x40, 0x4f), true);
+    resource_set_normalize(&outer);
+    TEST(size_t, "%zu", outer.ip[RESOURCE_AFI_IPV6].len, ==, 2);
+
+    TEST_BOOL(ip_contains(&outer.ip[RESOURCE_AFI_IPV6], 0x18, 0x28), true);
+    TEST_BOOL(ip_contains(&outer.ip[RESOURCE_AFI_IPV6], 0x28, 0x41), false);
+    TEST_BOOL(ip_contains(&outer.ip[RESOURCE_AFI_IPV6], 0x0f, 0x10), false);
+
+    TEST_BOOL(add_ip(&inner.ip[RESOURCE_AFI_IPV6], 0x12, 0x14), true);
+    TEST_BOOL(add_ip(&inner.ip[RESOURCE_AFI_IPV6], 0x44, 0x44), true);
+    resource_set_normalize(&inner);
+    TEST_BOOL(resource_set_contains(&outer, &inner), true);
+
+    // a family the outer set does not have
+    TEST_BOOL(add_ip(&inner.ip[RESOURCE_AFI_IPV4], 0x01, 0x01), true);
+    TEST_BOOL(resource_set_contains(&outer, &inner), false);
+
+    TEST_BOOL(ip_set_subtract(&outer.ip[RESOURCE_AFI_IPV6],
+                              &inner.ip[RESOURCE_AFI_IPV6], &out), true);
+    TEST(size_t, "%zu", out.len, ==, 4);
+    TEST(unsigned int, "%u", out.v[0].hi[RESOURCE_ADDR_LEN - 1], ==, 0x11);
+    TEST(unsigned int, "%u", out.v[1].lo[RESOURCE_ADDR_LEN - 1], ==, 0x15);
+    TEST(unsigned int, "%u", out.v[2].hi[RESOURCE_ADDR_LEN - 1], ==, 0x43);
+    TEST(unsigned int, "%u", out.v[3].lo[RESOURCE_ADDR_LEN - 1], ==, 0x45);
+
+    // intervals reaching the top of the address space merge correctly
+    memset(max, 0xFF, sizeof(max));
+    TEST_BOOL(ip_set_add(&out, max, max), true);
+    TEST_BOOL(ip_set_add(&out, max, max), true);
+    ip_set_normalize(&out);
+    TEST(size_t, "%zu", out.len, ==, 5);
+    TEST_BOOL(ip_set_contains_interval(&out, max, max), true);
+
+    resource_set_free(&outer);
+    resource_set_free(&inner);
+    free(out.v);
+    return true;
+}
+
+static bool test_inherit(
+    void)
+{
+    struct resource_set parent;
+    struct resource_set child;
+
+    resource_set_init(&parent);
+    resource_set_init(&child);
+
+    TEST_BOOL(as_set_add(&parent.as, 64496, 64511), true);
+    TEST_BOOL(add_ip(&parent.ip[RESOURCE_AFI_IPV4], 0x00, 0x7f), true);
+    resource_set_normalize(&parent);
+
+    child.as.inherit = true;
+    TEST_BOOL(add_ip(&child.ip[RESOURCE_AFI_IPV4], 0x10, 0x1f), true);
+    TEST_BOOL(resource_set_inherit(&child, &parent), true);
+    TEST_BOOL(child.as.inherit, false);
+    TEST(size_t, "%zu", child.as.len, ==, 1);
+    TEST_BOOL(resource_set_contains(&parent, &child), true);
+
+    resource_set_free(&parent);
+    resource_set_free(&child);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_as_normalize())
+        return -1;
+    if (!test_as_set_ops())
+        return -1;
+    if (!test_ip_set_ops())
+        return -1;
+    if (!test_inherit())
+        return -1;
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "notify.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+static bool make_addr(
+    struct sockaddr_un *addr,
+    const char *path)
+{
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+int rtr_notify_listen(
+    const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+    int saved_errno;
+
+    if (!make_addr(&addr, path))
+        return -1;
+
+    // Only remove what is left over from an earlier daemon, never a
+    // regular file that happens to be in the way.
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return fd;
+}
+
+ssize_t rtr_notify_drain(
+    int fd)
+{
+    uint8_t buf[sizeof(serial_number_t)];
+    ssize_t count = 0;
+    ssize_t retval;
+
+    while (true)
+    {
+        retval = recv(fd, buf, sizeof(buf), 0);
+        if (retval >= 0)
+        {
+            ++count;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return count;
+        }
+        else if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+}
+
+bool rtr_notify_send(
+    const char *path,
+    serial_number_t serial)
+{
+    struct sockaddr_un addr;
+    uint32_t serial_net = htonl(serial);
+    ssize_t retval;
+    int fd;
+    int saved_errno;
+
+    if (!make_addr(&addr, path))
+        return false;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return false;
+
+    retval = sendto(fd, &serial_net, sizeof(serial_net), MSG_DONTWAIT,
+                    (struct sockaddr *)&addr, sizeof(addr));
+    saved_errno = errno;
+    close(fd);
+
+    if (retval < 0)
+    {
+        // A full queue means the daemon already has a notification
+        // it hasn't read yet, which is all this one would tell it.
+        if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK)
+            return true;
+        errno = saved_errno;
+        return false;
+    }
+
+    return true;
+}
+
+void rtr_notify_close(
+    int fd,
+    const char *path)
+{
+    if (fd < 0)
+        return;
+    close(fd);
+    if (path != NULL)
+        unlink(path);
+}
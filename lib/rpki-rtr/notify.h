@@ -0,0 +1,60 @@
+#ifndef _RTR_NOTIFY_H
+#define _RTR_NOTIFY_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "pdu.h"
+
+/**
+   Notification of new serial numbers from rpki-rtr-update to
+   rpki-rtr-daemon.
+
+   The daemon binds a Unix domain datagram socket at the path given by
+   the RpkiRtrNotifySocket option, and rpki-rtr-update sends it a
+   datagram after it makes a new serial number available.  The
+   datagram only says that the database changed; the daemon still
+   reads the cache state from the database.  A notification sent when
+   no daemon is running is simply lost, which is fine because the
+   daemon reads the cache state when it starts.
+*/
+
+
+/**
+   Create the socket that notifications are received on, replacing a
+   stale socket left at @p path by a daemon that didn't exit cleanly.
+
+   @return
+       A non-blocking file descriptor, or -1 with errno set.
+*/
+int rtr_notify_listen(
+    const char *path);
+
+/**
+   Read and discard all pending notifications.
+
+   @return
+       The number of notifications read, or -1 with errno set.
+*/
+ssize_t rtr_notify_drain(
+    int fd);
+
+/**
+   Tell the daemon listening at @p path that @p serial is available.
+
+   @return
+       true on success.  On failure, errno is set; ENOENT and
+       ECONNREFUSED mean that no daemon is listening.
+*/
+bool rtr_notify_send(
+    const char *path,
+    serial_number_t serial);
+
+/**
+   Remove the socket created by rtr_notify_listen().
+*/
+void rtr_notify_close(
+    int fd,
+    const char *path);
+
+#endif
@@ -25,6 +25,20 @@ bool serial_number_greater(
 #undef SERIAL_BITS
 }
 
+bool rtr_intervals_valid(
+    uint32_t refresh,
+    uint32_t retry,
+    uint32_t expire)
+{
+    return refresh >= RTR_REFRESH_INTERVAL_MIN &&
+        refresh <= RTR_REFRESH_INTERVAL_MAX &&
+        retry >= RTR_RETRY_INTERVAL_MIN &&
+        retry <= RTR_RETRY_INTERVAL_MAX &&
+        expire >= RTR_EXPIRE_INTERVAL_MIN &&
+        expire <= RTR_EXPIRE_INTERVAL_MAX &&
+        expire > refresh && expire > retry;
+}
+
 // TODO: switch to uintmax_t instead of uint_fast32_t? 32 should be enough for
 // this protocol version
 // NOTE: this handles converting from network to host byte order
@@ -83,7 +97,7 @@ int parse_pdu(
     } while (false)
 
     EXTRACT_FIELD(pdu->protocolVersion);
-    if (pdu->protocolVersion != RTR_PROTOCOL_VERSION)
+    if (pdu->protocolVersion > RTR_PROTOCOL_VERSION)
     {
         return PDU_UNSUPPORTED_PROTOCOL_VERSION;
     }
@@ -107,6 +121,22 @@ int parse_pdu(
             ret = PDU_WARNING;
         }
         break;
+    case PDU_ROUTER_KEY:
+        if (pdu->protocolVersion < RTR_PROTOCOL_VERSION_1)
+        {
+            return PDU_UNSUPPORTED_PDU_TYPE;
+        }
+        EXTRACT_FIELD(pdu->routerKeyHeader.flags);
+        if (pdu->routerKeyHeader.flags & FLAGS_RESERVED)
+        {
+            ret = PDU_WARNING;
+        }
+        EXTRACT_FIELD(pdu->routerKeyHeader.zero);
+        if (pdu->routerKeyHeader.zero != 0)
+        {
+            ret = PDU_WARNING;
+        }
+        break;
     case PDU_ERROR_REPORT:
         EXTRACT_FIELD(pdu->errorCode);
         if (pdu->errorCode != ERR_CORRUPT_DATA &&
@@ -116,7 +146,9 @@ int parse_pdu(
             pdu->errorCode != ERR_UNSUPPORTED_VERSION &&
             pdu->errorCode != ERR_UNSUPPORTED_TYPE &&
             pdu->errorCode != ERR_UNKNOWN_WITHDRAW &&
-            pdu->errorCode != ERR_DUPLICATE_ANNOUNCE)
+            pdu->errorCode != ERR_DUPLICATE_ANNOUNCE &&
+            (pdu->errorCode != ERR_UNEXPECTED_VERSION ||
+             pdu->protocolVersion < RTR_PROTOCOL_VERSION_1))
         {
             ret = PDU_WARNING;
         }
@@ -128,9 +160,30 @@ int parse_pdu(
     EXTRACT_FIELD(pdu->length);
     switch (pdu->pduType)
     {
+    case PDU_END_OF_DATA:
+        if (pdu->protocolVersion >= RTR_PROTOCOL_VERSION_1)
+        {
+            if (pdu->length != PDU_HEADER_LENGTH + sizeof(EndOfData))
+            {
+                return PDU_CORRUPT_DATA;
+            }
+
+            EXTRACT_FIELD(pdu->endOfData.serialNumber);
+            EXTRACT_FIELD(pdu->endOfData.refreshInterval);
+            EXTRACT_FIELD(pdu->endOfData.retryInterval);
+            EXTRACT_FIELD(pdu->endOfData.expireInterval);
+            if (!rtr_intervals_valid(pdu->endOfData.refreshInterval,
+                                     pdu->endOfData.retryInterval,
+                                     pdu->endOfData.expireInterval))
+            {
+                return PDU_INVALID_VALUE;
+            }
+
+            return ret;
+        }
+        // version 0 is the same as the below
     case PDU_SERIAL_NOTIFY:
     case PDU_SERIAL_QUERY:
-    case PDU_END_OF_DATA:
         if (pdu->length != PDU_HEADER_LENGTH + sizeof(pdu->serialNumber))
         {
             return PDU_CORRUPT_DATA;
@@ -224,6 +277,26 @@ int parse_pdu(
 
         EXTRACT_FIELD(pdu->ip6PrefixData.asNumber);
 
+        return ret;
+    case PDU_ROUTER_KEY:
+        if (pdu->length < PDU_HEADER_LENGTH + PDU_ROUTER_KEY_HEADERS_LENGTH)
+        {
+            return PDU_CORRUPT_DATA;
+        }
+
+        EXTRACT_BIN_FIELD(pdu->routerKeyData.subjectKeyIdentifier);
+
+        EXTRACT_FIELD(pdu->routerKeyData.asNumber);
+
+        pdu->routerKeyData.subjectPublicKeyInfoLength =
+            pdu->length - PDU_HEADER_LENGTH - PDU_ROUTER_KEY_HEADERS_LENGTH;
+        if (buflen < offset + pdu->routerKeyData.subjectPublicKeyInfoLength)
+        {
+            return PDU_TRUNCATED;
+        }
+        pdu->routerKeyData.subjectPublicKeyInfo = buffer + offset;
+        offset += pdu->routerKeyData.subjectPublicKeyInfoLength;
+
         return ret;
     case PDU_ERROR_REPORT:
         if (pdu->length < PDU_HEADER_LENGTH + PDU_ERROR_HEADERS_LENGTH)
@@ -298,8 +371,17 @@ ssize_t dump_pdu(
     INCR_OFFSET(2);             // protocolVersion and pduType
     memcpy(buffer, (void *)pdu, 2);
 
-    INCR_OFFSET(2);             // sessionId, reserved, and errorCode
-    *(uint16_t *) (buffer + offset - 2) = htons(pdu->sessionId);
+    INCR_OFFSET(2);             // sessionId, reserved, errorCode, and
+                                // routerKeyHeader
+    if (pdu->pduType == PDU_ROUTER_KEY)
+    {
+        buffer[offset - 2] = pdu->routerKeyHeader.flags;
+        buffer[offset - 1] = pdu->routerKeyHeader.zero;
+    }
+    else
+    {
+        *(uint16_t *) (buffer + offset - 2) = htons(pdu->sessionId);
+    }
 
     INCR_OFFSET(4);             // length
     *(uint32_t *) (buffer + offset - 4) = htonl(pdu->length);
@@ -326,6 +408,23 @@ ssize_t dump_pdu(
             memcpy(buffer + offset - pdu->errorData.errorTextLength,
                    pdu->errorData.errorText, pdu->errorData.errorTextLength);
     }
+    else if (pdu->pduType == PDU_ROUTER_KEY)
+    {
+        INCR_OFFSET(RTR_SKI_LENGTH);
+        memcpy(buffer + offset - RTR_SKI_LENGTH,
+               pdu->routerKeyData.subjectKeyIdentifier, RTR_SKI_LENGTH);
+
+        INCR_OFFSET(4);
+        *(uint32_t *) (buffer + offset - 4) =
+            htonl(pdu->routerKeyData.asNumber);
+
+        INCR_OFFSET(pdu->routerKeyData.subjectPublicKeyInfoLength);
+        if (pdu->routerKeyData.subjectPublicKeyInfoLength > 0)
+            memcpy(buffer + offset -
+                   pdu->routerKeyData.subjectPublicKeyInfoLength,
+                   pdu->routerKeyData.subjectPublicKeyInfo,
+                   pdu->routerKeyData.subjectPublicKeyInfoLength);
+    }
     else
     {
         INCR_OFFSET(pdu->length - PDU_HEADER_LENGTH);
@@ -343,9 +442,12 @@ ssize_t dump_pdu(
                  pdu->pduType == PDU_SERIAL_QUERY ||
                  pdu->pduType == PDU_END_OF_DATA)
         {
-            // These require fixing the order of the serial number
-            *(uint32_t *) (buffer + PDU_HEADER_LENGTH) =
-                htonl(*(uint32_t *) (buffer + PDU_HEADER_LENGTH));
+            // These require fixing the order of the serial number and,
+            // for a version 1 End of Data, the intervals after it
+            size_t i;
+
+            for (i = PDU_HEADER_LENGTH; i + 4 <= offset; i += 4)
+                *(uint32_t *) (buffer + i) = htonl(*(uint32_t *) (buffer + i));
         }
     }
 
@@ -357,75 +459,86 @@ ssize_t dump_pdu(
 
 static void _fill_pdu_common(
     PDU * pdu,
+    uint8_t version,
     uint8_t type,
     uint32_t length)
 {
-    pdu->protocolVersion = RTR_PROTOCOL_VERSION;
+    pdu->protocolVersion = version;
     pdu->pduType = type;
     pdu->length = length;
 }
 
 static void _fill_pdu_with_serial_number(
     PDU * pdu,
+    uint8_t version,
     uint8_t type,
     uint16_t session_or_zero,   // session if the type has one, zero if the
                                 // type doesn't
     serial_number_t serial)
 {
-    _fill_pdu_common(pdu, type, PDU_HEADER_LENGTH + sizeof(pdu->serialNumber));
+    _fill_pdu_common(pdu, version, type,
+                     PDU_HEADER_LENGTH + sizeof(pdu->serialNumber));
     pdu->sessionId = session_or_zero;
     pdu->serialNumber = serial;
 }
 
 static void _fill_pdu_header_only(
     PDU * pdu,
+    uint8_t version,
     uint8_t type,
     uint16_t session_or_zero    // session if the type has one, zero if the
                                 // type doesn't
     )
 {
-    _fill_pdu_common(pdu, type, PDU_HEADER_LENGTH);
+    _fill_pdu_common(pdu, version, type, PDU_HEADER_LENGTH);
     pdu->sessionId = session_or_zero;
 }
 
 void fill_pdu_serial_notify(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
     serial_number_t serial)
 {
-    _fill_pdu_with_serial_number(pdu, PDU_SERIAL_NOTIFY, session, serial);
+    _fill_pdu_with_serial_number(pdu, version, PDU_SERIAL_NOTIFY, session,
+                                 serial);
 }
 
 void fill_pdu_serial_query(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
     serial_number_t serial)
 {
-    _fill_pdu_with_serial_number(pdu, PDU_SERIAL_QUERY, session, serial);
+    _fill_pdu_with_serial_number(pdu, version, PDU_SERIAL_QUERY, session,
+                                 serial);
 }
 
 void fill_pdu_reset_query(
-    PDU * pdu)
+    PDU * pdu,
+    uint8_t version)
 {
-    _fill_pdu_header_only(pdu, PDU_RESET_QUERY, 0);
+    _fill_pdu_header_only(pdu, version, PDU_RESET_QUERY, 0);
 }
 
 void fill_pdu_cache_response(
     PDU * pdu,
+    uint8_t version,
     session_id_t session)
 {
-    _fill_pdu_header_only(pdu, PDU_CACHE_RESPONSE, session);
+    _fill_pdu_header_only(pdu, version, PDU_CACHE_RESPONSE, session);
 }
 
 void fill_pdu_ipv4_prefix(
     PDU * pdu,
+    uint8_t version,
     uint8_t flags,
     uint8_t prefix_length,
     uint8_t max_length,
     const struct in_addr *prefix,
     as_number_t asn)
 {
-    _fill_pdu_common(pdu, PDU_IPV4_PREFIX,
+    _fill_pdu_common(pdu, version, PDU_IPV4_PREFIX,
                      PDU_HEADER_LENGTH + sizeof(pdu->ip4PrefixData));
     pdu->reserved = 0;
     pdu->ip4PrefixData.flags = flags;
@@ -438,13 +551,14 @@ void fill_pdu_ipv4_prefix(
 
 void fill_pdu_ipv6_prefix(
     PDU * pdu,
+    uint8_t version,
     uint8_t flags,
     uint8_t prefix_length,
     uint8_t max_length,
     const struct in6_addr *prefix,
     as_number_t asn)
 {
-    _fill_pdu_common(pdu, PDU_IPV6_PREFIX,
+    _fill_pdu_common(pdu, version, PDU_IPV6_PREFIX,
                      PDU_HEADER_LENGTH + sizeof(pdu->ip6PrefixData));
     pdu->reserved = 0;
     pdu->ip6PrefixData.flags = flags;
@@ -457,27 +571,63 @@ void fill_pdu_ipv6_prefix(
 
 void fill_pdu_end_of_data(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
-    serial_number_t serial)
+    serial_number_t serial,
+    uint32_t refresh_interval,
+    uint32_t retry_interval,
+    uint32_t expire_interval)
 {
-    _fill_pdu_with_serial_number(pdu, PDU_END_OF_DATA, session, serial);
+    _fill_pdu_with_serial_number(pdu, version, PDU_END_OF_DATA, session,
+                                 serial);
+    if (version >= RTR_PROTOCOL_VERSION_1)
+    {
+        pdu->length = PDU_HEADER_LENGTH + sizeof(pdu->endOfData);
+        pdu->endOfData.refreshInterval = refresh_interval;
+        pdu->endOfData.retryInterval = retry_interval;
+        pdu->endOfData.expireInterval = expire_interval;
+    }
 }
 
 void fill_pdu_cache_reset(
-    PDU * pdu)
+    PDU * pdu,
+    uint8_t version)
 {
-    _fill_pdu_header_only(pdu, PDU_CACHE_RESET, 0);
+    _fill_pdu_header_only(pdu, version, PDU_CACHE_RESET, 0);
+}
+
+void fill_pdu_router_key(
+    PDU * pdu,
+    uint8_t version,
+    uint8_t flags,
+    const uint8_t subject_key_identifier[RTR_SKI_LENGTH],
+    as_number_t asn,
+    uint32_t subject_public_key_info_length,
+    uint8_t * subject_public_key_info)
+{
+    _fill_pdu_common(pdu, version, PDU_ROUTER_KEY,
+                     PDU_HEADER_LENGTH + PDU_ROUTER_KEY_HEADERS_LENGTH +
+                     subject_public_key_info_length);
+    pdu->routerKeyHeader.flags = flags;
+    pdu->routerKeyHeader.zero = 0;
+    memcpy(pdu->routerKeyData.subjectKeyIdentifier, subject_key_identifier,
+           RTR_SKI_LENGTH);
+    pdu->routerKeyData.asNumber = asn;
+    pdu->routerKeyData.subjectPublicKeyInfoLength =
+        subject_public_key_info_length;
+    pdu->routerKeyData.subjectPublicKeyInfo = subject_public_key_info;
 }
 
 void fill_pdu_error_report(
     PDU * pdu,
+    uint8_t version,
     error_code_t code,
     uint32_t encapsulated_pdu_length,
     uint8_t * encapsulated_pdu,
     uint32_t error_text_length,
     uint8_t * error_text)
 {
-    _fill_pdu_common(pdu, PDU_ERROR_REPORT,
+    _fill_pdu_common(pdu, version, PDU_ERROR_REPORT,
                      PDU_HEADER_LENGTH + PDU_ERROR_HEADERS_LENGTH +
                      encapsulated_pdu_length + error_text_length);
     pdu->errorCode = code;
@@ -528,6 +678,26 @@ PDU *pdu_deepcopy(
                    ret->errorData.errorTextLength);
         }
     }
+    else if (ret->pduType == PDU_ROUTER_KEY)
+    {
+        if (ret->routerKeyData.subjectPublicKeyInfoLength == 0)
+        {
+            ret->routerKeyData.subjectPublicKeyInfo = NULL;
+            return ret;
+        }
+
+        ret->routerKeyData.subjectPublicKeyInfo =
+            malloc(ret->routerKeyData.subjectPublicKeyInfoLength);
+        if (ret->routerKeyData.subjectPublicKeyInfo == NULL)
+        {
+            free((void *)ret);
+            return NULL;
+        }
+
+        memcpy(ret->routerKeyData.subjectPublicKeyInfo,
+               pdu->routerKeyData.subjectPublicKeyInfo,
+               ret->routerKeyData.subjectPublicKeyInfoLength);
+    }
 
     return ret;
 }
@@ -544,6 +714,10 @@ static void _pdu_free_internal(
         free((void *)pdu->errorData.encapsulatedPDU);
         free((void *)pdu->errorData.errorText);
     }
+    else if (pdu->pduType == PDU_ROUTER_KEY)
+    {
+        free((void *)pdu->routerKeyData.subjectPublicKeyInfo);
+    }
 }
 
 void pdu_free(
@@ -696,6 +870,9 @@ void pdu_sprint(
     case PDU_CACHE_RESET:
         SNPRINTF(" Cache Reset");
         break;
+    case PDU_ROUTER_KEY:
+        SNPRINTF(" Router Key");
+        break;
     case PDU_ERROR_REPORT:
         SNPRINTF(" Error Report");
         break;
@@ -718,6 +895,10 @@ void pdu_sprint(
     case PDU_CACHE_RESET:
         // don't bother printing the reserved field
         break;
+    case PDU_ROUTER_KEY:
+        SNPRINTF(", flags = ");
+        SNPRINTF_FLAGS(pdu->routerKeyHeader.flags);
+        break;
     case PDU_ERROR_REPORT:
         switch (pdu->errorCode)
         {
@@ -745,6 +926,9 @@ void pdu_sprint(
         case ERR_DUPLICATE_ANNOUNCE:
             SNPRINTF(" (Duplicate Announce)");
             break;
+        case ERR_UNEXPECTED_VERSION:
+            SNPRINTF(" (Unexpected Version)");
+            break;
         default:
             SNPRINTF(" (unknown error code %" PRIu16 ")", pdu->errorCode);
             break;
@@ -760,8 +944,19 @@ void pdu_sprint(
     {
     case PDU_SERIAL_NOTIFY:
     case PDU_SERIAL_QUERY:
+        SNPRINTF(", serial number = %" PRIu32, pdu->serialNumber);
+        break;
     case PDU_END_OF_DATA:
         SNPRINTF(", serial number = %" PRIu32, pdu->serialNumber);
+        if (pdu->protocolVersion >= RTR_PROTOCOL_VERSION_1)
+        {
+            SNPRINTF(", refresh interval = %" PRIu32,
+                     pdu->endOfData.refreshInterval);
+            SNPRINTF(", retry interval = %" PRIu32,
+                     pdu->endOfData.retryInterval);
+            SNPRINTF(", expire interval = %" PRIu32,
+                     pdu->endOfData.expireInterval);
+        }
         break;
     case PDU_RESET_QUERY:
     case PDU_CACHE_RESPONSE:
@@ -785,6 +980,17 @@ void pdu_sprint(
         SNPRINTF_IP6(pdu->ip6PrefixData.prefix6);
         SNPRINTF(", AS number = %" PRIu32, pdu->ip6PrefixData.asNumber);
         break;
+    case PDU_ROUTER_KEY:
+        SNPRINTF(", SKI = ");
+        for (i = 0; i < RTR_SKI_LENGTH; ++i)
+        {
+            SNPRINTF("%02" PRIx8,
+                     pdu->routerKeyData.subjectKeyIdentifier[i]);
+        }
+        SNPRINTF(", AS number = %" PRIu32, pdu->routerKeyData.asNumber);
+        SNPRINTF(", SPKI length = %" PRIu32,
+                 pdu->routerKeyData.subjectPublicKeyInfoLength);
+        break;
     case PDU_ERROR_REPORT:
         SNPRINTF(", encapsulated PDU length = %" PRIu32,
                  pdu->errorData.encapsulatedPDULength);
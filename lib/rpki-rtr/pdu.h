@@ -22,12 +22,15 @@
 #define PDU_IPV6_PREFIX 6
 #define PDU_END_OF_DATA 7
 #define PDU_CACHE_RESET 8
+#define PDU_ROUTER_KEY 9        /* version 1 and later */
 #define PDU_ERROR_REPORT 10
 
 /*****
  * Constants for use in the PDUs
  *****/
-#define RTR_PROTOCOL_VERSION 0
+#define RTR_PROTOCOL_VERSION_0 0   /* RFC 6810 */
+#define RTR_PROTOCOL_VERSION_1 1   /* RFC 8210 */
+#define RTR_PROTOCOL_VERSION RTR_PROTOCOL_VERSION_1     /* highest supported */
 #define FLAG_WITHDRAW_ANNOUNCE 0x1
 #define FLAGS_RESERVED (0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80)
 
@@ -42,6 +45,7 @@
 #define ERR_UNSUPPORTED_TYPE 5
 #define ERR_UNKNOWN_WITHDRAW 6
 #define ERR_DUPLICATE_ANNOUNCE 7
+#define ERR_UNEXPECTED_VERSION 8        /* version 1 and later */
 #define ERR_IS_FATAL(code)                                              \
     ((code) != ERR_NO_DATA)
 
@@ -60,6 +64,30 @@ typedef uint32_t as_number_t;
 
 #define SCNSERIAL SCNu32
 
+/*****
+ * Timing parameters from a version 1 End of Data PDU, in seconds.
+ * See RFC 8210, Section 6.
+ *****/
+#define RTR_REFRESH_INTERVAL_MIN 1
+#define RTR_REFRESH_INTERVAL_MAX 86400
+#define RTR_REFRESH_INTERVAL_DEFAULT 3600
+#define RTR_RETRY_INTERVAL_MIN 1
+#define RTR_RETRY_INTERVAL_MAX 7200
+#define RTR_RETRY_INTERVAL_DEFAULT 600
+#define RTR_EXPIRE_INTERVAL_MIN 600
+#define RTR_EXPIRE_INTERVAL_MAX 172800
+#define RTR_EXPIRE_INTERVAL_DEFAULT 7200
+
+/**
+   @return
+       true iff the intervals are each within their allowed range and
+       expire is greater than both refresh and retry
+*/
+bool rtr_intervals_valid(
+    uint32_t refresh,
+    uint32_t retry,
+    uint32_t expire);
+
 
 /**
    @return
@@ -111,6 +139,31 @@ typedef struct _ErrorData {
 
 #define PDU_ERROR_HEADERS_LENGTH (sizeof(uint32_t) + sizeof(uint32_t))
 
+/*****
+ * structure holding the data for an End of Data PDU.  The intervals
+ * are only present in version 1 and later.
+ *****/
+typedef struct _EndOfData {
+    serial_number_t serialNumber;
+    uint32_t refreshInterval;
+    uint32_t retryInterval;
+    uint32_t expireInterval;
+} PACKED_STRUCT EndOfData;
+
+/*****
+ * structure holding the data for a Router Key PDU (version 1 and later)
+ *****/
+#define RTR_SKI_LENGTH 20
+
+typedef struct _RouterKeyData {
+    uint8_t subjectKeyIdentifier[RTR_SKI_LENGTH];
+    as_number_t asNumber;
+    uint32_t subjectPublicKeyInfoLength;
+    uint8_t *subjectPublicKeyInfo;
+} RouterKeyData;
+
+#define PDU_ROUTER_KEY_HEADERS_LENGTH (RTR_SKI_LENGTH + sizeof(as_number_t))
+
 /*****
  * Basic structure of a PDU
  *****/
@@ -121,13 +174,19 @@ struct _PDU {
         session_id_t sessionId;
         uint16_t reserved;
         error_code_t errorCode;
+        struct {
+            uint8_t flags;
+            uint8_t zero;
+        } PACKED_STRUCT routerKeyHeader;
     };
     uint32_t length;
     union {
-        serial_number_t serialNumber;
+        serial_number_t serialNumber;       // also endOfData.serialNumber
+        EndOfData endOfData;
         IP4PrefixData ip4PrefixData;
         IP6PrefixData ip6PrefixData;
         ErrorData errorData;
+        RouterKeyData routerKeyData;
     };
 } PACKED_STRUCT;
 
@@ -151,6 +210,11 @@ struct _PDU {
 /**
    Attempt to parse as much of buffer as possible into pdu.
 
+   Every protocol version up to RTR_PROTOCOL_VERSION is accepted, and
+   which PDU types and lengths are valid depends on the version in the
+   PDU.  Checking that the version matches the one negotiated for a
+   session is up to the caller.
+
    NOTE: pdu may contain pointers into buffer after parsing.  Use
    pdu_deepcopy to get a copy that isn't tied to buffer.
 
@@ -174,21 +238,30 @@ ssize_t dump_pdu(
     size_t buflen,
     const PDU * pdu);
 
+/**
+   The fill_pdu_* functions set every field of pdu for a PDU of the
+   given protocol version.
+*/
 void fill_pdu_serial_notify(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
     serial_number_t serial);
 void fill_pdu_serial_query(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
     serial_number_t serial);
 void fill_pdu_reset_query(
-    PDU * pdu);
+    PDU * pdu,
+    uint8_t version);
 void fill_pdu_cache_response(
     PDU * pdu,
+    uint8_t version,
     session_id_t session);
 void fill_pdu_ipv4_prefix(
     PDU * pdu,
+    uint8_t version,
     uint8_t flags,
     uint8_t prefix_length,
     uint8_t max_length,
@@ -196,17 +269,40 @@ void fill_pdu_ipv4_prefix(
     as_number_t asn);
 void fill_pdu_ipv6_prefix(
     PDU * pdu,
+    uint8_t version,
     uint8_t flags,
     uint8_t prefix_length,
     uint8_t max_length,
     const struct in6_addr *prefix,
     as_number_t asn);
+
+/**
+   The intervals are ignored for version 0, which doesn't have them.
+*/
 void fill_pdu_end_of_data(
     PDU * pdu,
+    uint8_t version,
     session_id_t session,
-    serial_number_t serial);
+    serial_number_t serial,
+    uint32_t refresh_interval,
+    uint32_t retry_interval,
+    uint32_t expire_interval);
 void fill_pdu_cache_reset(
-    PDU * pdu);
+    PDU * pdu,
+    uint8_t version);
+
+/**
+   Like fill_pdu_error_report(), subject_public_key_info is stored in
+   pdu without copying.
+*/
+void fill_pdu_router_key(
+    PDU * pdu,
+    uint8_t version,
+    uint8_t flags,
+    const uint8_t subject_key_identifier[RTR_SKI_LENGTH],
+    as_number_t asn,
+    uint32_t subject_public_key_info_length,
+    uint8_t * subject_public_key_info);
 
 /**
    The encapsulated_pdu and error_text parameters are stored in pdu
@@ -218,6 +314,7 @@ void fill_pdu_cache_reset(
 */
 void fill_pdu_error_report(
     PDU * pdu,
+    uint8_t version,
     error_code_t code,
     uint32_t encapsulated_pdu_length,
     uint8_t * encapsulated_pdu,
@@ -235,6 +235,28 @@ err_code
 roaValidate(
     struct CMS *r);
 
+/**
+ * @brief
+ *     Check that a ROA's prefixes are within its EE certificate's IP
+ *     resources.
+ *
+ * This is the resource check done by roaValidate() and
+ * roaValidate2().  The EE certificate's resource set is cached per
+ * thread, so checking the same certificate again does not rebuild
+ * it.
+ *
+ * @param[in] certp
+ *     The ROA's EE certificate.
+ * @param[in] roaIPAddrBlocksp
+ *     The ROA's address blocks.
+ * @return
+ *     0 on success or a negative error code on failure.
+ */
+err_code
+checkIPAddrs(
+    struct Certificate *certp,
+    struct ROAIPAddrBlocks *roaIPAddrBlocksp);
+
 /**=========================================================================
  * @brief Check conformance to manifest profile
  *
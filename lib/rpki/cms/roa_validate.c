@@ -7,12 +7,15 @@
 #include <wchar.h>
 #include <wctype.h>
 #include <locale.h>
+#include <pthread.h>
 
 #include "roa_utils.h"
 #include "rpki-object/certificate.h"
+#include "rpki-object/resources.h"
 #include "util/cryptlib_compat.h"
 #include "util/logging.h"
 #include "util/hashutils.h"
+#include "util/sha256.h"
 
 int strict_profile_checks_cms = 0;
 
@@ -178,6 +181,52 @@ static int getTime(
 }
 
 
+/*
+ * Extension and signed attribute OIDs that every signed object's
+ * lists are searched for.  They are encoded once into cms_oids, and
+ * each list member is looked up with a single objid_table_find().
+ */
+enum cms_oid {
+    CMS_OID_BASIC_CONSTRAINTS,
+    CMS_OID_SKI,
+    CMS_OID_CONTENT_TYPE,
+    CMS_OID_MESSAGE_DIGEST,
+    CMS_OID_SIGNING_TIME,
+    CMS_OID_BIN_SIGNING_TIME,
+    CMS_OID_NUM
+};
+
+static const char *const cms_oid_strs[CMS_OID_NUM] = {
+    [CMS_OID_BASIC_CONSTRAINTS] = id_basicConstraints,
+    [CMS_OID_SKI] = id_subjectKeyIdentifier,
+    [CMS_OID_CONTENT_TYPE] = id_contentTypeAttr,
+    [CMS_OID_MESSAGE_DIGEST] = id_messageDigestAttr,
+    [CMS_OID_SIGNING_TIME] = id_signingTimeAttr,
+    [CMS_OID_BIN_SIGNING_TIME] = id_binSigningTimeAttr,
+};
+
+static struct objid_table cms_oids;
+static pthread_once_t cms_oids_once = PTHREAD_ONCE_INIT;
+
+static void cms_oids_init(
+    void)
+{
+    if (objid_table_init(&cms_oids, cms_oid_strs, CMS_OID_NUM) != 0)
+        LOG(LOG_ERR, "out of memory");
+}
+
+/*
+ * @return the position of @p oidp in cms_oid_strs, -1 if it is some
+ *     other OID, or -2 on error
+ */
+static int cms_oid(
+    struct casn *oidp)
+{
+    pthread_once(&cms_oids_once, cms_oids_init);
+    return objid_table_find(&cms_oids, oidp);
+}
+
+
 static err_code
 check_cert(
     struct Certificate *certp,
@@ -210,11 +259,11 @@ check_cert(
          extp; extp = (struct Extension *)next_of(&extp->self))
     {
         /** @bug error code ignored without explanation */
-        if (isEE && !diff_objid(&extp->extnID, id_basicConstraints) &&
+        int oid = cms_oid(&extp->extnID);
+        if (isEE && oid == CMS_OID_BASIC_CONSTRAINTS &&
             size_casn(&extp->extnValue.basicConstraints.cA) > 0)
             return ERR_SCM_NOTEE;
-        /** @bug error code ignored without explanation */
-        if (!diff_objid(&extp->extnID, id_subjectKeyIdentifier))
+        if (oid == CMS_OID_SKI)
         {
             uchar *ski;
             ski_lth =
@@ -243,44 +292,45 @@ int check_fileAndHash(
     int inhashlen,
     int inhashtotlen)
 {
-    uchar *contentsp;
+    uchar hash[SHA256_DIGEST_LENGTH];
     err_code err = 0;
     int hash_lth;
     int bit_lth;
-    int name_lth = lseek(ffd, 0, SEEK_END);
 
-    lseek(ffd, 0, SEEK_SET);
-    contentsp = (uchar *) calloc(1, name_lth + 2);
-    if (read(ffd, contentsp, name_lth + 2) != name_lth)
-    {
-        free(contentsp);
-        return (ERR_SCM_BADFILE);
-    }
-    if (inhash != NULL && inhashlen > 0 && inhashlen <= (name_lth + 2))
+    if (inhash != NULL && inhashlen > 0)
     {
-        memcpy(contentsp, inhash, inhashlen);
+        if (inhashlen > (int)sizeof(hash))
+            return ERR_SCM_BADMFTHASH;
+        memcpy(hash, inhash, inhashlen);
         hash_lth = inhashlen;
     }
     else
     {
-        hash_lth = gen_hash(contentsp, name_lth, contentsp, CRYPT_ALGO_SHA2);
-        if (hash_lth < 0)
-        {
-            free(contentsp);
-            return (ERR_SCM_BADMKHASH);
-        }
+        /* stream the file rather than reading it all into memory */
+        struct sha256_ctx ctx;
+        uchar buf[16384];
+        ssize_t n;
+
+        if (lseek(ffd, 0, SEEK_SET) < 0)
+            return ERR_SCM_BADFILE;
+        sha256_init(&ctx);
+        while ((n = read(ffd, buf, sizeof(buf))) > 0)
+            sha256_update(&ctx, buf, n);
+        if (n < 0)
+            return ERR_SCM_BADFILE;
+        sha256_final(&ctx, hash);
+        hash_lth = SHA256_DIGEST_LENGTH;
     }
     bit_lth = vsize_casn(&fahp->hash);
     uchar *hashp = (uchar *) calloc(1, bit_lth);
     read_casn(&fahp->hash, hashp);
     if (hash_lth != (bit_lth - 1) ||
-        memcmp(&hashp[1], contentsp, hash_lth) != 0)
+        memcmp(&hashp[1], hash, hash_lth) != 0)
         err = ERR_SCM_BADMFTHASH;
     free(hashp);
     if (inhash != NULL && inhashtotlen >= hash_lth && inhashlen == 0
         && err == 0)
-        memcpy(inhash, contentsp, hash_lth);
-    free(contentsp);
+        memcpy(inhash, hash, hash_lth);
     return err == 0 ? hash_lth : err;
 }
 
@@ -303,7 +353,7 @@ int check_fileAndHash(
  *
  * @param[in] attrsp
  *     Attributes to search for the OID in.
- * @param[in] oidp
+ * @param[in] oid
  *     Attribute OID to search for.
  * @param[out] found_any
  *     True indicates any attributes with the OID were found.  False
@@ -314,7 +364,7 @@ int check_fileAndHash(
  */
 static struct Attribute *find_unique_attr(
     struct SignedAttributes *attrsp,
-    char *oidp,
+    enum cms_oid oid,
     bool *found_any)
 {
     struct Attribute *attrp,
@@ -324,7 +374,7 @@ static struct Attribute *find_unique_attr(
          attrp != NULL; attrp = (struct Attribute *)next_of(&attrp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&attrp->attrType, oidp))
+        if (cms_oid(&attrp->attrType) == (int)oid)
         {
             if (*found_any)
             {
@@ -340,58 +390,6 @@ static struct Attribute *find_unique_attr(
     return ch_attrp;
 }
 
-static err_code
-setup_cert_minmax(
-    struct IPAddressOrRangeA *rpAddrRangep,
-    uchar *cmin,
-    uchar *cmax,
-    int fam)
-{
-    memset(cmin, 0, MINMAXBUFSIZE);
-    /** @bug magic number */
-    memset(cmax, -1, MINMAXBUFSIZE);
-    /** @bug magic number */
-    if (fam == 1)
-        /** @bug magic number */
-        fam = 7;
-    /** @bug magic number */
-    else if (fam == 2)
-        /** @bug magic number */
-        fam = 19;
-    else
-        /** @bug error message not logged */
-        return ERR_SCM_INVALFAM;
-    /** @bug error code ignored without explanation */
-    if (tag_casn(&rpAddrRangep->self) == ASN_SEQUENCE)
-    {
-        /** @bug error code ignored without explanation */
-        if (size_casn(&rpAddrRangep->addressRange.min) > fam ||
-            /** @bug error code ignored without explanation */
-            size_casn(&rpAddrRangep->addressRange.max) > fam)
-            /** @bug error message not logged */
-            return ERR_SCM_INVALFAM;
-        /** @bug error code ignored without explanation */
-        encode_casn(&rpAddrRangep->addressRange.min, cmin);
-        /** @bug error code ignored without explanation */
-        encode_casn(&rpAddrRangep->addressRange.max, cmax);
-    }
-    else
-    {
-        /** @bug error code ignored without explanation */
-        if (size_casn(&rpAddrRangep->addressPrefix) > fam)
-            /** @bug error message not logged */
-            return ERR_SCM_INVALFAM;
-        /** @bug error code ignored without explanation */
-        encode_casn(&rpAddrRangep->addressPrefix, cmin);
-        /** @bug error code ignored without explanation */
-        encode_casn(&rpAddrRangep->addressPrefix, cmax);
-    }
-    fill_max(cmax);
-    cmin[2] = 0;
-    cmax[2] = 0;
-    return 0;
-}
-
 static err_code
 setup_roa_minmax(
     struct IPAddress *ripAddrp,
@@ -557,7 +555,7 @@ cmsValidate(
     struct Attribute *attrp;
     bool found_any;
     // make sure there is one and only one content
-    if (!(attrp = find_unique_attr(&sigInfop->signedAttrs, id_contentTypeAttr,
+    if (!(attrp = find_unique_attr(&sigInfop->signedAttrs, CMS_OID_CONTENT_TYPE,
                                    &found_any)) ||
         // make sure it is the same as in EncapsulatedContentInfo
         diff_casn(&attrp->attrValues.array.contentType,
@@ -565,7 +563,7 @@ cmsValidate(
         return ERR_SCM_BADCONTTYPE;
     // make sure there is one and only one message digest
     if (!(attrp = find_unique_attr(&sigInfop->signedAttrs,
-                                   id_messageDigestAttr, &found_any)) ||
+                                   CMS_OID_MESSAGE_DIGEST, &found_any)) ||
         // make sure the message digest is 32 bytes long and we can get it
         vsize_casn(&attrp->attrValues.array.messageDigest) != 32 ||
         read_casn(&attrp->attrValues.array.messageDigest, digestbuf) != 32)
@@ -573,7 +571,7 @@ cmsValidate(
 
     // if there is a signing time, make sure it is the right format
     attrp =
-        find_unique_attr(&sigInfop->signedAttrs, id_signingTimeAttr,
+        find_unique_attr(&sigInfop->signedAttrs, CMS_OID_SIGNING_TIME,
                          &found_any);
     if (attrp)
     {
@@ -604,7 +602,7 @@ cmsValidate(
         return ERR_SCM_SIGINFOTIM;
     // check that there is no more than one binSigning time attribute
     attrp =
-        find_unique_attr(&sigInfop->signedAttrs, id_binSigningTimeAttr,
+        find_unique_attr(&sigInfop->signedAttrs, CMS_OID_BIN_SIGNING_TIME,
                          &found_any);
     if (attrp == NULL && found_any)
         return ERR_SCM_BINSIGTIME;
@@ -631,13 +629,11 @@ cmsValidate(
         attrp = (struct Attribute *)next_of(&attrp->self))
     {
         /** @bug error code ignored without explanation */
-        if (diff_objid(&attrp->attrType, id_contentTypeAttr) &&
-            /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_messageDigestAttr) &&
-            /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_signingTimeAttr) &&
-            /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_binSigningTimeAttr))
+        int oid = cms_oid(&attrp->attrType);
+        if (oid != CMS_OID_CONTENT_TYPE &&
+            oid != CMS_OID_MESSAGE_DIGEST &&
+            oid != CMS_OID_SIGNING_TIME &&
+            oid != CMS_OID_BIN_SIGNING_TIME)
         {
             return ERR_SCM_INVALSATTR;
         }
@@ -658,7 +654,7 @@ cmsValidate(
          (struct Extension *)member_casn(&certp->toBeSigned.extensions.
                                          self, 0);
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, id_subjectKeyIdentifier);
+         extp && cms_oid(&extp->extnID) != CMS_OID_SKI;
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (!extp
@@ -1019,92 +1015,81 @@ done:
     return iRes;
 }
 
-struct certrange {
-    uchar lo[18],
-        hi[18];
-};
-
-static int setuprange(
-    struct certrange *certrangep,
-    struct casn *lorangep,
-    struct casn *hirangep)
-{
-    uchar locbuf[18];
-    memset(locbuf, 0, 18);
-    memset(certrangep->lo, 0, sizeof(certrangep->lo));
-    memset(certrangep->hi, -1, sizeof(certrangep->hi));
-    int lth = read_casn(lorangep, locbuf);
-    int unused = locbuf[0];
-    memcpy(certrangep->lo, &locbuf[1], --lth);
-    certrangep->lo[lth - 1] &= (0xFF << unused);
-    lth = read_casn(hirangep, locbuf);
-    unused = locbuf[0];
-    memcpy(certrangep->hi, &locbuf[1], --lth);
-    certrangep->hi[lth - 1] |= (0xFF >> (8 - unused));
-    return 0;
-}
+/*
+ * Resource set of the most recently checked EE certificate, keyed by
+ * the DER encoding of its IP address extension.  roaValidate() and
+ * roaValidate2() both check a ROA's prefixes against the same EE
+ * certificate, so the second check reuses the set built by the first.
+ * The cache is per thread so that ROAs can be validated concurrently.
+ */
+static __thread struct {
+    uchar *key;
+    int keylen;
+    struct resource_set set;
+} ee_resources_cache;
 
-static int certrangecmp(
-    const void *range1_voidp,
-    const void *range2_voidp)
+static err_code
+ee_resources(
+    struct Certificate *certp,
+    const struct resource_set **setpp)
 {
-    const struct certrange *range1 = (const struct certrange *)range1_voidp;
-    const struct certrange *range2 = (const struct certrange *)range2_voidp;
-
-    int ret = memcmp(range1->lo, range2->lo, sizeof(range1->lo));
-    if (ret != 0)
-        return ret;
-    else
-        return memcmp(range1->hi, range2->hi, sizeof(range1->hi));
-}
+    struct Extension *extp;
+    uchar *key;
+    int keylen;
 
-/** @return non-zero iff range1 fully contains range2 */
-static int certrangeContains(
-    const struct certrange *range1,
-    const struct certrange *range2)
-{
-    return memcmp(range2->lo, range1->lo, sizeof(range1->lo)) >= 0 &&
-        memcmp(range2->hi, range1->hi, sizeof(range1->hi)) <= 0;
-}
+    extp = find_extension(&certp->toBeSigned.extensions, id_pe_ipAddrBlock,
+                          false);
+    if (!extp)
+        return ERR_SCM_NOIPEXT;
+    keylen = size_casn(&extp->self);
+    if (keylen <= 0)
+        return ERR_SCM_INVALIPB;
+    key = malloc(keylen);
+    if (!key)
+        return ERR_SCM_NOMEM;
+    encode_casn(&extp->self, key);
+    if (keylen == ee_resources_cache.keylen &&
+        memcmp(key, ee_resources_cache.key, keylen) == 0)
+    {
+        free(key);
+        *setpp = &ee_resources_cache.set;
+        return 0;
+    }
 
-/** @return non-zero iff range1 does not intersect range2
-  and range1 is before range2 */
-static int certrangeBefore(
-    const struct certrange *range1,
-    const struct certrange *range2)
-{
-    return memcmp(range1->hi, range2->lo, sizeof(range1->hi)) < 0;
+    free(ee_resources_cache.key);
+    ee_resources_cache.key = NULL;
+    ee_resources_cache.keylen = 0;
+    resource_set_free(&ee_resources_cache.set);
+    if (!resource_set_from_cert(&ee_resources_cache.set, certp))
+    {
+        free(key);
+        resource_set_free(&ee_resources_cache.set);
+        return ERR_SCM_INVALIPB;
+    }
+    ee_resources_cache.key = key;
+    ee_resources_cache.keylen = keylen;
+    *setpp = &ee_resources_cache.set;
+    return 0;
 }
 
-static err_code
+err_code
 checkIPAddrs(
     struct Certificate *certp,
     struct ROAIPAddrBlocks *roaIPAddrBlocksp)
 {
     // determine if all the address blocks in the ROA are within the EE cert
-    struct Extension *extp;
-    /** @bug error code ignored without explanation */
-    for (extp =
-         (struct Extension *)member_casn(&certp->toBeSigned.extensions.self,
-                                         0);
-         /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, id_pe_ipAddrBlock);
-         /** @bug error code ignored without explanation */
-         extp = (struct Extension *)next_of(&extp->self));
-    if (!extp)
-        return ERR_SCM_NOIPEXT;
-    struct IpAddrBlock *certIpAddrBlockp = &extp->extnValue.ipAddressBlock;
+    const struct resource_set *certResources;
+    struct resource_set roaResources;
+    err_code sta;
+    int afi;
 
-    struct ROAIPAddressFamily *roaFamilyp;
-    struct IPAddressFamilyA *certFamilyp;
+    if ((sta = ee_resources(certp, &certResources)) < 0)
+        return sta;
 
     // make sure none of the cert families are marked inherit
-    for (certFamilyp =
-        (struct IPAddressFamilyA *)member_casn(&certIpAddrBlockp->self, 0);
-        certFamilyp;
-        certFamilyp = (struct IPAddressFamilyA *)next_of(&certFamilyp->self))
+    for (afi = 0; afi < RESOURCE_NUM_AFI; afi++)
     {
-        if (size_casn(&certFamilyp->ipAddressChoice.inherit))
+        if (certResources->ip[afi].inherit)
         {
             LOG(LOG_ERR,
                 "ROA's EE certificate has IP resources marked inherit");
@@ -1112,100 +1097,13 @@ checkIPAddrs(
         }
     }
 
-    // for each ROA family, see if it is in cert
-    for (roaFamilyp =
-         (struct ROAIPAddressFamily *)member_casn(&roaIPAddrBlocksp->self, 0);
-         roaFamilyp;
-         roaFamilyp = (struct ROAIPAddressFamily *)next_of(&roaFamilyp->self))
-    {
-        int matchedCertFamily = 0;
-        for (certFamilyp =
-             (struct IPAddressFamilyA *)member_casn(&certIpAddrBlockp->self,
-                                                    0); certFamilyp;
-             certFamilyp =
-             (struct IPAddressFamilyA *)next_of(&certFamilyp->self))
-        {
-            if (diff_casn
-                (&certFamilyp->addressFamily, &roaFamilyp->addressFamily))
-                continue;
-            matchedCertFamily = 1;
-            // for each ROA entry, see if it is in cert
-            const int roaNumPrefixes = num_items(&roaFamilyp->addresses.self);
-            struct certrange *roaRanges =
-                malloc(roaNumPrefixes * sizeof(struct certrange));
-            if (!roaRanges)
-                return ERR_SCM_NOMEM;
-            struct ROAIPAddress *roaIPAddrp;
-            int roaPrefixNum;
-            for (roaIPAddrp =
-                 (struct ROAIPAddress *)member_casn(&roaFamilyp->addresses.
-                                                    self, 0), roaPrefixNum = 0;
-                 roaIPAddrp;
-                 roaIPAddrp =
-                 (struct ROAIPAddress *)next_of(&roaIPAddrp->self),
-                 ++roaPrefixNum)
-            {
-                // roaIPAddrp->address is a prefix (BIT string)
-                setuprange(&roaRanges[roaPrefixNum], &roaIPAddrp->address,
-                           &roaIPAddrp->address);
-            }
-            qsort(roaRanges, roaNumPrefixes, sizeof(roaRanges[0]),
-                  certrangecmp);
-            struct IPAddressOrRangeA *certIPAddressOrRangeAp =
-                (struct IPAddressOrRangeA *)member_casn(&certFamilyp->
-                                                        ipAddressChoice.
-                                                        addressesOrRanges.self,
-                                                        0);
-            struct certrange certrange;
-            roaPrefixNum = 0;
-            while (roaPrefixNum < roaNumPrefixes)
-            {
-                do
-                {
-                    if (certIPAddressOrRangeAp == NULL)
-                    {
-                        // reached end of certranges when there are still
-                        // roaranges to match
-                        free(roaRanges);
-                        return ERR_SCM_ROAIPMISMATCH;
-                    }
-                    // certIPAddressOrRangep is either a prefix (BIT string)
-                    // or a range
-                    if (size_casn(&certIPAddressOrRangeAp->addressRange.self))
-                        setuprange(&certrange,
-                                   &certIPAddressOrRangeAp->addressRange.min,
-                                   &certIPAddressOrRangeAp->addressRange.max);
-                    else
-                        setuprange(&certrange,
-                                   &certIPAddressOrRangeAp->addressPrefix,
-                                   &certIPAddressOrRangeAp->addressPrefix);
-                    certIPAddressOrRangeAp =
-                        (struct IPAddressOrRangeA
-                         *)next_of(&certIPAddressOrRangeAp->self);
-                } while (!certrangeContains
-                         (&certrange, &roaRanges[roaPrefixNum])
-                         && !certrangeBefore(&roaRanges[roaPrefixNum],
-                                             &certrange));
-                if (!certrangeContains(&certrange, &roaRanges[roaPrefixNum]))
-                {
-                    // roarange is unmatched and all remaining certrange are
-                    // greater than roarange
-                    free(roaRanges);
-                    return ERR_SCM_ROAIPMISMATCH;
-                }
-                while (roaPrefixNum < roaNumPrefixes &&
-                       certrangeContains(&certrange, &roaRanges[roaPrefixNum]))
-                {
-                    // skip all roaranges contained by this certrange
-                    ++roaPrefixNum;
-                }
-            }
-            free(roaRanges);
-        }
-        if (!matchedCertFamily)
-            return ERR_SCM_ROAIPMISMATCH;
-    }
-    return 0;
+    resource_set_init(&roaResources);
+    if (!resource_set_add_roa(&roaResources, roaIPAddrBlocksp))
+        sta = ERR_SCM_INVALIPB;
+    else if (!resource_set_contains(certResources, &roaResources))
+        sta = ERR_SCM_ROAIPMISMATCH;
+    resource_set_free(&roaResources);
+    return sta;
 }
 
 err_code
@@ -1308,18 +1206,8 @@ roaValidate2(
     LOG(LOG_DEBUG, "roaValidate2(rp=%p)", rp);
 
     err_code sta = 0;
-    long ii;
-    long ij;
     struct Extension *extp;
     char *oidp = NULL;
-    uchar cmin[MINMAXBUFSIZE];
-    uchar cmax[MINMAXBUFSIZE];
-    uchar rmin[MINMAXBUFSIZE];
-    uchar rmax[MINMAXBUFSIZE];
-    /** @bug magic number */
-    uchar rfam[8];
-    /** @bug magic number */
-    uchar cfam[8];
     int all_extns = 0;
     struct SignedData *rd = &rp->content.signedData;
 
@@ -1369,110 +1257,15 @@ roaValidate2(
         else if (!memcmp(oidp, id_pe_ipAddrBlock, strlen(oidp)))
         {
             all_extns |= HAS_EXTN_IPADDR;
-            // start at first family in cert. NOTE order must be v4
-            // then v6, per RFC3779
-            struct IPAddressFamilyA *rpAddrFamp =
-                &extp->extnValue.ipAddressBlock.iPAddressFamilyA;
-            /** @bug error code ignored without explanation */
-            read_casn(&rpAddrFamp->addressFamily, cfam);
-            // for ieach of the ROA's families
-            struct ROAIPAddressFamily *ripAddrFamp;
-            struct RouteOriginAttestation *roa =
-                &rd->encapContentInfo.eContent.roa;
-            for (ripAddrFamp = &roa->ipAddrBlocks.rOAIPAddressFamily;
-                 ripAddrFamp;
-                 /** @bug error code ignored without explanation */
-                 ripAddrFamp = (struct ROAIPAddressFamily *)next_of(
-                     &ripAddrFamp->self))
+            // check that the ROA's prefixes are within the cert's
+            // resources (the cert's resource set is cached from
+            // roaValidate())
+            if (checkIPAddrs(cert, &rd->encapContentInfo.eContent.roa.
+                             ipAddrBlocks) < 0)
             {
-                // find that family in cert
-                /** @bug error code ignored without explanation */
-                read_casn(&ripAddrFamp->addressFamily, rfam);
-                /** @bug magic number */
-                /** @bug are cfam and rfam guaranteed to have len 2? */
-                while (rpAddrFamp && memcmp(cfam, rfam, 2) != 0)
-                {
-                    /** @bug error code ignored without explanation */
-                    if (!(rpAddrFamp = (struct IPAddressFamilyA *)next_of(
-                              &rpAddrFamp->self)))
-                    {
-                        sta = ERR_SCM_INVALIPB;
-                        goto done;
-                    }
-                    /** @bug error code ignored without explanation */
-                    read_casn(&rpAddrFamp->addressFamily, cfam);
-                }
-                // OK, got the cert family, too f it's not inheriting
-                /** @bug error code ignored without explanation */
-                if (tag_casn(&rpAddrFamp->ipAddressChoice.self) == ASN_SEQUENCE)
-                {
-                    // go through all ip addresses in that ROA family
-                    struct ROAIPAddress *roaAddrp;
-                    for (roaAddrp = &ripAddrFamp->addresses.rOAIPAddress;
-                         roaAddrp;
-                         /** @bug error code ignored without explanation */
-                         roaAddrp = (struct ROAIPAddress *)next_of(
-                             &roaAddrp->self))
-                    {
-                        // set up the limits
-                        /** @bug error code possibly ignored without
-                         * explanation */
-                        /** @bug why rfam[1]? */
-                        if ((sta = setup_roa_minmax(
-                                 &roaAddrp->address, rmin, rmax, rfam[1])) < 0)
-                        {
-                            goto done;
-                        }
-                        // first set up initial entry in cert
-                        struct IPAddressOrRangeA *rpAddrRangep =
-                            &rpAddrFamp->ipAddressChoice.addressesOrRanges.
-                            iPAddressOrRangeA;
-                        /** @bug error code possibly ignored without
-                         * explanation */
-                        /** @bug why cfam[1]? */
-                        if ((sta = setup_cert_minmax(
-                                 rpAddrRangep, cmin, cmax, cfam[1])) < 0)
-                        {
-                            goto done;
-                        }
-                        // go through cert addresses until a high
-                        // enough one is found i.e. skip cert
-                        // addresses whose max is below roa's min
-                        while (rpAddrRangep && memcmp(
-                                   &cmax[2], &rmin[2], sizeof(rmin) - 2) <= 0)
-                        {
-                            /** @bug brace nesting too deep */
-
-                            /** @bug error code ignored without explanation */
-                            if (!(rpAddrRangep =
-                                  (struct IPAddressOrRangeA *)next_of(
-                                      &rpAddrRangep->self))
-                                || setup_cert_minmax(
-                                    rpAddrRangep, cmin, cmax, cfam[1]) < 0)
-                            {
-                                /** @bug error message not logged */
-                                sta = ERR_SCM_INVALIPB;
-                                goto done;
-                            }
-                        }
-                        if (rpAddrRangep)
-                        {
-                            // now at cert values at or beyond roa.
-                            // if roa min is below cert min OR roa max
-                            // beyond cert max, bail out
-                            if ((ii = memcmp(
-                                     &rmin[2], &cmin[2], sizeof(cmin) - 2)) < 0
-                                || (ij = memcmp(
-                                        &rmax[2], &cmax[2],
-                                        sizeof(cmin) - 2)) > 0)
-                            {
-                                /** @bug error message not logged */
-                                sta = ERR_SCM_INVALIPB;
-                                goto done;
-                            }
-                        }
-                    }
-                }
+                /** @bug error message not logged */
+                sta = ERR_SCM_INVALIPB;
+                goto done;
             }
         }
     }
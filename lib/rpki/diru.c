@@ -127,38 +127,66 @@ int strwillfit(
     return (already + newlen);
 }
 
+/*
+ * Canonical form of the most recent absolute directory passed to
+ * canonical_dir()
+ */
+static char last_raw_dir[PATH_MAX];
+static char last_canon_dir[PATH_MAX];
+
+/*
+ * Convert a directory name into an absolute pathname in canonical
+ * form, like r2adir(), but into a caller-supplied PATH_MAX buffer and
+ * without changing the working directory.
+ */
+static err_code
+canonical_dir(
+    const char *indir,
+    char *outdir)
+{
+    struct stat mystat;
+
+    if (indir[0] == '/' && last_raw_dir[0] != 0 &&
+        strcmp(indir, last_raw_dir) == 0)
+    {
+        strcpy(outdir, last_canon_dir);
+        return (0);
+    }
+    if (realpath(indir, outdir) == NULL)
+    {
+        ERR_LOG(errno, NULL, "realpath(\"%s\") failed", indir);
+        return (ERR_SCM_NOTADIR);
+    }
+    if (stat(outdir, &mystat) < 0 || !S_ISDIR(mystat.st_mode))
+    {
+        LOG(LOG_ERR, "%s is not a directory", indir);
+        return (ERR_SCM_NOTADIR);
+    }
+    if (indir[0] == '/')
+    {
+        strcpy(last_raw_dir, indir);
+        strcpy(last_canon_dir, outdir);
+    }
+    return (0);
+}
+
 err_code
-splitdf(
-    char *dirprefix,
-    char *dirname,
-    char *fname,
-    char **outdir,
-    char **outfile,
-    char **outfull)
+splitdf_r(
+    const char *dirprefix,
+    const char *dirname,
+    const char *fname,
+    struct split_path *out)
 {
+    char work[PATH_MAX];
     char *slash;
-    char *work;
-    char *outd = NULL;
-    char *outf = NULL;
-    int wsta = ERR_SCM_UNSPECIFIED;
+    int len;
+    err_code sta;
 
-    if (fname == NULL || fname[0] == 0)
+    if (fname == NULL || fname[0] == 0 || out == NULL)
     {
         LOG(LOG_ERR, "fname argument must not be NULL or an empty string");
         return (ERR_SCM_INVALARG);
     }
-    if (outdir != NULL)
-        *outdir = NULL;
-    if (outfile != NULL)
-        *outfile = NULL;
-    if (outfull != NULL)
-        *outfull = NULL;
-    work = (char *)calloc(PATH_MAX, sizeof(char));
-    if (work == NULL)
-    {
-        LOG(LOG_ERR, "out of memory");
-        return (ERR_SCM_NOMEM);
-    }
     /*
      * First form a path. in the special case that the prefix and the dirname
      * both null and fname contains no / characters, then use the current
@@ -168,108 +196,108 @@ splitdf(
     {
         if (!getcwd(work, PATH_MAX))
             abort();
-        wsta = strwillfit(work, PATH_MAX, wsta, "/");
-        if (wsta < 0)
-        {
-            free((void *)work);
-            return (wsta);
-        }
-        wsta = strwillfit(work, PATH_MAX, wsta, fname);
-        if (wsta < 0)
-        {
-            free((void *)work);
-            return (wsta);
-        }
+        len = snprintf(out->full, PATH_MAX, "%s/%s", work, fname);
     }
     else
     {
-        if (dirprefix != NULL && dirprefix[0] != 0)
-        {
-            wsta = strwillfit(work, PATH_MAX, wsta, dirprefix);
-            if (wsta < 0)
-            {
-                free((void *)work);
-                return (wsta);
-            }
-        }
-        if (dirname != NULL && dirname[0] != 0)
-        {
-            if (work[0] != 0)
-            {
-                wsta = strwillfit(work, PATH_MAX, wsta, "/");
-                if (wsta < 0)
-                {
-                    free((void *)work);
-                    return (wsta);
-                }
-            }
-            wsta = strwillfit(work, PATH_MAX, wsta, dirname);
-            if (wsta < 0)
-            {
-                free((void *)work);
-                return (wsta);
-            }
-        }
-        if (work[0] != 0)
-        {
-            wsta = strwillfit(work, PATH_MAX, wsta, "/");
-            if (wsta < 0)
-            {
-                free((void *)work);
-                return (wsta);
-            }
-        }
-        wsta = strwillfit(work, PATH_MAX, wsta, fname);
-        if (wsta < 0)
-        {
-            free((void *)work);
-            return (wsta);
-        }
+        const char *sep1 = "";
+        const char *sep2 = "";
+
+        if (dirprefix == NULL)
+            dirprefix = "";
+        if (dirname == NULL)
+            dirname = "";
+        if (dirprefix[0] != 0 && dirname[0] != 0)
+            sep1 = "/";
+        if (dirprefix[0] != 0 || dirname[0] != 0)
+            sep2 = "/";
+        len = snprintf(out->full, PATH_MAX, "%s%s%s%s%s", dirprefix, sep1,
+                       dirname, sep2, fname);
     }
+    if (len < 0 || len >= PATH_MAX)
+    {
+        LOG(LOG_ERR, "not enough room in buffer to concatenate strings");
+        return (ERR_SCM_INVALSZ);
+    }
+    memcpy(work, out->full, len + 1);
     slash = strrchr(work, '/');
     if (slash == NULL)
     {
         LOG(LOG_ERR, "no slash found in current working directory: %s", work);
-        free((void *)work);
         return (ERR_SCM_NOTADIR);
     }
     if (slash[1] == 0)
     {
         LOG(LOG_ERR, "working directory ends with a slash: %s", work);
-        free((void *)work);
         return (ERR_SCM_BADFILE);
     }
     *slash = 0;
-    outd = r2adir(work);
-    if (outd == NULL)
+    sta = canonical_dir(work, out->dir);
+    if (sta < 0)
     {
         LOG(LOG_ERR, "unable to convert relative path to absolute path: %s",
             work);
-        free((void *)work);
-        return (ERR_SCM_NOTADIR);
+        return (sta);
+    }
+    len = snprintf(out->full, PATH_MAX, "%s/%s", out->dir, slash + 1);
+    if (len < 0 || len >= PATH_MAX)
+    {
+        LOG(LOG_ERR, "not enough room in buffer to concatenate strings");
+        return (ERR_SCM_INVALSZ);
     }
+    out->file = out->full + strlen(out->dir) + 1;
+    return (0);
+}
+
+err_code
+splitdf(
+    char *dirprefix,
+    char *dirname,
+    char *fname,
+    char **outdir,
+    char **outfile,
+    char **outfull)
+{
+    struct split_path *sp;
+    err_code sta;
+
     if (outdir != NULL)
-        *outdir = outd;
-    outf = strdup(slash + 1);
-    if (outf == NULL)
+        *outdir = NULL;
+    if (outfile != NULL)
+        *outfile = NULL;
+    if (outfull != NULL)
+        *outfull = NULL;
+    sp = malloc(sizeof(*sp));
+    if (sp == NULL)
     {
         LOG(LOG_ERR, "out of memory");
         return (ERR_SCM_NOMEM);
     }
-    if (outfile != NULL)
-        *outfile = outf;
-    if (outfull != NULL)
+    sta = splitdf_r(dirprefix, dirname, fname, sp);
+    if (sta < 0)
     {
-        xsnprintf(work, PATH_MAX, "%s/%s", outd, outf);
-        *outfull = strdup(work);
-        if (*outfull == NULL)
+        free(sp);
+        return (sta);
+    }
+    if ((outdir != NULL && (*outdir = strdup(sp->dir)) == NULL) ||
+        (outfile != NULL && (*outfile = strdup(sp->file)) == NULL) ||
+        (outfull != NULL && (*outfull = strdup(sp->full)) == NULL))
+    {
+        LOG(LOG_ERR, "out of memory");
+        sta = ERR_SCM_NOMEM;
+        if (outdir != NULL)
         {
-            LOG(LOG_ERR, "out of memory");
-            return (ERR_SCM_NOMEM);
+            free(*outdir);
+            *outdir = NULL;
+        }
+        if (outfile != NULL)
+        {
+            free(*outfile);
+            *outfile = NULL;
         }
     }
-    free((void *)work);
-    return (0);
+    free(sp);
+    return (sta);
 }
 
 err_code
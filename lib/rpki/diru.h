@@ -1,6 +1,8 @@
 #ifndef LIB_RPKI_DIRU_H
 #define LIB_RPKI_DIRU_H
 
+#include <limits.h>
+
 #include "err.h"
 
 /*
@@ -54,6 +56,31 @@ splitdf(
     char **outfile,
     char **outfull);
 
+/*
+ * A path split by splitdf_r(). file points into full, just after the
+ * last slash.
+ */
+struct split_path {
+    char dir[PATH_MAX];
+    char full[PATH_MAX];
+    char *file;
+};
+
+/*
+ * Like splitdf(), but the results are stored in *out instead of in
+ * allocated memory.  The canonical form of the most recent absolute
+ * directory is remembered, so splitting many files in the same
+ * directory costs one realpath() in total.
+ *
+ * This function uses static memory and is not thread-safe.
+ */
+extern err_code
+splitdf_r(
+    const char *dirprefix,
+    const char *dirname,
+    const char *fname,
+    struct split_path *out);
+
 /*
  * This function returns 0 if the indicated file is an acceptable file, which
  * means a regular file that is also not a symlink, and a negative error code
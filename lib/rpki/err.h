@@ -173,6 +173,11 @@
     f(ERR_SCM_TAINHERIT, "TA cert has inherit resources")               \
     f(ERR_SCM_TRUNCATED, "Truncated data")                              \
     f(ERR_SCM_BREAK, "Stop iteration (no error)")                       \
+    f(ERR_SCM_NOTYET, "Not yet valid")                                  \
+    f(ERR_SCM_OVERCLAIM, "Resources not held by the issuer")            \
+    f(ERR_SCM_STALECRL, "CRL is stale")                                 \
+    f(ERR_SCM_STALEMAN, "Manifest is stale")                            \
+    f(ERR_SCM_TALKEY, "Key does not match the TAL")                     \
     // end of error codes list
 
 #define ERROR_ENUM_POS(NAME, DESCR) POS_##NAME,
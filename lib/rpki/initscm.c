@@ -133,9 +133,43 @@ static char *firsttok(
  * Parse the schema and build a list of columns.
  */
 
+/*
+ * Like strtok(..., ","), but commas nested within parentheses, such as
+ * those in the expression of a generated column, do not separate
+ * tokens.  *cursor is advanced past the returned token, or set to NULL
+ * after the last one.
+ */
+
+static char *nextcoldef(
+    char **cursor)
+{
+    char *start = *cursor;
+    char *ptr;
+    int depth = 0;
+
+    if (start == NULL)
+        return (NULL);
+    for (ptr = start; *ptr != 0; ptr++)
+    {
+        if (*ptr == '(')
+            depth++;
+        else if (*ptr == ')' && depth > 0)
+            depth--;
+        else if (*ptr == ',' && depth == 0)
+        {
+            *ptr = 0;
+            *cursor = ptr + 1;
+            return (start);
+        }
+    }
+    *cursor = NULL;
+    return (start);
+}
+
 static int makecolumns(
     scmtab *outtab)
 {
+    char *cursor;
     char *ptr;
     char *dp;
     int rcnt = 0;
@@ -149,13 +183,14 @@ static int makecolumns(
     dp = strdup(outtab->tstr);
     if (dp == NULL)
         return (-2);
-    ptr = strtok(dp, ",");
+    cursor = dp;
+    ptr = nextcoldef(&cursor);
     while (ptr != NULL && ptr[0] != 0)
     {
         if (islower((int)(unsigned char)(ptr[0]))
             && !isspace((int)(unsigned char)(ptr[0])))
             cnt++;
-        ptr = strtok(NULL, ",");
+        ptr = nextcoldef(&cursor);
     }
     free(dp);
     outtab->cols = (char **)calloc(cnt, sizeof(char *));
@@ -164,7 +199,8 @@ static int makecolumns(
     dp = strdup(outtab->tstr);
     if (dp == NULL)
         return (-4);
-    ptr = strtok(dp, ",");
+    cursor = dp;
+    ptr = nextcoldef(&cursor);
     while (ptr != NULL && ptr[0] != 0 && rcnt < cnt)
     {
         if (!islower((int)(unsigned char)(ptr[0]))
@@ -177,7 +213,7 @@ static int makecolumns(
             return (-rcnt - 5);
         }
         rcnt++;
-        ptr = strtok(NULL, ",");
+        ptr = nextcoldef(&cursor);
     }
     free(dp);
     outtab->ncols = rcnt;
@@ -0,0 +1,411 @@
+#include "loadqueue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "diru.h"
+#include "sqhl.h"
+#include "casn/casn.h"
+#include "rpki-asn1/cms.h"
+#include "rpki-asn1/crlv2.h"
+#include "rpki-object/certificate.h"
+#include "util/logging.h"
+
+/** Maximum length of a key identifier that is used for ordering */
+#define KEYID_MAX 64
+
+enum entry_state {
+    ENTRY_PENDING,
+    ENTRY_VISITING,
+    ENTRY_DONE,
+};
+
+struct keyid {
+    int len;                    /**< 0 if unknown */
+    unsigned char val[KEYID_MAX];
+};
+
+struct load_entry {
+    char op;
+    enum entry_state state;
+    /** outfull and outdir share one allocation, owned by outfull */
+    char *outdir;
+    char *outfile;              /**< points into outfull */
+    char *outfull;
+    struct keyid ski;           /**< only set for certificates */
+    struct keyid aki;
+    /** decoded certificate handed to the callback, or NULL */
+    struct Certificate *cert;
+};
+
+struct load_queue {
+    load_queue_func *fn;
+    void *ctx;
+    size_t max_pending;
+    size_t len;
+    struct load_entry *entries;
+    /** number of pending entries that hold a decoded certificate */
+    size_t ncert;
+    /** indexes of the entries with an SKI, sorted by SKI */
+    size_t *by_ski;
+    size_t nski;
+    /** number of entries released ahead of their arrival order */
+    size_t hoisted;
+};
+
+static void
+read_keyid(
+    struct casn *casnp,
+    struct keyid *out)
+{
+    int len = vsize_casn(casnp);
+
+    out->len = 0;
+    if (len <= 0 || len > KEYID_MAX)
+        return;
+    if (read_casn(casnp, out->val) != len)
+        return;
+    out->len = len;
+}
+
+static void
+cert_keyids(
+    struct Certificate *certp,
+    struct keyid *ski,
+    struct keyid *aki)
+{
+    struct Extension *extp;
+
+    if (ski != NULL &&
+        (extp = find_extension(&certp->toBeSigned.extensions,
+                               id_subjectKeyIdentifier, false)) != NULL)
+        read_keyid(&extp->extnValue.subjectKeyIdentifier, ski);
+    if ((extp = find_extension(&certp->toBeSigned.extensions,
+                               id_authKeyId, false)) != NULL)
+        read_keyid(&extp->extnValue.authKeyId.keyIdentifier, aki);
+}
+
+static void
+free_cert(
+    struct Certificate *certp)
+{
+    if (certp == NULL)
+        return;
+    delete_casn(&certp->self);
+    free(certp);
+}
+
+/**
+ * @brief
+ *     Read the key identifiers that determine where an object goes in
+ *     the issuer-first order.
+ *
+ * A certificate stays decoded in @p e, for the loader, while the
+ * queue holds fewer than LOAD_QUEUE_MAX_DECODED of them.
+ *
+ * Objects that cannot be parsed simply get no key identifiers; the
+ * loader will report them when it gets to them.
+ */
+static void
+read_keyids(
+    struct load_queue *q,
+    struct load_entry *e)
+{
+    switch (infer_filetype(e->outfull))
+    {
+    case OT_CER:
+        {
+            struct Certificate *certp = malloc(sizeof(*certp));
+            if (certp == NULL)
+                break;
+            Certificate(certp, (ushort)0);
+            if (get_casn_file(&certp->self, e->outfull, 0) < 0)
+            {
+                free_cert(certp);
+                break;
+            }
+            cert_keyids(certp, &e->ski, &e->aki);
+            if (q->ncert < LOAD_QUEUE_MAX_DECODED)
+            {
+                e->cert = certp;
+                q->ncert++;
+            }
+            else
+                free_cert(certp);
+        }
+        break;
+    case OT_CRL:
+        {
+            struct CertificateRevocationList crl;
+            struct CRLExtension *extp;
+            CertificateRevocationList(&crl, (ushort)0);
+            if (get_casn_file(&crl.self, e->outfull, 0) >= 0)
+            {
+                for (extp = (struct CRLExtension *)
+                     member_casn(&crl.toBeSigned.extensions.self, 0);
+                     extp != NULL;
+                     extp = (struct CRLExtension *)next_of(&extp->self))
+                {
+                    if (!diff_objid(&extp->extnID, id_authKeyId))
+                    {
+                        read_keyid(&extp->extnValue.authKeyId.keyIdentifier,
+                                   &e->aki);
+                        break;
+                    }
+                }
+            }
+            delete_casn(&crl.self);
+        }
+        break;
+    case OT_ROA:
+    case OT_MAN:
+    case OT_GBR:
+        {
+            struct CMS cms;
+            CMS(&cms, (ushort)0);
+            if (get_casn_file(&cms.self, e->outfull, 0) >= 0)
+                cert_keyids(&cms.content.signedData.certificates.certificate,
+                            NULL, &e->aki);
+            delete_casn(&cms.self);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+free_entry(
+    struct load_entry *e)
+{
+    free(e->outfull);
+    free_cert(e->cert);
+}
+
+static int
+cmp_keyid(
+    const struct keyid *a,
+    const struct keyid *b)
+{
+    if (a->len != b->len)
+        return a->len < b->len ? -1 : 1;
+    return memcmp(a->val, b->val, a->len);
+}
+
+/*
+ * qsort() has no context argument, so the entries being sorted are
+ * passed through this variable.
+ */
+static const struct load_entry *sort_entries;
+
+static int
+cmp_by_ski(
+    const void *a,
+    const void *b)
+{
+    return cmp_keyid(&sort_entries[*(const size_t *)a].ski,
+                     &sort_entries[*(const size_t *)b].ski);
+}
+
+/**
+ * @brief
+ *     Find a pending certificate whose SKI is @p aki.
+ *
+ * @return
+ *     The entry's index, or @c q->len if there is none.
+ */
+static size_t
+find_issuer(
+    const struct load_queue *q,
+    const struct keyid *aki)
+{
+    size_t lo = 0;
+    size_t hi = q->nski;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = cmp_keyid(&q->entries[q->by_ski[mid]].ski, aki);
+        if (c == 0)
+            return q->by_ski[mid];
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return q->len;
+}
+
+/**
+ * @brief
+ *     Perform entry @p i, after first performing its issuer if that
+ *     is also pending.
+ *
+ * The VISITING state guards against AKI/SKI cycles, so the recursion
+ * depth is bounded by the number of pending entries.
+ */
+static void
+release(
+    struct load_queue *q,
+    size_t i,
+    size_t first)
+{
+    struct load_entry *e = &q->entries[i];
+    size_t parent;
+
+    if (e->state != ENTRY_PENDING)
+        return;
+    e->state = ENTRY_VISITING;
+    if (e->aki.len > 0)
+    {
+        parent = find_issuer(q, &e->aki);
+        if (parent < q->len && parent != i)
+            release(q, parent, first);
+    }
+    if (i != first)
+        q->hoisted++;
+    (void)(*q->fn)(q->ctx, e->op, e->outdir, e->outfile, e->outfull,
+                   e->cert);
+    e->state = ENTRY_DONE;
+    // the loader is done with it, so don't hold it until the flush ends
+    if (e->cert != NULL)
+    {
+        free_cert(e->cert);
+        e->cert = NULL;
+        q->ncert--;
+    }
+}
+
+struct load_queue *
+load_queue_new(
+    size_t max_pending,
+    load_queue_func *fn,
+    void *ctx)
+{
+    struct load_queue *q;
+
+    if (max_pending == 0)
+        max_pending = 1;
+    q = calloc(1, sizeof(*q));
+    if (q == NULL)
+        return NULL;
+    q->entries = calloc(max_pending, sizeof(*q->entries));
+    q->by_ski = calloc(max_pending, sizeof(*q->by_ski));
+    if (q->entries == NULL || q->by_ski == NULL)
+    {
+        free(q->entries);
+        free(q->by_ski);
+        free(q);
+        return NULL;
+    }
+    q->fn = fn;
+    q->ctx = ctx;
+    q->max_pending = max_pending;
+    return q;
+}
+
+void
+load_queue_free(
+    struct load_queue *q)
+{
+    size_t i;
+
+    if (q == NULL)
+        return;
+    for (i = 0; i < q->len; i++)
+        free_entry(&q->entries[i]);
+    free(q->entries);
+    free(q->by_ski);
+    free(q);
+}
+
+void
+load_queue_flush(
+    struct load_queue *q)
+{
+    size_t i;
+
+    if (q->len == 0)
+        return;
+    q->nski = 0;
+    for (i = 0; i < q->len; i++)
+    {
+        if (q->entries[i].ski.len > 0)
+            q->by_ski[q->nski++] = i;
+    }
+    sort_entries = q->entries;
+    qsort(q->by_ski, q->nski, sizeof(*q->by_ski), &cmp_by_ski);
+    sort_entries = NULL;
+
+    q->hoisted = 0;
+    for (i = 0; i < q->len; i++)
+        release(q, i, i);
+    LOG(LOG_DEBUG, "released %zu queued objects, %zu ahead of arrival order",
+        q->len, q->hoisted);
+
+    for (i = 0; i < q->len; i++)
+        free_entry(&q->entries[i]);
+    q->len = 0;
+    q->nski = 0;
+    q->ncert = 0;
+}
+
+err_code
+load_queue_push(
+    struct load_queue *q,
+    char op,
+    char *dirprefix,
+    char *value)
+{
+    struct load_entry e;
+    struct split_path sp;
+    size_t fulllen;
+    size_t dirlen;
+    size_t i;
+    err_code sta;
+
+    memset(&e, 0, sizeof(e));
+    e.op = op;
+    e.state = ENTRY_PENDING;
+    sta = splitdf_r(dirprefix, NULL, value, &sp);
+    if (sta != 0)
+    {
+        LOG(LOG_ERR, "Error loading file %s/%s: %s (%s)",
+            dirprefix, value, err2string(sta), err2name(sta));
+        return sta;
+    }
+    fulllen = strlen(sp.full);
+    dirlen = sp.file - sp.full - 1;
+    e.outfull = malloc(fulllen + 1 + dirlen + 1);
+    if (e.outfull == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return ERR_SCM_NOMEM;
+    }
+    memcpy(e.outfull, sp.full, fulllen + 1);
+    e.outfile = e.outfull + dirlen + 1;
+    e.outdir = e.outfull + fulllen + 1;
+    memcpy(e.outdir, sp.dir, dirlen);
+    e.outdir[dirlen] = '\0';
+
+    if (op == 'r')
+    {
+        for (i = 0; i < q->len; i++)
+        {
+            if (strcmp(q->entries[i].outfull, e.outfull) == 0)
+            {
+                load_queue_flush(q);
+                break;
+            }
+        }
+        (void)(*q->fn)(q->ctx, op, e.outdir, e.outfile, e.outfull, NULL);
+        free_entry(&e);
+        return 0;
+    }
+
+    read_keyids(q, &e);
+    q->entries[q->len++] = e;
+    if (q->len >= q->max_pending)
+        load_queue_flush(q);
+    return 0;
+}
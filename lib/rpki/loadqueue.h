@@ -0,0 +1,128 @@
+#ifndef LIB_RPKI_LOADQUEUE_H
+#define LIB_RPKI_LOADQUEUE_H
+
+/**
+ * @file
+ *
+ * @brief
+ *     Parent-first scheduling of objects handed to the loader
+ *
+ * Objects arrive at the loader in whatever order the fetcher reports
+ * them.  A child that arrives before its issuer is first stored as
+ * not valid and has to be revalidated by verifyOrNotChildren() once
+ * the issuer shows up, which more than doubles the work done for it.
+ *
+ * A load queue buffers add and update requests, reads the SKI and
+ * AKI of each buffered object, and releases them so that every
+ * certificate in the batch is loaded before the objects it issued.
+ * Objects whose issuer is not in the batch keep their arrival order.
+ * At most @c max_pending objects are buffered; when the queue fills
+ * up it is flushed, which bounds how long an object whose issuer
+ * never arrives can be deferred.
+ *
+ * Certificates are decoded once, when they are queued, and the
+ * decoded certificate is handed to the operation so the loader
+ * doesn't parse the file again.  A decoded certificate is large, so
+ * only the first LOAD_QUEUE_MAX_DECODED pending certificates are kept
+ * decoded; the rest are decoded again by the loader.
+ */
+
+#include <stddef.h>
+
+#include "err.h"
+
+struct Certificate;
+
+/** Maximum number of decoded certificates a queue keeps at once */
+#define LOAD_QUEUE_MAX_DECODED 256
+
+/**
+ * @brief
+ *     Function that performs a queued operation.
+ *
+ * @param[in] op
+ *     'a' (add), 'u' (update), or 'r' (remove).
+ * @param[in] outdir
+ *     Directory containing the object (as returned by splitdf()).
+ * @param[in] outfile
+ *     Filename of the object (as returned by splitdf()).
+ * @param[in] outfull
+ *     Full path to the object (as returned by splitdf()).
+ * @param[in] certp
+ *     The decoded certificate if the object is a certificate that the
+ *     queue has already decoded, otherwise NULL.  It is owned by the
+ *     queue and freed after the call.
+ */
+typedef err_code
+load_queue_func(
+    void *ctx,
+    char op,
+    char *outdir,
+    char *outfile,
+    char *outfull,
+    struct Certificate *certp);
+
+struct load_queue;
+
+/**
+ * @brief
+ *     Create an empty load queue.
+ *
+ * @param[in] max_pending
+ *     Maximum number of objects to buffer before flushing.
+ * @param[in] fn
+ *     Function called to perform each operation.
+ * @param[in] ctx
+ *     Passed unchanged to @p fn.
+ *
+ * @return
+ *     The new queue, or NULL if out of memory.
+ */
+struct load_queue *
+load_queue_new(
+    size_t max_pending,
+    load_queue_func *fn,
+    void *ctx);
+
+/**
+ * @brief
+ *     Free a load queue.  Pending operations are discarded, so call
+ *     load_queue_flush() first.
+ */
+void
+load_queue_free(
+    struct load_queue *q);
+
+/**
+ * @brief
+ *     Queue an operation on an object.
+ *
+ * Adds and updates are buffered.  Removals are performed right away
+ * (after flushing the queue if the object being removed is itself
+ * pending) since they never depend on another object.
+ *
+ * @param[in] dirprefix
+ *     Directory to resolve @p value against (may be NULL).
+ * @param[in] value
+ *     Path to the object.
+ *
+ * @return
+ *     0 on success or a negative error code.  Errors from the
+ *     operations themselves are reported by the callback, not here.
+ */
+err_code
+load_queue_push(
+    struct load_queue *q,
+    char op,
+    char *dirprefix,
+    char *value);
+
+/**
+ * @brief
+ *     Perform all buffered operations, issuers first.
+ */
+void
+load_queue_flush(
+    struct load_queue *q);
+
+#endif
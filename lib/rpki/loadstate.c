@@ -0,0 +1,586 @@
+#include "loadstate.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/logging.h"
+
+/*
+ * Snapshot format.  All integers are big-endian.
+ *
+ *   magic          8 bytes  LOADSTATE_MAGIC
+ *   version        4 bytes  LOADSTATE_VERSION
+ *   generation     8 bytes
+ *   dbid length    4 bytes
+ *   dbid           dbid length bytes
+ *   section count  4 bytes
+ *   sections:
+ *     type         4 bytes  enum loadstate_section
+ *     length       4 bytes
+ *     payload      length bytes
+ *   crc            4 bytes  CRC-32 of everything above
+ *
+ * Directory section payload:
+ *
+ *   count          4 bytes
+ *   entries:
+ *     dir_id       4 bytes
+ *     name length  4 bytes
+ *     name         name length bytes, not NUL-terminated
+ */
+
+#define LOADSTATE_MAGIC "RPSTLDST"
+#define LOADSTATE_MAGIC_LEN 8
+#define LOADSTATE_VERSION 1
+
+enum loadstate_section {
+    LOADSTATE_SECTION_DIRS = 1,
+};
+
+/*
+ * Directory name to id map: open addressing with linear probing,
+ * kept at most half full.
+ */
+
+struct dir_entry {
+    char *name;                 /* NULL if the slot is empty */
+    uint64_t hash;
+    unsigned int id;
+};
+
+static struct dir_entry *dirs = NULL;
+static size_t dirs_cap = 0;     /* always 0 or a power of 2 */
+static size_t dirs_len = 0;
+
+static uint64_t
+hash_name(
+    const char *name,
+    size_t len)
+{
+    // FNV-1a
+    uint64_t h = UINT64_C(14695981039346656037);
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)name[i];
+        h *= UINT64_C(1099511628211);
+    }
+    return h;
+}
+
+static struct dir_entry *
+dir_slot(
+    struct dir_entry *table,
+    size_t cap,
+    const char *name,
+    uint64_t hash)
+{
+    size_t i = (size_t)hash & (cap - 1);
+
+    while (table[i].name != NULL &&
+           (table[i].hash != hash || strcmp(table[i].name, name) != 0))
+        i = (i + 1) & (cap - 1);
+    return &table[i];
+}
+
+static bool
+dir_grow(
+    void)
+{
+    size_t cap = dirs_cap ? 2 * dirs_cap : 1024;
+    struct dir_entry *table = calloc(cap, sizeof(*table));
+    size_t i;
+
+    if (table == NULL)
+        return false;
+    for (i = 0; i < dirs_cap; i++)
+    {
+        if (dirs[i].name != NULL)
+            *dir_slot(table, cap, dirs[i].name, dirs[i].hash) = dirs[i];
+    }
+    free(dirs);
+    dirs = table;
+    dirs_cap = cap;
+    return true;
+}
+
+bool
+loadstate_dir_get(
+    const char *dirname,
+    unsigned int *idp)
+{
+    struct dir_entry *e;
+
+    if (dirs_len == 0)
+        return false;
+    e = dir_slot(dirs, dirs_cap, dirname,
+                 hash_name(dirname, strlen(dirname)));
+    if (e->name == NULL)
+        return false;
+    *idp = e->id;
+    return true;
+}
+
+/*
+ * Add or replace an entry, taking ownership of name.
+ */
+static err_code
+dir_put_owned(
+    char *name,
+    size_t len,
+    unsigned int id)
+{
+    uint64_t hash = hash_name(name, len);
+    struct dir_entry *e;
+
+    if (2 * (dirs_len + 1) > dirs_cap && !dir_grow())
+    {
+        free(name);
+        return ERR_SCM_NOMEM;
+    }
+    e = dir_slot(dirs, dirs_cap, name, hash);
+    if (e->name != NULL)
+    {
+        free(name);
+        e->id = id;
+        return 0;
+    }
+    e->name = name;
+    e->hash = hash;
+    e->id = id;
+    dirs_len++;
+    return 0;
+}
+
+err_code
+loadstate_dir_put(
+    const char *dirname,
+    unsigned int id)
+{
+    size_t len = strlen(dirname);
+    char *name = malloc(len + 1);
+
+    if (name == NULL)
+        return ERR_SCM_NOMEM;
+    memcpy(name, dirname, len + 1);
+    return dir_put_owned(name, len, id);
+}
+
+size_t
+loadstate_dir_count(
+    void)
+{
+    return dirs_len;
+}
+
+void
+loadstate_clear(
+    void)
+{
+    size_t i;
+
+    for (i = 0; i < dirs_cap; i++)
+        free(dirs[i].name);
+    free(dirs);
+    dirs = NULL;
+    dirs_cap = 0;
+    dirs_len = 0;
+}
+
+static uint32_t
+crc32(
+    const unsigned char *buf,
+    size_t len)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+    uint32_t crc = 0xffffffff;
+    size_t i;
+
+    if (!table_ready)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            uint32_t c = (uint32_t)i;
+            int k;
+
+            for (k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        table_ready = true;
+    }
+    for (i = 0; i < len; i++)
+        crc = table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+}
+
+/*
+ * Growable output buffer.  Once an allocation fails the buffer stays
+ * failed and further writes are ignored.
+ */
+struct outbuf {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+};
+
+static void
+put_bytes(
+    struct outbuf *out,
+    const void *data,
+    size_t len)
+{
+    if (out->failed)
+        return;
+    if (out->cap - out->len < len)
+    {
+        size_t cap = out->cap ? out->cap : 65536;
+        unsigned char *p;
+
+        while (cap - out->len < len)
+            cap *= 2;
+        p = realloc(out->data, cap);
+        if (p == NULL)
+        {
+            out->failed = true;
+            return;
+        }
+        out->data = p;
+        out->cap = cap;
+    }
+    memcpy(&out->data[out->len], data, len);
+    out->len += len;
+}
+
+static void
+put_u32(
+    struct outbuf *out,
+    uint32_t v)
+{
+    unsigned char b[4] = {v >> 24, v >> 16, v >> 8, v};
+
+    put_bytes(out, b, sizeof(b));
+}
+
+static void
+put_u64(
+    struct outbuf *out,
+    uint64_t v)
+{
+    put_u32(out, (uint32_t)(v >> 32));
+    put_u32(out, (uint32_t)v);
+}
+
+static void
+put_dirs(
+    struct outbuf *out)
+{
+    size_t start;
+    size_t i;
+
+    put_u32(out, LOADSTATE_SECTION_DIRS);
+    start = out->len;
+    put_u32(out, 0);            // length, filled in below
+    put_u32(out, (uint32_t)dirs_len);
+    for (i = 0; i < dirs_cap; i++)
+    {
+        size_t len;
+
+        if (dirs[i].name == NULL)
+            continue;
+        len = strlen(dirs[i].name);
+        put_u32(out, dirs[i].id);
+        put_u32(out, (uint32_t)len);
+        put_bytes(out, dirs[i].name, len);
+    }
+    if (!out->failed)
+    {
+        uint32_t len = (uint32_t)(out->len - start - 4);
+        unsigned char *p = &out->data[start];
+
+        p[0] = len >> 24;
+        p[1] = len >> 16;
+        p[2] = len >> 8;
+        p[3] = len;
+    }
+}
+
+int
+loadstate_save(
+    const char *path,
+    const char *dbid,
+    uint64_t generation)
+{
+    struct outbuf out = {NULL, 0, 0, false};
+    size_t len = strlen(path);
+    char *tmp = NULL;
+    FILE *fp = NULL;
+    int ret = -1;
+    int saved_errno;
+
+    put_bytes(&out, LOADSTATE_MAGIC, LOADSTATE_MAGIC_LEN);
+    put_u32(&out, LOADSTATE_VERSION);
+    put_u64(&out, generation);
+    put_u32(&out, (uint32_t)strlen(dbid));
+    put_bytes(&out, dbid, strlen(dbid));
+    put_u32(&out, 1);           // number of sections
+    put_dirs(&out);
+    if (!out.failed)
+        put_u32(&out, crc32(out.data, out.len));
+    if (out.failed)
+    {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    tmp = malloc(len + sizeof(".tmp"));
+    if (tmp == NULL)
+        goto done;
+    memcpy(tmp, path, len);
+    memcpy(&tmp[len], ".tmp", sizeof(".tmp"));
+    fp = fopen(tmp, "w");
+    if (fp == NULL)
+        goto done;
+    if (fwrite(out.data, 1, out.len, fp) != out.len)
+    {
+        saved_errno = errno;
+        fclose(fp);
+        unlink(tmp);
+        errno = saved_errno;
+        goto done;
+    }
+    if (fclose(fp) != 0 || rename(tmp, path) != 0)
+    {
+        saved_errno = errno;
+        unlink(tmp);
+        errno = saved_errno;
+        goto done;
+    }
+    ret = 0;
+
+done:
+    saved_errno = errno;
+    free(tmp);
+    free(out.data);
+    errno = saved_errno;
+    return ret;
+}
+
+/*
+ * Bounds-checked reader over a snapshot in memory
+ */
+struct inbuf {
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+};
+
+static bool
+get_bytes(
+    struct inbuf *in,
+    const unsigned char **p,
+    size_t len)
+{
+    if (in->len - in->pos < len)
+        return false;
+    *p = &in->data[in->pos];
+    in->pos += len;
+    return true;
+}
+
+static bool
+get_u32(
+    struct inbuf *in,
+    uint32_t *v)
+{
+    const unsigned char *p;
+
+    if (!get_bytes(in, &p, 4))
+        return false;
+    *v = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+        ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    return true;
+}
+
+static bool
+get_u64(
+    struct inbuf *in,
+    uint64_t *v)
+{
+    uint32_t hi;
+    uint32_t lo;
+
+    if (!get_u32(in, &hi) || !get_u32(in, &lo))
+        return false;
+    *v = ((uint64_t)hi << 32) | lo;
+    return true;
+}
+
+static err_code
+get_dirs(
+    struct inbuf *in)
+{
+    const unsigned char *name;
+    uint32_t count;
+    uint32_t id;
+    uint32_t len;
+    uint32_t i;
+    char *copy;
+    err_code sta;
+
+    if (!get_u32(in, &count))
+        return ERR_SCM_NODATA;
+    for (i = 0; i < count; i++)
+    {
+        if (!get_u32(in, &id) || !get_u32(in, &len) ||
+            !get_bytes(in, &name, len) || len == 0 ||
+            memchr(name, '\0', len) != NULL)
+            return ERR_SCM_NODATA;
+        copy = malloc((size_t)len + 1);
+        if (copy == NULL)
+            return ERR_SCM_NOMEM;
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+        if ((sta = dir_put_owned(copy, len, id)) < 0)
+            return sta;
+    }
+    return (in->pos == in->len) ? 0 : ERR_SCM_NODATA;
+}
+
+static unsigned char *
+read_file(
+    const char *path,
+    size_t *lenp)
+{
+    FILE *fp;
+    unsigned char *data = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t n;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return NULL;
+    for (;;)
+    {
+        if (cap - len < 65536)
+        {
+            unsigned char *p = realloc(data, cap ? 2 * cap : 65536);
+
+            if (p == NULL)
+            {
+                free(data);
+                fclose(fp);
+                return NULL;
+            }
+            data = p;
+            cap = cap ? 2 * cap : 65536;
+        }
+        n = fread(&data[len], 1, cap - len, fp);
+        len += n;
+        if (n == 0)
+            break;
+    }
+    if (ferror(fp))
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *lenp = len;
+    return data;
+}
+
+err_code
+loadstate_load(
+    const char *path,
+    const char *dbid,
+    uint64_t generation)
+{
+    struct inbuf in = {NULL, 0, 0};
+    struct inbuf sec;
+    unsigned char *data;
+    const unsigned char *p;
+    size_t len;
+    uint32_t crc;
+    uint32_t version;
+    uint64_t snap_generation;
+    uint32_t n;
+    uint32_t nsections;
+    uint32_t type;
+    err_code sta = ERR_SCM_NODATA;
+
+    loadstate_clear();
+    data = read_file(path, &len);
+    if (data == NULL)
+    {
+        if (errno != ENOENT)
+            LOG(LOG_WARNING, "Could not read loader state %s: %s", path,
+                strerror(errno));
+        return ERR_SCM_NODATA;
+    }
+    in.data = data;
+    in.len = len;
+    in.pos = len - 4;
+    if (len < 4 || !get_u32(&in, &crc) || crc != crc32(data, len - 4))
+    {
+        LOG(LOG_WARNING, "Loader state %s is corrupt", path);
+        goto done;
+    }
+    in.len = len - 4;
+    in.pos = 0;
+    if (!get_bytes(&in, &p, LOADSTATE_MAGIC_LEN) ||
+        memcmp(p, LOADSTATE_MAGIC, LOADSTATE_MAGIC_LEN) != 0 ||
+        !get_u32(&in, &version) || version != LOADSTATE_VERSION)
+    {
+        LOG(LOG_WARNING, "Loader state %s has an unknown format", path);
+        goto done;
+    }
+    if (!get_u64(&in, &snap_generation) || !get_u32(&in, &n) ||
+        !get_bytes(&in, &p, n))
+        goto done;
+    if (snap_generation != generation || n != strlen(dbid) ||
+        memcmp(p, dbid, n) != 0)
+    {
+        LOG(LOG_INFO, "Loader state %s is out of date", path);
+        goto done;
+    }
+    if (!get_u32(&in, &nsections))
+        goto done;
+    for (; nsections > 0; nsections--)
+    {
+        if (!get_u32(&in, &type) || !get_u32(&in, &n) ||
+            !get_bytes(&in, &p, n))
+        {
+            sta = ERR_SCM_NODATA;
+            goto done;
+        }
+        sec.data = p;
+        sec.len = n;
+        sec.pos = 0;
+        switch (type)
+        {
+        case LOADSTATE_SECTION_DIRS:
+            sta = get_dirs(&sec);
+            break;
+        default:
+            sta = 0;            // written by a newer loader; ignore it
+            break;
+        }
+        if (sta < 0)
+            goto done;
+    }
+    sta = (in.pos == in.len) ? 0 : ERR_SCM_NODATA;
+
+done:
+    free(data);
+    if (sta < 0)
+        loadstate_clear();
+    return sta;
+}
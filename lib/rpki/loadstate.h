@@ -0,0 +1,110 @@
+#ifndef LIB_RPKI_LOADSTATE_H
+#define LIB_RPKI_LOADSTATE_H
+
+/**
+ * @file
+ *
+ * @brief
+ *     In-memory loader state and its warm-restart snapshot
+ *
+ * The loader keeps facts derived from the database in memory so that
+ * it does not have to ask the database for them again.  The state
+ * can be checkpointed to a snapshot file and reloaded by the next
+ * loader, which then starts warm instead of cold.
+ *
+ * A snapshot is only trusted if it was written against the same
+ * database at the same generation.  The generation is a counter in
+ * the metadata table that every writer increments before it starts
+ * changing the database (see bump_db_generation()), so a snapshot
+ * written before any later change, or by a loader that died before
+ * it could checkpoint, is never reloaded.
+ *
+ * The snapshot is made of an identifying header, a sequence of
+ * typed sections, and a trailing CRC-32 of everything before it.
+ * Unknown section types are skipped so that sections can be added
+ * without bumping the format version.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "err.h"
+
+/**
+ * @brief
+ *     Look up the id of a directory.
+ *
+ * @return
+ *     true and the id in @p idp if the directory is known, false
+ *     otherwise
+ */
+bool loadstate_dir_get(
+    const char *dirname,
+    unsigned int *idp);
+
+/**
+ * @brief
+ *     Remember the id of a directory.
+ *
+ * Directory ids are never reused or removed from the database, so
+ * an entry stays correct for the life of the database.
+ *
+ * @return
+ *     0 on success, ERR_SCM_NOMEM if out of memory
+ */
+err_code loadstate_dir_put(
+    const char *dirname,
+    unsigned int id);
+
+/**
+ * @brief
+ *     Number of directories known.
+ */
+size_t loadstate_dir_count(
+    void);
+
+/**
+ * @brief
+ *     Forget all state.
+ */
+void loadstate_clear(
+    void);
+
+/**
+ * @brief
+ *     Atomically replace @p path with a snapshot of the current
+ *     state.
+ *
+ * @param[in] dbid
+ *     String identifying the database instance (e.g. its creation
+ *     time), so that a snapshot of a dropped and re-created database
+ *     is not mistaken for one of the current database.
+ * @param[in] generation
+ *     Current database generation.
+ * @return
+ *     0 on success, -1 on error (with errno set).
+ */
+int loadstate_save(
+    const char *path,
+    const char *dbid,
+    uint64_t generation);
+
+/**
+ * @brief
+ *     Replace the current state with the contents of a snapshot.
+ *
+ * The snapshot is rejected, leaving the state empty, if it is
+ * missing, corrupt, of an unknown version, or was not written for
+ * @p dbid at @p generation.
+ *
+ * @return
+ *     0 if the snapshot was loaded, ERR_SCM_NODATA if it was
+ *     rejected, or ERR_SCM_NOMEM.
+ */
+err_code loadstate_load(
+    const char *path,
+    const char *dbid,
+    uint64_t generation);
+
+#endif
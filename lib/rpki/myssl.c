@@ -13,6 +13,7 @@
 #include <getopt.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 #include <util/cryptlib_compat.h>
 #include <stdbool.h>
 
@@ -3894,12 +3895,17 @@ rescert_subj_iss_UID_chk(
 }
 
 
-/**
-    @brief Check for unknown extensions.
-*/
-static err_code
-rescert_extensions_chk(
-    struct Certificate *certp)
+/*
+ * Extensions allowed in a resource certificate, looked up by
+ * rescert_extensions_chk().  The table is built once, by whichever
+ * thread gets there first.
+ */
+static struct objid_table allowed_extensions_table;
+static pthread_once_t allowed_extensions_once = PTHREAD_ONCE_INIT;
+
+static void
+allowed_extensions_init(
+    void)
 {
     static char const *const allowed_extensions[] = {
         id_basicConstraints,
@@ -3913,33 +3919,40 @@ rescert_extensions_chk(
         id_certificatePolicies,
         id_pe_ipAddrBlock,
         id_pe_autonomousSysNum,
-        NULL
     };
 
+    (void)objid_table_init(&allowed_extensions_table, allowed_extensions,
+                           sizeof(allowed_extensions) /
+                           sizeof(allowed_extensions[0]));
+}
+
+/**
+    @brief Check for unknown extensions.
+*/
+static err_code
+rescert_extensions_chk(
+    struct Certificate *certp)
+{
     // to prevent memory overflows
     static const int max_oid_print_length = 50;
 
     struct Extension *extp = NULL;
-    bool ext_allowed;
-    size_t i;
+
+    if (pthread_once(&allowed_extensions_once,
+                     &allowed_extensions_init) != 0 ||
+        allowed_extensions_table.size == 0)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return ERR_SCM_NOMEM;
+    }
 
     for (extp =
          (struct Extension *)member_casn(&certp->toBeSigned.extensions.self,
                                          0); extp != NULL;
          extp = (struct Extension *)next_of(&extp->self))
     {
-        ext_allowed = false;
-        for (i = 0; allowed_extensions[i] != NULL; ++i)
-        {
-            /** @bug error code ignored without explanation */
-            if (!diff_objid(&extp->extnID, allowed_extensions[i]))
-            {
-                ext_allowed = true;
-                break;
-            }
-        }
-
-        if (!ext_allowed)
+        /** @bug error code ignored without explanation */
+        if (objid_table_find(&allowed_extensions_table, &extp->extnID) < 0)
         {
             int oid_size = vsize_objid(&extp->extnID);
             char oid_print[max_oid_print_length + 1];
@@ -0,0 +1,234 @@
+#include "perf.h"
+#include "sqhl.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PERF_NUM_TYPES OT_MAXBASIC_PLUS_ONE
+
+struct perf_counter {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t hist[PERF_HIST_BUCKETS];
+};
+
+static struct perf_counter counters[PERF_NUM_STAGES][PERF_NUM_TYPES];
+
+static time_t last_write;
+
+static const char *const stage_names[PERF_NUM_STAGES] = {
+    [PERF_STAGE_ADD_OBJECT] = "add_object",
+    [PERF_STAGE_ADD_CERT] = "add_cert",
+    [PERF_STAGE_PROFILE_CHECK] = "profile_check",
+    [PERF_STAGE_VERIFY_CERT] = "verify_cert",
+    [PERF_STAGE_ADD_ROA] = "add_roa",
+    [PERF_STAGE_MANIFEST_OBJS] = "manifest_objs",
+    [PERF_STAGE_VERIFY_CHILDREN] = "verify_children",
+    [PERF_STAGE_SQL_EXECUTE] = "sql_execute",
+    [PERF_STAGE_SQL_FETCH] = "sql_fetch",
+};
+
+static const char *const type_names[PERF_NUM_TYPES] = {
+    [OT_UNKNOWN] = "-",
+    [OT_CER] = "cer",
+    [OT_CRL] = "crl",
+    [OT_ROA] = "roa",
+    [OT_MAN] = "man",
+    [OT_GBR] = "gbr",
+};
+
+static int
+normalize_type(
+    int objtype)
+{
+    if (objtype >= OT_PEM_OFFSET)
+        objtype -= OT_PEM_OFFSET;
+    if (objtype < 0 || objtype >= PERF_NUM_TYPES)
+        objtype = OT_UNKNOWN;
+    return objtype;
+}
+
+static unsigned int
+hist_bucket(
+    uint64_t ns)
+{
+    uint64_t usec = ns / 1000;
+    unsigned int b = 0;
+
+    while (usec != 0 && b < PERF_HIST_BUCKETS - 1)
+    {
+        usec >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/**
+ * @brief
+ *     Upper bound, in microseconds, of the latencies in histogram
+ *     bucket @p b.
+ */
+static uint64_t
+bucket_limit_us(
+    unsigned int b)
+{
+    return (uint64_t)1 << b;
+}
+
+/**
+ * @brief
+ *     Estimate a percentile from the histogram, returning the upper
+ *     bound of the bucket that contains it.
+ */
+static uint64_t
+percentile_us(
+    const struct perf_counter *c,
+    unsigned int pct)
+{
+    uint64_t target = (c->count * pct + 99) / 100;
+    uint64_t seen = 0;
+    unsigned int b;
+
+    for (b = 0; b < PERF_HIST_BUCKETS; b++)
+    {
+        seen += c->hist[b];
+        if (seen >= target)
+            return bucket_limit_us(b);
+    }
+    return bucket_limit_us(PERF_HIST_BUCKETS - 1);
+}
+
+void
+perf_start(
+    struct perf_timer *timer)
+{
+    clock_gettime(CLOCK_MONOTONIC, &timer->start);
+}
+
+void
+perf_stop(
+    const struct perf_timer *timer,
+    enum perf_stage stage,
+    int objtype)
+{
+    struct timespec now;
+    struct perf_counter *c;
+    int64_t ns;
+
+    if ((unsigned int)stage >= PERF_NUM_STAGES)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (int64_t)(now.tv_sec - timer->start.tv_sec) * 1000000000 +
+        (now.tv_nsec - timer->start.tv_nsec);
+    if (ns < 0)
+        ns = 0;
+
+    c = &counters[stage][normalize_type(objtype)];
+    c->count++;
+    c->total_ns += (uint64_t)ns;
+    if ((uint64_t)ns > c->max_ns)
+        c->max_ns = (uint64_t)ns;
+    c->hist[hist_bucket((uint64_t)ns)]++;
+}
+
+void
+perf_reset(
+    void)
+{
+    memset(counters, 0, sizeof(counters));
+}
+
+void
+perf_print(
+    FILE *out)
+{
+    int s;
+    int t;
+    unsigned int b;
+
+    fprintf(out, "# stage type count total_us mean_us max_us p50_us p99_us"
+            " hist(<us:count ...)\n");
+    for (s = 0; s < PERF_NUM_STAGES; s++)
+    {
+        for (t = 0; t < PERF_NUM_TYPES; t++)
+        {
+            const struct perf_counter *c = &counters[s][t];
+
+            if (c->count == 0)
+                continue;
+            fprintf(out, "%s %s %" PRIu64 " %" PRIu64 " %" PRIu64
+                    " %" PRIu64 " %" PRIu64 " %" PRIu64,
+                    stage_names[s], type_names[t], c->count,
+                    c->total_ns / 1000, c->total_ns / c->count / 1000,
+                    c->max_ns / 1000, percentile_us(c, 50),
+                    percentile_us(c, 99));
+            for (b = 0; b < PERF_HIST_BUCKETS; b++)
+            {
+                if (c->hist[b] != 0)
+                    fprintf(out, " <%" PRIu64 ":%" PRIu64,
+                            bucket_limit_us(b), c->hist[b]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
+
+int
+perf_write(
+    const char *path)
+{
+    size_t len = strlen(path);
+    char *tmp;
+    FILE *out;
+    int ret = -1;
+    int saved_errno;
+
+    tmp = malloc(len + sizeof(".tmp"));
+    if (tmp == NULL)
+        return -1;
+    memcpy(tmp, path, len);
+    memcpy(&tmp[len], ".tmp", sizeof(".tmp"));
+
+    out = fopen(tmp, "w");
+    if (out == NULL)
+        goto done;
+    perf_print(out);
+    if (fclose(out) != 0)
+    {
+        saved_errno = errno;
+        unlink(tmp);
+        errno = saved_errno;
+        goto done;
+    }
+    if (rename(tmp, path) != 0)
+    {
+        saved_errno = errno;
+        unlink(tmp);
+        errno = saved_errno;
+        goto done;
+    }
+    ret = 0;
+
+done:
+    saved_errno = errno;
+    free(tmp);
+    errno = saved_errno;
+    return ret;
+}
+
+int
+perf_write_periodic(
+    const char *path,
+    time_t interval)
+{
+    time_t now = time(NULL);
+
+    if (last_write != 0 && now - last_write < interval)
+        return 0;
+    last_write = now;
+    return perf_write(path);
+}
@@ -0,0 +1,121 @@
+#ifndef LIB_RPKI_PERF_H
+#define LIB_RPKI_PERF_H
+
+/**
+ * @file
+ *
+ * @brief
+ *     Always-on timing counters for the loader's processing stages
+ *
+ * Each stage is timed per object type.  For every (stage, type)
+ * pair the number of calls, the total and maximum latency, and a
+ * log2 histogram of latencies (in microseconds) are kept in memory.
+ * perf_write() renders the counters as text so that a long-running
+ * loader can periodically publish them to a file.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * @brief
+ *     Instrumented loader stages
+ */
+enum perf_stage {
+    PERF_STAGE_ADD_OBJECT,      /**< add_object() */
+    PERF_STAGE_ADD_CERT,        /**< add_cert_2() */
+    PERF_STAGE_PROFILE_CHECK,   /**< rescert_profile_chk() */
+    PERF_STAGE_VERIFY_CERT,     /**< verify_cert() */
+    PERF_STAGE_ADD_ROA,         /**< add_roa_internal() */
+    PERF_STAGE_MANIFEST_OBJS,   /**< updateManifestObjs() */
+    PERF_STAGE_VERIFY_CHILDREN, /**< verifyOrNotChildren() */
+    PERF_STAGE_SQL_EXECUTE,     /**< SQL round trips in statementscm() */
+    PERF_STAGE_SQL_FETCH,       /**< row fetches in searchscm() */
+    PERF_NUM_STAGES
+};
+
+/**
+ * @brief
+ *     Number of log2 microsecond histogram buckets
+ *
+ * Bucket @c i counts latencies in [2^(i-1), 2^i) microseconds;
+ * bucket 0 counts latencies under one microsecond and the last
+ * bucket absorbs everything longer.
+ */
+#define PERF_HIST_BUCKETS 32
+
+/**
+ * @brief
+ *     Start time of an in-progress measurement
+ */
+struct perf_timer {
+    struct timespec start;
+};
+
+/**
+ * @brief
+ *     Begin timing a stage.
+ */
+void perf_start(
+    struct perf_timer *timer);
+
+/**
+ * @brief
+ *     Finish timing a stage and record the elapsed time.
+ *
+ * @param[in] objtype
+ *     Object type (an @c object_type value; PEM variants are folded
+ *     into their DER counterparts).  Use @c OT_UNKNOWN for stages
+ *     not tied to an object type.
+ */
+void perf_stop(
+    const struct perf_timer *timer,
+    enum perf_stage stage,
+    int objtype);
+
+/**
+ * @brief
+ *     Discard all recorded measurements.
+ */
+void perf_reset(
+    void);
+
+/**
+ * @brief
+ *     Print the recorded measurements in text form.
+ *
+ * One line is printed per (stage, type) pair that has been
+ * observed, giving the call count, total/mean/max latency, the
+ * estimated median and 99th percentile, and the non-empty
+ * histogram buckets.
+ */
+void perf_print(
+    FILE *out);
+
+/**
+ * @brief
+ *     Atomically replace @p path with the current measurements.
+ *
+ * The output is written to a temporary file next to @p path which
+ * is then renamed over it, so readers never see a partial file.
+ *
+ * @return
+ *     0 on success, -1 on error (with errno set).
+ */
+int perf_write(
+    const char *path);
+
+/**
+ * @brief
+ *     Call perf_write() if at least @p interval seconds have passed
+ *     since the last write through this function.
+ *
+ * @return
+ *     0 if nothing needed to be written or the write succeeded, -1
+ *     on error.
+ */
+int perf_write_periodic(
+    const char *path,
+    time_t interval);
+
+#endif
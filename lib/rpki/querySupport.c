@@ -43,6 +43,24 @@ void addQueryFlagTests(
         addFlagTest(whereStr, SCM_FLAG_NOTYET, 0, 1);
 }
 
+int queryFlagsAccepted(
+    unsigned int flags)
+{
+    // NOTE: This must be kept in sync with addQueryFlagTests.
+
+    if (!(flags & SCM_FLAG_VALID))
+        return 0;
+    if (!CONFIG_RPKI_ALLOW_STALE_CRL_get() && (flags & SCM_FLAG_STALECRL))
+        return 0;
+    if (!CONFIG_RPKI_ALLOW_STALE_MANIFEST_get() && (flags & SCM_FLAG_STALEMAN))
+        return 0;
+    if (!CONFIG_RPKI_ALLOW_NO_MANIFEST_get() && !(flags & SCM_FLAG_ONMAN))
+        return 0;
+    if (!CONFIG_RPKI_ALLOW_NOT_YET_get() && (flags & SCM_FLAG_NOTYET))
+        return 0;
+    return 1;
+}
+
 
 /*
  * all these static variables are used for efficiency, so that
@@ -51,158 +69,117 @@ void addQueryFlagTests(
 static scmtab *roaPrefixTable = NULL;
 static scmtab *validTable = NULL;
 static scmsrcha *validSrch = NULL;
-char *validWhereStr;
-static char *whereInsertPtr;
-static int parentsFound;
-static char *nextSKI,
-   *nextSubject;
+static int validFound;
+static int validTrusted;
+static char validAKI[SKISIZE];
+static char validIssuer[SUBJSIZE];
 
 /**
  * @brief
- *     callback to indicate that a parent was found
+ *     callback to record a certificate found while walking a chain
  */
-static sqlvaluefunc registerParent;
+static sqlvaluefunc registerValid;
 err_code
-registerParent(
+registerValid(
     scmcon *conp,
     scmsrcha *s,
     ssize_t numLine)
 {
     UNREFERENCED_PARAMETER(conp);
-    UNREFERENCED_PARAMETER(s);
     UNREFERENCED_PARAMETER(numLine);
 
-    /* FIXME: nextSKI and nextSubject already point to
-     * s->vec[0].valptr and s->vec[1].valptr, so they are not updated
-     * here.  But when a column is NULL, avalsize = SQL_NULL_DATA
-     * (-1), and we should NOT be using the corresponding valptr.
-     * checkValidity() currently depends on valptr being zeroed out.
-     * This is Bad(TM).  Fix this on a rewrite of checkValidity. */
-
-    /* Count parent. */
-    parentsFound++;
+    validFound++;
+    if (*(unsigned int *)s->vec[2].valptr)
+        validTrusted = 1;
+    if (s->vec[0].avalsize == SQL_NULL_DATA)
+        validAKI[0] = 0;
+    else
+        xstrlcpy(validAKI, (char *)s->vec[0].valptr, sizeof(validAKI));
+    xstrlcpy(validIssuer, (char *)s->vec[1].valptr, sizeof(validIssuer));
     return 0;
 }
 
-/**
- * @brief set up main part of query
- *
- * Global variables are initialized only once, instead of once per
- * object.
- *
- * @param[in] scmp
- *     Database schema pointer.
- */
-static void
-initSearch(
-    scm *scmp)
-{
-    if (validTable)
-        return;
-
-    validTable = findtablescm(scmp, "certificate");
-    validSrch = newsrchscm(NULL, 3, 0, 1);
-    QueryField *field = findField("aki");
-    /** @bug ignores error code without explanation */
-    addcolsrchscm(validSrch, "aki", field->sqlType, field->maxSize);
-    /** @bug ignores error code without explanation */
-    char *now = LocalTimeToDBTime(NULL);
-    field = findField("issuer");
-    /** @bug ignores error code without explanation */
-    addcolsrchscm(validSrch, "issuer", field->sqlType, field->maxSize);
-    validWhereStr = validSrch->wherestr;
-    validWhereStr[0] = 0;
-    xsnprintf(validWhereStr, WHERESTR_SIZE, "valto>\"%s\"", now);
-    free(now);
-    addFlagTest(validWhereStr, SCM_FLAG_VALID, 1, 1);
-    if (!CONFIG_RPKI_ALLOW_STALE_CRL_get())
-        addFlagTest(validWhereStr, SCM_FLAG_STALECRL, 0, 1);
-    if (!CONFIG_RPKI_ALLOW_STALE_MANIFEST_get())
-        addFlagTest(validWhereStr, SCM_FLAG_STALEMAN, 0, 1);
-    if (!CONFIG_RPKI_ALLOW_NOT_YET_get())
-        addFlagTest(validWhereStr, SCM_FLAG_NOTYET, 0, 1);
-    if (!CONFIG_RPKI_ALLOW_NO_MANIFEST_get())
-    {
-        int len = strlen(validWhereStr);
-        xsnprintf(&validWhereStr[len], WHERESTR_SIZE - len,
-                  " and ("
-                  "((flags%%%d)>=%d)"
-                  " or ((flags%%%d)<%d)"
-                  " or ((flags%%%d)>=%d)"
-                  ")",
-                  2 * SCM_FLAG_ONMAN, SCM_FLAG_ONMAN, 2 * SCM_FLAG_CA,
-                  SCM_FLAG_CA, 2 * SCM_FLAG_TRUSTED, SCM_FLAG_TRUSTED);
-    }
-    whereInsertPtr = &validWhereStr[strlen(validWhereStr)];
-    nextSKI = (char *)validSrch->vec[0].valptr;
-    nextSubject = (char *)validSrch->vec[1].valptr;
-}
-
 int checkValidity(
     char *ski,
     unsigned int localID,
     scm *scmp,
     scmcon *connect)
 {
-    initSearch(scmp);
-
-    /* FIXME: This code assumes that is suffices to trace a single
-     * parent until one arrives at a trust anchor.  This will not
-     * always be the case, so key rollover or malicious activity might
-     * break the query client.  In addition, the right behavior is to
-     * trace up to any TRUSTED cert, which is not necessarily
-     * equivalent to any SELF-SIGNED cert.  Fix this on a future
-     * rewrite of checkValidity().  */
-
-    // now do the part specific to this cert
-    int firstTime = 1;
-    char prevSKI[128];
-    // keep going until trust anchor, where either AKI = SKI or no AKI
-    while (firstTime ||
-           !(strcmp(nextSKI, prevSKI) == 0 || strlen(nextSKI) == 0))
-    {
-        if (firstTime)
-        {
-            firstTime = 0;
-            if (ski)
-            {
-                xsnprintf(whereInsertPtr, WHERESTR_SIZE - strlen(validWhereStr),
-                          " and ski=\"%s\"", ski);
-                strncpy(prevSKI, ski, 128);
-            }
-            else
-            {
-                xsnprintf(whereInsertPtr, WHERESTR_SIZE - strlen(validWhereStr),
-                          " and local_id=\"%d\"", localID);
-                prevSKI[0] = 0;
-            }
-        }
-        else
-        {
-            char escaped_subject[2 * strlen(nextSubject) + 1];
-            mysql_escape_string(escaped_subject, nextSubject,
-                                strlen(nextSubject));
-            xsnprintf(whereInsertPtr, WHERESTR_SIZE - strlen(validWhereStr),
-                      " and ski=\"%s\" and subject=\"%s\"", nextSKI,
-                      escaped_subject);
-            strncpy(prevSKI, nextSKI, 128);
-        }
-        parentsFound = 0;
+    char *wherestr;
+    char *now;
+    size_t base;
+    size_t off;
+    int depth;
+
+    if (validTable == NULL)
+    {
+        validTable = findtablescm(scmp, "certificate");
+        validSrch = newsrchscm(NULL, 3, 0, 1);
+        /** @bug ignores error code without explanation */
+        addcolsrchscm(validSrch, "aki", SQL_C_CHAR, SKISIZE);
+        /** @bug ignores error code without explanation */
+        addcolsrchscm(validSrch, "issuer", SQL_C_CHAR, SUBJSIZE);
+        /** @bug ignores error code without explanation */
+        addcolsrchscm(validSrch, "is_trusted", SQL_C_ULONG,
+                      sizeof(unsigned int));
+    }
+
+    /* This is the slow path for when the loader's materialized state
+     * (see update_effective_validity()) was computed under another
+     * policy: every certificate up to a trust anchor must pass the
+     * same test as a link in update_effective_validity() does, and
+     * must not have expired. */
+    wherestr = validSrch->wherestr;
+    now = LocalTimeToDBTime(NULL);
+    if (now == NULL)
+        return 0;
+    off = xsnprintf(wherestr, WHERESTR_SIZE, "%s.valto>\"%s\" AND ",
+                    validTable->tabname, now);
+    free(now);
+    off += own_validity_predicate(&wherestr[off], WHERESTR_SIZE - off,
+                                  validTable->tabname, 1);
+    base = off;
+    if (ski)
+    {
+        xsnprintf(&wherestr[off], WHERESTR_SIZE - off, " AND ");
+        where_append_keyid(wherestr, "ski", ski);
+    }
+    else
+    {
+        xsnprintf(&wherestr[off], WHERESTR_SIZE - off, " AND local_id=%u",
+                  localID);
+    }
+    for (depth = 0; depth < MAX_CHAIN_DEPTH; depth++)
+    {
+        validFound = 0;
+        validTrusted = 0;
         /** @bug ignores error code without explanation */
         searchscm(connect, validTable, validSrch, NULL,
-                  &registerParent, SCM_SRCH_DOVALUE_ALWAYS, NULL);
-        if (parentsFound > 1)
+                  &registerValid, SCM_SRCH_DOVALUE_ALWAYS, NULL);
+        if (validFound == 0)
+            return 0;
+        if (validFound > 1)
         {
             LOG(LOG_WARNING, "multiple parents (%d) found; results suspect",
-                parentsFound);
+                validFound);
         }
-        else if (parentsFound == 0)
-        {
-            // no parent cert
+        if (validTrusted)
+            return 1;
+        if (validAKI[0] == 0)
             return 0;
-        }
+
+        // move up to the issuer
+        char escaped_issuer[2 * strlen(validIssuer) + 1];
+        mysql_escape_string(escaped_issuer, validIssuer, strlen(validIssuer));
+        off = base;
+        off += xsnprintf(&wherestr[off], WHERESTR_SIZE - off, " AND ");
+        off += where_append_keyid(wherestr, "ski", validAKI);
+        xsnprintf(&wherestr[off], WHERESTR_SIZE - off, " AND subject=\"%s\"",
+                  escaped_issuer);
     }
-    return 1;
+    LOG(LOG_WARNING, "no trust anchor within %d certificates; "
+        "treating the chain as invalid", MAX_CHAIN_DEPTH);
+    return 0;
 }
 
 
@@ -615,6 +592,14 @@ static QueryField fields[] = {
         NULL, NULL,
         "CRLDP", NULL,
     },
+    {
+        "ta_id",
+        "local_id of the trust anchor certificate at the top of the chain",
+        Q_FOR_ROA | Q_FOR_CRL | Q_FOR_CERT | Q_FOR_MAN | Q_FOR_GBR,
+        SQL_C_ULONG, sizeof(unsigned long),
+        NULL, NULL,
+        "TA", NULL,
+    },
     {
         "local_id",
         NULL,
@@ -19,6 +19,17 @@ extern void addQueryFlagTests(
     char *whereStr,
     int needAnd);
 
+/**
+ * @brief
+ *     check whether an object's @c flags column passes the tests
+ *     added by addQueryFlagTests()
+ *
+ * @return
+ *     1 if the flags pass, 0 if not
+ */
+extern int queryFlagsAccepted(
+    unsigned int flags);
+
 /**
  * @brief
  *     prototype for a function for displaying a field
@@ -81,6 +92,12 @@ extern int getNumFields(
  * @brief
  *     check the validity of a cert in the db
  *
+ * Walks up the chain from the certificate to a trust anchor, testing
+ * each certificate under the current configuration.  This issues a
+ * query per certificate in the chain, so clients should only use it
+ * when check_effective_validity() says the materialized chain state
+ * can't be used.
+ *
  * @param[in] ski
  *     If non-NULL, the subject key identifier identifying the
  *     certificate to check.  If NULL, the certificate to check is
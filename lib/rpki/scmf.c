@@ -1,6 +1,9 @@
 #include "scmf.h"
 #include "util/stringutils.h"
 #include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <mysql.h>
 
 int
 where_append(
@@ -25,3 +28,81 @@ where_append_v(
     assert(len <= WHERESTR_SIZE);
     return xvsnprintf(&buf[len], WHERESTR_SIZE - len, format, ap);
 }
+
+int
+where_append_keyid(
+    char *restrict buf,
+    const char *restrict column,
+    const char *restrict keyid)
+{
+    size_t len = strlen(keyid);
+    char hex[len + 1];
+    size_t nhex = 0;
+    int wellformed = 1;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (keyid[i] == ':')
+            continue;
+        if (!isxdigit((int)(unsigned char)keyid[i]))
+        {
+            wellformed = 0;
+            break;
+        }
+        hex[nhex++] = keyid[i];
+    }
+    hex[nhex] = '\0';
+    if (wellformed && nhex > 0 && nhex % 2 == 0)
+        return where_append(buf, "%s_bin=x'%s'", column, hex);
+
+    // there is no binary copy of a malformed value to compare against
+    char escaped[2 * len + 1];
+    mysql_escape_string(escaped, keyid, len);
+    return where_append(buf, "%s=\"%s\"", column, escaped);
+}
+
+int
+where_append_hashed(
+    char *restrict buf,
+    const char *restrict column,
+    const char *restrict value)
+{
+    size_t len = strlen(value);
+    char escaped[2 * len + 1];
+
+    mysql_escape_string(escaped, value, len);
+    return where_append(buf, "%s_hash=UNHEX(SHA1(\"%s\")) and %s=\"%s\"",
+                        column, escaped, column, escaped);
+}
+
+int
+keyid_to_bin(
+    const char *keyid,
+    unsigned char *buf,
+    size_t buflen)
+{
+    size_t nhex = 0;
+    int nibble;
+
+    for (; *keyid; ++keyid)
+    {
+        if (*keyid == ':')
+            continue;
+        if (!isxdigit((int)(unsigned char)*keyid))
+            return -1;
+        if (isdigit((int)(unsigned char)*keyid))
+            nibble = *keyid - '0';
+        else
+            nibble = tolower((int)(unsigned char)*keyid) - 'a' + 10;
+        if (nhex / 2 >= buflen)
+            return -1;
+        if (nhex % 2 == 0)
+            buf[nhex / 2] = nibble << 4;
+        else
+            buf[nhex / 2] |= nibble;
+        ++nhex;
+    }
+    if (nhex == 0 || nhex % 2 != 0)
+        return -1;
+    return nhex / 2;
+}
@@ -19,20 +19,54 @@ typedef struct _scmstat         /* connection statistics */
     int rows;                   /* rows changed */
 } scmstat;
 
-typedef struct _stmtstk {
-    SQLHSTMT hstmt;
-    struct _stmtstk *next;
-} stmtstk;
+/*
+ * Recurring loader queries that are prepared once per connection and
+ * then executed with bound parameters; see searchscm_prepared().  The
+ * query text is in sqcon.c.
+ */
+enum scm_pstmt {
+    SCM_PSTMT_DIR_ID,           /* directory lookup by name */
+    SCM_PSTMT_CERT_PATHS,       /* valid certs by SKI and subject */
+    SCM_PSTMT_CERT_CHILDREN,    /* child certs by AKI and issuer */
+    SCM_PSTMT_CRL_REVOKED,      /* valid CRLs by issuer */
+    SCM_PSTMT_MFT_FILE_CERT,    /* objects not yet on a manifest, by */
+    SCM_PSTMT_MFT_FILE_CRL,     /* file name */
+    SCM_PSTMT_MFT_FILE_ROA,
+    SCM_PSTMT_MFT_FILE_GBR,
+    SCM_PSTMT_SET_FLAGS_CERT,   /* flags update by local_id */
+    SCM_PSTMT_SET_FLAGS_CRL,
+    SCM_PSTMT_SET_FLAGS_ROA,
+    SCM_PSTMT_SET_FLAGS_MAN,
+    SCM_PSTMT_SET_FLAGS_GBR,
+    SCM_PSTMT_NUM
+};
+
+/*
+ * SQL dialect spoken by a connection; see scmdialect().
+ */
+enum scm_dialect {
+    SCM_DIALECT_MYSQL,          /* MySQL server, through ODBC or natively */
+    SCM_DIALECT_SQLITE,         /* embedded database */
+};
+
+struct scm_backend;
 
 typedef struct _scmcon          /* connection info */
 {
-    SQLHENV henv;               /* environment handle */
-    SQLHDBC hdbc;               /* database handle */
-    stmtstk *hstmtp;            /* stack of statement handles */
+    const struct scm_backend *backend;  /* see sqbackend.h */
+    void *bdata;                /* backend's connection state */
     int connected;              /* are we connected? */
     scmstat mystat;             /* statistics and errors */
 } scmcon;
 
+typedef struct _scmparam        /* a parameter of a prepared statement */
+{
+    int sqltype;                /* SQL_C_CHAR, SQL_C_BINARY or SQL_C_ULONG */
+    const void *valptr;         /* the value */
+    SQLLEN valsize;             /* length of the value, or SQL_NTS for a
+                                 * nul-terminated string */
+} scmparam;
+
 typedef struct _scmkv           /* used for a single column of an insert */
 {
     const char *column;         /* column name */
@@ -107,7 +141,7 @@ sqlvaluefunc(
 #define SCM_SRCH_DO_JOIN_SELF    0x100  /* Include join with self */
 
 
-#define WHERESTR_SIZE 1024
+#define WHERESTR_SIZE 4096
 
 #ifndef SQLOK
 #define SQLOK(s) (s == SQL_SUCCESS || s == SQL_SUCCESS_WITH_INFO)
@@ -116,6 +150,11 @@ sqlvaluefunc(
 /*
  * Initialize a connection to the named DSN. Return a connection object on
  * success and a negative error code on failure.
+ *
+ * The DatabaseBackend configuration option selects whether the connection
+ * goes through ODBC, straight to the local MySQL server through its client
+ * library, or to an embedded database in DatabaseDir. In the latter two
+ * cases only the DATABASE, UID and PASSWORD fields of the DSN are used.
  */
 extern scmcon *connectscm(
     char *dsnp,
@@ -164,8 +203,62 @@ where_append_v(
     const char *restrict format,
     va_list ap) WARN_PRINTF(2, 0);
 
+/**
+ * @brief
+ *     Append to a WHERE buffer a test that a key identifier column
+ *     (ski or aki) equals the given value.
+ *
+ * Key identifiers are stored as colon-separated hex strings, but they
+ * are indexed through a binary copy of the column (e.g., @c ski_bin).
+ * The test is made against the binary copy so that it can use that
+ * index.
+ *
+ * @param[out] buf
+ *     WHERE buffer, as with where_append().
+ * @param[in] column
+ *     Name of the key identifier column, optionally qualified with a
+ *     table alias (e.g., "c.aki").
+ * @param[in] keyid
+ *     Key identifier as stored in @p column, e.g., "01:23:AB".  If
+ *     this is not a well-formed hex string, the test is made against
+ *     @p column itself.
+ * @return
+ *     The number of characters appended to the buffer.
+ */
+int
+where_append_keyid(
+    char *restrict buf,
+    const char *restrict column,
+    const char *restrict keyid);
+
+/**
+ * @brief
+ *     Append to a WHERE buffer a test that a wide string column
+ *     (subject, issuer, or sig) equals the given value.
+ *
+ * These columns are indexed through a SHA-1 digest of the column
+ * (e.g., @c subject_hash).  The test includes both the digest, so that
+ * it can use that index, and the column itself, so that a digest
+ * collision cannot produce a false match.
+ *
+ * @param[out] buf
+ *     WHERE buffer, as with where_append().
+ * @param[in] column
+ *     Name of the column, optionally qualified with a table alias.
+ * @param[in] value
+ *     The value, unescaped.
+ * @return
+ *     The number of characters appended to the buffer.
+ */
+int
+where_append_hashed(
+    char *restrict buf,
+    const char *restrict column,
+    const char *restrict value);
+
 /*
- * add clause for testing the value of a flag to a where string
+ * add clause for testing the value of a flag to a where string, using the
+ * flag's indexed state column (e.g. is_valid) when it has one
  */
 extern void addFlagTest(
     char *whereStr,
@@ -220,18 +313,13 @@ extern int getrowsscm(
     scmcon *conp);
 
 /*
- * Execute an SQL statement.
- *
- * Before calling statementscm: You must call newhstmt(conp) and verify its
- * return value.
- *
- * After calling statementscm and using its statement handle: You must call
- * pophstmt(conp).
+ * Get the SQL dialect of a connection, for the few statements that
+ * can't be written the same way for every backend.  The statements
+ * built by this library and the where strings passed to it are MySQL;
+ * the embedded backend translates them.
  */
-err_code
-statementscm(
-    scmcon *conp,
-    char *stm);
+extern enum scm_dialect scmdialect(
+    scmcon *conp);
 
 /**
  * @brief
@@ -291,20 +379,14 @@ getmaxidscm(
     scmtab *mtab,
     unsigned int *ival);
 
-err_code
-getuintscm(
-    scmcon *conp,
-    unsigned int *ival);
-
 /**
  * @brief
  *     searches in a database table for entries that match the stated
  *     search criteria
  *
  * Note that searchscm() can be called recursively, so that there can
- * be more than one cursor open at a time.  For this reason,
- * searchscm() must create its own STMT and then destroy it when it is
- * done.
+ * be more than one cursor open at a time.  For this reason, each call
+ * gets its own cursor from the backend and closes it when it is done.
  */
 err_code
 searchscm(
@@ -316,6 +398,58 @@ searchscm(
     int what,
     char *orderp);
 
+/**
+ * @brief
+ *     like searchscm(), but runs one of the prepared statements in
+ *     enum scm_pstmt with the given parameters
+ *
+ * The statement is prepared on first use and kept for the life of the
+ * connection, so the server doesn't have to parse and plan it again.
+ * The columns of @p srch must match the statement's select list;
+ * @p srch must not have "where" conditionals, and the join bits of
+ * @p what are ignored.  Like searchscm(), this may be called
+ * recursively from a value callback, even for the same statement; each
+ * level of recursion gets its own handle, which is then kept for reuse.
+ */
+err_code
+searchscm_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const scmparam *params,
+    int nparams,
+    scmsrcha *srch,
+    sqlcountfunc *cnter,
+    sqlvaluefunc *valer,
+    int what);
+
+/**
+ * @brief
+ *     execute one of the prepared statements in enum scm_pstmt that
+ *     returns no rows, e.g. an update
+ */
+err_code
+statementscm_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const scmparam *params,
+    int nparams);
+
+/**
+ * @brief
+ *     Convert a key identifier to its binary form, as stored in the
+ *     @c ski_bin and @c aki_bin columns.
+ *
+ * @return
+ *     The number of bytes written to @p buf, or -1 if @p keyid is not
+ *     a well-formed hex string (see where_append_keyid()) or does not
+ *     fit in @p buflen bytes.
+ */
+int
+keyid_to_bin(
+    const char *keyid,
+    unsigned char *buf,
+    size_t buflen);
+
 /*
  * Add a new column to a search array. Note that this function does not grow
  * the size of the column array, so enough space must have already been
@@ -402,20 +536,6 @@ updateblobscm(
     unsigned int snlen,
     unsigned int lid);
 
-/*
- * Create a new STMT and push it onto the top of the stack of STMTs in the
- * connection.
- */
-extern SQLRETURN newhstmt(
-    scmcon *conp);
-
-/*
- * Pop the top element off the hstmt stack of a connection, free the hstmt and
- * the associated memory.
- */
-extern void pophstmt(
-    scmcon *conp);
-
 /*
  * Directives for hexify()
  */
@@ -28,6 +28,62 @@
     "CHECK (prefix_length <= prefix_max_length)," \
     "CHECK (prefix_max_length <= length(prefix) * 8)"
 
+/**
+ * @brief Generated columns that expose the object states held in the
+ *     flags column.
+ *
+ * Predicates on these columns can use an index, unlike bit arithmetic
+ * on flags.  The constants must match the SCM_FLAG_* values in
+ * db_constants.h.
+ *
+ *   - is_valid: #SCM_FLAG_VALID
+ *   - is_notyet: #SCM_FLAG_NOTYET
+ *   - is_stalecrl: #SCM_FLAG_STALECRL
+ *   - is_staleman: #SCM_FLAG_STALEMAN
+ *   - is_onman: #SCM_FLAG_ONMAN
+ *
+ * @sa SCM_KEY_STATE
+ */
+#define SCM_COLDEFS_STATE \
+    "is_valid    BOOLEAN AS ((flags & 4) <> 0) STORED," \
+    "is_notyet   BOOLEAN AS ((flags & 16) <> 0) STORED," \
+    "is_stalecrl BOOLEAN AS ((flags & 32) <> 0) STORED," \
+    "is_staleman BOOLEAN AS ((flags & 64) <> 0) STORED," \
+    "is_onman    BOOLEAN AS ((flags & 256) <> 0) STORED"
+
+/**
+ * @brief Columns of the composite index over #SCM_COLDEFS_STATE.
+ *
+ * The order matches the tests made by addQueryFlagTests() and
+ * flag_tests_default() so that the common "valid objects" lookup is
+ * a range scan on this index.
+ */
+#define SCM_KEY_STATE \
+    "is_valid, is_stalecrl, is_staleman, is_notyet, is_onman"
+
+/**
+ * @brief Generated column holding the binary form of a key
+ *     identifier column.
+ *
+ * Key identifiers (ski, aki) are stored as colon-separated hex
+ * strings.  Indexing the binary form instead of the string shrinks the
+ * index to less than a third of its size.  Lookups must test the
+ * binary column to use the index; see where_append_keyid().
+ */
+#define SCM_COLDEF_KEYID(col) \
+    col "_bin VARBINARY(64) AS (UNHEX(REPLACE(" col ", ':', ''))) STORED"
+
+/**
+ * @brief Generated column holding the SHA-1 digest of a wide string
+ *     column (subject, issuer, sig).
+ *
+ * The digest is indexed in place of the column itself.  Because the
+ * digest is not unique in the face of a deliberate collision, lookups
+ * must test both the digest and the column; see where_append_hashed().
+ */
+#define SCM_COLDEF_DIGEST(col) \
+    col "_hash BINARY(20) AS (UNHEX(SHA1(" col "))) STORED"
+
 /*
  * Table definitions
  */
@@ -35,7 +91,8 @@
 /*
  * The sceme for adding in SQL statements to scmtabbuilder is the following:
  * column names should start with a lowercase letter all SQL keywords should
- * be uppercase
+ * be uppercase.  Commas within parentheses (e.g., in the expression of a
+ * generated column) do not separate column definitions.
  */
 
 static scmtab scmtabbuilder[] = {
@@ -43,6 +100,17 @@ static scmtab scmtabbuilder[] = {
      /*
       * Usage notes: valfrom and valto are stored in GMT. local_id is a unique
       * identifier with the new one obtained via max(local_id) + 1
+      *
+      * ta_id, eff_valid and eff_valto are maintained by
+      * update_effective_validity() for this table and every table of
+      * objects signed by a certificate.  ta_id is the local_id of the
+      * trust anchor at the top of the object's chain (NULL if the chain
+      * does not reach one) and eff_valid is true iff every certificate
+      * in that chain is acceptable under the stale CRL, stale manifest,
+      * not-yet-valid and no-manifest policies recorded in
+      * rpki_metadata.eff_policy.  eff_valto is the earliest valto in the
+      * chain; it is compared with the current time when the object is
+      * queried, since certificates expire without the database changing.
       */
      "rpki_cert",
      "CERTIFICATE",
@@ -66,12 +134,26 @@ static scmtab scmtabbuilder[] = {
      "ipb      BLOB,"
      "ts_mod   TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,"
      "local_id INT UNSIGNED NOT NULL UNIQUE,"
+     "ta_id    INT UNSIGNED,"
+     "eff_valid BOOLEAN NOT NULL DEFAULT FALSE,"
+     "eff_valto DATETIME,"
+     "is_ca    BOOLEAN AS ((flags & 1) <> 0) STORED,"
+     "is_trusted BOOLEAN AS ((flags & 2) <> 0) STORED,"
+     SCM_COLDEFS_STATE ","
+     SCM_COLDEF_KEYID("ski") ","
+     SCM_COLDEF_KEYID("aki") ","
+     SCM_COLDEF_DIGEST("subject") ","
+     SCM_COLDEF_DIGEST("issuer") ","
+     SCM_COLDEF_DIGEST("sig") ","
      "         PRIMARY KEY (filename, dir_id),"
-     "         KEY ski (ski, subject),"
-     "         KEY aki (aki, issuer),"
+     "         KEY eff_valid (eff_valid, ta_id),"
+     "         KEY state (" SCM_KEY_STATE ", is_ca),"
+     "         KEY trusted (is_trusted),"
+     "         KEY ski (ski_bin, subject_hash),"
+     "         KEY aki (aki_bin, issuer_hash),"
      "         KEY lid (local_id),"
-     "         KEY sig (sig),"
-     "         KEY isn (issuer, sn)",
+     "         KEY sig (sig_hash),"
+     "         KEY isn (issuer_hash, sn)",
      NULL,
      0},
     {                           /* RPKI_CRL */
@@ -106,10 +188,19 @@ static scmtab scmtabbuilder[] = {
      "snlist   MEDIUMBLOB,"
      "flags    INT UNSIGNED DEFAULT 0,"
      "local_id INT UNSIGNED NOT NULL UNIQUE,"
+     "ta_id    INT UNSIGNED,"
+     "eff_valid BOOLEAN NOT NULL DEFAULT FALSE,"
+     "eff_valto DATETIME,"
+     SCM_COLDEFS_STATE ","
+     SCM_COLDEF_KEYID("aki") ","
+     SCM_COLDEF_DIGEST("issuer") ","
+     SCM_COLDEF_DIGEST("sig") ","
      "         PRIMARY KEY (filename, dir_id),"
-     "         KEY issuer (issuer),"
-     "         KEY aki (aki),"
-     "         KEY sig (sig),"
+     "         KEY eff_valid (eff_valid, ta_id),"
+     "         KEY state (" SCM_KEY_STATE "),"
+     "         KEY issuer (issuer_hash),"
+     "         KEY aki (aki_bin, issuer_hash),"
+     "         KEY sig (sig_hash),"
      "         KEY lid (local_id)",
      NULL,
      0},
@@ -131,11 +222,19 @@ static scmtab scmtabbuilder[] = {
      "asn      INT UNSIGNED NOT NULL,"
      "flags    INT UNSIGNED DEFAULT 0,"
      "local_id INT UNSIGNED NOT NULL UNIQUE,"
+     "ta_id    INT UNSIGNED,"
+     "eff_valid BOOLEAN NOT NULL DEFAULT FALSE,"
+     "eff_valto DATETIME,"
+     SCM_COLDEFS_STATE ","
+     SCM_COLDEF_KEYID("ski") ","
+     SCM_COLDEF_DIGEST("sig") ","
      "         PRIMARY KEY (filename, dir_id),"
+     "         KEY eff_valid (eff_valid, ta_id),"
+     "         KEY state (" SCM_KEY_STATE ", local_id, asn),"
      "         KEY asn (asn),"
-     "         KEY sig (sig),"
+     "         KEY sig (sig_hash),"
      "         KEY lid (local_id),"
-     "         KEY ski (ski)",
+     "         KEY ski (ski_bin)",
      NULL,
      0},
     {
@@ -143,7 +242,7 @@ static scmtab scmtabbuilder[] = {
      "ROA_PREFIX",
      "roa_local_id INT UNSIGNED NOT NULL,"
      SCM_COLDEFS_PREFIX_MAXLEN ","
-     "KEY (roa_local_id, prefix),"
+     "KEY roa_prefix (roa_local_id, prefix, prefix_length, prefix_max_length),"
      "FOREIGN KEY (roa_local_id) REFERENCES rpki_roa (local_id) "
      "    ON DELETE CASCADE "
      "    ON UPDATE CASCADE,"
@@ -163,9 +262,16 @@ static scmtab scmtabbuilder[] = {
      "fileslen INT UNSIGNED DEFAULT 0,"
      "flags    INT UNSIGNED DEFAULT 0,"
      "local_id INT UNSIGNED NOT NULL UNIQUE,"
+     "ta_id    INT UNSIGNED,"
+     "eff_valid BOOLEAN NOT NULL DEFAULT FALSE,"
+     "eff_valto DATETIME,"
+     SCM_COLDEFS_STATE ","
+     SCM_COLDEF_KEYID("ski") ","
      "         PRIMARY KEY (filename, dir_id),"
+     "         KEY eff_valid (eff_valid, ta_id),"
+     "         KEY state (" SCM_KEY_STATE "),"
      "         KEY lid (local_id),"
-     "         KEY ski (ski)",
+     "         KEY ski (ski_bin)",
      NULL,
      0},
     {
@@ -177,9 +283,16 @@ static scmtab scmtabbuilder[] = {
      "ski      VARCHAR(128) NOT NULL,"
      "hash     VARCHAR(256),"
      "flags    INT UNSIGNED DEFAULT 0,"
+     "ta_id    INT UNSIGNED,"
+     "eff_valid BOOLEAN NOT NULL DEFAULT FALSE,"
+     "eff_valto DATETIME,"
+     SCM_COLDEFS_STATE ","
+     SCM_COLDEF_KEYID("ski") ","
      "         PRIMARY KEY (filename, dir_id),"
+     "         KEY eff_valid (eff_valid, ta_id),"
+     "         KEY state (" SCM_KEY_STATE "),"
      "         KEY lid (local_id),"
-     "         KEY ski (ski)",
+     "         KEY ski (ski_bin)",
      NULL,
      0},
     {                           /* RPKI_DIR */
@@ -198,6 +311,8 @@ static scmtab scmtabbuilder[] = {
      "inited   TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
      "flags    INT UNSIGNED DEFAULT 0,"
      "local_id INT UNSIGNED DEFAULT 1,"
+     "generation INT UNSIGNED NOT NULL DEFAULT 0,"
+     "eff_policy INT UNSIGNED NOT NULL DEFAULT 0,"
      "         PRIMARY KEY (local_id)",
      NULL,
      0},
@@ -257,6 +372,10 @@ static scmtab scmtabbuilder[] = {
 
 #undef SCM_COLDEFS_PREFIX_MAXLEN
 #undef SCM_CHECKS_PREFIX_MAXLEN
+#undef SCM_COLDEFS_STATE
+#undef SCM_KEY_STATE
+#undef SCM_COLDEF_KEYID
+#undef SCM_COLDEF_DIGEST
 
 #endif
 
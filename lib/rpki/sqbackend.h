@@ -0,0 +1,122 @@
+#ifndef LIB_RPKI_SQBACKEND_H
+#define LIB_RPKI_SQBACKEND_H
+
+/*
+ * Interface between sqcon.c, which builds the SQL for the scm layer,
+ * and the code that runs it against a particular kind of database.
+ * There is one implementation for each value of the DatabaseBackend
+ * configuration option.
+ */
+
+#include "scm.h"
+#include "scmf.h"
+
+/*
+ * The rows returned by a statement.  Each backend defines its own.
+ * A caller may run other statements on the same connection while it
+ * reads a cursor (value callbacks of searchscm() do), so a backend
+ * must not tie up the connection for the life of a cursor.
+ */
+typedef struct _scmcursor scmcursor;
+
+struct scm_backend {
+    const char *name;           /* value of DatabaseBackend */
+    enum scm_dialect dialect;
+
+    /*
+     * Connect to the database named by a DSN from makedsnscm(),
+     * setting conp->bdata.  On failure, the reason is left in
+     * conp->mystat.errmsg and conp->bdata is either NULL or ready for
+     * disconnect().
+     */
+    err_code (*connect)(scmcon *conp, const char *dsn);
+
+    /* Close the connection and free conp->bdata. */
+    void (*disconnect)(scmcon *conp);
+
+    /*
+     * Execute a statement and set conp->mystat.rows.  If curp is
+     * NULL, any rows are discarded.  Otherwise *curp is set to a
+     * cursor over the rows, or to NULL if the statement doesn't
+     * return any; the caller closes it with close().
+     */
+    err_code (*execute)(scmcon *conp, const char *stm, scmcursor **curp);
+
+    /*
+     * Like execute(), for prepared statement "which", whose text is
+     * query.  A backend may keep the statement prepared for the life
+     * of the connection.  The parameters are only read during the
+     * call.
+     */
+    err_code (*execute_prepared)(scmcon *conp, enum scm_pstmt which,
+                                 const char *query, const scmparam *params,
+                                 int nparams, scmcursor **curp);
+
+    /* Get the number of rows in a cursor before any are fetched. */
+    err_code (*rowcount)(scmcon *conp, scmcursor *curp, ssize_t *nrows);
+
+    /*
+     * Fetch the next row into the columns of srch, setting each
+     * column's avalsize the way SQLBindCol() would: the full length
+     * of the value (strings are cut to fit with a nul terminator) or
+     * SQL_NULL_DATA.  Returns 1 for a row, 0 after the last row, and
+     * a negative error code if this row couldn't be fetched.  srch is
+     * the same for every fetch from a cursor.
+     */
+    int (*fetch)(scmcon *conp, scmcursor *curp, scmsrcha *srch);
+
+    void (*close)(scmcon *conp, scmcursor *curp);
+
+    /* Create or delete (if it exists) a database. */
+    err_code (*createdb)(scmcon *conp, const char *dbname);
+    err_code (*deletedb)(scmcon *conp, const char *dbname);
+
+    /* Switch the connection to another database, as with USE. */
+    err_code (*usedb)(scmcon *conp, const char *dbname);
+
+    /* Create a table of the current database. */
+    err_code (*createtable)(scmcon *conp, const scmtab *tabp);
+};
+
+extern const struct scm_backend scm_backend_odbc;
+extern const struct scm_backend scm_backend_mysql;
+#ifdef HAVE_SQLITE
+extern const struct scm_backend scm_backend_embedded;
+#endif
+
+/*
+ * Implementations of the database operations for backends that talk
+ * to a MySQL server, which does them with plain statements.
+ */
+err_code
+sqlcreatedb(
+    scmcon *conp,
+    const char *dbname);
+
+err_code
+sqldeletedb(
+    scmcon *conp,
+    const char *dbname);
+
+err_code
+sqlusedb(
+    scmcon *conp,
+    const char *dbname);
+
+err_code
+sqlcreatetable(
+    scmcon *conp,
+    const scmtab *tabp);
+
+/*
+ * Get the value of a field (e.g., "DATABASE") of a DSN in a buffer
+ * of at least strlen(dsn) + 1 bytes.  Returns NULL if the field isn't
+ * there.
+ */
+char *
+dsnfield(
+    const char *dsn,
+    const char *field,
+    char *buf);
+
+#endif
@@ -2,95 +2,33 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 
 #include <mysql.h>
 
 #include "scm.h"
 #include "scmf.h"
+#include "sqbackend.h"
 #include "diru.h"
 #include "err.h"
 #include "globals.h"
+#include "db_constants.h"
+#include "perf.h"
+#include "sqhl.h"
+#include "config/config.h"
 #include "util/stringutils.h"
 
 
-/*
- * Decode the last error on a handle
- */
-
-static void heer(
-    SQLSMALLINT what,
-    SQLHANDLE h,
-    char *errmsg,
-    int emlen)
-{
-    SQLINTEGER nep;
-    SQLSMALLINT tl;
-    // ODBC docs say that state gets a 5-character SQLSTATE code plus
-    // a terminating nul byte
-    SQLCHAR state[6];
-    SQLSMALLINT i = 1;
-    // RFC5424 says minimum maximum syslog message is 480 octets; use
-    // 400 to give room for overhead
-    SQLCHAR msg[400];
-
-    while (SQLOK(SQLGetDiagRec(
-                     what, h, i, state, &nep, msg,
-                     sizeof(msg)/sizeof(msg[0]), &tl)))
-    {
-        LOG(LOG_ERR, "  %s %ld %s%s",
-            (char *)state, (long)nep, (char *)msg,
-            ((size_t)tl >= sizeof(msg)) ? " (truncated)" : "");
-        ++i;
-    }
-
-    SQLGetDiagRec(what, h, 1, state, &nep,
-                  (SQLCHAR *) errmsg, emlen, &tl);
-}
-
-/*
- * Free a stack of SQLHSTMTs.
- */
-
-static void freehstack(
-    stmtstk *stackp)
-{
-    stmtstk *nextp;
-
-    while (stackp != NULL)
-    {
-        if (stackp->hstmt != NULL)
-        {
-            SQLFreeHandle(SQL_HANDLE_STMT, stackp->hstmt);
-            stackp->hstmt = NULL;
-        }
-        nextp = stackp->next;
-        free((void *)stackp);
-        stackp = nextp;
-    }
-}
-
 void disconnectscm(
     scmcon *conp)
 {
     if (conp == NULL)
         return;
-    freehstack(conp->hstmtp);
-    if (conp->connected > 0)
-    {
-        SQLDisconnect(conp->hdbc);
-        conp->connected = 0;
-    }
-    if (conp->hdbc != NULL)
-    {
-        SQLFreeHandle(SQL_HANDLE_DBC, conp->hdbc);
-        conp->hdbc = NULL;
-    }
-    if (conp->henv != NULL)
-    {
-        SQLFreeHandle(SQL_HANDLE_ENV, conp->henv);
-        conp->henv = NULL;
-    }
+    if (conp->backend != NULL && conp->bdata != NULL)
+        conp->backend->disconnect(conp);
+    conp->bdata = NULL;
+    conp->connected = 0;
     if (conp->mystat.errmsg != NULL)
     {
         free((void *)(conp->mystat.errmsg));
@@ -99,50 +37,30 @@ void disconnectscm(
     free((void *)conp);
 }
 
-SQLRETURN newhstmt(
-    scmcon *conp)
+char *dsnfield(
+    const char *dsn,
+    const char *field,
+    char *buf)
 {
-    SQLRETURN ret;
-    stmtstk *stackp;
+    size_t flen = strlen(field);
+    const char *cp = dsn;
+    const char *end;
 
-    if (conp == NULL)
-        return (-1);
-    stackp = (stmtstk *) calloc(1, sizeof(stmtstk));
-    if (stackp == NULL)
-        return (-1);
-    ret = SQLAllocHandle(SQL_HANDLE_STMT, conp->hdbc, &stackp->hstmt);
-    if (!SQLOK(ret))
-    {
-        free((void *)stackp);
-        return (ret);
-    }
-    ret = SQLSetStmtAttr(stackp->hstmt, SQL_ATTR_NOSCAN,
-                         (SQLPOINTER) SQL_NOSCAN_ON, SQL_IS_UINTEGER);
-    if (!SQLOK(ret))
+    while (*cp != 0)
     {
-        SQLFreeHandle(SQL_HANDLE_STMT, stackp->hstmt);
-        free((void *)stackp);
-        return (ret);
+        end = strchr(cp, ';');
+        if (end == NULL)
+            end = cp + strlen(cp);
+        if ((size_t)(end - cp) > flen && cp[flen] == '=' &&
+            strncasecmp(cp, field, flen) == 0)
+        {
+            memcpy(buf, &cp[flen + 1], end - cp - flen - 1);
+            buf[end - cp - flen - 1] = 0;
+            return (buf);
+        }
+        cp = (*end == ';') ? end + 1 : end;
     }
-    stackp->next = conp->hstmtp;
-    conp->hstmtp = stackp;
-    return (0);
-}
-
-void pophstmt(
-    scmcon *conp)
-{
-    stmtstk *stackp;
-
-    if (conp == NULL)
-        return;
-    stackp = conp->hstmtp;
-    if (stackp == NULL)
-        return;
-    conp->hstmtp = stackp->next;
-    if (stackp->hstmt != NULL)
-        SQLFreeHandle(SQL_HANDLE_STMT, stackp->hstmt);
-    free((void *)stackp);
+    return (NULL);
 }
 
 scmcon *connectscm(
@@ -150,14 +68,9 @@ scmcon *connectscm(
     char *errmsg,
     int emlen)
 {
-    SQLSMALLINT inret;
-    SQLSMALLINT outret;
     static char nulldsn[] = "NULL DSN";
-    static char badhenv[] = "Cannot allocate HENV handle";
     static char oom[] = "Out of memory!";
     scmcon *conp;
-    SQLRETURN ret;
-    char outlen[1024];
     int leen;
 
     if (errmsg != NULL && emlen > 0)
@@ -187,55 +100,45 @@ scmcon *connectscm(
         return (NULL);
     }
     conp->mystat.emlen = 1024;
-    ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &conp->henv);
-    if (!SQLOK(ret))
-    {
-        disconnectscm(conp);
-        leen = strlen(badhenv);
-        if (errmsg != NULL && emlen > leen)
-            (void)strncpy(errmsg, badhenv, leen);
-        return (NULL);
-    }
-    ret = SQLSetEnvAttr(conp->henv, SQL_ATTR_ODBC_VERSION,
-                        (SQLPOINTER) SQL_OV_ODBC3, sizeof(int));
-    if (!SQLOK(ret))
+    switch (CONFIG_DATABASE_BACKEND_get())
     {
+    case DATABASE_BACKEND_MYSQL:
+        conp->backend = &scm_backend_mysql;
+        break;
+    case DATABASE_BACKEND_EMBEDDED:
+#ifdef HAVE_SQLITE
+        conp->backend = &scm_backend_embedded;
+        break;
+#else
         if (errmsg != NULL && emlen > 0)
-            heer(SQL_HANDLE_ENV, conp->henv, errmsg, emlen);
+            (void)snprintf(errmsg, emlen, "DatabaseBackend embedded is not "
+                           "available; rebuild with --with-sqlite");
         disconnectscm(conp);
         return (NULL);
+#endif
+    default:
+        conp->backend = &scm_backend_odbc;
+        break;
     }
-    ret = SQLAllocHandle(SQL_HANDLE_DBC, conp->henv, &conp->hdbc);
-    if (!SQLOK(ret))
+    if (conp->backend->connect(conp, dsnp) < 0)
     {
         if (errmsg != NULL && emlen > 0)
-            heer(SQL_HANDLE_ENV, conp->henv, errmsg, emlen);
+            (void)snprintf(errmsg, emlen, "%s", conp->mystat.errmsg);
         disconnectscm(conp);
         return (NULL);
     }
-    inret = strlen(dsnp) + 1;
-    ret = SQLDriverConnect(conp->hdbc, NULL, (SQLCHAR *) dsnp, inret,
-                           (SQLCHAR *) & outlen[0], 1024, &outret, 0);
-    if (!SQLOK(ret))
-    {
-        if (errmsg != NULL && emlen > 0)
-            heer(SQL_HANDLE_DBC, conp->hdbc, errmsg, emlen);
-        // disconnectscm(conp); # if not connected, cannot disconnect
-        return (NULL);
-    }
     conp->connected++;
-    ret = newhstmt(conp);
-    if (!SQLOK(ret))
-    {
-        if (errmsg != NULL && emlen > 0 && conp->hstmtp != NULL &&
-            conp->hstmtp->hstmt != NULL)
-            heer(SQL_HANDLE_STMT, conp->hstmtp->hstmt, errmsg, emlen);
-        disconnectscm(conp);
-        return (NULL);
-    }
     return (conp);
 }
 
+enum scm_dialect scmdialect(
+    scmcon *conp)
+{
+    if (conp == NULL || conp->backend == NULL)
+        return (SCM_DIALECT_MYSQL);
+    return (conp->backend->dialect);
+}
+
 char *geterrorscm(
     scmcon *conp)
 {
@@ -263,48 +166,24 @@ int getrowsscm(
     return (r);
 }
 
-err_code
-statementscm(
+/*
+ * Run a statement through the connection's backend.  See execute() in
+ * sqbackend.h.
+ */
+static err_code
+executescm(
     scmcon *conp,
-    char *stm)
+    const char *stm,
+    scmcursor **curp)
 {
-    LOG(LOG_DEBUG, "statementscm(conp=%p, stm=\"%s\")", conp, stm);
-
-    err_code sta = 0;
-    SQLINTEGER istm;
-    SQLLEN len;
-    SQLRETURN ret;
+    struct perf_timer timer;
+    err_code sta;
 
-    if (conp == NULL || conp->connected == 0 || stm == NULL || stm[0] == 0)
-    {
-        sta = ERR_SCM_INVALARG;
-        goto done;
-    }
     memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
-    istm = strlen(stm);
-    ret = SQLExecDirect(conp->hstmtp->hstmt, (SQLCHAR *) stm, istm);
-    if (!SQLOK(ret))
-    {
-        LOG(LOG_ERR, "SQLExecDirect() failed:");
-        heer(SQL_HANDLE_STMT, conp->hstmtp->hstmt,
-             conp->mystat.errmsg, conp->mystat.emlen);
-        sta = ERR_SCM_SQL;
-        goto done;
-    }
-    len = 0;
-    ret = SQLRowCount(conp->hstmtp->hstmt, &len);
-    if (!SQLOK(ret))
-    {
-        LOG(LOG_ERR, "SQLRowCount() failed:");
-        heer(SQL_HANDLE_STMT, conp->hstmtp->hstmt,
-             conp->mystat.errmsg, conp->mystat.emlen);
-        sta = ERR_SCM_SQL;
-        goto done;
-    }
-done:
-    LOG(LOG_DEBUG, "statementscm() returning %s: %s",
-        err2name(sta), err2string(sta));
-    return sta;
+    perf_start(&timer);
+    sta = conp->backend->execute(conp, stm, curp);
+    perf_stop(&timer, PERF_STAGE_SQL_EXECUTE, OT_UNKNOWN);
+    return (sta);
 }
 
 err_code
@@ -315,19 +194,13 @@ statementscm_no_data(
     LOG(LOG_DEBUG, "statementscm_no_data(conp=%p, stm=\"%s\")", conp, stm);
 
     err_code sta = 0;
-    SQLRETURN ret;
 
-    ret = newhstmt(conp);
-    if (!SQLOK(ret))
+    if (conp == NULL || conp->connected == 0 || stm == NULL || stm[0] == 0)
     {
-        sta = ERR_SCM_SQL;
+        sta = ERR_SCM_INVALARG;
         goto done;
     }
-
-    sta = statementscm(conp, stm);
-
-    pophstmt(conp);
-
+    sta = executescm(conp, stm, NULL);
 done:
     LOG(LOG_DEBUG, "statementscm_no_data() returning %s: %s",
         err2name(sta), err2string(sta));
@@ -335,97 +208,137 @@ done:
 }
 
 err_code
-createdbscm(
+sqlcreatedb(
     scmcon *conp,
-    char *dbname,
-    char *dbuser)
+    const char *dbname)
 {
     char *mk;
     err_code sta;
     int leen;
 
-    if (dbname == NULL || dbname[0] == 0 || conp == NULL ||
-        conp->connected == 0 || dbuser == NULL || dbuser[0] == 0)
-        return (ERR_SCM_INVALARG);
-    leen = strlen(dbname) + strlen(dbuser) + 130;
+    leen = strlen(dbname) + 30;
     mk = (char *)calloc(leen, sizeof(char));
     if (mk == NULL)
         return (ERR_SCM_NOMEM);
     xsnprintf(mk, leen, "CREATE DATABASE %s;", dbname);
-    sta = statementscm_no_data(conp, mk);
+    sta = executescm(conp, mk, NULL);
     free((void *)mk);
     return (sta);
 }
 
 err_code
-deletedbscm(
+sqldeletedb(
     scmcon *conp,
-    char *dbname)
+    const char *dbname)
 {
     char *mk;
     err_code sta;
     int leen;
 
-    if (dbname == NULL || dbname[0] == 0 || conp == NULL ||
-        conp->connected == 0)
-        return (ERR_SCM_INVALARG);
     leen = strlen(dbname) + 30;
     mk = (char *)calloc(leen, sizeof(char));
     if (mk == NULL)
         return (ERR_SCM_NOMEM);
     xsnprintf(mk, leen, "DROP DATABASE IF EXISTS %s;", dbname);
-    sta = statementscm_no_data(conp, mk);
+    sta = executescm(conp, mk, NULL);
     free((void *)mk);
     return (sta);
 }
 
-/*
- * Create a single table.
- */
+err_code
+sqlusedb(
+    scmcon *conp,
+    const char *dbname)
+{
+    char *mk;
+    err_code sta;
+    int leen;
 
-static err_code
-createonetablescm(
+    leen = strlen(dbname) + 30;
+    mk = (char *)calloc(leen, sizeof(char));
+    if (mk == NULL)
+        return (ERR_SCM_NOMEM);
+    xsnprintf(mk, leen, "USE %s;", dbname);
+    sta = executescm(conp, mk, NULL);
+    free((void *)mk);
+    return (sta);
+}
+
+err_code
+sqlcreatetable(
     scmcon *conp,
-    scmtab *tabp)
+    const scmtab *tabp)
 {
     char *mk;
     err_code sta;
     int leen;
 
-    if (tabp->tstr == NULL || tabp->tstr[0] == 0)
-        return (0);             /* no op */
-    conp->mystat.tabname = tabp->hname;
     leen = strlen(tabp->tabname) + strlen(tabp->tstr) + 100;
     mk = (char *)calloc(leen, sizeof(char));
     if (mk == NULL)
         return (ERR_SCM_NOMEM);
     xsnprintf(mk, leen, "CREATE TABLE %s ( %s ) ENGINE=InnoDB;",
               tabp->tabname, tabp->tstr);
-    sta = statementscm_no_data(conp, mk);
+    sta = executescm(conp, mk, NULL);
     free((void *)mk);
     return (sta);
 }
 
+err_code
+createdbscm(
+    scmcon *conp,
+    char *dbname,
+    char *dbuser)
+{
+    if (dbname == NULL || dbname[0] == 0 || conp == NULL ||
+        conp->connected == 0 || dbuser == NULL || dbuser[0] == 0)
+        return (ERR_SCM_INVALARG);
+    memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
+    return (conp->backend->createdb(conp, dbname));
+}
+
+err_code
+deletedbscm(
+    scmcon *conp,
+    char *dbname)
+{
+    if (dbname == NULL || dbname[0] == 0 || conp == NULL ||
+        conp->connected == 0)
+        return (ERR_SCM_INVALARG);
+    memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
+    return (conp->backend->deletedb(conp, dbname));
+}
+
+/*
+ * Create a single table.
+ */
+
+static err_code
+createonetablescm(
+    scmcon *conp,
+    scmtab *tabp)
+{
+    if (tabp->tstr == NULL || tabp->tstr[0] == 0)
+        return (0);             /* no op */
+    conp->mystat.tabname = tabp->hname;
+    memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
+    return (conp->backend->createtable(conp, tabp));
+}
+
 err_code
 createalltablesscm(
     scmcon *conp,
     scm *scmp)
 {
-    char *mk;
     err_code sta = 0;
-    int leen;
     int i;
 
     if (conp == NULL || conp->connected == 0 || scmp == NULL)
         return (ERR_SCM_INVALARG);
     if (scmp->ntables > 0 && scmp->tables == NULL)
         return (ERR_SCM_INVALARG);
-    leen = strlen(scmp->db) + 30;
-    mk = (char *)calloc(leen, sizeof(char));
-    if (mk == NULL)
-        return (ERR_SCM_NOMEM);
-    xsnprintf(mk, leen, "USE %s;", scmp->db);
-    sta = statementscm_no_data(conp, mk);
+    memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
+    sta = conp->backend->usedb(conp, scmp->db);
     if (sta < 0)
         return (sta);
     for (i = 0; i < scmp->ntables; i++)
@@ -678,38 +591,6 @@ done:
     return (sta);
 }
 
-err_code
-getuintscm(
-    scmcon *conp,
-    unsigned int *ival)
-{
-    SQLUINTEGER f1;
-    SQLLEN f1len;
-    SQLRETURN rc;
-    int fnd = 0;
-
-    if (conp == NULL || conp->connected == 0 || ival == NULL)
-        return (ERR_SCM_INVALARG);
-    SQLBindCol(conp->hstmtp->hstmt, 1, SQL_C_ULONG, &f1, sizeof(f1), &f1len);
-    while (1)
-    {
-        rc = SQLFetch(conp->hstmtp->hstmt);
-        if (rc == SQL_NO_DATA)
-            break;
-        if (!SQLOK(rc))
-            continue;
-        if (f1len == SQL_NULL_DATA)
-            break;
-        fnd++;
-        *ival = (unsigned int)f1;
-    }
-    SQLCloseCursor(conp->hstmtp->hstmt);
-    if (fnd == 0)
-        return (ERR_SCM_NODATA);
-    else
-        return (0);
-}
-
 err_code
 getmaxidscm(
     scm *scmp,
@@ -724,33 +605,42 @@ getmaxidscm(
 
     char stmt[160];
     err_code sta = 0;
-    SQLRETURN sqlsta;
+    scmcursor *curp = NULL;
+    SQLUINTEGER maxid = 0;
+    scmsrch col = {
+        .colno = 1,
+        .sqltype = SQL_C_ULONG,
+        .colname = field,
+        .valptr = &maxid,
+        .valsize = sizeof(maxid),
+    };
+    scmsrcha srch = {
+        .vec = &col,
+        .ntot = 1,
+        .nused = 1,
+    };
 
     if (scmp == NULL || conp == NULL || conp->connected == 0 || ival == NULL)
     {
         sta = ERR_SCM_INVALARG;
         goto done;
     }
-    sqlsta = newhstmt(conp);
-    if (!SQLOK(sqlsta))
-    {
-        sta = ERR_SCM_SQL;
-        goto done;
-    }
     xsnprintf(stmt, sizeof(stmt),
               "SELECT MAX(%s) FROM %s;", field, mtab->tabname);
-    sta = statementscm(conp, stmt);
+    sta = executescm(conp, stmt, &curp);
     if (sta < 0)
     {
         goto done;
     }
+    // No rows (or NULL), set max to arbitrary value of 0.
     *ival = 0;
-    sta = getuintscm(conp, ival);
-    pophstmt(conp);
-    if (sta < 0)
-        *ival = 0;              /* No rows (or NULL), set max to arbitrary
-                                 * value of 0. */
-    sta = 0;
+    if (curp != NULL)
+    {
+        if (conp->backend->fetch(conp, curp, &srch) > 0 &&
+            col.avalsize != SQL_NULL_DATA)
+            *ival = (unsigned int)maxid;
+        conp->backend->close(conp, curp);
+    }
 done:
     LOG(LOG_DEBUG, "getmaxidscm() returning %s: %s",
         err2name(sta), err2string(sta));
@@ -793,6 +683,122 @@ validsrchscm(
     return (0);
 }
 
+/*
+ * Check that at most one of the value callback bits is set.
+ */
+static int
+validwhatscm(
+    int what)
+{
+    int bset = 0;
+
+    if ((what & SCM_SRCH_DOVALUE))
+    {
+        if ((what & SCM_SRCH_DOVALUE_ANN))
+            bset++;
+        if ((what & SCM_SRCH_DOVALUE_SNN))
+            bset++;
+        if ((what & SCM_SRCH_DOVALUE_ALWAYS))
+            bset++;
+    }
+    return (bset <= 1);
+}
+/*
+ * Count and/or fetch the rows of a cursor, calling the callbacks as
+ * requested by "what".  The caller closes the cursor.
+ */
+static err_code
+fetchscm(
+    scmcon *conp,
+    scmcursor *curp,
+    scmsrcha *srch,
+    sqlcountfunc *cnter,
+    sqlvaluefunc *valer,
+    int what)
+{
+    ssize_t nrows = 0;
+    int rc;
+    int docall;
+    err_code sta = 0;
+    int nfnd = 0;
+    ssize_t ridx = 0;
+    int nok = 0;
+    int fnd;
+    int i;
+    struct perf_timer timer;
+
+    // count rows and call counter function if requested
+    if ((what & SCM_SRCH_DOCOUNT) && cnter != NULL)
+    {
+        sta = conp->backend->rowcount(conp, curp, &nrows);
+        if (sta < 0)
+        {
+            if (what & SCM_SRCH_BREAK_CERR)
+                return (sta);
+            nrows = 0;
+        }
+        /** @bug ignores error code without explanation */
+        sta = (*cnter)(conp, srch, nrows);
+        if (sta < 0 && (what & SCM_SRCH_BREAK_CERR))
+            return (sta);
+    }
+    // loop over the results calling the value callback if requested
+    if ((what & SCM_SRCH_DOVALUE) && valer != NULL)
+    {
+        while (1)
+        {
+            ridx++;
+            perf_start(&timer);
+            rc = conp->backend->fetch(conp, curp, srch);
+            perf_stop(&timer, PERF_STAGE_SQL_FETCH, OT_UNKNOWN);
+            if (rc == 0)
+                break;
+            if (rc < 0)
+            {
+                nok++;
+                if (nok >= 2)
+                    break;
+                else
+                    continue;
+            }
+            // Count how many columns actually contain data.
+            // In addition, zero out any stale data to discourage misuse.
+            fnd = 0;
+            for (i = 0; i < srch->nused; i++)
+            {
+                if (srch->vec[i].avalsize != SQL_NULL_DATA)
+                    fnd++;
+                else            /* Zero out any stale data. */
+                    memset(srch->vec[i].valptr, 0, srch->vec[i].valsize);
+            }
+            if (fnd == 0)
+                continue;
+            nfnd++;
+            // determine if the function should be called and call it if so
+            // we have already validated that only one of these bits is set
+            docall = 0;
+            if ((what & SCM_SRCH_DOVALUE_ALWAYS))
+                docall++;
+            if ((what & SCM_SRCH_DOVALUE_SNN) && (fnd > 0))
+                docall++;
+            if ((what & SCM_SRCH_DOVALUE_ANN) && (fnd == srch->nused))
+                docall++;
+            if (docall > 0)
+            {
+                sta = (*valer)(conp, srch, ridx);
+                if ((sta < 0) && (what & SCM_SRCH_BREAK_VERR))
+                    break;
+            }
+        }
+    }
+    if (sta < 0)
+        return (sta);
+    if (nfnd == 0)
+        return (ERR_SCM_NODATA);
+    else
+        return (0);
+}
+
 err_code
 searchscm(
     scmcon *conp,
@@ -803,20 +809,12 @@ searchscm(
     int what,
     char *orderp)
 {
-    SQLLEN nrows = 0;
-    SQLRETURN rc;
-    scmsrch *vecp;
+    scmcursor *curp = NULL;
     char *stmt = NULL;
     char *quoted = NULL;
-    int docall;
     int leen = 100;
     err_code sta = 0;
-    int nfnd = 0;
-    int bset = 0;
-    ssize_t ridx = 0;
-    int nok = 0;
     int didw = 0;
-    int fnd;
     int i;
 
     // validate arguments
@@ -830,17 +828,8 @@ searchscm(
             return (sta);
         srch->vald = 1;
     }
-    if ((what & SCM_SRCH_DOVALUE))
-    {
-        if ((what & SCM_SRCH_DOVALUE_ANN))
-            bset++;
-        if ((what & SCM_SRCH_DOVALUE_SNN))
-            bset++;
-        if ((what & SCM_SRCH_DOVALUE_ALWAYS))
-            bset++;
-        if (bset > 1)
-            return (ERR_SCM_INVALARG);
-    }
+    if (!validwhatscm(what))
+        return (ERR_SCM_INVALARG);
     // construct the SELECT statement
     conp->mystat.tabname = tabp->hname;
     leen += strlen(tabp->tabname);
@@ -891,7 +880,7 @@ searchscm(
     }
     if ((what & SCM_SRCH_DO_JOIN_CRL))
     {
-        strcat(stmt, " LEFT JOIN rpki_crl on rpki_cert.aki = rpki_crl.aki");
+        strcat(stmt, " LEFT JOIN rpki_crl on rpki_cert.aki_bin = rpki_crl.aki_bin");
     }
     if (srch->where != NULL)
     {
@@ -938,126 +927,150 @@ searchscm(
     (void)strcat(stmt, ";");
 
     // execute the select statement
-    rc = newhstmt(conp);
-    if (!SQLOK(rc))
-    {
-        free((void *)stmt);
-        return (ERR_SCM_SQL);
-    }
-    sta = statementscm(conp, stmt);
+    sta = executescm(conp, stmt, &curp);
     free((void *)stmt);
     if (sta < 0)
-    {
-        SQLCloseCursor(conp->hstmtp->hstmt);
-        pophstmt(conp);
         return (sta);
-    }
-    // count rows and call counter function if requested
-    if ((what & SCM_SRCH_DOCOUNT) && cnter != NULL)
+    if (curp == NULL)
+        return (ERR_SCM_NODATA);
+    sta = fetchscm(conp, curp, srch, cnter, valer, what);
+    conp->backend->close(conp, curp);
+    return (sta);
+}
+
+/*
+ * Query text for enum scm_pstmt.  tabname is the table's hname, for
+ * error reporting.
+ */
+#define MFT_FILE_QUERY(table) \
+    "SELECT dirname, local_id, hash, flags FROM " table \
+    " LEFT JOIN rpki_dir ON " table ".dir_id = rpki_dir.dir_id" \
+    " WHERE filename=? AND is_onman=FALSE"
+
+#define SET_FLAGS_QUERY(table) \
+    "UPDATE " table " SET flags=? WHERE local_id=?"
+
+static const struct {
+    char *tabname;
+    const char *query;
+} pstmt_queries[SCM_PSTMT_NUM] = {
+    [SCM_PSTMT_DIR_ID] = {
+        "DIRECTORY",
+        "SELECT dir_id FROM rpki_dir WHERE dirname=?",
+    },
+    [SCM_PSTMT_CERT_PATHS] = {
+        "CERTIFICATE",
+        "SELECT filename, dirname, flags, aki, issuer FROM rpki_cert"
+        " LEFT JOIN rpki_dir ON rpki_cert.dir_id = rpki_dir.dir_id"
+        " WHERE ski_bin=?"
+        " AND subject_hash=UNHEX(SHA1(?)) AND subject=?"
+        " AND is_valid=TRUE",
+    },
+    [SCM_PSTMT_CERT_CHILDREN] = {
+        "CERTIFICATE",
+        "SELECT dirname, filename, flags, ski, subject, local_id, aki, issuer"
+        " FROM rpki_cert"
+        " LEFT JOIN rpki_dir ON rpki_cert.dir_id = rpki_dir.dir_id"
+        " WHERE aki_bin=? AND ski<>?"
+        " AND issuer_hash=UNHEX(SHA1(?)) AND issuer=?"
+        " AND is_valid=?",
+    },
+    [SCM_PSTMT_CRL_REVOKED] = {
+        "CRL",
+        "SELECT snlen, snlist FROM rpki_crl"
+        " WHERE issuer_hash=UNHEX(SHA1(?)) AND issuer=?"
+        " AND is_valid=TRUE",
+    },
+    [SCM_PSTMT_MFT_FILE_CERT] = {"CERTIFICATE", MFT_FILE_QUERY("rpki_cert")},
+    [SCM_PSTMT_MFT_FILE_CRL] = {"CRL", MFT_FILE_QUERY("rpki_crl")},
+    [SCM_PSTMT_MFT_FILE_ROA] = {"ROA", MFT_FILE_QUERY("rpki_roa")},
+    [SCM_PSTMT_MFT_FILE_GBR] = {
+        "GHOSTBUSTERS",
+        MFT_FILE_QUERY("rpki_ghostbusters"),
+    },
+    [SCM_PSTMT_SET_FLAGS_CERT] = {"CERTIFICATE", SET_FLAGS_QUERY("rpki_cert")},
+    [SCM_PSTMT_SET_FLAGS_CRL] = {"CRL", SET_FLAGS_QUERY("rpki_crl")},
+    [SCM_PSTMT_SET_FLAGS_ROA] = {"ROA", SET_FLAGS_QUERY("rpki_roa")},
+    [SCM_PSTMT_SET_FLAGS_MAN] = {"MANIFEST", SET_FLAGS_QUERY("rpki_manifest")},
+    [SCM_PSTMT_SET_FLAGS_GBR] = {
+        "GHOSTBUSTERS",
+        SET_FLAGS_QUERY("rpki_ghostbusters"),
+    },
+};
+
+/*
+ * Run prepared statement "which" through the connection's backend.
+ * See execute_prepared() in sqbackend.h.
+ */
+static err_code
+executepstmt(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const scmparam *params,
+    int nparams,
+    scmcursor **curp)
+{
+    struct perf_timer timer;
+    err_code sta;
+
+    memset(conp->mystat.errmsg, 0, conp->mystat.emlen);
+    conp->mystat.tabname = pstmt_queries[which].tabname;
+    perf_start(&timer);
+    sta = conp->backend->execute_prepared(conp, which,
+                                          pstmt_queries[which].query,
+                                          params, nparams, curp);
+    perf_stop(&timer, PERF_STAGE_SQL_EXECUTE, OT_UNKNOWN);
+    return (sta);
+}
+
+err_code
+searchscm_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const scmparam *params,
+    int nparams,
+    scmsrcha *srch,
+    sqlcountfunc *cnter,
+    sqlvaluefunc *valer,
+    int what)
+{
+    scmcursor *curp = NULL;
+    err_code sta;
+
+    if (conp == NULL || conp->connected == 0 || (int)which < 0 ||
+        which >= SCM_PSTMT_NUM || srch == NULL || srch->where != NULL ||
+        (params == NULL && nparams > 0))
+        return (ERR_SCM_INVALARG);
+    if (srch->vald == 0)
     {
-        /**
-         * @bug
-         *     The ODBC documentation for SQLRowCount() says:
-         *
-         *     > [T]he driver may define the value returned in
-         *     > *RowCountPtr.  For example, some data sources may be
-         *     > able to return the number of rows returned by a
-         *     > SELECT statement or a catalog function before
-         *     > fetching the rows.
-         *     >
-         *     > Note
-         *     >   Many data sources cannot return the number of rows
-         *     >   in a result set before fetching them; for maximum
-         *     >   interoperability, applications should not rely on
-         *     >   this behavior.
-         *
-         *     The following relies on that unreliable behavior.
-         *
-         *     There may be alternative ways to reliably get the
-         *     count; see http://stackoverflow.com/q/243782
-         */
-        rc = SQLRowCount(conp->hstmtp->hstmt, &nrows);
-        if (!SQLOK(rc) && (what & SCM_SRCH_BREAK_CERR))
-        {
-            heer(SQL_HANDLE_STMT, conp->hstmtp->hstmt,
-                 conp->mystat.errmsg, conp->mystat.emlen);
-            SQLCloseCursor(conp->hstmtp->hstmt);
-            pophstmt(conp);
-            return (ERR_SCM_SQL);
-        }
-        /** @bug ignores error code without explanation */
-        sta = (*cnter)(conp, srch, nrows);
-        if (sta < 0 && (what & SCM_SRCH_BREAK_CERR))
-        {
-            SQLCloseCursor(conp->hstmtp->hstmt);
-            pophstmt(conp);
+        sta = validsrchscm(conp, NULL, srch);
+        if (sta < 0)
             return (sta);
-        }
-    }
-    // loop over the results calling the value callback if requested
-    if ((what & SCM_SRCH_DOVALUE) && valer != NULL)
-    {
-        // do the column binding
-        for (i = 0; i < srch->nused; i++)
-        {
-            vecp = (&srch->vec[i]);
-            SQLBindCol(conp->hstmtp->hstmt,
-                       vecp->colno <= 0 ? i + 1 : vecp->colno, vecp->sqltype,
-                       vecp->valptr, vecp->valsize,
-                       &vecp->avalsize);
-        }
-        while (1)
-        {
-            ridx++;
-            rc = SQLFetch(conp->hstmtp->hstmt);
-            if (rc == SQL_NO_DATA)
-                break;
-            if (!SQLOK(rc))
-            {
-                nok++;
-                if (nok >= 2)
-                    break;
-                else
-                    continue;
-            }
-            // Count how many columns actually contain data.
-            // In addition, zero out any stale data to discourage misuse.
-            fnd = 0;
-            for (i = 0; i < srch->nused; i++)
-            {
-                if (srch->vec[i].avalsize != SQL_NULL_DATA)
-                    fnd++;
-                else            /* Zero out any stale data. */
-                    memset(srch->vec[i].valptr, 0, srch->vec[i].valsize);
-            }
-            if (fnd == 0)
-                continue;
-            nfnd++;
-            // determine if the function should be called and call it if so
-            // we have already validated that only one of these bits is set
-            docall = 0;
-            if ((what & SCM_SRCH_DOVALUE_ALWAYS))
-                docall++;
-            if ((what & SCM_SRCH_DOVALUE_SNN) && (fnd > 0))
-                docall++;
-            if ((what & SCM_SRCH_DOVALUE_ANN) && (fnd == srch->nused))
-                docall++;
-            if (docall > 0)
-            {
-                sta = (*valer)(conp, srch, ridx);
-                if ((sta < 0) && (what & SCM_SRCH_BREAK_VERR))
-                    break;
-            }
-        }
+        srch->vald = 1;
     }
-    SQLCloseCursor(conp->hstmtp->hstmt);
-    pophstmt(conp);
+    if (!validwhatscm(what))
+        return (ERR_SCM_INVALARG);
+    sta = executepstmt(conp, which, params, nparams, &curp);
     if (sta < 0)
         return (sta);
-    if (nfnd == 0)
+    if (curp == NULL)
         return (ERR_SCM_NODATA);
-    else
-        return (0);
+    sta = fetchscm(conp, curp, srch, cnter, valer, what);
+    conp->backend->close(conp, curp);
+    return (sta);
+}
+
+err_code
+statementscm_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const scmparam *params,
+    int nparams)
+{
+    if (conp == NULL || conp->connected == 0 || (int)which < 0 ||
+        which >= SCM_PSTMT_NUM || (params == NULL && nparams > 0))
+        return (ERR_SCM_INVALARG);
+    return (executepstmt(conp, which, params, nparams, NULL));
 }
 
 void freesrchscm(
@@ -1105,21 +1118,62 @@ void freesrchscm(
     }
 }
 
+/*
+ * Return the name of the generated column (see SCM_COLDEFS_STATE in
+ * scmmain.h) that mirrors a single flag, or NULL if there is none.
+ */
+static const char *
+flagcolumn(
+    int flagVal)
+{
+    switch (flagVal)
+    {
+    case SCM_FLAG_CA:
+        return "is_ca";
+    case SCM_FLAG_TRUSTED:
+        return "is_trusted";
+    case SCM_FLAG_VALID:
+        return "is_valid";
+    case SCM_FLAG_NOTYET:
+        return "is_notyet";
+    case SCM_FLAG_STALECRL:
+        return "is_stalecrl";
+    case SCM_FLAG_STALEMAN:
+        return "is_staleman";
+    case SCM_FLAG_ONMAN:
+        return "is_onman";
+    default:
+        return NULL;
+    }
+}
+
 void addFlagTest(
     char *whereStr,
     int flagVal,
     int isSet,
     int needAnd)
 {
+    const char *column = flagcolumn(flagVal);
+
+    /*
+     * Test the state column rather than the flags column so that the
+     * predicate can use an index.
+     */
+    if (column != NULL)
+    {
+        where_append(whereStr, "%s %s=%s",
+                     needAnd ? " and" : "",
+                     column,
+                     isSet ? "TRUE" : "FALSE");
+        return;
+    }
+
     /*
-     * Obfuscated note: the search where string is a spec that tells how to
-     * test for the value of a flag being set or clear in a total-flags value
-     * using the c mod operator '%'.  A simpler to follow way would be to
-     * test using bitwise and and then != 0 or == 0 test, but this is
-     * (presumably) not allowed.  The 'mod' test is best understood by example
-     * - so to test for flag 0x04 being set, take the value of total-flags mod
-     * (0x04 * 2) and see if it is >= 0x04 (in which case bit 0x04 is set),
-     * or < 0x04 (in which case bit 0x04 is not set).
+     * No state column for this flag; fall back to arithmetic on the
+     * flags column.  To test for flag 0x04 being set, take the value
+     * of total-flags mod (0x04 * 2) and see if it is >= 0x04 (in which
+     * case bit 0x04 is set), or < 0x04 (in which case bit 0x04 is not
+     * set).
      */
     where_append(whereStr, "%s ((flags%%%d)%s%d)",
                  needAnd ? " and" : "",
@@ -0,0 +1,1109 @@
+/*
+ * DatabaseBackend "embedded": each database is a SQLite file in
+ * DatabaseDir that is opened in-process, so no database server is
+ * involved in a query.
+ *
+ * The scm layer writes its SQL for MySQL.  Statements are translated
+ * on the way in (see translate()) and table definitions are rewritten
+ * (see embed_createtable()).  The few statements that can't be
+ * translated are chosen with scmdialect() by their callers.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <openssl/sha.h>
+#include <sqlite3.h>
+
+#include "scm.h"
+#include "scmf.h"
+#include "sqbackend.h"
+#include "err.h"
+#include "config/config.h"
+#include "util/stringutils.h"
+
+
+/*
+ * How long (milliseconds) to wait for another process to finish
+ * writing before giving up with "database is locked".
+ */
+#define EMBED_BUSY_TIMEOUT 60000
+
+/*
+ * Set up every connection to a database file.  WAL lets readers in
+ * other processes (e.g., query) run while the loader writes.  Up to
+ * 1 GiB of the file is mapped into memory, so that reads of it don't
+ * copy pages through SQLite's page cache.
+ */
+#define EMBED_PRAGMAS \
+    "PRAGMA journal_mode=WAL;" \
+    "PRAGMA synchronous=NORMAL;" \
+    "PRAGMA foreign_keys=ON;" \
+    "PRAGMA mmap_size=1073741824;"
+
+/*
+ * The rows of a result, copied out of the statement so that the
+ * statement can be reset (or reused by a nested search) while the
+ * rows are read.
+ */
+struct _scmcursor {
+    sqlite3_value **vals;       /* nrows rows of ncols values */
+    size_t nrows;
+    size_t ncols;
+    size_t next;                /* index of the next row to fetch */
+};
+
+struct embedcon {
+    sqlite3 *db;                /* NULL until a database is selected */
+    sqlite3_stmt *pstmts[SCM_PSTMT_NUM];        /* prepared on first use */
+};
+
+static void
+embedeer(
+    scmcon *conp,
+    sqlite3 *db,
+    const char *what)
+{
+    LOG(LOG_ERR, "%s failed: %d %s", what, sqlite3_errcode(db),
+        sqlite3_errmsg(db));
+    (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s",
+                   sqlite3_errmsg(db));
+}
+
+static void
+freecursor(
+    scmcursor *curp)
+{
+    size_t i;
+
+    if (curp == NULL)
+        return;
+    for (i = 0; i < curp->nrows * curp->ncols; i++)
+        sqlite3_value_free(curp->vals[i]);
+    free(curp->vals);
+    free((void *)curp);
+}
+
+/*
+ * SHA1(str): the SHA-1 digest of str in lowercase hex, as in MySQL.
+ */
+static void
+sqlfunc_sha1(
+    sqlite3_context *ctx,
+    int argc,
+    sqlite3_value **argv)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    unsigned char md[SHA_DIGEST_LENGTH];
+    char hex[2 * SHA_DIGEST_LENGTH];
+    const unsigned char *val;
+    int i;
+
+    UNREFERENCED_PARAMETER(argc);
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    val = sqlite3_value_blob(argv[0]);
+    SHA1(val != NULL ? val : (const unsigned char *)"",
+         sqlite3_value_bytes(argv[0]), md);
+    for (i = 0; i < SHA_DIGEST_LENGTH; i++)
+    {
+        hex[2 * i] = hexdigits[md[i] >> 4];
+        hex[2 * i + 1] = hexdigits[md[i] & 0xf];
+    }
+    sqlite3_result_text(ctx, hex, sizeof(hex), SQLITE_TRANSIENT);
+}
+
+/*
+ * UNHEX(str): the bytes spelled by a string of hex digits, or NULL if
+ * str isn't one, as in MySQL.
+ */
+static void
+sqlfunc_unhex(
+    sqlite3_context *ctx,
+    int argc,
+    sqlite3_value **argv)
+{
+    const unsigned char *hex;
+    unsigned char *out;
+    int len;
+    int pad;
+    int i;
+    int k;
+    int nibble;
+
+    UNREFERENCED_PARAMETER(argc);
+    hex = sqlite3_value_text(argv[0]);
+    if (hex == NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    len = sqlite3_value_bytes(argv[0]);
+    out = sqlite3_malloc(len / 2 + 1);
+    if (out == NULL)
+    {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+    // an odd number of digits has an implicit leading zero
+    pad = len % 2;
+    out[0] = 0;
+    for (i = 0; i < len; i++)
+    {
+        if (!isxdigit(hex[i]))
+        {
+            sqlite3_free(out);
+            sqlite3_result_null(ctx);
+            return;
+        }
+        nibble = isdigit(hex[i]) ? hex[i] - '0' : tolower(hex[i]) - 'a' + 10;
+        k = i + pad;
+        if (k % 2 == 0)
+            out[k / 2] = nibble << 4;
+        else
+            out[k / 2] |= nibble;
+    }
+    sqlite3_result_blob(ctx, out, (len + 1) / 2, sqlite3_free);
+}
+
+static void
+freeregex(
+    void *re)
+{
+    regfree((regex_t *)re);
+    sqlite3_free(re);
+}
+
+/*
+ * "str REGEXP pattern" calls regexp(pattern, str).  Matching is
+ * case-sensitive, as with MySQL's REGEXP BINARY, and a blob matches
+ * if any of its nul-separated pieces does.
+ */
+static void
+sqlfunc_regexp(
+    sqlite3_context *ctx,
+    int argc,
+    sqlite3_value **argv)
+{
+    regex_t *cached;
+    regex_t *re;
+    const char *pattern;
+    const char *str;
+    char *buf;
+    int len;
+    int off;
+    int matched = 0;
+
+    UNREFERENCED_PARAMETER(argc);
+    pattern = (const char *)sqlite3_value_text(argv[0]);
+    if (pattern == NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    // the compiled pattern is kept while the pattern is a constant
+    cached = sqlite3_get_auxdata(ctx, 0);
+    re = cached;
+    if (re == NULL)
+    {
+        re = sqlite3_malloc(sizeof(regex_t));
+        if (re == NULL)
+        {
+            sqlite3_result_error_nomem(ctx);
+            return;
+        }
+        if (regcomp(re, pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        {
+            sqlite3_free(re);
+            sqlite3_result_error(ctx, "invalid regular expression", -1);
+            return;
+        }
+    }
+    str = sqlite3_value_blob(argv[1]);
+    len = sqlite3_value_bytes(argv[1]);
+    buf = sqlite3_malloc(len + 1);
+    if (buf == NULL)
+        sqlite3_result_error_nomem(ctx);
+    else
+    {
+        if (len > 0)
+            memcpy(buf, str, len);
+        buf[len] = 0;
+        for (off = 0; off <= len && !matched; off += strlen(&buf[off]) + 1)
+            matched = (regexec(re, &buf[off], 0, NULL, 0) == 0);
+        sqlite3_free(buf);
+        sqlite3_result_int(ctx, matched);
+    }
+    // SQLite frees re when it's done with it, possibly right away
+    if (cached == NULL)
+        sqlite3_set_auxdata(ctx, 0, re, freeregex);
+}
+
+/*
+ * Get the name of a file making up a database.
+ */
+static char *
+dbpath(
+    const char *dbname,
+    const char *suffix)
+{
+    const char *dir = CONFIG_DATABASE_DIR_get();
+    size_t len = strlen(dir) + strlen(dbname) + strlen(suffix) + 5;
+    char *path;
+
+    path = malloc(len);
+    if (path != NULL)
+        xsnprintf(path, len, "%s/%s.db%s", dir, dbname, suffix);
+    return (path);
+}
+
+/*
+ * A database name becomes a file name, so it must not name a
+ * directory.
+ */
+static int
+validdbname(
+    scmcon *conp,
+    const char *dbname)
+{
+    if (dbname[0] == 0 || dbname[0] == '.' || strchr(dbname, '/') != NULL)
+    {
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                       "Incorrect database name '%s'", dbname);
+        LOG(LOG_ERR, "%s", conp->mystat.errmsg);
+        return (0);
+    }
+    return (1);
+}
+
+static void
+closedb(
+    struct embedcon *ec)
+{
+    int i;
+
+    for (i = 0; i < SCM_PSTMT_NUM; i++)
+    {
+        sqlite3_finalize(ec->pstmts[i]);
+        ec->pstmts[i] = NULL;
+    }
+    sqlite3_close(ec->db);
+    ec->db = NULL;
+}
+
+/*
+ * Select database dbname, which must exist.
+ */
+static err_code
+opendb(
+    scmcon *conp,
+    const char *dbname)
+{
+    struct embedcon *ec = conp->bdata;
+    sqlite3 *db = NULL;
+    char *path;
+    int rc;
+
+    closedb(ec);
+    if (!validdbname(conp, dbname))
+        return (ERR_SCM_INVALARG);
+    path = dbpath(dbname, "");
+    if (path == NULL)
+        return (ERR_SCM_NOMEM);
+    rc = sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE, NULL);
+    free(path);
+    if (db == NULL)
+        return (ERR_SCM_NOMEM);
+    if (rc == SQLITE_CANTOPEN)
+    {
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                       "Unknown database '%s'", dbname);
+        LOG(LOG_ERR, "%s", conp->mystat.errmsg);
+        sqlite3_close(db);
+        return (ERR_SCM_SQL);
+    }
+    if (rc != SQLITE_OK ||
+        sqlite3_busy_timeout(db, EMBED_BUSY_TIMEOUT) != SQLITE_OK ||
+        sqlite3_create_function(db, "SHA1", 1,
+                                SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                sqlfunc_sha1, NULL, NULL) != SQLITE_OK ||
+        sqlite3_create_function(db, "UNHEX", 1,
+                                SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                sqlfunc_unhex, NULL, NULL) != SQLITE_OK ||
+        sqlite3_create_function(db, "regexp", 2,
+                                SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                sqlfunc_regexp, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, EMBED_PRAGMAS, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        embedeer(conp, db, "opening the database");
+        sqlite3_close(db);
+        return (ERR_SCM_SQL);
+    }
+    ec->db = db;
+    return (0);
+}
+
+static void
+embed_disconnect(
+    scmcon *conp)
+{
+    struct embedcon *ec = conp->bdata;
+
+    closedb(ec);
+    free((void *)ec);
+    conp->bdata = NULL;
+}
+
+/*
+ * Only the DATABASE field of the DSN matters.  As with MySQL, a
+ * connection to "information_schema" (see rcli) has no database
+ * selected and is only good for creating and deleting databases.
+ */
+static err_code
+embed_connect(
+    scmcon *conp,
+    const char *dsn)
+{
+    struct embedcon *ec;
+    char *buf;
+    char *dbname;
+    err_code sta = 0;
+
+    ec = (struct embedcon *)calloc(1, sizeof(struct embedcon));
+    buf = malloc(strlen(dsn) + 1);
+    if (ec == NULL || buf == NULL)
+    {
+        free(ec);
+        free(buf);
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                       "Out of memory!");
+        return (ERR_SCM_NOMEM);
+    }
+    conp->bdata = ec;
+    dbname = dsnfield(dsn, "DATABASE", buf);
+    if (dbname != NULL && strcasecmp(dbname, "information_schema") != 0)
+        sta = opendb(conp, dbname);
+    free(buf);
+    return (sta);
+}
+
+/*
+ * Translate a MySQL statement to SQLite:
+ *
+ *   - "str" and 'str' with backslash escapes become 'str'
+ *   - 0x0123 becomes x'0123'
+ *   - REGEXP BINARY becomes REGEXP
+ *   - a <=> b becomes a IS b
+ *
+ * The result is at most twice as long as the statement.
+ */
+static char *
+translate(
+    const char *stm)
+{
+    char *out;
+    char *op;
+    const char *cp = stm;
+    const char *word;
+    int after_regexp = 0;
+    char quote;
+    char c;
+    size_t n;
+
+    out = malloc(2 * strlen(stm) + 1);
+    if (out == NULL)
+        return (NULL);
+    op = out;
+    while (*cp != 0)
+    {
+        if (*cp == '"' || *cp == '\'')
+        {
+            quote = *cp++;
+            *op++ = '\'';
+            while (*cp != 0)
+            {
+                c = *cp++;
+                if (c == quote && *cp == quote)
+                    cp++;
+                else if (c == quote)
+                    break;
+                else if (c == '\\' && *cp != 0)
+                {
+                    c = *cp++;
+                    switch (c)
+                    {
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case 'b':
+                        c = '\b';
+                        break;
+                    case 'Z':
+                        c = '\032';
+                        break;
+                    case '%':
+                    case '_':
+                        // still escaped for LIKE
+                        *op++ = '\\';
+                        break;
+                    }
+                }
+                if (c == '\'')
+                    *op++ = '\'';
+                *op++ = c;
+            }
+            *op++ = '\'';
+            after_regexp = 0;
+        }
+        else if (*cp == '`')
+        {
+            *op++ = *cp++;
+            while (*cp != 0 && *cp != '`')
+                *op++ = *cp++;
+            if (*cp != 0)
+                *op++ = *cp++;
+            after_regexp = 0;
+        }
+        else if (cp[0] == '0' && (cp[1] == 'x' || cp[1] == 'X') &&
+                 isxdigit((int)(unsigned char)cp[2]))
+        {
+            cp += 2;
+            n = 0;
+            while (isxdigit((int)(unsigned char)cp[n]))
+                n++;
+            *op++ = 'x';
+            *op++ = '\'';
+            if (n % 2 != 0)
+                *op++ = '0';
+            memcpy(op, cp, n);
+            op += n;
+            cp += n;
+            *op++ = '\'';
+            after_regexp = 0;
+        }
+        else if (strncmp(cp, "<=>", 3) == 0)
+        {
+            memcpy(op, " IS ", 4);
+            op += 4;
+            cp += 3;
+            after_regexp = 0;
+        }
+        else if (isalnum((int)(unsigned char)*cp) || *cp == '_')
+        {
+            word = cp;
+            while (isalnum((int)(unsigned char)*cp) || *cp == '_' ||
+                   *cp == '$')
+                cp++;
+            n = cp - word;
+            if (after_regexp && n == 6 && strncasecmp(word, "binary", 6) == 0)
+            {
+                after_regexp = 0;
+                continue;
+            }
+            after_regexp = (n == 6 && strncasecmp(word, "regexp", 6) == 0);
+            memcpy(op, word, n);
+            op += n;
+        }
+        else
+        {
+            if (!isspace((int)(unsigned char)*cp))
+                after_regexp = 0;
+            *op++ = *cp++;
+        }
+    }
+    *op = 0;
+    return (out);
+}
+
+/*
+ * Run a statement to completion, copying any rows it returns into a
+ * new cursor.
+ */
+static err_code
+runstmt(
+    scmcon *conp,
+    sqlite3_stmt *stmt,
+    scmcursor **curp)
+{
+    struct embedcon *ec = conp->bdata;
+    scmcursor *cur = NULL;
+    sqlite3_value **vals;
+    size_t ncols = sqlite3_column_count(stmt);
+    size_t nalloc = 0;
+    size_t i;
+    int rc;
+
+    *curp = NULL;
+    if (ncols > 0)
+    {
+        cur = (scmcursor *) calloc(1, sizeof(scmcursor));
+        if (cur == NULL)
+            return (ERR_SCM_NOMEM);
+        cur->ncols = ncols;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if ((cur->nrows + 1) * ncols > nalloc)
+        {
+            nalloc = (nalloc == 0) ? 16 * ncols : 2 * nalloc;
+            vals = realloc(cur->vals, nalloc * sizeof(sqlite3_value *));
+            if (vals == NULL)
+            {
+                freecursor(cur);
+                return (ERR_SCM_NOMEM);
+            }
+            cur->vals = vals;
+        }
+        vals = &cur->vals[cur->nrows * ncols];
+        for (i = 0; i < ncols; i++)
+        {
+            vals[i] = sqlite3_value_dup(sqlite3_column_value(stmt, i));
+            if (vals[i] == NULL)
+            {
+                while (i > 0)
+                    sqlite3_value_free(vals[--i]);
+                freecursor(cur);
+                return (ERR_SCM_NOMEM);
+            }
+        }
+        cur->nrows++;
+    }
+    if (rc != SQLITE_DONE)
+    {
+        embedeer(conp, ec->db, "sqlite3_step()");
+        freecursor(cur);
+        return (ERR_SCM_SQL);
+    }
+    if (cur != NULL)
+        conp->mystat.rows = (int)cur->nrows;
+    else
+        conp->mystat.rows = sqlite3_changes(ec->db);
+    *curp = cur;
+    return (0);
+}
+
+static err_code
+nodb(
+    scmcon *conp)
+{
+    (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                   "No database selected");
+    LOG(LOG_ERR, "%s", conp->mystat.errmsg);
+    return (ERR_SCM_SQL);
+}
+
+static err_code
+embed_execute(
+    scmcon *conp,
+    const char *stm,
+    scmcursor **curp)
+{
+    struct embedcon *ec = conp->bdata;
+    scmcursor *cur = NULL;
+    scmcursor *last = NULL;
+    sqlite3_stmt *stmt;
+    const char *tail;
+    char *sql;
+    err_code sta = 0;
+
+    if (curp != NULL)
+        *curp = NULL;
+    if (ec->db == NULL)
+        return (nodb(conp));
+    sql = translate(stm);
+    if (sql == NULL)
+        return (ERR_SCM_NOMEM);
+    // the rows of the last statement in stm are the result
+    for (tail = sql; sta == 0 && *tail != 0;)
+    {
+        if (sqlite3_prepare_v2(ec->db, tail, -1, &stmt, &tail) != SQLITE_OK)
+        {
+            LOG(LOG_ERR, "could not prepare statement: %s", stm);
+            embedeer(conp, ec->db, "sqlite3_prepare_v2()");
+            sta = ERR_SCM_SQL;
+            break;
+        }
+        if (stmt == NULL)
+            continue;
+        sta = runstmt(conp, stmt, &cur);
+        sqlite3_finalize(stmt);
+        if (sta == 0)
+        {
+            freecursor(last);
+            last = cur;
+        }
+    }
+    free(sql);
+    if (sta < 0 || curp == NULL)
+        freecursor(last);
+    else
+        *curp = last;
+    return (sta);
+}
+
+static err_code
+embed_execute_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const char *query,
+    const scmparam *params,
+    int nparams,
+    scmcursor **curp)
+{
+    struct embedcon *ec = conp->bdata;
+    sqlite3_stmt *stmt;
+    scmcursor *cur = NULL;
+    char *sql;
+    err_code sta = 0;
+    int rc = SQLITE_OK;
+    int i;
+
+    if (curp != NULL)
+        *curp = NULL;
+    if (ec->db == NULL)
+        return (nodb(conp));
+    stmt = ec->pstmts[which];
+    if (stmt == NULL)
+    {
+        sql = translate(query);
+        if (sql == NULL)
+            return (ERR_SCM_NOMEM);
+        rc = sqlite3_prepare_v3(ec->db, sql, -1, SQLITE_PREPARE_PERSISTENT,
+                                &stmt, NULL);
+        free(sql);
+        if (rc != SQLITE_OK)
+        {
+            LOG(LOG_ERR, "could not prepare query: %s", query);
+            embedeer(conp, ec->db, "sqlite3_prepare_v3()");
+            return (ERR_SCM_SQL);
+        }
+        ec->pstmts[which] = stmt;
+    }
+    // the parameters are only bound until the rows are copied out
+    for (i = 0; i < nparams && rc == SQLITE_OK; i++)
+    {
+        switch (params[i].sqltype)
+        {
+        case SQL_C_CHAR:
+            rc = sqlite3_bind_text(stmt, i + 1, params[i].valptr,
+                                   params[i].valsize == SQL_NTS ? -1 :
+                                   (int)params[i].valsize, SQLITE_STATIC);
+            break;
+        case SQL_C_BINARY:
+            rc = sqlite3_bind_blob(stmt, i + 1, params[i].valptr,
+                                   (int)params[i].valsize, SQLITE_STATIC);
+            break;
+        case SQL_C_ULONG:
+            rc = sqlite3_bind_int64(stmt, i + 1,
+                                    *(const SQLUINTEGER *)params[i].valptr);
+            break;
+        default:
+            sta = ERR_SCM_INVALARG;
+            break;
+        }
+    }
+    if (sta == 0 && rc != SQLITE_OK)
+    {
+        embedeer(conp, ec->db, "sqlite3_bind()");
+        sta = ERR_SCM_SQL;
+    }
+    if (sta == 0)
+        sta = runstmt(conp, stmt, &cur);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (curp != NULL)
+        *curp = cur;
+    else
+        freecursor(cur);
+    return (sta);
+}
+
+static err_code
+embed_rowcount(
+    scmcon *conp,
+    scmcursor *curp,
+    ssize_t *nrows)
+{
+    UNREFERENCED_PARAMETER(conp);
+    *nrows = (ssize_t)curp->nrows;
+    return (0);
+}
+
+static int
+embed_fetch(
+    scmcon *conp,
+    scmcursor *curp,
+    scmsrcha *srch)
+{
+    sqlite3_value **row;
+    sqlite3_value *val;
+    const void *ptr;
+    scmsrch *vecp;
+    size_t col;
+    unsigned n;
+    int len;
+    int ret = 1;
+    int i;
+
+    UNREFERENCED_PARAMETER(conp);
+    if (curp->next >= curp->nrows)
+        return (0);
+    row = &curp->vals[curp->next++ * curp->ncols];
+    for (i = 0; i < srch->nused; i++)
+    {
+        vecp = (&srch->vec[i]);
+        col = vecp->colno <= 0 ? (size_t)i : (size_t)vecp->colno - 1;
+        if (col >= curp->ncols || sqlite3_value_type(row[col]) == SQLITE_NULL)
+        {
+            vecp->avalsize = SQL_NULL_DATA;
+            continue;
+        }
+        val = row[col];
+        switch (vecp->sqltype)
+        {
+        case SQL_C_CHAR:
+        case SQL_C_BINARY:
+            if (vecp->sqltype == SQL_C_CHAR)
+                ptr = sqlite3_value_text(val);
+            else
+                ptr = sqlite3_value_blob(val);
+            len = sqlite3_value_bytes(val);
+            if (ptr == NULL && len > 0)
+            {
+                vecp->avalsize = SQL_NULL_DATA;
+                ret = ERR_SCM_NOMEM;
+                break;
+            }
+            n = (unsigned)len;
+            // leave room for the nul terminator, as ODBC does
+            if (vecp->sqltype == SQL_C_CHAR && n >= vecp->valsize)
+                n = vecp->valsize - 1;
+            else if (n > vecp->valsize)
+                n = vecp->valsize;
+            if (n > 0)
+                memcpy(vecp->valptr, ptr, n);
+            if (vecp->sqltype == SQL_C_CHAR)
+                ((char *)vecp->valptr)[n] = 0;
+            vecp->avalsize = len;
+            break;
+        case SQL_C_ULONG:
+            *(SQLUINTEGER *)vecp->valptr =
+                (SQLUINTEGER)sqlite3_value_int64(val);
+            vecp->avalsize = sizeof(SQLUINTEGER);
+            break;
+        case SQL_C_LONG:
+            *(SQLINTEGER *)vecp->valptr = (SQLINTEGER)sqlite3_value_int64(val);
+            vecp->avalsize = sizeof(SQLINTEGER);
+            break;
+        default:
+            LOG(LOG_ERR, "unsupported SQL C type %d for column %s",
+                vecp->sqltype, vecp->colname);
+            vecp->avalsize = SQL_NULL_DATA;
+            ret = ERR_SCM_INVALARG;
+            break;
+        }
+    }
+    return (ret);
+}
+
+static void
+embed_close(
+    scmcon *conp,
+    scmcursor *curp)
+{
+    UNREFERENCED_PARAMETER(conp);
+    freecursor(curp);
+}
+
+static err_code
+embed_createdb(
+    scmcon *conp,
+    const char *dbname)
+{
+    char *path;
+    int fd;
+
+    if (!validdbname(conp, dbname))
+        return (ERR_SCM_INVALARG);
+    path = dbpath(dbname, "");
+    if (path == NULL)
+        return (ERR_SCM_NOMEM);
+    // an empty file is an empty database
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        if (errno == EEXIST)
+            (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                           "Can't create database '%s'; database exists",
+                           dbname);
+        else
+            (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                           "Can't create database '%s': %s: %s", dbname,
+                           path, strerror(errno));
+        LOG(LOG_ERR, "%s", conp->mystat.errmsg);
+        free(path);
+        return (ERR_SCM_COFILE);
+    }
+    close(fd);
+    free(path);
+    return (0);
+}
+
+static err_code
+embed_deletedb(
+    scmcon *conp,
+    const char *dbname)
+{
+    static const char *suffixes[] = {"", "-wal", "-shm"};
+    char *path;
+    err_code sta = 0;
+    size_t i;
+
+    if (!validdbname(conp, dbname))
+        return (ERR_SCM_INVALARG);
+    for (i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]) && sta == 0; i++)
+    {
+        path = dbpath(dbname, suffixes[i]);
+        if (path == NULL)
+            return (ERR_SCM_NOMEM);
+        if (unlink(path) != 0 && errno != ENOENT)
+        {
+            (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen,
+                           "Can't drop database '%s': %s: %s", dbname,
+                           path, strerror(errno));
+            LOG(LOG_ERR, "%s", conp->mystat.errmsg);
+            sta = ERR_SCM_COFILE;
+        }
+        free(path);
+    }
+    return (sta);
+}
+
+static err_code
+embed_usedb(
+    scmcon *conp,
+    const char *dbname)
+{
+    return (opendb(conp, dbname));
+}
+
+/*
+ * Get the next definition of a table: columns and constraints are
+ * separated by commas outside parentheses.  Returns NULL after the
+ * last one.
+ */
+static const char *
+nextdef(
+    const char **cpp,
+    size_t *lenp)
+{
+    const char *def = *cpp;
+    const char *cp;
+    int depth = 0;
+
+    while (isspace((int)(unsigned char)*def))
+        def++;
+    if (*def == 0)
+        return (NULL);
+    for (cp = def; *cp != 0 && (*cp != ',' || depth > 0); cp++)
+    {
+        if (*cp == '(')
+            depth++;
+        else if (*cp == ')')
+            depth--;
+    }
+    *lenp = cp - def;
+    while (*lenp > 0 && isspace((int)(unsigned char)def[*lenp - 1]))
+        (*lenp)--;
+    *cpp = (*cp == ',') ? cp + 1 : cp;
+    return (def);
+}
+
+/*
+ * If a definition is an index ("[UNIQUE] KEY [name] (columns)"), get
+ * the text after KEY.
+ */
+static const char *
+keydef(
+    const char *def,
+    size_t len,
+    int *uniquep)
+{
+    *uniquep = (len > 7 && strncasecmp(def, "UNIQUE ", 7) == 0);
+    if (*uniquep)
+    {
+        def += 7;
+        len -= 7;
+        while (len > 0 && isspace((int)(unsigned char)*def))
+        {
+            def++;
+            len--;
+        }
+    }
+    if (len > 4 && strncasecmp(def, "KEY", 3) == 0 &&
+        (isspace((int)(unsigned char)def[3]) || def[3] == '('))
+        return (def + 3);
+    return (NULL);
+}
+
+/*
+ * Create an index for a "KEY" definition.  SQLite index names are
+ * global, so they are prefixed with the table name.  Prefix lengths
+ * (e.g., "dirname(512)") are dropped: SQLite indexes whole values.
+ */
+static err_code
+createindex(
+    scmcon *conp,
+    const scmtab *tabp,
+    const char *def,
+    size_t len,
+    int unique,
+    int num)
+{
+    const char *end = def + len;
+    const char *name = NULL;
+    size_t namelen = 0;
+    char *stmt;
+    char *op;
+    err_code sta;
+    size_t leen;
+    size_t n;
+
+    while (def < end && isspace((int)(unsigned char)*def))
+        def++;
+    if (def < end && *def != '(')
+    {
+        if (*def == '`')
+            def++;
+        name = def;
+        while (def < end && *def != '`' && *def != '(' &&
+               !isspace((int)(unsigned char)*def))
+            def++;
+        namelen = def - name;
+        while (def < end && *def != '(')
+            def++;
+    }
+    leen = 2 * strlen(tabp->tabname) + namelen + (end - def) + 64;
+    stmt = malloc(leen);
+    if (stmt == NULL)
+        return (ERR_SCM_NOMEM);
+    if (name != NULL)
+        op = stmt + xsnprintf(stmt, leen, "CREATE %sINDEX %s_%.*s ON %s ",
+                              unique ? "UNIQUE " : "", tabp->tabname,
+                              (int)namelen, name, tabp->tabname);
+    else
+        op = stmt + xsnprintf(stmt, leen, "CREATE %sINDEX %s_%d ON %s ",
+                              unique ? "UNIQUE " : "", tabp->tabname, num,
+                              tabp->tabname);
+    while (def < end)
+    {
+        if (def[0] == '(' && isdigit((int)(unsigned char)def[1]))
+        {
+            n = strspn(&def[1], "0123456789");
+            if (def[1 + n] == ')')
+            {
+                def += n + 2;
+                continue;
+            }
+        }
+        *op++ = *def++;
+    }
+    *op++ = ';';
+    *op = 0;
+    sta = embed_execute(conp, stmt, NULL);
+    free(stmt);
+    return (sta);
+}
+
+/*
+ * Create a table from its MySQL definition.  SQLite takes the column
+ * types, generated columns and constraints as they are, but indexes
+ * are separate statements, and there is no ON UPDATE for a column's
+ * value (ts_mod is only set on insert).
+ */
+static err_code
+embed_createtable(
+    scmcon *conp,
+    const scmtab *tabp)
+{
+    static const char onupdate[] = " ON UPDATE CURRENT_TIMESTAMP";
+    const char *cp;
+    const char *def;
+    char *stmt;
+    char *op;
+    char *found;
+    err_code sta;
+    size_t leen;
+    size_t len;
+    int unique;
+    int num;
+
+    leen = strlen(tabp->tabname) + 2 * strlen(tabp->tstr) + 32;
+    stmt = malloc(leen);
+    if (stmt == NULL)
+        return (ERR_SCM_NOMEM);
+    op = stmt + xsnprintf(stmt, leen, "CREATE TABLE %s (", tabp->tabname);
+    cp = tabp->tstr;
+    while ((def = nextdef(&cp, &len)) != NULL)
+    {
+        if (keydef(def, len, &unique) != NULL)
+            continue;
+        if (op[-1] != '(')
+            *op++ = ',';
+        *op++ = ' ';
+        memcpy(op, def, len);
+        op[len] = 0;
+        found = strstr(op, onupdate);
+        if (found != NULL)
+        {
+            memmove(found, found + strlen(onupdate),
+                    strlen(found + strlen(onupdate)) + 1);
+            len -= strlen(onupdate);
+        }
+        op += len;
+    }
+    strcpy(op, " );");
+    sta = embed_execute(conp, stmt, NULL);
+    free(stmt);
+    cp = tabp->tstr;
+    for (num = 1; sta == 0 && (def = nextdef(&cp, &len)) != NULL; num++)
+    {
+        const char *key = keydef(def, len, &unique);
+
+        if (key != NULL)
+            sta = createindex(conp, tabp, key, len - (key - def), unique, num);
+    }
+    return (sta);
+}
+
+const struct scm_backend scm_backend_embedded = {
+    .name = "embedded",
+    .dialect = SCM_DIALECT_SQLITE,
+    .connect = embed_connect,
+    .disconnect = embed_disconnect,
+    .execute = embed_execute,
+    .execute_prepared = embed_execute_prepared,
+    .rowcount = embed_rowcount,
+    .fetch = embed_fetch,
+    .close = embed_close,
+    .createdb = embed_createdb,
+    .deletedb = embed_deletedb,
+    .usedb = embed_usedb,
+    .createtable = embed_createtable,
+};
@@ -18,11 +18,14 @@
 #include "diru.h"
 #include "myssl.h"
 #include "err.h"
+#include "loadstate.h"
+#include "perf.h"
 #include "rpwork.h"
 #include "casn/casn.h"
 #include "rpki-asn1/crlv2.h"
 
 #include "cms/roa_utils.h"
+#include "config/config.h"
 #include "util/logging.h"
 #include "util/macros.h"
 #include "util/stringutils.h"
@@ -118,6 +121,69 @@ static void initTables(
     }
 }
 
+static sqlvaluefunc ok;
+
+static unsigned int preload_dir_id;
+static char preload_dirname[PATH_MAX];
+
+static sqlvaluefunc preload_dir;
+err_code
+preload_dir(
+    scmcon *conp,
+    scmsrcha *s,
+    ssize_t idx)
+{
+    UNREFERENCED_PARAMETER(conp);
+    UNREFERENCED_PARAMETER(s);
+    UNREFERENCED_PARAMETER(idx);
+    return (loadstate_dir_put(preload_dirname, preload_dir_id));
+}
+
+err_code
+preload_dirs(
+    scm *scmp,
+    scmcon *conp)
+{
+    err_code sta;
+
+    if (scmp == NULL || conp == NULL || conp->connected == 0)
+        return (ERR_SCM_INVALARG);
+    conp->mystat.tabname = "DIRECTORY";
+    initTables(scmp);
+    scmsrch srch1[] = {
+        {
+            .colno = 1,
+            .sqltype = SQL_C_ULONG,
+            .colname = "dir_id",
+            .valptr = &preload_dir_id,
+            .valsize = sizeof(preload_dir_id),
+            .avalsize = 0,
+        },
+        {
+            .colno = 2,
+            .sqltype = SQL_C_CHAR,
+            .colname = "dirname",
+            .valptr = preload_dirname,
+            .valsize = sizeof(preload_dirname),
+            .avalsize = 0,
+        },
+    };
+    scmsrcha srch = {
+        .vec = srch1,
+        .sname = NULL,
+        .ntot = ELTS(srch1),
+        .nused = ELTS(srch1),
+        .vald = 0,
+        .where = NULL,
+        .wherestr = NULL,
+    };
+    sta = searchscm(conp, theDirTable, &srch, NULL, &preload_dir,
+                    SCM_SRCH_DOVALUE_ALWAYS, NULL);
+    if (sta == ERR_SCM_NODATA)
+        sta = 0;
+    return (sta);
+}
+
 err_code
 findorcreatedir(
     scm *scmp,
@@ -127,11 +193,38 @@ findorcreatedir(
 {
     scmsrcha *srch;
     err_code sta;
+    unsigned int dir_id = 0;
+    scmsrch idcol = {
+        .colno = 1,
+        .sqltype = SQL_C_ULONG,
+        .colname = "dir_id",
+        .valptr = &dir_id,
+        .valsize = sizeof(dir_id),
+    };
+    scmsrcha idsrch = {
+        .vec = &idcol,
+        .ntot = 1,
+        .nused = 1,
+    };
+    scmparam param = {SQL_C_CHAR, dirname, SQL_NTS};
 
     if (conp == NULL || conp->connected == 0 || dirname == NULL ||
         dirname[0] == 0 || idp == NULL)
         return (ERR_SCM_INVALARG);
     *idp = (unsigned int)(-1);
+    if (loadstate_dir_get(dirname, idp))
+        return (0);
+    // nearly every directory already exists, so try the prepared
+    // lookup before the find-or-create
+    sta = searchscm_prepared(conp, SCM_PSTMT_DIR_ID, &param, 1, &idsrch,
+                             NULL, &ok, SCM_SRCH_DOVALUE_ANN);
+    if (sta == 0)
+    {
+        *idp = dir_id;
+        return (loadstate_dir_put(dirname, dir_id));
+    }
+    if (sta != ERR_SCM_NODATA)
+        return (sta);
     conp->mystat.tabname = "DIRECTORY";
     initTables(scmp);
     scmkv two[] = {
@@ -162,10 +255,11 @@ findorcreatedir(
     srch->where = &where;
     sta = searchorcreatescm(scmp, conp, theDirTable, srch, &ins, idp);
     freesrchscm(srch);
+    if (sta == 0)
+        sta = loadstate_dir_put(dirname, *idp);
     return (sta);
 }
 
-static sqlvaluefunc ok;
 err_code
 ok(
     scmcon *conp,
@@ -243,6 +337,77 @@ char *retrieve_tdir(
     return (oot);
 }
 
+err_code
+get_db_generation(
+    scm *scmp,
+    scmcon *conp,
+    unsigned int *genp,
+    char *dbid,
+    size_t dbidlen)
+{
+    if (scmp == NULL || conp == NULL || conp->connected == 0 ||
+        genp == NULL || dbid == NULL || dbidlen == 0)
+        return (ERR_SCM_INVALARG);
+    conp->mystat.tabname = "METADATA";
+    initTables(scmp);
+    scmkv one[] = {
+        {"local_id", "1"},
+    };
+    scmkva where = {
+        .vec = one,
+        .ntot = ELTS(one),
+        .nused = ELTS(one),
+        .vald = 0,
+    };
+    scmsrch srch1[] = {
+        {
+            .colno = 1,
+            .sqltype = SQL_C_ULONG,
+            .colname = "generation",
+            .valptr = genp,
+            .valsize = sizeof(*genp),
+            .avalsize = 0,
+        },
+        {
+            .colno = 2,
+            .sqltype = SQL_C_CHAR,
+            .colname = "inited",
+            .valptr = dbid,
+            .valsize = dbidlen,
+            .avalsize = 0,
+        },
+    };
+    scmsrcha srch = {
+        .vec = srch1,
+        .sname = NULL,
+        .ntot = ELTS(srch1),
+        .nused = ELTS(srch1),
+        .vald = 0,
+        .where = &where,
+        .wherestr = NULL,
+    };
+    *genp = 0;
+    dbid[0] = 0;
+    return (searchscm(conp, theMetaTable, &srch, NULL,
+                      &ok, SCM_SRCH_DOVALUE_ALWAYS, NULL));
+}
+
+err_code
+bump_db_generation(
+    scm *scmp,
+    scmcon *conp)
+{
+    char stmt[128];
+
+    if (scmp == NULL || conp == NULL || conp->connected == 0)
+        return (ERR_SCM_INVALARG);
+    initTables(scmp);
+    xsnprintf(stmt, sizeof(stmt),
+              "UPDATE %s SET generation = generation + 1 WHERE local_id = 1;",
+              theMetaTable->tabname);
+    return (statementscm_no_data(conp, stmt));
+}
+
 /*
  * Ask the DB if it has any matching signatures to the one passed in. This
  * function works on any of the three tables that have signatures.
@@ -263,15 +428,8 @@ dupsigscm(
         return (ERR_SCM_INVALARG);
     conp->mystat.tabname = tabp->hname;
     initTables(scmp);
-    scmkv one[] = {
-        {"sig", msig},
-    };
-    scmkva where = {
-        .vec = one,
-        .ntot = ELTS(one),
-        .nused = ELTS(one),
-        .vald = 0,
-    };
+    char where[WHERESTR_SIZE] = "";
+    where_append_hashed(where, "sig", msig);
     scmsrch srch1[] = {
         {
             .colno = 1,
@@ -288,8 +446,8 @@ dupsigscm(
         .ntot = ELTS(srch1),
         .nused = ELTS(srch1),
         .vald = 0,
-        .where = &where,
-        .wherestr = NULL,
+        .where = NULL,
+        .wherestr = where,
     };
     sta = searchscm(conp, tabp, &srch, NULL,
                     &ok, SCM_SRCH_DOVALUE_ALWAYS, NULL);
@@ -564,8 +722,10 @@ get_cert_sigval(
         ADDCOL(sigsrch, "sigval", SQL_C_ULONG, sizeof(unsigned int), sta,
                SIGVAL_UNKNOWN);
     }
-    xsnprintf(sigsrch->wherestr, WHERESTR_SIZE,
-              "ski=\"%s\" and subject=\"%s\"", ski, subj);
+    sigsrch->wherestr[0] = 0;
+    where_append_keyid(sigsrch->wherestr, "ski", ski);
+    where_append(sigsrch->wherestr, " and ");
+    where_append_hashed(sigsrch->wherestr, "subject", subj);
     sta = searchscm(conp, theCertTable, sigsrch, NULL, &ok,
                     SCM_SRCH_DOVALUE_ALWAYS, NULL);
     if (sta < 0)
@@ -602,7 +762,8 @@ get_roa_sigval(
         ADDCOL(sigsrch, "sigval", SQL_C_ULONG, sizeof(unsigned int), sta,
                SIGVAL_UNKNOWN);
     }
-    xsnprintf(sigsrch->wherestr, WHERESTR_SIZE, "ski=\"%s\"", ski);
+    sigsrch->wherestr[0] = 0;
+    where_append_keyid(sigsrch->wherestr, "ski", ski);
     sta = searchscm(conp, theROATable, sigsrch, NULL, &ok,
                     SCM_SRCH_DOVALUE_ALWAYS, NULL);
     if (sta < 0)
@@ -648,19 +809,21 @@ set_cert_sigval(
     const char *ski,
     sigval_state valu)
 {
+    char where[WHERESTR_SIZE] = "";
     /** @bug magic number */
-    char stmt[520];
+    char stmt[WHERESTR_SIZE + 128];
     err_code sta;
 
     if (theSCMP != NULL)
         initTables(theSCMP);
     if (theCertTable == NULL)
         return ERR_SCM_NOSUCHTAB;
-    char escaped_subj[2 * strlen(subj) + 1];
-    mysql_escape_string(escaped_subj, subj, strlen(subj));
+    where_append_keyid(where, "ski", ski);
+    where_append(where, " and ");
+    where_append_hashed(where, "subject", subj);
     xsnprintf(stmt, sizeof(stmt),
-              "update %s set sigval=%d where ski=\"%s\" and subject=\"%s\";",
-              theCertTable->tabname, valu, ski, escaped_subj);
+              "update %s set sigval=%d where %s;",
+              theCertTable->tabname, valu, where);
     sta = statementscm_no_data(conp, stmt);
     return sta;
 }
@@ -671,17 +834,19 @@ set_roa_sigval(
     const char *ski,
     sigval_state valu)
 {
+    char where[WHERESTR_SIZE] = "";
     /** @bug magic number */
-    char stmt[520];
+    char stmt[WHERESTR_SIZE + 128];
     err_code sta;
 
     if (theSCMP != NULL)
         initTables(theSCMP);
     if (theROATable == NULL)
         return ERR_SCM_NOSUCHTAB;
+    where_append_keyid(where, "ski", ski);
     xsnprintf(stmt, sizeof(stmt),
-              "update %s set sigval=%d where ski=\"%s\";",
-              theROATable->tabname, valu, ski);
+              "update %s set sigval=%d where %s;",
+              theROATable->tabname, valu, where);
     sta = statementscm_no_data(conp, stmt);
     return sta;
 }
@@ -1266,14 +1431,13 @@ find_certs(
 
     // find the entry whose subject is our issuer and whose ski is our aki,
     // e.g. our parent
-    if (subject != NULL){
-        char escaped [strlen(subject)*2+1];
-        mysql_escape_string(escaped, subject, strlen(subject));
-        xsnprintf(certSrch->wherestr, WHERESTR_SIZE,
-                  "ski=\'%s\' and subject=\'%s\'", ski, escaped);
+    certSrch->wherestr[0] = 0;
+    where_append_keyid(certSrch->wherestr, "ski", ski);
+    if (subject != NULL)
+    {
+        where_append(certSrch->wherestr, " and ");
+        where_append_hashed(certSrch->wherestr, "subject", subject);
     }
-    else
-        xsnprintf(certSrch->wherestr, WHERESTR_SIZE, "ski=\'%s\'", ski);
     addFlagTest(certSrch->wherestr, SCM_FLAG_VALID, 1, 1);
 
     sta = searchscm(conp, theCertTable, certSrch, NULL, &addCert2List,
@@ -1428,10 +1592,11 @@ struct cert_answers *find_cert_by_aKI(
     found_certs->num_ansrs = 0;
     certSrch->context = found_certs;
 
+    certSrch->wherestr[0] = 0;
     if (ski)
-        xsnprintf(certSrch->wherestr, WHERESTR_SIZE, "ski=\'%s\'", ski);
+        where_append_keyid(certSrch->wherestr, "ski", ski);
     else
-        xsnprintf(certSrch->wherestr, WHERESTR_SIZE, "aki=\'%s\'", aki);
+        where_append_keyid(certSrch->wherestr, "aki", aki);
     addFlagTest(certSrch->wherestr, SCM_FLAG_VALID, 1, 1);
 
     sta = searchscm(conp, theCertTable, certSrch, NULL, &addCert2List,
@@ -1543,7 +1708,7 @@ cert_revoked(
     // set up query once first time through and then just modify
     if (revokedSrch == NULL)
     {
-        revokedSrch = newsrchscm(NULL, 2, 0, 1);
+        revokedSrch = newsrchscm(NULL, 2, 0, 0);
         initTables(scmp);
         ADDCOL(revokedSrch, "snlen", SQL_C_ULONG, sizeof(unsigned int),
                sta, sta);
@@ -1555,10 +1720,10 @@ cert_revoked(
     }
     // query for crls such that issuer = issuer, and flags & valid
     // and set isRevoked = 1 in the callback if sn is in snlist
-    char escaped [strlen(issuer)*2+1];
-    mysql_escape_string(escaped, issuer, strlen(issuer));
-    xsnprintf(revokedSrch->wherestr, WHERESTR_SIZE, "issuer=\"%s\"", escaped);
-    addFlagTest(revokedSrch->wherestr, SCM_FLAG_VALID, 1, 1);
+    scmparam params[] = {
+        {SQL_C_CHAR, issuer, SQL_NTS},
+        {SQL_C_CHAR, issuer, SQL_NTS},
+    };
     isRevoked = 0;
     sn_len = strlen(sn);
     if (sn_len != 2 + 2*SER_NUM_MAX_SZ) // "^x" followed by hex
@@ -1573,8 +1738,9 @@ cert_revoked(
         goto done;
     }
     /** @bug ignores error code without explanation */
-    sta = searchscm(conp, theCRLTable, revokedSrch, NULL, &revokedHandler,
-                    SCM_SRCH_DOVALUE_ALWAYS, NULL);
+    sta = searchscm_prepared(conp, SCM_PSTMT_CRL_REVOKED, params,
+                             ELTS(params), revokedSrch, NULL, &revokedHandler,
+                             SCM_SRCH_DOVALUE_ALWAYS);
     free(revokedSN);
     revokedSN = NULL;
     sta = isRevoked ? ERR_SCM_REVOKED : 0;
@@ -1802,13 +1968,9 @@ find_cert_paths_internal(
             .valsize = sizeof(issuer),
         },
     };
-    char where[WHERESTR_SIZE];
-    size_t subject_len = strlen(subject);
-    char subject_escaped[subject_len*2+1];
-    mysql_escape_string(subject_escaped, subject, subject_len);
-    xsnprintf(where, sizeof(where),
-              "(`flags` & 0x%x) != 0 AND `ski` = '%s' AND `subject` = '%s'",
-              SCM_FLAG_VALID, ski, subject_escaped);
+    char where[WHERESTR_SIZE] = "";
+    unsigned char ski_bin[SKISIZE];
+    int ski_bin_len = keyid_to_bin(ski, ski_bin, sizeof(ski_bin));
     scmsrcha srch = {
         .vec = srchvec,
         .ntot = ELTS(srchvec),
@@ -1817,9 +1979,30 @@ find_cert_paths_internal(
         .context = ctx,
     };
 
-    sta = searchscm(
-        conp, theCertTable, &srch, NULL, &find_cert_paths_handle_row,
-        SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_BREAK_VERR | SCM_SRCH_DO_JOIN, NULL);
+    if (ski_bin_len > 0)
+    {
+        scmparam params[] = {
+            {SQL_C_BINARY, ski_bin, ski_bin_len},
+            {SQL_C_CHAR, subject, SQL_NTS},
+            {SQL_C_CHAR, subject, SQL_NTS},
+        };
+        sta = searchscm_prepared(
+            conp, SCM_PSTMT_CERT_PATHS, params, ELTS(params), &srch, NULL,
+            &find_cert_paths_handle_row,
+            SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_BREAK_VERR);
+    }
+    else
+    {
+        // malformed SKI; compare against the text column
+        where_append_keyid(where, "ski", ski);
+        where_append(where, " AND ");
+        where_append_hashed(where, "subject", subject);
+        addFlagTest(where, SCM_FLAG_VALID, 1, 1);
+        sta = searchscm(
+            conp, theCertTable, &srch, NULL, &find_cert_paths_handle_row,
+            SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_BREAK_VERR | SCM_SRCH_DO_JOIN,
+            NULL);
+    }
     if (ERR_SCM_NODATA == sta)
     {
         sta = 0;
@@ -1970,7 +2153,9 @@ verify_cert(
         conp, cert, isTrusted, aki, issuer);
 
     err_code sta = 0;
+    struct perf_timer timer;
 
+    perf_start(&timer);
     if (isTrusted)
     {
         // trust anchor
@@ -2000,6 +2185,7 @@ verify_cert(
     sta = ctx.success ? 0 : ERR_SCM_NOTVALID;
 
 done:
+    perf_stop(&timer, PERF_STAGE_VERIFY_CERT, OT_CER);
     LOG(LOG_DEBUG, "verify_cert() returning %s: %s",
         err2name(sta), err2string(sta));
     return (sta);
@@ -2153,6 +2339,46 @@ done:
     return sta;
 }
 
+/**
+ * @brief
+ *     set the flags of the object with the given local_id, using the
+ *     table's prepared update statement
+ */
+static err_code
+set_flags(
+    scmcon *conp,
+    scmtab *tabp,
+    unsigned int id,
+    unsigned int flags)
+{
+    enum scm_pstmt which;
+    char stmt[150];
+
+    if (tabp == theCertTable)
+        which = SCM_PSTMT_SET_FLAGS_CERT;
+    else if (tabp == theCRLTable)
+        which = SCM_PSTMT_SET_FLAGS_CRL;
+    else if (tabp == theROATable)
+        which = SCM_PSTMT_SET_FLAGS_ROA;
+    else if (tabp == theManifestTable)
+        which = SCM_PSTMT_SET_FLAGS_MAN;
+    else if (tabp == theGBRTable)
+        which = SCM_PSTMT_SET_FLAGS_GBR;
+    else
+    {
+        xsnprintf(stmt, sizeof(stmt),
+                  "update %s set flags=%u where local_id=%u;",
+                  tabp->tabname, flags, id);
+        return statementscm_no_data(conp, stmt);
+    }
+
+    scmparam params[] = {
+        {SQL_C_ULONG, &flags, 0},
+        {SQL_C_ULONG, &id, 0},
+    };
+    return statementscm_prepared(conp, which, params, ELTS(params));
+}
+
 /**
  * @brief
  *     utility function for setting and zeroing the flags dealing with
@@ -2166,13 +2392,10 @@ updateValidFlags(
     unsigned int prevFlags,
     int isValid)
 {
-    char stmt[150];
-    int flags = isValid ?
+    unsigned int flags = isValid ?
         (prevFlags | SCM_FLAG_VALID) :
         (prevFlags & (~SCM_FLAG_VALID));
-    xsnprintf(stmt, sizeof(stmt), "update %s set flags=%d where local_id=%d;",
-              tabp->tabname, flags, id);
-    return statementscm_no_data(conp, stmt);
+    return set_flags(conp, tabp, id, flags);
 }
 
 // Used by rpwork
@@ -2182,10 +2405,7 @@ set_cert_flag(
     unsigned int id,
     unsigned int flags)
 {
-    char stmt[150];
-    xsnprintf(stmt, sizeof(stmt), "update %s set flags=%d where local_id=%d;",
-              theCertTable->tabname, flags, id);
-    return statementscm_no_data(conp, stmt);
+    return set_flags(conp, theCertTable, id, flags);
 }
 
 // Allowed CRL extension oids
@@ -2214,6 +2434,172 @@ static int make_goodoids(
     return lth;
 }
 
+/**
+ * @brief
+ *     sorted set of the serial numbers of the certificates issued by
+ *     one CA
+ */
+struct serial_set {
+    uint8_t *sns;               /**< SER_NUM_MAX_SZ bytes per entry */
+    size_t len;
+    size_t cap;
+};
+
+static int
+cmp_serial(
+    const void *a,
+    const void *b)
+{
+    return memcmp(a, b, SER_NUM_MAX_SZ);
+}
+
+/**
+ * @brief
+ *     callback function for load_issued_serials()
+ */
+static sqlvaluefunc add_issued_serial;
+err_code
+add_issued_serial(
+    scmcon *conp,
+    scmsrcha *s,
+    ssize_t idx)
+{
+    struct serial_set *set = s->context;
+
+    UNREFERENCED_PARAMETER(conp);
+    UNREFERENCED_PARAMETER(idx);
+    if (s->vec[0].avalsize != SER_NUM_MAX_SZ)
+        return 0;
+    if (set->len == set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : 64;
+        uint8_t *sns = realloc(set->sns, cap * SER_NUM_MAX_SZ);
+        if (sns == NULL)
+            return ERR_SCM_NOMEM;
+        set->sns = sns;
+        set->cap = cap;
+    }
+    memcpy(&set->sns[set->len * SER_NUM_MAX_SZ], s->vec[0].valptr,
+           SER_NUM_MAX_SZ);
+    set->len++;
+    return 0;
+}
+
+/**
+ * @brief
+ *     Fetch the serial numbers of all certificates with the given
+ *     issuer and AKI in one query and sort them.
+ */
+static err_code
+load_issued_serials(
+    scmcon *conp,
+    const char *issuer,
+    const char *aki,
+    struct serial_set *set)
+{
+    uint8_t sn[SER_NUM_MAX_SZ];
+    char where[WHERESTR_SIZE] = "";
+    scmsrch srch1[] = {
+        {
+            .colno = 1,
+            .sqltype = SQL_C_BINARY,
+            .colname = "sn",
+            .valptr = sn,
+            .valsize = sizeof(sn),
+            .avalsize = 0,
+        },
+    };
+    scmsrcha srch = {
+        .vec = srch1,
+        .sname = NULL,
+        .ntot = ELTS(srch1),
+        .nused = ELTS(srch1),
+        .vald = 0,
+        .where = NULL,
+        .wherestr = where,
+        .context = set,
+    };
+    err_code sta;
+
+    where_append_hashed(where, "issuer", issuer);
+    where_append(where, " AND ");
+    where_append_keyid(where, "aki", aki);
+    sta = searchscm(conp, theCertTable, &srch, NULL, &add_issued_serial,
+                    SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_BREAK_VERR, NULL);
+    if (sta == ERR_SCM_NODATA)
+        sta = 0;
+    if (sta < 0)
+        return sta;
+    if (set->len > 1)
+        qsort(set->sns, set->len, SER_NUM_MAX_SZ, &cmp_serial);
+    return 0;
+}
+
+/**
+ * @brief
+ *     Apply the revocations in a CRL's serial number list.
+ *
+ * Rather than searching the certificate table once per CRL entry,
+ * this fetches the serial numbers of every certificate the CRL's
+ * issuer has issued and intersects them with @p snlist in memory.
+ * @p cfunc is only called for the entries that name a certificate
+ * in the database.
+ *
+ * @return
+ *     The number of entries for which @p cfunc deleted something, or
+ *     a negative error code on failure.
+ */
+static int
+apply_crl_entries(
+    scm *scmp,
+    scmcon *conp,
+    char *issuer,
+    char *aki,
+    uint8_t *snlist,
+    unsigned int snlen,
+    crlfunc *cfunc)
+{
+    struct serial_set issued = {NULL, 0, 0};
+    uint8_t *u;
+    unsigned int i;
+    unsigned int nhits = 0;
+    int chgd = 0;
+    err_code ista;
+    err_code sta;
+
+    if (issuer == NULL || issuer[0] == 0 || aki == NULL || aki[0] == 0 ||
+        snlen == 0)
+        return 0;
+    sta = load_issued_serials(conp, issuer, aki, &issued);
+    if (sta < 0 || issued.len == 0)
+        goto done;
+    for (i = 0, u = snlist; i < snlen; i++, u += SER_NUM_MAX_SZ)
+    {
+        if (bsearch(u, issued.sns, issued.len, SER_NUM_MAX_SZ,
+                    &cmp_serial) == NULL)
+            continue;
+        nhits++;
+        if (LOG_DEBUG <= LOG_LEVEL)
+        {
+            char *x = hexify(SER_NUM_MAX_SZ, u, HEXIFY_X);
+            LOG(LOG_DEBUG, "  entry %u revokes a known certificate: %s",
+                i, x);
+            free(x);
+        }
+        ista = (*cfunc)(scmp, conp, issuer, aki, u);
+        if (ista < 0)
+            sta = ista;
+        else if (ista == 1)
+            chgd++;
+    }
+
+done:
+    LOG(LOG_DEBUG, "CRL has %u entries, %u of %zu issued certificates"
+        " listed", snlen, nhits, issued.len);
+    free(issued.sns);
+    return sta < 0 ? sta : chgd;
+}
+
 /**
  * @brief
  *     callback function for verifyChildCert()
@@ -2232,7 +2618,6 @@ verifyChildCRL(
     X509_CRL *crl = NULL;
     int crlsta = 0;
     err_code sta = 0;
-    unsigned int i;
     unsigned int id;
     object_type typ;
     int chainOK;
@@ -2269,13 +2654,10 @@ verifyChildCRL(
     /** @bug ignores error code without explanation */
     sta = updateValidFlags(conp, theCRLTable, id,
                            *((unsigned int *)(s->vec[3].valptr)), 1);
-    for (i = 0; i < cf->snlen; i++)
-    {
-        /** @bug ignores error code without explanation */
-        revoke_cert_by_serial(theSCMP, conp, cf->fields[CRF_FIELD_ISSUER],
-                              cf->fields[CRF_FIELD_AKI],
-                              &((uint8_t *)cf->snlist)[SER_NUM_MAX_SZ * i]);
-    }
+    /** @bug ignores error code without explanation */
+    apply_crl_entries(theSCMP, conp, cf->fields[CRF_FIELD_ISSUER],
+                      cf->fields[CRF_FIELD_AKI], (uint8_t *)cf->snlist,
+                      cf->snlen, &revoke_cert_by_serial);
     sta = 0;
 done:
     LOG(LOG_DEBUG, "verifyChildCRL() returning %s: %s",
@@ -2341,6 +2723,7 @@ verifyChildROA(
 static scmsrcha *updateManSrch = NULL;
 static scmsrcha *updateManSrch2 = NULL;
 static unsigned int updateManLid;
+static unsigned int updateManFlags;
 static char updateManPath[PATH_MAX];
 static char updateManHash[HASHSIZE];
 
@@ -2378,6 +2761,7 @@ handleUpdateMan(
               (char *)updateManSrch->vec[0].valptr);
     xsnprintf(updateManHash, HASHSIZE, "%s",
               (char *)updateManSrch->vec[2].valptr);
+    updateManFlags = *((unsigned int *)updateManSrch->vec[3].valptr);
     return 0;
 }
 
@@ -2388,25 +2772,28 @@ updateManifestObjs(
 {
     struct FileAndHash *fahp = NULL;
     uchar file[NAME_MAX + 1];
-    char escaped_file[NAME_MAX * 2 + 1];
     uchar bytehash[HASHSIZE / 2];
     uchar *bhash;
     scmtab *tabp;
+    enum scm_pstmt which;
     char flagStmt[200 + HASHSIZE];
     int bhashlen;
     int gothash;
     err_code sta;
     int fd;
     int len;
+    struct perf_timer timer;
 
     // set up part of query
     if (updateManSrch == NULL)
     {
-        updateManSrch = newsrchscm(NULL, 3, 0, 1);
+        updateManSrch = newsrchscm(NULL, 4, 0, 0);
         ADDCOL(updateManSrch, "dirname", SQL_C_CHAR, DNAMESIZE, sta, sta);
         ADDCOL(updateManSrch, "local_id", SQL_C_ULONG, sizeof(unsigned int),
                sta, sta);
         ADDCOL(updateManSrch, "hash", SQL_C_CHAR, HASHSIZE, sta, sta);
+        ADDCOL(updateManSrch, "flags", SQL_C_ULONG, sizeof(unsigned int),
+               sta, sta);
     }
     if (updateManSrch2 == NULL)
     {
@@ -2418,6 +2805,8 @@ updateManifestObjs(
         ADDCOL(updateManSrch2, "flags", SQL_C_ULONG, sizeof(unsigned int),
                sta, sta);
     }
+    perf_start(&timer);
+    sta = 0;
     // loop over files and hashes
     for (fahp = (struct FileAndHash *)member_casn(&manifest->fileList.self, 0);
          fahp != NULL; fahp = (struct FileAndHash *)next_of(&fahp->self))
@@ -2425,29 +2814,39 @@ updateManifestObjs(
         int hashlen;
         if (vsize_casn(&fahp->file) + 1 > (int)sizeof(file))
         {
-            return ERR_SCM_BADMFTFILENAME;
+            sta = ERR_SCM_BADMFTFILENAME;
+            break;
         }
         int flth = read_casn(&fahp->file, file);
         file[flth] = 0;
         if (strstr((char *)file, ".cer"))
+        {
             tabp = theCertTable;
+            which = SCM_PSTMT_MFT_FILE_CERT;
+        }
         else if (strstr((char *)file, ".crl"))
+        {
             tabp = theCRLTable;
+            which = SCM_PSTMT_MFT_FILE_CRL;
+        }
         else if (strstr((char *)file, ".roa"))
+        {
             tabp = theROATable;
+            which = SCM_PSTMT_MFT_FILE_ROA;
+        }
         else if (strstr((char *)file, ".gbr"))
+        {
             tabp = theGBRTable;
+            which = SCM_PSTMT_MFT_FILE_GBR;
+        }
         else
             continue;
-        mysql_escape_string(escaped_file, (char *)file, strlen((char *)file));
-        xsnprintf(updateManSrch->wherestr, WHERESTR_SIZE, "filename=\"%s\"",
-                  escaped_file);
-        addFlagTest(updateManSrch->wherestr, SCM_FLAG_ONMAN, 0, 1);
+        scmparam param = {SQL_C_CHAR, file, flth};
         updateManLid = 0;
         memset(updateManHash, 0, sizeof(updateManHash));
         /** @bug ignores error code without explanation */
-        searchscm(conp, tabp, updateManSrch, NULL, &handleUpdateMan,
-                  SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
+        searchscm_prepared(conp, which, &param, 1, updateManSrch, NULL,
+                           &handleUpdateMan, SCM_SRCH_DOVALUE_ALWAYS);
         if (!updateManLid)
             continue;
         len = strlen(updateManPath);
@@ -2493,9 +2892,9 @@ updateManifestObjs(
             // if hash okay, set ONMAN flag and optionally the hash if we just
             // computed it
             if (gothash == 1)
-                xsnprintf(flagStmt, sizeof(flagStmt),
-                          "update %s set flags=flags+%d where local_id=%d;",
-                          tabp->tabname, SCM_FLAG_ONMAN, updateManLid);
+                /** @bug ignores error code without explanation */
+                set_flags(conp, tabp, updateManLid,
+                          updateManFlags | SCM_FLAG_ONMAN);
             else
             {
                 char *h = hexify(hashlen, bytehash, HEXIFY_NO);
@@ -2504,9 +2903,9 @@ updateManifestObjs(
                           " where local_id=%d;",
                           tabp->tabname, SCM_FLAG_ONMAN, h, updateManLid);
                 free(h);
+                /** @bug ignores error code without explanation */
+                statementscm_no_data(conp, flagStmt);
             }
-            /** @bug ignores error code without explanation */
-            statementscm_no_data(conp, flagStmt);
         }
         else
         {
@@ -2538,7 +2937,8 @@ updateManifestObjs(
             }
         }
     }
-    return 0;
+    perf_stop(&timer, PERF_STAGE_MANIFEST_OBJS, OT_MAN);
+    return sta;
 }
 
 /**
@@ -2680,22 +3080,25 @@ verifyChildCert(
                sta, sta);
         ADDCOL(crlSrch, "flags", SQL_C_ULONG, sizeof(unsigned int), sta, sta);
     }
-    xsnprintf(crlSrch->wherestr, WHERESTR_SIZE,
-              "aki=\"%s\" and issuer=\"%s\"",
-              data->ski, data->subject);
+    crlSrch->wherestr[0] = 0;
+    where_append_keyid(crlSrch->wherestr, "aki", data->ski);
+    where_append(crlSrch->wherestr, " and ");
+    where_append_hashed(crlSrch->wherestr, "issuer", data->subject);
     addFlagTest(crlSrch->wherestr, SCM_FLAG_VALID, 0, 1);
     /** @bug ignores error code without explanation */
     sta = searchscm(conp, theCRLTable, crlSrch, NULL, &verifyChildCRL,
                     SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
 
     /* Check for associated GBRs */
-    xsnprintf(crlSrch->wherestr, WHERESTR_SIZE, "ski=\"%s\"", data->ski);
+    crlSrch->wherestr[0] = 0;
+    where_append_keyid(crlSrch->wherestr, "ski", data->ski);
     /** @bug ignores error code without explanation */
     searchscm(conp, theGBRTable, crlSrch, NULL, &verifyChildGhostbusters,
               SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
 
     /* Check for associated ROA */
-    xsnprintf(crlSrch->wherestr, WHERESTR_SIZE, "ski=\"%s\"", data->ski);
+    crlSrch->wherestr[0] = 0;
+    where_append_keyid(crlSrch->wherestr, "ski", data->ski);
     addFlagTest(crlSrch->wherestr, SCM_FLAG_VALID, 0, 1);
     /** @bug ignores error code without explanation */
     sta = searchscm(conp, theROATable, crlSrch, NULL, &verifyChildROA,
@@ -2711,7 +3114,8 @@ verifyChildCert(
         ADDCOL(manSrch, "dirname", SQL_C_CHAR, DNAMESIZE, sta, sta);
         ADDCOL(manSrch, "filename", SQL_C_CHAR, FNAMESIZE, sta, sta);
     }
-    xsnprintf(manSrch->wherestr, WHERESTR_SIZE, "ski=\"%s\"", data->ski);
+    manSrch->wherestr[0] = 0;
+    where_append_keyid(manSrch->wherestr, "ski", data->ski);
     /** @bug ignores error code without explanation */
     sta = searchscm(conp, theManifestTable, manSrch, NULL, &verifyChildManifest,
                     SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
@@ -2765,25 +3169,17 @@ static int countvalidparents(
 {
     // ?????? replace this with shorter version using utility funcs ????????
     unsigned int flags = 0;
-    scmkv w[2];
     mcf mymcf;
-    char ws[256];
+    char ws[WHERESTR_SIZE] = "";
     char *now;
     err_code sta;
-    char escaped[(IS != NULL) ? strlen(IS)*2+1 : 0];
 
-    w[0] = (scmkv){"ski", AK};
+    where_append_keyid(ws, "ski", AK);
     if (IS != NULL)
     {
-        mysql_escape_string(escaped, IS, strlen(IS));
-        w[1] = (scmkv){"subject", escaped};
+        where_append(ws, " AND ");
+        where_append_hashed(ws, "subject", IS);
     }
-    scmkva where = {
-        .vec = w,
-        .ntot = (IS == NULL) ? 1 : 2,
-        .nused = (IS == NULL) ? 1 : 2,
-        .vald = 0,
-    };
     scmsrch srch1[] = {
         {
             .colno = 1,
@@ -2797,7 +3193,7 @@ static int countvalidparents(
     now = LocalTimeToDBTime(&sta);
     if (now == NULL)
         return (sta);
-    xsnprintf(ws, sizeof(ws), "valfrom < \"%s\" AND \"%s\" < valto", now, now);
+    where_append(ws, " AND valfrom < \"%s\" AND \"%s\" < valto", now, now);
     free(now);
     addFlagTest(ws, SCM_FLAG_VALID, 1, 1);
     mymcf.did = 0;
@@ -2807,7 +3203,7 @@ static int countvalidparents(
         .ntot = ELTS(srch1),
         .nused = ELTS(srch1),
         .vald = 0,
-        .where = &where,
+        .where = NULL,
         .wherestr = ws,
         .context = &mymcf,
     };
@@ -2986,7 +3382,8 @@ invalidateChildCert(
         ADDCOL(roaSrch, "ski", SQL_C_CHAR, SKISIZE, sta, sta);
         ADDCOL(roaSrch, "flags", SQL_C_ULONG, sizeof(unsigned int), sta, sta);
     }
-    xsnprintf(roaSrch->wherestr, WHERESTR_SIZE, "ski=\"%s\"", data->ski);
+    roaSrch->wherestr[0] = 0;
+    where_append_keyid(roaSrch->wherestr, "ski", data->ski);
     addFlagTest(roaSrch->wherestr, SCM_FLAG_VALID, 1, 1);
 
     if (invalidateCRLSrch == NULL)
@@ -2999,10 +3396,10 @@ invalidateChildCert(
         ADDCOL(invalidateCRLSrch, "flags", SQL_C_ULONG, sizeof(unsigned int),
                sta, sta);
     }
-    char escaped[strlen(data->subject)*2+1];
-    mysql_escape_string(escaped, data->subject, strlen(data->subject));
-    xsnprintf(invalidateCRLSrch->wherestr, WHERESTR_SIZE,
-              "aki=\"%s\" AND issuer=\"%s\"", data->ski, escaped);
+    invalidateCRLSrch->wherestr[0] = 0;
+    where_append_keyid(invalidateCRLSrch->wherestr, "aki", data->ski);
+    where_append(invalidateCRLSrch->wherestr, " AND ");
+    where_append_hashed(invalidateCRLSrch->wherestr, "issuer", data->subject);
     addFlagTest(invalidateCRLSrch->wherestr, SCM_FLAG_VALID, 1, 1);
 
 
@@ -3117,7 +3514,23 @@ verifyOrNotChildren(
     int doIt;
     int idx;
     err_code sta = 0;
+    struct perf_timer timer;
+    // parameters of the prepared children query; copies because the
+    // PropData strings are freed before the query runs
+    unsigned char parent_ski_bin[SKISIZE];
+    int parent_ski_bin_len = -1;
+    char parent_ski[SKISIZE];
+    char parent_subject[SUBJSIZE];
+    unsigned int want_valid = !doVerify;
+    scmparam params[] = {
+        {SQL_C_BINARY, parent_ski_bin, 0},
+        {SQL_C_CHAR, parent_ski, SQL_NTS},
+        {SQL_C_CHAR, parent_subject, SQL_NTS},
+        {SQL_C_CHAR, parent_subject, SQL_NTS},
+        {SQL_C_ULONG, &want_valid, 0},
+    };
 
+    perf_start(&timer);
     prevPropData = currPropData;
     currPropData = doVerify ? &vPropData : &iPropData;
 
@@ -3164,17 +3577,21 @@ verifyOrNotChildren(
         LOG(LOG_DEBUG, "doIt=%i", doIt);
         if (doIt)
         {
-            char escaped [strlen(currPropData->data[idx].subject)*2+1];
-            mysql_escape_string(escaped, currPropData->data[idx].subject,
-                                strlen(currPropData->data[idx].subject));
-
-            xsnprintf(childrenSrch->wherestr, WHERESTR_SIZE,
-                      "aki=\"%s\" and ski<>\"%s\" and issuer=\"%s\"",
-                      currPropData->data[idx].ski, currPropData->data[idx].ski,
-                      escaped);
+            PropData *parent = &currPropData->data[idx];
+
+            parent_ski_bin_len = -1;
+            if (strlen(parent->ski) < sizeof(parent_ski) &&
+                strlen(parent->subject) < sizeof(parent_subject))
+            {
+                parent_ski_bin_len = keyid_to_bin(parent->ski, parent_ski_bin,
+                                                  sizeof(parent_ski_bin));
+                params[0].valsize = parent_ski_bin_len;
+                strcpy(parent_ski, parent->ski);
+                strcpy(parent_subject, parent->subject);
+            }
             /**
              * @bug
-             *     This WHERE clause addition skips children that are
+             *     The validity test in the query skips children that are
              *     not valid (doVerify) or valid (!doVerify), and thus
              *     their descendants are not processed.  While it's OK
              *     to skip descendants that are already valid
@@ -3198,7 +3615,19 @@ verifyOrNotChildren(
              *                 that should now be valid
              *     @endverbatim
              */
-            addFlagTest(childrenSrch->wherestr, SCM_FLAG_VALID, !doVerify, 1);
+            if (parent_ski_bin_len <= 0)
+            {
+                // malformed SKI; compare against the text column
+                childrenSrch->wherestr[0] = 0;
+                where_append_keyid(childrenSrch->wherestr, "aki",
+                                   parent->ski);
+                where_append(childrenSrch->wherestr, " and ski<>\"%s\" and ",
+                             parent->ski);
+                where_append_hashed(childrenSrch->wherestr, "issuer",
+                                    parent->subject);
+                addFlagTest(childrenSrch->wherestr, SCM_FLAG_VALID,
+                            !doVerify, 1);
+            }
         }
         if (!already_verified)
         {
@@ -3209,7 +3638,12 @@ verifyOrNotChildren(
             free(currPropData->data[idx].aki);
             free(currPropData->data[idx].issuer);
         }
-        if (doIt)
+        if (doIt && parent_ski_bin_len > 0)
+            /** @bug ignores error code without explanation */
+            searchscm_prepared(conp, SCM_PSTMT_CERT_CHILDREN, params,
+                               ELTS(params), childrenSrch, NULL,
+                               &registerChild, SCM_SRCH_DOVALUE_ALWAYS);
+        else if (doIt)
             /** @bug ignores error code without explanation */
             searchscm(conp, theCertTable, childrenSrch, NULL, &registerChild,
                       SCM_SRCH_DOVALUE_ALWAYS | SCM_SRCH_DO_JOIN, NULL);
@@ -3217,6 +3651,7 @@ verifyOrNotChildren(
     }
     currPropData = prevPropData;
 
+    perf_stop(&timer, PERF_STAGE_VERIFY_CHILDREN, OT_CER);
     LOG(LOG_DEBUG, "verifyOrNotChildren() returning %s: %s",
         err2name(sta), err2string(sta));
     return sta;
@@ -3327,13 +3762,18 @@ struct Extension *get_extension(
     struct Extensions *extsp = &certp->toBeSigned.extensions;
     struct Extension *extp = NULL;
     struct Extension *ret = NULL;
+    uchar der[CASN_OBJID_DER_MAX];
+    int lth;
     int cnt = 0;
 
-    for (extp = (struct Extension *)member_casn(&extsp->self, 0);
+    // encode the OID once rather than once per extension
+    lth = encode_objid(idp, der, sizeof(der));
+    for (extp = (lth > 0) ?
+         (struct Extension *)member_casn(&extsp->self, 0) : NULL;
          extp != NULL; extp = (struct Extension *)next_of(&extp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&extp->extnID, idp))
+        if (!diff_objid_der(&extp->extnID, der, lth))
         {
             if (!cnt)
                 ret = extp;
@@ -3353,6 +3793,9 @@ struct Extension *get_extension(
  *
  * We should eventually merge this with add_cert_internal()
  *
+ * decoded is the certificate in fullpath if the caller has already
+ * decoded it, or NULL to read it from fullpath.
+ *
  * Note: caller is responsible for invoking freecf(cf).
  */
 
@@ -3365,41 +3808,52 @@ add_cert_2(
     unsigned int id,
     int utrust,
     unsigned int *cert_id,
-    char *fullpath)
+    char *fullpath,
+    struct Certificate *decoded)
 {
     LOG(LOG_DEBUG, "add_cert_2(scmp=%p, conp=%p, cf=%p, x=%p, id=%u"
-        ", utrust=%d, cert_id=%p, fullpath=%s)",
-        scmp, conp, cf, x, id, utrust, cert_id, fullpath);
+        ", utrust=%d, cert_id=%p, fullpath=%s, decoded=%p)",
+        scmp, conp, cf, x, id, utrust, cert_id, fullpath, decoded);
 
     err_code sta = 0;
     int ct = UN_CERT;
+    struct perf_timer timer;
+    struct perf_timer stage_timer;
 
+    perf_start(&timer);
     cf->dirid = id;
-    struct Certificate cert;
-    Certificate(&cert, (ushort)0);
+    struct Certificate localcert;
+    struct Certificate *certp = decoded;
     struct Extension *ski_extp;
     struct Extension *aki_extp;
     err_code locerr = 0;
-    if (get_casn_file(&cert.self, fullpath, 0) < 0)
+    if (certp == NULL)
     {
-        LOG(LOG_DEBUG, "get_casn_file() returned an error code");
-        locerr = ERR_SCM_BADCERT;
+        certp = &localcert;
+        Certificate(certp, (ushort)0);
+        if (get_casn_file(&certp->self, fullpath, 0) < 0)
+        {
+            LOG(LOG_DEBUG, "get_casn_file() returned an error code");
+            locerr = ERR_SCM_BADCERT;
+        }
     }
-    else if (!(ski_extp = find_extension(&cert.toBeSigned.extensions,
-                                         id_subjectKeyIdentifier, false)))
+    if (!locerr &&
+        !(ski_extp = find_extension(&certp->toBeSigned.extensions,
+                                    id_subjectKeyIdentifier, false)))
     {
         LOG(LOG_DEBUG, "no SKI extension found");
         locerr = ERR_SCM_NOSKI;
     }
     if (locerr)
     {
-        delete_casn(&cert.self);
+        if (certp == &localcert)
+            delete_casn(&certp->self);
         sta = locerr;
         goto done;
     }
     if (utrust > 0)
     {
-        if ((aki_extp = find_extension(&cert.toBeSigned.extensions,
+        if ((aki_extp = find_extension(&certp->toBeSigned.extensions,
                                        id_authKeyId, false)) &&
             diff_casn(&ski_extp->extnValue.subjectKeyIdentifier,
                       &aki_extp->extnValue.authKeyId.keyIdentifier))
@@ -3413,12 +3867,12 @@ add_cert_2(
             LOG(LOG_DEBUG, "subject and issuer don't match");
             locerr = 1;
         }
-        else if (vsize_casn(&cert.signature) < 256)
+        else if (vsize_casn(&certp->signature) < 256)
         {
             LOG(LOG_DEBUG, "signature too small");
             locerr = ERR_SCM_SMALLKEY;
         }
-        else if (vsize_casn(&cert.toBeSigned.subjectPublicKeyInfo.
+        else if (vsize_casn(&certp->toBeSigned.subjectPublicKeyInfo.
                             subjectPublicKey) < 265)
         {
             LOG(LOG_DEBUG, "key too small");
@@ -3426,7 +3880,8 @@ add_cert_2(
         }
         if (locerr)
         {
-            delete_casn(&cert.self);
+            if (certp == &localcert)
+                delete_casn(&certp->self);
             sta = (locerr < 0) ? locerr : ERR_SCM_NOTSS;
             goto done;
         }
@@ -3437,8 +3892,11 @@ add_cert_2(
         ct = TA_CERT;
     else
         ct = (cf->flags & SCM_FLAG_CA) ? CA_CERT : EE_CERT;
-    sta = rescert_profile_chk(x, &cert, ct);
-    delete_casn(&cert.self);
+    perf_start(&stage_timer);
+    sta = rescert_profile_chk(x, certp, ct);
+    perf_stop(&stage_timer, PERF_STAGE_PROFILE_CHECK, OT_CER);
+    if (certp == &localcert)
+        delete_casn(&certp->self);
     if (sta)
     {
         LOG(LOG_DEBUG, "rescert_profile_chk() returned %s: %s",
@@ -3511,6 +3969,7 @@ add_cert_2(
         }
     }
 done:
+    perf_stop(&timer, PERF_STAGE_ADD_CERT, OT_CER);
     LOG(LOG_DEBUG, "add_cert_2() returning %s: %s",
         err2name(sta), err2string(sta));
     return (sta);
@@ -3525,12 +3984,13 @@ add_cert(
     unsigned int id,
     int utrust,
     object_type typ,
-    unsigned int *cert_id)
+    unsigned int *cert_id,
+    struct Certificate *certp)
 {
     LOG(LOG_DEBUG, "add_cert(scmp=%p, conp=%p, outfile=\"%s\""
         ", outfull=\"%s\", id=%u, utrust=%d, typ=%d"
-        ", cert_id=%p)",
-        scmp, conp, outfile, outfull, id, utrust, typ, cert_id);
+        ", cert_id=%p, certp=%p)",
+        scmp, conp, outfile, outfull, id, utrust, typ, cert_id, certp);
 
     cert_fields *cf;
     X509 *x = NULL;
@@ -3547,7 +4007,8 @@ add_cert(
     {
         goto done;
     }
-    sta = add_cert_2(scmp, conp, cf, x, id, utrust, cert_id, outfull);
+    sta = add_cert_2(scmp, conp, cf, x, id, utrust, cert_id, outfull,
+                     certp);
     LOG(LOG_DEBUG, "add_cert_2() returned error code %s: %s",
         err2name(sta), err2string(sta));
 done:
@@ -3576,7 +4037,6 @@ add_crl(
     X509_CRL *xcrl = NULL;
     int crlsta = 0;
     err_code sta = 0;
-    unsigned int i;
     int chainOK;
     struct CertificateRevocationList crl;
 
@@ -3633,20 +4093,10 @@ add_crl(
     // and do the revocations
     if (chainOK)
     {
-        LOG(LOG_DEBUG, "CRL has %u entries", cf->snlen);
-        uint8_t *u = (uint8_t *) cf->snlist;
-        for (i = 0; i < cf->snlen; i++, u += SER_NUM_MAX_SZ)
-        {
-            if (LOG_DEBUG <= LOG_LEVEL)
-            {
-                char *x = hexify(SER_NUM_MAX_SZ, u, HEXIFY_X);
-                LOG(LOG_DEBUG, "  entry %u: %s", i, x);
-                free(x);
-            }
-            /** @bug ignores error code without explanation */
-            revoke_cert_by_serial(scmp, conp, cf->fields[CRF_FIELD_ISSUER],
-                                  cf->fields[CRF_FIELD_AKI], u);
-        }
+        /** @bug ignores error code without explanation */
+        apply_crl_entries(scmp, conp, cf->fields[CRF_FIELD_ISSUER],
+                          cf->fields[CRF_FIELD_AKI], (uint8_t *)cf->snlist,
+                          cf->snlen, &revoke_cert_by_serial);
     }
 
 done:
@@ -3832,7 +4282,7 @@ extractAndAddCert(
     {
         // add the X509 cert to the db with the right directory
         sta = add_cert_2(scmp, conp, cf, x509p, dir_id, utrust, &cert_id,
-                         pathname);
+                         pathname, certp);
         if (typ == OT_ROA && sta == ERR_SCM_DUPSIG)
             sta = 0;            // dup roas OK
         else if (sta < 0)
@@ -3892,6 +4342,9 @@ add_roa_internal(
     /** @bug magic number */
     char did[24];
     _Bool inserted = 0;
+    struct perf_timer timer;
+
+    perf_start(&timer);
 
     // Buffer to hold a potentially large INSERT statement. This is
     // used to insert multiple rows per statement into
@@ -4098,6 +4551,7 @@ done:
 
     free(multiinsert);
 
+    perf_stop(&timer, PERF_STAGE_ADD_ROA, OT_ROA);
     LOG(LOG_DEBUG, "add_roa_internal() returning %s: %s",
         err2name(sta), err2string(sta));
     return (sta);
@@ -4528,17 +4982,20 @@ add_object(
     char *outfile,
     char *outdir,
     char *outfull,
-    int utrust)
+    int utrust,
+    struct Certificate *certp)
 {
     LOG(LOG_DEBUG, "add_object(scmp=%p, conp=%p, outfile=\"%s\""
-        ", outdir=\"%s\", outfull=\"%s\", utrust=%d)",
-        scmp, conp, outfile, outdir, outfull, utrust);
+        ", outdir=\"%s\", outfull=\"%s\", utrust=%d, certp=%p)",
+        scmp, conp, outfile, outdir, outfull, utrust, certp);
 
     unsigned int id = 0;
     unsigned int obj_id = 0;
-    object_type typ;
+    object_type typ = OT_UNKNOWN;
     err_code sta;
+    struct perf_timer timer;
 
+    perf_start(&timer);
     if (scmp == NULL || conp == NULL || conp->connected == 0 ||
         outfile == NULL || outdir == NULL || outfull == NULL)
     {
@@ -4575,9 +5032,10 @@ add_object(
     case OT_CER_PEM:
     case OT_UNKNOWN:
     case OT_UNKNOWN + OT_PEM_OFFSET:
-        LOG(LOG_DEBUG, "calling add_cert(%p, %p, \"%s\", \"%s\", %d, %d, %d, %p)",
-            scmp, conp, outfile, outfull, id, utrust, typ, &obj_id);
-        sta = add_cert(scmp, conp, outfile, outfull, id, utrust, typ, &obj_id);
+        LOG(LOG_DEBUG, "calling add_cert(%p, %p, \"%s\", \"%s\", %d, %d, %d, %p, %p)",
+            scmp, conp, outfile, outfull, id, utrust, typ, &obj_id, certp);
+        sta = add_cert(scmp, conp, outfile, outfull, id, utrust, typ, &obj_id,
+                       certp);
         LOG(LOG_DEBUG, "add_cert() returned %s: %s",
             err2name(sta), err2string(sta));
         break;
@@ -4612,6 +5070,7 @@ add_object(
         break;
     }
 done:
+    perf_stop(&timer, PERF_STAGE_ADD_OBJECT, typ);
     LOG(LOG_DEBUG, "add_object() returning %s: %s",
         err2name(sta), err2string(sta));
     return (sta);
@@ -4638,12 +5097,10 @@ crliterator(
     unsigned int sninuse;
     unsigned int flags;
     unsigned int lid;
-    unsigned int i;
     crlinfo *crlip;
     char *issuer;
     char *aki;
-    err_code ista;
-    int chgd = 0;
+    int chgd;
     err_code sta = 0;
 
     UNREFERENCED_PARAMETER(idx);
@@ -4675,23 +5132,12 @@ crliterator(
     if (s->vec[5].avalsize <= 0)
         return (0);
     snlist = (uint8_t *)(s->vec[5].valptr);
-    for (i = 0; i < snlen; i++)
-    {
-        ista =
-            (*crlip->cfunc)(crlip->scmp, crlip->conp, issuer, aki,
-                            &snlist[SER_NUM_MAX_SZ * i]);
-        if (ista < 0)
-            sta = ista;
-        if (ista == 1)
-        {
-            // per STK action item #7 we no longer set SN to zero as an
-            // exemplar
-            chgd++;
-        }
-    }
+    // per STK action item #7 we no longer set SN to zero as an exemplar
+    chgd = apply_crl_entries(crlip->scmp, crlip->conp, issuer, aki, snlist,
+                             snlen, crlip->cfunc);
     // on error do nothing
-    if (sta < 0)
-        return (sta);
+    if (chgd < 0)
+        return (chgd);
     // no changes: do not update the CRL
     if (chgd == 0)
         return (0);
@@ -5092,22 +5538,14 @@ revoke_cert_by_serial(
         goto done;
     }
     {
-        char escaped [strlen(issuer)*2+1];
-        mysql_escape_string(escaped, issuer, strlen(issuer));
-        scmkv w[] = {
-            {"issuer", escaped},
-            {"sn", sno},
-            {"aki", aki},
-        };
-        scmkva where = {
-            .vec = w,
-            .ntot = ELTS(w),
-            .nused = ELTS(w),
-            .vald = 0,
-        };
+        char where[WHERESTR_SIZE] = "";
+        where_append_hashed(where, "issuer", issuer);
+        // skip the "^x" prefix of the hexified serial number
+        where_append(where, " AND sn=0x%s AND ", sno + 2);
+        where_append_keyid(where, "aki", aki);
         fillInColumns(srch1, &lid, ski, subject, &flags, &srch);
-        srch.where = &where;
-        srch.wherestr = NULL;
+        srch.where = NULL;
+        srch.wherestr = where;
         srch.context = &mymcf;
         sta = searchscm(
             conp, theCertTable, &srch, NULL, &revoke_cert_and_children,
@@ -5332,6 +5770,327 @@ certificate_validity(
     return (retsta);
 }
 
+size_t
+own_validity_predicate(
+    char *buf,
+    size_t len,
+    const char *alias,
+    int is_cert)
+{
+    size_t off;
+
+    off = xsnprintf(buf, len, "%s.is_valid", alias);
+    if (!CONFIG_RPKI_ALLOW_STALE_CRL_get())
+        off += xsnprintf(&buf[off], len - off, " AND NOT %s.is_stalecrl",
+                         alias);
+    if (!CONFIG_RPKI_ALLOW_STALE_MANIFEST_get())
+        off += xsnprintf(&buf[off], len - off, " AND NOT %s.is_staleman",
+                         alias);
+    if (!CONFIG_RPKI_ALLOW_NOT_YET_get())
+        off += xsnprintf(&buf[off], len - off, " AND NOT %s.is_notyet",
+                         alias);
+    if (!CONFIG_RPKI_ALLOW_NO_MANIFEST_get())
+    {
+        // only CA certificates must be on a manifest to extend a chain
+        if (is_cert)
+            off += xsnprintf(&buf[off], len - off,
+                             " AND (%s.is_onman OR NOT %s.is_ca"
+                             " OR %s.is_trusted)",
+                             alias, alias, alias);
+        else
+            off += xsnprintf(&buf[off], len - off, " AND %s.is_onman",
+                             alias);
+    }
+    return off;
+}
+
+/*
+ * The policies that own_validity_predicate() depends on, and the bit
+ * each sets in the encoding stored in rpki_metadata.eff_policy.
+ */
+static const struct {
+    const char *name;
+    bool (*get)(void);
+    unsigned int bit;
+} validity_policies[] = {
+    {"RPKIAllowStaleCRL", CONFIG_RPKI_ALLOW_STALE_CRL_get, 2},
+    {"RPKIAllowStaleManifest", CONFIG_RPKI_ALLOW_STALE_MANIFEST_get, 4},
+    {"RPKIAllowNotYet", CONFIG_RPKI_ALLOW_NOT_YET_get, 8},
+    {"RPKIAllowNoManifest", CONFIG_RPKI_ALLOW_NO_MANIFEST_get, 16},
+};
+
+/*
+ * Encode the current policies, so that the policy the materialized
+ * state was computed under can be compared with the current
+ * configuration.  Zero means the state has never been computed.
+ */
+static unsigned int
+validity_policy(
+    void)
+{
+    unsigned int policy = 1;
+    size_t i;
+
+    for (i = 0; i < ELTS(validity_policies); i++)
+        if (validity_policies[i].get())
+            policy |= validity_policies[i].bit;
+    return policy;
+}
+
+/*
+ * Join condition relating a certificate or CRL (alias child) to the
+ * certificate that issued it (alias parent).  The key identifier and
+ * name digest columns carry the index; the names themselves are
+ * compared too in case of a digest collision.
+ */
+#define PARENT_JOIN(child, parent) \
+    child ".aki_bin=" parent ".ski_bin" \
+    " AND " child ".issuer_hash=" parent ".subject_hash" \
+    " AND " child ".issuer=" parent ".subject"
+
+/*
+ * Copy ta_id, eff_valid and eff_valto from the signing certificate to
+ * every row of an object table.  The join condition relates the object (alias
+ * o) to its certificate (alias c).
+ *
+ * SQLite has no multi-table UPDATE, so there the new values are
+ * computed by a join in a subquery and matched up by rowid.
+ */
+static err_code
+update_object_validity(
+    scmcon *conp,
+    scmtab *tabp,
+    const char *joincond,
+    const char *ownok)
+{
+    char stmt[2 * WHERESTR_SIZE];
+
+    if (scmdialect(conp) == SCM_DIALECT_SQLITE)
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS t SET ta_id=n.ta_id, eff_valid=n.eff_valid,"
+                  " eff_valto=n.eff_valto"
+                  " FROM (SELECT o.rowid AS rid, c.ta_id AS ta_id,"
+                  " COALESCE(c.eff_valid AND (%s), FALSE) AS eff_valid,"
+                  " c.eff_valto AS eff_valto"
+                  " FROM %s AS o LEFT JOIN %s AS c ON %s) AS n"
+                  " WHERE t.rowid=n.rid AND (t.ta_id IS NOT n.ta_id"
+                  " OR t.eff_valid<>n.eff_valid"
+                  " OR t.eff_valto IS NOT n.eff_valto);",
+                  tabp->tabname, ownok, tabp->tabname,
+                  theCertTable->tabname, joincond);
+    else
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS o LEFT JOIN %s AS c ON %s"
+                  " SET o.ta_id=c.ta_id,"
+                  " o.eff_valid=COALESCE(c.eff_valid AND (%s), FALSE),"
+                  " o.eff_valto=c.eff_valto"
+                  " WHERE NOT (o.ta_id<=>c.ta_id)"
+                  " OR o.eff_valid<>COALESCE(c.eff_valid AND (%s), FALSE)"
+                  " OR NOT (o.eff_valto<=>c.eff_valto);",
+                  tabp->tabname, theCertTable->tabname, joincond, ownok,
+                  ownok);
+    return statementscm_no_data(conp, stmt);
+}
+
+err_code
+update_effective_validity(
+    scm *scmp,
+    scmcon *conp)
+{
+    char certok[WHERESTR_SIZE];
+    char objok[WHERESTR_SIZE];
+    char stmt[3 * WHERESTR_SIZE];
+    int depth;
+    err_code sta = 0;
+
+    if (scmp == NULL || conp == NULL || conp->connected == 0)
+        return (ERR_SCM_INVALARG);
+    initTables(scmp);
+    own_validity_predicate(certok, sizeof(certok), "c", 1);
+    own_validity_predicate(objok, sizeof(objok), "o", 0);
+    // trust anchors are the roots of their own chains
+    xsnprintf(stmt, sizeof(stmt),
+              "UPDATE %s AS c SET ta_id=c.local_id, eff_valid=(%s),"
+              " eff_valto=c.valto"
+              " WHERE c.is_trusted=TRUE;",
+              theCertTable->tabname, certok);
+    sta = statementscm_no_data(conp, stmt);
+    if (sta < 0)
+        return (sta);
+    // certificates whose parent is not in the database are unanchored
+    if (scmdialect(conp) == SCM_DIALECT_SQLITE)
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS c"
+                  " SET ta_id=NULL, eff_valid=FALSE, eff_valto=NULL"
+                  " WHERE c.is_trusted=FALSE"
+                  " AND (c.ta_id IS NOT NULL OR c.eff_valid"
+                  " OR c.eff_valto IS NOT NULL)"
+                  " AND NOT EXISTS (SELECT 1 FROM %s AS p"
+                  " WHERE " PARENT_JOIN("c", "p")
+                  " AND c.local_id<>p.local_id);",
+                  theCertTable->tabname, theCertTable->tabname);
+    else
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS c LEFT JOIN %s AS p"
+                  " ON " PARENT_JOIN("c", "p")
+                  " AND c.local_id<>p.local_id"
+                  " SET c.ta_id=NULL, c.eff_valid=FALSE, c.eff_valto=NULL"
+                  " WHERE c.is_trusted=FALSE AND p.local_id IS NULL"
+                  " AND (c.ta_id IS NOT NULL OR c.eff_valid"
+                  " OR c.eff_valto IS NOT NULL);",
+                  theCertTable->tabname, theCertTable->tabname);
+    sta = statementscm_no_data(conp, stmt);
+    if (sta < 0)
+        return (sta);
+    // push the state down one generation at a time until nothing
+    // changes; eff_valto is the earlier of the parent's and the
+    // certificate's own valto
+    if (scmdialect(conp) == SCM_DIALECT_SQLITE)
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS c"
+                  " SET ta_id=p.ta_id, eff_valid=(p.eff_valid AND (%s)),"
+                  " eff_valto=MIN(p.eff_valto, c.valto)"
+                  " FROM %s AS p"
+                  " WHERE " PARENT_JOIN("c", "p")
+                  " AND c.local_id<>p.local_id"
+                  " AND c.is_trusted=FALSE AND (c.ta_id IS NOT p.ta_id"
+                  " OR c.eff_valid<>(p.eff_valid AND (%s))"
+                  " OR c.eff_valto IS NOT MIN(p.eff_valto, c.valto));",
+                  theCertTable->tabname, certok, theCertTable->tabname,
+                  certok);
+    else
+        xsnprintf(stmt, sizeof(stmt),
+                  "UPDATE %s AS c JOIN %s AS p"
+                  " ON " PARENT_JOIN("c", "p")
+                  " AND c.local_id<>p.local_id"
+                  " SET c.ta_id=p.ta_id, c.eff_valid=(p.eff_valid AND (%s)),"
+                  " c.eff_valto=LEAST(p.eff_valto, c.valto)"
+                  " WHERE c.is_trusted=FALSE AND (NOT (c.ta_id<=>p.ta_id)"
+                  " OR c.eff_valid<>(p.eff_valid AND (%s))"
+                  " OR NOT (c.eff_valto<=>LEAST(p.eff_valto, c.valto)));",
+                  theCertTable->tabname, theCertTable->tabname, certok,
+                  certok);
+    for (depth = 0; depth < MAX_CHAIN_DEPTH; depth++)
+    {
+        sta = statementscm_no_data(conp, stmt);
+        if (sta < 0)
+            return (sta);
+        if (getrowsscm(conp) <= 0)
+            break;
+    }
+    if (depth == MAX_CHAIN_DEPTH)
+        LOG(LOG_WARNING, "effective validity did not settle after %d "
+            "generations; some certificates may have several parents",
+            MAX_CHAIN_DEPTH);
+    // finally the objects hanging off the certificates
+    sta = update_object_validity(conp, theROATable, "o.ski_bin=c.ski_bin", objok);
+    if (sta < 0)
+        return (sta);
+    sta = update_object_validity(conp, theManifestTable, "o.ski_bin=c.ski_bin",
+                                 objok);
+    if (sta < 0)
+        return (sta);
+    sta = update_object_validity(conp, theGBRTable, "o.ski_bin=c.ski_bin", objok);
+    if (sta < 0)
+        return (sta);
+    sta = update_object_validity(conp, theCRLTable,
+                                 PARENT_JOIN("o", "c"),
+                                 objok);
+    if (sta < 0)
+        return (sta);
+    xsnprintf(stmt, sizeof(stmt),
+              "UPDATE %s SET eff_policy=%u WHERE local_id=1;",
+              theMetaTable->tabname, validity_policy());
+    return statementscm_no_data(conp, stmt);
+}
+
+err_code
+check_effective_validity(
+    scm *scmp,
+    scmcon *conp,
+    int *currentp)
+{
+    unsigned int policy = 0;
+    err_code sta;
+
+    if (scmp == NULL || conp == NULL || conp->connected == 0 ||
+        currentp == NULL)
+        return (ERR_SCM_INVALARG);
+    conp->mystat.tabname = "METADATA";
+    initTables(scmp);
+    scmkv one[] = {
+        {"local_id", "1"},
+    };
+    scmkva where = {
+        .vec = one,
+        .ntot = ELTS(one),
+        .nused = ELTS(one),
+        .vald = 0,
+    };
+    scmsrch srch1[] = {
+        {
+            .colno = 1,
+            .sqltype = SQL_C_ULONG,
+            .colname = "eff_policy",
+            .valptr = &policy,
+            .valsize = sizeof(policy),
+            .avalsize = 0,
+        },
+    };
+    scmsrcha srch = {
+        .vec = srch1,
+        .sname = NULL,
+        .ntot = ELTS(srch1),
+        .nused = ELTS(srch1),
+        .vald = 0,
+        .where = &where,
+        .wherestr = NULL,
+    };
+    sta = searchscm(conp, theMetaTable, &srch, NULL,
+                    &ok, SCM_SRCH_DOVALUE_ALWAYS, NULL);
+    if (sta < 0)
+        return (sta);
+    *currentp = (policy == validity_policy());
+    if (*currentp)
+        return (0);
+    if (policy == 0)
+    {
+        LOG(LOG_NOTICE, "effective validity has not been computed; "
+            "checking each chain at query time");
+        return (0);
+    }
+    for (size_t i = 0; i < ELTS(validity_policies); i++)
+    {
+        if (((policy & validity_policies[i].bit) != 0) ==
+            validity_policies[i].get())
+            continue;
+        LOG(LOG_NOTICE, "%s is %s in this configuration but the loader "
+            "computed effective validity with %s",
+            validity_policies[i].name,
+            validity_policies[i].get() ? "yes" : "no",
+            validity_policies[i].get() ? "no" : "yes");
+    }
+    LOG(LOG_NOTICE, "checking each chain at query time; run \"rcli -V\" "
+        "with this configuration to avoid that");
+    return (0);
+}
+
+err_code
+effective_validity_predicate(
+    char *buf,
+    size_t len)
+{
+    char *now;
+    err_code sta = 0;
+
+    now = LocalTimeToDBTime(&sta);
+    if (now == NULL)
+        return (sta);
+    xsnprintf(buf, len, "eff_valid=TRUE AND eff_valto>\"%s\"", now);
+    free(now);
+    return (0);
+}
+
 /*
  * open syslog and write message that application started
  */
@@ -5426,6 +6185,7 @@ void sqcleanup(
         free(snlist);
         snlist = NULL;
     }
+    loadstate_clear();
 
     if (iPropData.data)
         free(iPropData.data);
@@ -113,6 +113,15 @@ findorcreatedir(
     const char *dirname,
     unsigned int *idp);
 
+/*
+ * Load the whole directory table into the directory id map consulted
+ * by findorcreatedir(), so that no directory costs a lookup.
+ */
+err_code
+preload_dirs(
+    scm *scmp,
+    scmcon *conp);
+
 /*
  * Add the indicated object to the DB. If "trusted" is set then verify that
  * the object is self-signed. Note that this add operation may result in the
@@ -120,6 +129,10 @@ findorcreatedir(
  *
  * Symlinks and files that are not regular files are not processed.
  *
+ * If the caller has already decoded a certificate it passes it as
+ * certp, which is used instead of reading the file again; otherwise
+ * certp is NULL.  The caller keeps ownership of certp.
+ *
  * This function returns 0 on success and a negative error code on failure.
  */
 err_code
@@ -129,7 +142,8 @@ add_object(
     char *outfile,
     char *outdir,
     char *outfull,
-    int utrust);
+    int utrust,
+    struct Certificate *certp);
 
 /**
  * @brief
@@ -175,7 +189,8 @@ infer_filetype(
 
 /*
  * Add a certificate to the DB. If utrust is set, check that it is self-signed
- * first. Validate the cert and add it.
+ * first. Validate the cert and add it.  certp is the already decoded
+ * certificate, or NULL to read it from outfull; see add_object().
  *
  * This function returns 0 on success and a negative error code on failure.
  */
@@ -188,7 +203,8 @@ add_cert(
     unsigned int id,
     int utrust,
     object_type typ,
-    unsigned int *cert_id);
+    unsigned int *cert_id,
+    struct Certificate *certp);
 
 /*
  * Add a CRL to the DB.  This function returns 0 on success and a negative
@@ -258,8 +274,12 @@ extern int add_rta(
  *     Iterate through all CRLs in the DB, recursively processing each
  *     CRL to obtain its (issuer, snlist) information.
  *
- * For each SN in the list, call a specified function (persumably a
- * certificate revocation function) on that (issuer, sn) combination.
+ * For each SN in the list that matches the serial number of a
+ * certificate from the same issuer in the DB, call a specified
+ * function (presumably a certificate revocation function) on that
+ * (issuer, sn) combination.  The issuer's serial numbers are fetched
+ * once per CRL and intersected with the list in memory, so entries
+ * that do not name a known certificate cost nothing.
  *
  * @return
  *     On success this function returns 0.  On failure it returns a
@@ -312,6 +332,95 @@ certificate_validity(
     scm *scmp,
     scmcon *conp);
 
+/**
+ * @brief
+ *     Upper bound on the length of a chain
+ *
+ * update_effective_validity() gives up propagating after this many
+ * generations, and checkValidity() after walking this many
+ * certificates.  Real chains are far shorter; the limit only matters
+ * if certificates with several candidate parents keep flipping between
+ * them, or if certificates form a loop.
+ */
+#define MAX_CHAIN_DEPTH 64
+
+/**
+ * @brief
+ *     SQL predicate that one object must satisfy on its own
+ *
+ * Writes into @p buf the condition that the row with the given table
+ * alias must satisfy, ignoring its ancestors, to be accepted under the
+ * current configuration.  Certificates (@p is_cert nonzero) are tested
+ * as links in a chain, so only CA certificates need to be on a
+ * manifest; every other object is tested as the final object of a
+ * query (see addQueryFlagTests()).  Expiry is not tested, because
+ * update_effective_validity() stores the result; it is tested against
+ * @c eff_valto when the object is queried (see
+ * effective_validity_predicate()).
+ *
+ * @return
+ *     the length of the predicate
+ */
+size_t
+own_validity_predicate(
+    char *buf,
+    size_t len,
+    const char *alias,
+    int is_cert);
+
+/**
+ * @brief
+ *     recompute the materialized chain state of every object
+ *
+ * Sets the @c ta_id, @c eff_valid and @c eff_valto columns of
+ * certificates, CRLs, ROAs, manifests and ghostbusters records from
+ * the flags of each object and of all the certificates above it, so
+ * that consumers such as the query client can test validity with a
+ * single indexed predicate instead of walking the chain themselves.
+ * @c eff_valid reflects the configured stale CRL, stale manifest,
+ * not-yet-valid and no-manifest policies at the time of the call, and
+ * the policies are recorded in rpki_metadata.  Expiry is left to
+ * effective_validity_predicate().
+ */
+err_code
+update_effective_validity(
+    scm *scmp,
+    scmcon *conp);
+
+/**
+ * @brief
+ *     check whether the materialized chain state matches the
+ *     configuration
+ *
+ * Read-only clients call this before relying on @c eff_valid.  It sets
+ * @p *currentp to zero, and logs which policies differ, if the loader
+ * computed the state under different stale CRL, stale manifest,
+ * not-yet-valid or no-manifest policies than the ones now configured,
+ * e.g. because the client was run with a different configuration file
+ * than the loader, or if it was never computed.  Such clients should
+ * then test each object with checkValidity() instead.  Nothing is
+ * written to the database.
+ */
+err_code
+check_effective_validity(
+    scm *scmp,
+    scmcon *conp,
+    int *currentp);
+
+/**
+ * @brief
+ *     SQL predicate for objects whose whole chain is acceptable now
+ *
+ * Writes into @p buf a condition on the @c eff_valid and @c eff_valto
+ * columns that is true iff every certificate in the object's chain was
+ * acceptable when update_effective_validity() last ran and none of
+ * them has expired since.
+ */
+err_code
+effective_validity_predicate(
+    char *buf,
+    size_t len);
+
 err_code
 addStateToFlags(
     unsigned int *flags,
@@ -359,6 +468,29 @@ extern char *retrieve_tdir(
     scmcon *conp,
     err_code *stap);
 
+/*
+ * Read the database generation and the database's creation time,
+ * which together identify the database contents for the loader's
+ * warm-restart snapshot (see loadstate.h).  dbid receives the
+ * creation time as a string.
+ */
+extern err_code get_db_generation(
+    scm *scmp,
+    scmcon *conp,
+    unsigned int *genp,
+    char *dbid,
+    size_t dbidlen);
+
+/*
+ * Increment the database generation.  Every program that changes
+ * the object tables must call this before its first change so that
+ * snapshots of the loader's state taken before the change are no
+ * longer trusted.
+ */
+extern err_code bump_db_generation(
+    scm *scmp,
+    scmcon *conp);
+
 extern void startSyslog(
     char *appName);
 
@@ -0,0 +1,603 @@
+/*
+ * DatabaseBackend "mysql": statements go straight to the local MySQL
+ * server through the MySQL client library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mysql.h>
+
+#include "scm.h"
+#include "scmf.h"
+#include "sqbackend.h"
+#include "err.h"
+
+
+/*
+ * Results are always transferred to the client before they are read
+ * (mysql_store_result(), mysql_stmt_store_result()), so that other
+ * statements can run while a cursor is open, as nested searches do.
+ */
+struct _scmcursor {
+    MYSQL_RES *res;             /* result of a text statement, or NULL */
+    MYSQL_STMT *stmt;           /* prepared statement, or NULL */
+    int which;                  /* enum scm_pstmt if stmt is set */
+    unsigned int nfields;       /* result columns of stmt */
+    MYSQL_BIND *bind;           /* result buffers of stmt, once bound */
+    unsigned long *lengths;
+    my_bool *nulls;
+    struct _scmcursor *next;    /* next idle handle for the same "which" */
+};
+
+struct mysqlcon {
+    MYSQL *mysql;
+    scmcursor *pstmts[SCM_PSTMT_NUM];   /* idle prepared statements */
+};
+
+/*
+ * Decode the last error on the connection
+ */
+
+static void myheer(
+    scmcon *conp,
+    const char *what)
+{
+    struct mysqlcon *my = conp->bdata;
+
+    LOG(LOG_ERR, "%s failed: %u %s", what, mysql_errno(my->mysql),
+        mysql_error(my->mysql));
+    (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s",
+                   mysql_error(my->mysql));
+}
+
+/*
+ * Decode the last error on a prepared statement
+ */
+
+static void mystmteer(
+    scmcon *conp,
+    MYSQL_STMT *stmt,
+    const char *what)
+{
+    LOG(LOG_ERR, "%s failed:", what);
+    LOG(LOG_ERR, "    %u: %s", mysql_stmt_errno(stmt),
+        mysql_stmt_error(stmt));
+    (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s",
+                   mysql_stmt_error(stmt));
+}
+
+/*
+ * Forget the result buffers of a prepared statement; they belong to
+ * the caller's search array.
+ */
+
+static void unbind(
+    scmcursor *curp)
+{
+    free(curp->bind);
+    free(curp->lengths);
+    free(curp->nulls);
+    curp->bind = NULL;
+    curp->lengths = NULL;
+    curp->nulls = NULL;
+}
+
+/*
+ * Free a list of prepared statements.
+ */
+
+static void freecursors(
+    scmcursor *curp)
+{
+    scmcursor *nextp;
+
+    while (curp != NULL)
+    {
+        if (curp->stmt != NULL)
+            mysql_stmt_close(curp->stmt);
+        unbind(curp);
+        nextp = curp->next;
+        free((void *)curp);
+        curp = nextp;
+    }
+}
+
+static void
+my_disconnect(
+    scmcon *conp)
+{
+    struct mysqlcon *my = conp->bdata;
+    int i;
+
+    for (i = 0; i < SCM_PSTMT_NUM; i++)
+    {
+        freecursors(my->pstmts[i]);
+        my->pstmts[i] = NULL;
+    }
+    if (my->mysql != NULL)
+        mysql_close(my->mysql);
+    free((void *)my);
+    conp->bdata = NULL;
+}
+
+/*
+ * The server is reached through "localhost", i.e. its UNIX socket, and
+ * the credentials are taken from the DSN.
+ */
+static err_code
+my_connect(
+    scmcon *conp,
+    const char *dsn)
+{
+    static char oom[] = "Out of memory!";
+    struct mysqlcon *my;
+    char *buf;
+    char *db;
+    char *uid;
+    char *pass;
+    size_t len = strlen(dsn) + 1;
+    err_code sta = 0;
+
+    my = (struct mysqlcon *)calloc(1, sizeof(struct mysqlcon));
+    buf = malloc(3 * len);
+    if (my == NULL || buf == NULL)
+    {
+        free(my);
+        free(buf);
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s", oom);
+        return (ERR_SCM_NOMEM);
+    }
+    conp->bdata = my;
+    db = dsnfield(dsn, "DATABASE", buf);
+    uid = dsnfield(dsn, "UID", &buf[len]);
+    pass = dsnfield(dsn, "PASSWORD", &buf[2 * len]);
+    if (pass == NULL)
+        pass = dsnfield(dsn, "PWD", &buf[2 * len]);
+    my->mysql = mysql_init(NULL);
+    if (my->mysql == NULL)
+    {
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s", oom);
+        sta = ERR_SCM_NOMEM;
+    }
+    else if (mysql_real_connect(my->mysql, "localhost", uid, pass, db, 0,
+                                NULL, 0) == NULL)
+    {
+        myheer(conp, "mysql_real_connect()");
+        sta = ERR_SCM_SQL;
+    }
+    free(buf);
+    return (sta);
+}
+
+static err_code
+my_execute(
+    scmcon *conp,
+    const char *stm,
+    scmcursor **curp)
+{
+    struct mysqlcon *my = conp->bdata;
+    MYSQL_RES *res;
+
+    if (mysql_real_query(my->mysql, stm, strlen(stm)) != 0)
+    {
+        myheer(conp, "mysql_real_query()");
+        return (ERR_SCM_SQL);
+    }
+    res = mysql_store_result(my->mysql);
+    if (res == NULL && mysql_field_count(my->mysql) != 0)
+    {
+        myheer(conp, "mysql_store_result()");
+        return (ERR_SCM_SQL);
+    }
+    if (res != NULL)
+        conp->mystat.rows = (int)mysql_num_rows(res);
+    else
+        conp->mystat.rows = (int)mysql_affected_rows(my->mysql);
+    if (curp == NULL || res == NULL)
+    {
+        if (res != NULL)
+            mysql_free_result(res);
+        if (curp != NULL)
+            *curp = NULL;
+        return (0);
+    }
+    *curp = (scmcursor *) calloc(1, sizeof(scmcursor));
+    if (*curp == NULL)
+    {
+        mysql_free_result(res);
+        return (ERR_SCM_NOMEM);
+    }
+    (*curp)->res = res;
+    return (0);
+}
+
+/*
+ * Get a handle on which prepared statement "which" is ready to
+ * execute.  As with ODBC, idle handles are kept on a per-statement
+ * stack so that a statement still open further up the call stack gets
+ * a second handle.
+ */
+static scmcursor *
+getpstmt(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const char *query)
+{
+    struct mysqlcon *my = conp->bdata;
+    scmcursor *cur;
+    MYSQL_RES *meta;
+
+    cur = my->pstmts[which];
+    if (cur != NULL)
+    {
+        my->pstmts[which] = cur->next;
+        cur->next = NULL;
+        return (cur);
+    }
+    cur = (scmcursor *) calloc(1, sizeof(scmcursor));
+    if (cur == NULL)
+        return (NULL);
+    cur->which = which;
+    cur->stmt = mysql_stmt_init(my->mysql);
+    if (cur->stmt == NULL)
+    {
+        myheer(conp, "mysql_stmt_init()");
+        free((void *)cur);
+        return (NULL);
+    }
+    if (mysql_stmt_prepare(cur->stmt, query, strlen(query)))
+    {
+        LOG(LOG_ERR, "could not prepare query: %s", query);
+        mystmteer(conp, cur->stmt, "mysql_stmt_prepare()");
+        freecursors(cur);
+        return (NULL);
+    }
+    meta = mysql_stmt_result_metadata(cur->stmt);
+    if (meta != NULL)
+    {
+        cur->nfields = mysql_num_fields(meta);
+        mysql_free_result(meta);
+    }
+    return (cur);
+}
+
+/*
+ * Return a handle from getpstmt() to the idle stack.
+ */
+static void
+putpstmt(
+    scmcon *conp,
+    scmcursor *cur)
+{
+    struct mysqlcon *my = conp->bdata;
+
+    mysql_stmt_free_result(cur->stmt);
+    unbind(cur);
+    cur->next = my->pstmts[cur->which];
+    my->pstmts[cur->which] = cur;
+}
+
+static err_code
+my_execute_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const char *query,
+    const scmparam *params,
+    int nparams,
+    scmcursor **curp)
+{
+    MYSQL_BIND bind[nparams > 0 ? nparams : 1];
+    unsigned long lengths[nparams > 0 ? nparams : 1];
+    scmcursor *cur;
+    int i;
+
+    cur = getpstmt(conp, which, query);
+    if (cur == NULL)
+        return (ERR_SCM_SQL);
+    memset(bind, 0, sizeof(bind));
+    for (i = 0; i < nparams; i++)
+    {
+        bind[i].buffer = (void *)params[i].valptr;
+        switch (params[i].sqltype)
+        {
+        case SQL_C_CHAR:
+        case SQL_C_BINARY:
+            bind[i].buffer_type = (params[i].sqltype == SQL_C_CHAR) ?
+                MYSQL_TYPE_STRING : MYSQL_TYPE_BLOB;
+            lengths[i] = (params[i].valsize == SQL_NTS) ?
+                strlen(params[i].valptr) : (unsigned long)params[i].valsize;
+            bind[i].buffer_length = lengths[i];
+            bind[i].length = &lengths[i];
+            break;
+        case SQL_C_ULONG:
+            bind[i].buffer_type = MYSQL_TYPE_LONG;
+            bind[i].is_unsigned = (my_bool)1;
+            break;
+        default:
+            putpstmt(conp, cur);
+            return (ERR_SCM_INVALARG);
+        }
+    }
+    // the parameter buffers are read by mysql_stmt_execute()
+    if (nparams > 0 && mysql_stmt_bind_param(cur->stmt, bind))
+    {
+        mystmteer(conp, cur->stmt, "mysql_stmt_bind_param()");
+        putpstmt(conp, cur);
+        return (ERR_SCM_SQL);
+    }
+    if (mysql_stmt_execute(cur->stmt))
+    {
+        LOG(LOG_ERR, "could not execute query: %s", query);
+        mystmteer(conp, cur->stmt, "mysql_stmt_execute()");
+        putpstmt(conp, cur);
+        return (ERR_SCM_SQL);
+    }
+    if (cur->nfields == 0)
+    {
+        conp->mystat.rows = (int)mysql_stmt_affected_rows(cur->stmt);
+        putpstmt(conp, cur);
+        if (curp != NULL)
+            *curp = NULL;
+        return (0);
+    }
+    if (mysql_stmt_store_result(cur->stmt))
+    {
+        mystmteer(conp, cur->stmt, "mysql_stmt_store_result()");
+        putpstmt(conp, cur);
+        return (ERR_SCM_SQL);
+    }
+    conp->mystat.rows = (int)mysql_stmt_num_rows(cur->stmt);
+    if (curp != NULL)
+        *curp = cur;
+    else
+        putpstmt(conp, cur);
+    return (0);
+}
+
+static err_code
+my_rowcount(
+    scmcon *conp,
+    scmcursor *curp,
+    ssize_t *nrows)
+{
+    UNREFERENCED_PARAMETER(conp);
+    if (curp->res != NULL)
+        *nrows = (ssize_t)mysql_num_rows(curp->res);
+    else
+        *nrows = (ssize_t)mysql_stmt_num_rows(curp->stmt);
+    return (0);
+}
+
+/*
+ * Fetch the next row of a text statement's result, converting from
+ * the text protocol the way SQLBindCol() would.
+ */
+static int
+fetchrow(
+    scmcursor *curp,
+    scmsrcha *srch)
+{
+    MYSQL_ROW row;
+    unsigned long *lens;
+    unsigned int nfields;
+    unsigned int col;
+    unsigned long n;
+    scmsrch *vecp;
+    int ret = 1;
+    int i;
+
+    row = mysql_fetch_row(curp->res);
+    if (row == NULL)
+        return (0);
+    lens = mysql_fetch_lengths(curp->res);
+    nfields = mysql_num_fields(curp->res);
+    for (i = 0; i < srch->nused; i++)
+    {
+        vecp = (&srch->vec[i]);
+        col = vecp->colno <= 0 ? (unsigned int)i :
+            (unsigned int)vecp->colno - 1;
+        if (col >= nfields || row[col] == NULL)
+        {
+            vecp->avalsize = SQL_NULL_DATA;
+            continue;
+        }
+        switch (vecp->sqltype)
+        {
+        case SQL_C_CHAR:
+            // leave room for the nul terminator, as ODBC does
+            n = lens[col] < vecp->valsize ? lens[col] : vecp->valsize - 1;
+            memcpy(vecp->valptr, row[col], n);
+            ((char *)vecp->valptr)[n] = 0;
+            vecp->avalsize = lens[col];
+            break;
+        case SQL_C_BINARY:
+            n = lens[col] < vecp->valsize ? lens[col] : vecp->valsize;
+            memcpy(vecp->valptr, row[col], n);
+            vecp->avalsize = lens[col];
+            break;
+        case SQL_C_ULONG:
+            *(SQLUINTEGER *)vecp->valptr =
+                (SQLUINTEGER)strtoul(row[col], NULL, 10);
+            vecp->avalsize = sizeof(SQLUINTEGER);
+            break;
+        case SQL_C_LONG:
+            *(SQLINTEGER *)vecp->valptr =
+                (SQLINTEGER)strtol(row[col], NULL, 10);
+            vecp->avalsize = sizeof(SQLINTEGER);
+            break;
+        default:
+            LOG(LOG_ERR, "unsupported SQL C type %d for column %s",
+                vecp->sqltype, vecp->colname);
+            vecp->avalsize = SQL_NULL_DATA;
+            ret = ERR_SCM_INVALARG;
+            break;
+        }
+    }
+    return (ret);
+}
+
+/*
+ * Bind the columns of a search array as the result buffers of a
+ * prepared statement.  Columns of the result that aren't in the
+ * search array are skipped.
+ */
+static err_code
+bindresult(
+    scmcon *conp,
+    scmcursor *curp,
+    scmsrcha *srch)
+{
+    unsigned int n = curp->nfields;
+    unsigned int col;
+    scmsrch *vecp;
+    MYSQL_BIND *b;
+    int i;
+
+    curp->bind = calloc(n, sizeof(MYSQL_BIND));
+    curp->lengths = calloc(n, sizeof(unsigned long));
+    curp->nulls = calloc(n, sizeof(my_bool));
+    if (curp->bind == NULL || curp->lengths == NULL || curp->nulls == NULL)
+    {
+        unbind(curp);
+        return (ERR_SCM_NOMEM);
+    }
+    for (col = 0; col < n; col++)
+    {
+        curp->bind[col].buffer_type = MYSQL_TYPE_NULL;
+        curp->bind[col].length = &curp->lengths[col];
+        curp->bind[col].is_null = &curp->nulls[col];
+    }
+    for (i = 0; i < srch->nused; i++)
+    {
+        vecp = (&srch->vec[i]);
+        col = vecp->colno <= 0 ? (unsigned int)i :
+            (unsigned int)vecp->colno - 1;
+        if (col >= n)
+            continue;
+        b = &curp->bind[col];
+        b->buffer = vecp->valptr;
+        b->buffer_length = vecp->valsize;
+        switch (vecp->sqltype)
+        {
+        case SQL_C_CHAR:
+            b->buffer_type = MYSQL_TYPE_STRING;
+            break;
+        case SQL_C_BINARY:
+            b->buffer_type = MYSQL_TYPE_BLOB;
+            break;
+        case SQL_C_ULONG:
+            b->buffer_type = MYSQL_TYPE_LONG;
+            b->is_unsigned = (my_bool)1;
+            break;
+        case SQL_C_LONG:
+            b->buffer_type = MYSQL_TYPE_LONG;
+            break;
+        default:
+            LOG(LOG_ERR, "unsupported SQL C type %d for column %s",
+                vecp->sqltype, vecp->colname);
+            unbind(curp);
+            return (ERR_SCM_INVALARG);
+        }
+    }
+    if (mysql_stmt_bind_result(curp->stmt, curp->bind))
+    {
+        mystmteer(conp, curp->stmt, "mysql_stmt_bind_result()");
+        unbind(curp);
+        return (ERR_SCM_SQL);
+    }
+    return (0);
+}
+
+static int
+my_fetch(
+    scmcon *conp,
+    scmcursor *curp,
+    scmsrcha *srch)
+{
+    unsigned int col;
+    unsigned long len;
+    scmsrch *vecp;
+    err_code sta;
+    int ret;
+    int i;
+
+    if (curp->res != NULL)
+        return (fetchrow(curp, srch));
+    if (curp->bind == NULL)
+    {
+        sta = bindresult(conp, curp, srch);
+        if (sta < 0)
+            return (sta);
+    }
+    ret = mysql_stmt_fetch(curp->stmt);
+    if (ret == MYSQL_NO_DATA)
+        return (0);
+    // truncated strings are cut to fit below, as ODBC does
+    if (ret != 0 && ret != MYSQL_DATA_TRUNCATED)
+    {
+        mystmteer(conp, curp->stmt, "mysql_stmt_fetch()");
+        return (ERR_SCM_SQL);
+    }
+    for (i = 0; i < srch->nused; i++)
+    {
+        vecp = (&srch->vec[i]);
+        col = vecp->colno <= 0 ? (unsigned int)i :
+            (unsigned int)vecp->colno - 1;
+        if (col >= curp->nfields || curp->nulls[col])
+        {
+            vecp->avalsize = SQL_NULL_DATA;
+            continue;
+        }
+        len = curp->lengths[col];
+        switch (vecp->sqltype)
+        {
+        case SQL_C_CHAR:
+            ((char *)vecp->valptr)[len < vecp->valsize ?
+                                   len : vecp->valsize - 1] = 0;
+            vecp->avalsize = len;
+            break;
+        case SQL_C_BINARY:
+            vecp->avalsize = len;
+            break;
+        case SQL_C_ULONG:
+            vecp->avalsize = sizeof(SQLUINTEGER);
+            break;
+        default:
+            vecp->avalsize = sizeof(SQLINTEGER);
+            break;
+        }
+    }
+    return (1);
+}
+
+static void
+my_close(
+    scmcon *conp,
+    scmcursor *curp)
+{
+    if (curp->stmt != NULL)
+    {
+        putpstmt(conp, curp);
+        return;
+    }
+    mysql_free_result(curp->res);
+    free((void *)curp);
+}
+
+const struct scm_backend scm_backend_mysql = {
+    .name = "mysql",
+    .dialect = SCM_DIALECT_MYSQL,
+    .connect = my_connect,
+    .disconnect = my_disconnect,
+    .execute = my_execute,
+    .execute_prepared = my_execute_prepared,
+    .rowcount = my_rowcount,
+    .fetch = my_fetch,
+    .close = my_close,
+    .createdb = sqlcreatedb,
+    .deletedb = sqldeletedb,
+    .usedb = sqlusedb,
+    .createtable = sqlcreatetable,
+};
@@ -0,0 +1,485 @@
+/*
+ * DatabaseBackend "odbc": statements go through the ODBC driver
+ * manager to the driver named by DatabaseDSN.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scm.h"
+#include "scmf.h"
+#include "sqbackend.h"
+#include "err.h"
+
+
+struct _scmcursor {
+    SQLHSTMT hstmt;
+    int which;                  /* enum scm_pstmt, or -1 if not prepared */
+    int bound;                  /* have the columns been bound? */
+    struct _scmcursor *next;    /* next idle handle for the same "which" */
+};
+
+struct odbccon {
+    SQLHENV henv;               /* environment handle */
+    SQLHDBC hdbc;               /* database handle */
+    int connected;              /* did SQLDriverConnect() succeed? */
+    scmcursor *pstmts[SCM_PSTMT_NUM];   /* idle prepared statements */
+};
+
+/*
+ * Decode the last error on a handle
+ */
+
+static void heer(
+    SQLSMALLINT what,
+    SQLHANDLE h,
+    char *errmsg,
+    int emlen)
+{
+    SQLINTEGER nep;
+    SQLSMALLINT tl;
+    // ODBC docs say that state gets a 5-character SQLSTATE code plus
+    // a terminating nul byte
+    SQLCHAR state[6];
+    SQLSMALLINT i = 1;
+    // RFC5424 says minimum maximum syslog message is 480 octets; use
+    // 400 to give room for overhead
+    SQLCHAR msg[400];
+
+    while (SQLOK(SQLGetDiagRec(
+                     what, h, i, state, &nep, msg,
+                     sizeof(msg)/sizeof(msg[0]), &tl)))
+    {
+        LOG(LOG_ERR, "  %s %ld %s%s",
+            (char *)state, (long)nep, (char *)msg,
+            ((size_t)tl >= sizeof(msg)) ? " (truncated)" : "");
+        ++i;
+    }
+
+    SQLGetDiagRec(what, h, 1, state, &nep,
+                  (SQLCHAR *) errmsg, emlen, &tl);
+}
+
+/*
+ * Free a list of statement handles.
+ */
+
+static void freecursors(
+    scmcursor *curp)
+{
+    scmcursor *nextp;
+
+    while (curp != NULL)
+    {
+        if (curp->hstmt != NULL)
+        {
+            SQLFreeHandle(SQL_HANDLE_STMT, curp->hstmt);
+            curp->hstmt = NULL;
+        }
+        nextp = curp->next;
+        free((void *)curp);
+        curp = nextp;
+    }
+}
+
+/*
+ * Allocate a statement handle for statement "which" (or -1).
+ */
+
+static scmcursor *newcursor(
+    scmcon *conp,
+    int which)
+{
+    struct odbccon *odbc = conp->bdata;
+    scmcursor *curp;
+    SQLRETURN ret;
+
+    curp = (scmcursor *) calloc(1, sizeof(scmcursor));
+    if (curp == NULL)
+        return (NULL);
+    curp->which = which;
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, odbc->hdbc, &curp->hstmt);
+    if (!SQLOK(ret))
+    {
+        LOG(LOG_ERR, "SQLAllocHandle() failed:");
+        heer(SQL_HANDLE_DBC, odbc->hdbc,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        free((void *)curp);
+        return (NULL);
+    }
+    if (which < 0)
+    {
+        ret = SQLSetStmtAttr(curp->hstmt, SQL_ATTR_NOSCAN,
+                             (SQLPOINTER) SQL_NOSCAN_ON, SQL_IS_UINTEGER);
+        if (!SQLOK(ret))
+        {
+            heer(SQL_HANDLE_STMT, curp->hstmt,
+                 conp->mystat.errmsg, conp->mystat.emlen);
+            freecursors(curp);
+            return (NULL);
+        }
+    }
+    return (curp);
+}
+
+static void
+odbc_disconnect(
+    scmcon *conp)
+{
+    struct odbccon *odbc = conp->bdata;
+    int i;
+
+    for (i = 0; i < SCM_PSTMT_NUM; i++)
+    {
+        freecursors(odbc->pstmts[i]);
+        odbc->pstmts[i] = NULL;
+    }
+    if (odbc->connected)
+    {
+        SQLDisconnect(odbc->hdbc);
+        odbc->connected = 0;
+    }
+    if (odbc->hdbc != NULL)
+    {
+        SQLFreeHandle(SQL_HANDLE_DBC, odbc->hdbc);
+        odbc->hdbc = NULL;
+    }
+    if (odbc->henv != NULL)
+    {
+        SQLFreeHandle(SQL_HANDLE_ENV, odbc->henv);
+        odbc->henv = NULL;
+    }
+    free((void *)odbc);
+    conp->bdata = NULL;
+}
+
+static err_code
+odbc_connect(
+    scmcon *conp,
+    const char *dsn)
+{
+    static char badhenv[] = "Cannot allocate HENV handle";
+    static char oom[] = "Out of memory!";
+    struct odbccon *odbc;
+    SQLSMALLINT outret;
+    SQLRETURN ret;
+    char outlen[1024];
+
+    odbc = (struct odbccon *)calloc(1, sizeof(struct odbccon));
+    if (odbc == NULL)
+    {
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s", oom);
+        return (ERR_SCM_NOMEM);
+    }
+    conp->bdata = odbc;
+    ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &odbc->henv);
+    if (!SQLOK(ret))
+    {
+        (void)snprintf(conp->mystat.errmsg, conp->mystat.emlen, "%s",
+                       badhenv);
+        return (ERR_SCM_SQL);
+    }
+    ret = SQLSetEnvAttr(odbc->henv, SQL_ATTR_ODBC_VERSION,
+                        (SQLPOINTER) SQL_OV_ODBC3, sizeof(int));
+    if (!SQLOK(ret))
+    {
+        heer(SQL_HANDLE_ENV, odbc->henv,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        return (ERR_SCM_SQL);
+    }
+    ret = SQLAllocHandle(SQL_HANDLE_DBC, odbc->henv, &odbc->hdbc);
+    if (!SQLOK(ret))
+    {
+        heer(SQL_HANDLE_ENV, odbc->henv,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        return (ERR_SCM_SQL);
+    }
+    ret = SQLDriverConnect(odbc->hdbc, NULL, (SQLCHAR *) dsn,
+                           strlen(dsn) + 1, (SQLCHAR *) & outlen[0],
+                           sizeof(outlen), &outret, 0);
+    if (!SQLOK(ret))
+    {
+        heer(SQL_HANDLE_DBC, odbc->hdbc,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        return (ERR_SCM_SQL);
+    }
+    odbc->connected = 1;
+    return (0);
+}
+
+static err_code
+odbc_execute(
+    scmcon *conp,
+    const char *stm,
+    scmcursor **curp)
+{
+    scmcursor *cur;
+    SQLLEN len;
+    SQLRETURN ret;
+
+    cur = newcursor(conp, -1);
+    if (cur == NULL)
+        return (ERR_SCM_SQL);
+    ret = SQLExecDirect(cur->hstmt, (SQLCHAR *) stm, strlen(stm));
+    if (!SQLOK(ret))
+    {
+        LOG(LOG_ERR, "SQLExecDirect() failed:");
+        heer(SQL_HANDLE_STMT, cur->hstmt,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        freecursors(cur);
+        return (ERR_SCM_SQL);
+    }
+    len = 0;
+    ret = SQLRowCount(cur->hstmt, &len);
+    if (!SQLOK(ret))
+    {
+        LOG(LOG_ERR, "SQLRowCount() failed:");
+        heer(SQL_HANDLE_STMT, cur->hstmt,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        freecursors(cur);
+        return (ERR_SCM_SQL);
+    }
+    conp->mystat.rows = (int)len;
+    if (curp != NULL)
+        *curp = cur;
+    else
+        freecursors(cur);
+    return (0);
+}
+
+/*
+ * Get a handle on which prepared statement "which" is ready to
+ * execute.  Idle handles are kept on a per-statement stack, so that a
+ * statement that is still open further up the call stack (see
+ * searchscm_prepared()) gets a second handle rather than being
+ * clobbered.  A new handle is prepared only when the stack is empty.
+ */
+static scmcursor *
+getpstmt(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const char *query)
+{
+    struct odbccon *odbc = conp->bdata;
+    scmcursor *cur;
+    SQLRETURN ret;
+
+    cur = odbc->pstmts[which];
+    if (cur != NULL)
+    {
+        odbc->pstmts[which] = cur->next;
+        cur->next = NULL;
+        return (cur);
+    }
+    cur = newcursor(conp, which);
+    if (cur == NULL)
+        return (NULL);
+    ret = SQLPrepare(cur->hstmt, (SQLCHAR *) query, SQL_NTS);
+    if (!SQLOK(ret))
+    {
+        LOG(LOG_ERR, "SQLPrepare(\"%s\") failed:", query);
+        heer(SQL_HANDLE_STMT, cur->hstmt,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        freecursors(cur);
+        return (NULL);
+    }
+    return (cur);
+}
+
+/*
+ * Return a handle from getpstmt() to the idle stack.
+ */
+static void
+putpstmt(
+    scmcon *conp,
+    scmcursor *cur)
+{
+    struct odbccon *odbc = conp->bdata;
+
+    // the column buffers belong to the caller's search array
+    SQLFreeStmt(cur->hstmt, SQL_CLOSE);
+    SQLFreeStmt(cur->hstmt, SQL_UNBIND);
+    cur->bound = 0;
+    cur->next = odbc->pstmts[cur->which];
+    odbc->pstmts[cur->which] = cur;
+}
+
+static err_code
+odbc_execute_prepared(
+    scmcon *conp,
+    enum scm_pstmt which,
+    const char *query,
+    const scmparam *params,
+    int nparams,
+    scmcursor **curp)
+{
+    SQLLEN ind[nparams > 0 ? nparams : 1];
+    scmcursor *cur;
+    SQLSMALLINT sqltype;
+    SQLULEN colsize;
+    SQLLEN len;
+    SQLRETURN ret;
+    int i;
+
+    cur = getpstmt(conp, which, query);
+    if (cur == NULL)
+        return (ERR_SCM_SQL);
+    for (i = 0; i < nparams; i++)
+    {
+        switch (params[i].sqltype)
+        {
+        case SQL_C_CHAR:
+            sqltype = SQL_VARCHAR;
+            colsize = (params[i].valsize == SQL_NTS) ?
+                strlen(params[i].valptr) : (SQLULEN)params[i].valsize;
+            ind[i] = params[i].valsize;
+            break;
+        case SQL_C_BINARY:
+            sqltype = SQL_VARBINARY;
+            colsize = params[i].valsize;
+            ind[i] = params[i].valsize;
+            break;
+        case SQL_C_ULONG:
+            sqltype = SQL_INTEGER;
+            colsize = 0;
+            ind[i] = 0;
+            break;
+        default:
+            SQLFreeStmt(cur->hstmt, SQL_RESET_PARAMS);
+            putpstmt(conp, cur);
+            return (ERR_SCM_INVALARG);
+        }
+        ret = SQLBindParameter(cur->hstmt, i + 1, SQL_PARAM_INPUT,
+                               params[i].sqltype, sqltype, colsize, 0,
+                               (SQLPOINTER) params[i].valptr,
+                               (params[i].valsize == SQL_NTS) ?
+                               0 : params[i].valsize, &ind[i]);
+        if (!SQLOK(ret))
+        {
+            LOG(LOG_ERR, "SQLBindParameter() failed:");
+            heer(SQL_HANDLE_STMT, cur->hstmt,
+                 conp->mystat.errmsg, conp->mystat.emlen);
+            SQLFreeStmt(cur->hstmt, SQL_RESET_PARAMS);
+            putpstmt(conp, cur);
+            return (ERR_SCM_SQL);
+        }
+    }
+    ret = SQLExecute(cur->hstmt);
+    // the parameter buffers don't outlive this call
+    SQLFreeStmt(cur->hstmt, SQL_RESET_PARAMS);
+    if (!SQLOK(ret) && ret != SQL_NO_DATA)
+    {
+        LOG(LOG_ERR, "SQLExecute(\"%s\") failed:", query);
+        heer(SQL_HANDLE_STMT, cur->hstmt,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        putpstmt(conp, cur);
+        return (ERR_SCM_SQL);
+    }
+    len = 0;
+    if (SQLOK(SQLRowCount(cur->hstmt, &len)))
+        conp->mystat.rows = (int)len;
+    if (curp != NULL)
+        *curp = cur;
+    else
+        putpstmt(conp, cur);
+    return (0);
+}
+
+static err_code
+odbc_rowcount(
+    scmcon *conp,
+    scmcursor *curp,
+    ssize_t *nrows)
+{
+    SQLLEN len = 0;
+
+    /**
+     * @bug
+     *     The ODBC documentation for SQLRowCount() says:
+     *
+     *     > [T]he driver may define the value returned in
+     *     > *RowCountPtr.  For example, some data sources may be
+     *     > able to return the number of rows returned by a
+     *     > SELECT statement or a catalog function before
+     *     > fetching the rows.
+     *     >
+     *     > Note
+     *     >   Many data sources cannot return the number of rows
+     *     >   in a result set before fetching them; for maximum
+     *     >   interoperability, applications should not rely on
+     *     >   this behavior.
+     *
+     *     The following relies on that unreliable behavior.
+     *
+     *     There may be alternative ways to reliably get the
+     *     count; see http://stackoverflow.com/q/243782
+     */
+    if (!SQLOK(SQLRowCount(curp->hstmt, &len)))
+    {
+        heer(SQL_HANDLE_STMT, curp->hstmt,
+             conp->mystat.errmsg, conp->mystat.emlen);
+        return (ERR_SCM_SQL);
+    }
+    *nrows = len;
+    return (0);
+}
+
+static int
+odbc_fetch(
+    scmcon *conp,
+    scmcursor *curp,
+    scmsrcha *srch)
+{
+    scmsrch *vecp;
+    SQLRETURN rc;
+    int i;
+
+    UNREFERENCED_PARAMETER(conp);
+    // do the column binding
+    for (i = 0; !curp->bound && i < srch->nused; i++)
+    {
+        vecp = (&srch->vec[i]);
+        SQLBindCol(curp->hstmt,
+                   vecp->colno <= 0 ? i + 1 : vecp->colno, vecp->sqltype,
+                   vecp->valptr, vecp->valsize,
+                   &vecp->avalsize);
+    }
+    curp->bound = 1;
+    rc = SQLFetch(curp->hstmt);
+    if (rc == SQL_NO_DATA)
+        return (0);
+    if (!SQLOK(rc))
+        return (ERR_SCM_SQL);
+    return (1);
+}
+
+static void
+odbc_close(
+    scmcon *conp,
+    scmcursor *curp)
+{
+    if (curp->which >= 0)
+    {
+        putpstmt(conp, curp);
+        return;
+    }
+    SQLCloseCursor(curp->hstmt);
+    freecursors(curp);
+}
+
+const struct scm_backend scm_backend_odbc = {
+    .name = "odbc",
+    .dialect = SCM_DIALECT_MYSQL,
+    .connect = odbc_connect,
+    .disconnect = odbc_disconnect,
+    .execute = odbc_execute,
+    .execute_prepared = odbc_execute_prepared,
+    .rowcount = odbc_rowcount,
+    .fetch = odbc_fetch,
+    .close = odbc_close,
+    .createdb = sqlcreatedb,
+    .deletedb = sqldeletedb,
+    .usedb = sqlusedb,
+    .createtable = sqlcreatetable,
+};
@@ -0,0 +1,642 @@
+/*
+ * Microbenchmarks of the per-object kernels that the loader and
+ * offline-validate spend their time in: ASN.1 decoding and encoding,
+ * OpenSSL field extraction, the standalone profile checks, signature
+ * verification, and hashing.
+ *
+ * Usage: kernels-bench [-t seconds] file...
+ *
+ * Each file is classified by its extension (.cer, .crl, .roa, or
+ * .mft/.man) and must decode.  Every kernel that applies to a type is
+ * first run once over all the objects of that type, counting the
+ * objects it rejects (the corpus may contain deliberately bad
+ * objects), and is then run over them repeatedly for at least the
+ * given number of seconds (default 0.5).  The results are printed as
+ * "name value" lines, e.g.
+ *
+ *     decode_casn_cer_objects 17
+ *     decode_casn_cer_failures 0
+ *     decode_casn_cer_ns_per_object 10234
+ *     decode_casn_cer_allocs_per_object 161.00
+ *     decode_casn_cer_bytes_per_object 9876.00
+ *
+ * Allocations are counted by wrapping malloc(), calloc(), and
+ * realloc(), which is only done with glibc.  Allocations that libc
+ * makes internally (e.g. in strdup()) are not seen.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/x509.h>
+
+#include "casn/casn.h"
+#include "config/config.h"
+#include "rpki/myssl.h"
+#include "rpki/sqhl.h"
+#include "rpki/cms/roa_utils.h"
+#include "rpki-object/certificate.h"
+#include "test/unittest.h"
+#include "util/hashutils.h"
+#include "util/logging.h"
+
+
+#ifdef __GLIBC__
+
+#define COUNT_ALLOCS 1
+
+extern void *__libc_malloc(
+    size_t size);
+extern void *__libc_calloc(
+    size_t nmemb,
+    size_t size);
+extern void *__libc_realloc(
+    void *ptr,
+    size_t size);
+
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+
+void *malloc(
+    size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(
+    size_t nmemb,
+    size_t size)
+{
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(
+    void *ptr,
+    size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+#else
+
+#define COUNT_ALLOCS 0
+
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+
+#endif
+
+
+enum kind {
+    KIND_CER,
+    KIND_CRL,
+    KIND_ROA,
+    KIND_MFT,
+    NUM_KINDS
+};
+
+static const char *const kind_names[NUM_KINDS] = {
+    "cer",
+    "crl",
+    "roa",
+    "mft",
+};
+
+union decoded {
+    struct Certificate cert;
+    struct CertificateRevocationList crl;
+    struct CMS cms;
+};
+
+struct object {
+    char *path;
+    const char *name;           /* last component of path */
+    unsigned char *der;
+    int len;
+    union decoded *decoded;
+    X509 *x509;                 /* certificates only */
+    int cert_type;              /* TA_CERT, CA_CERT, or EE_CERT */
+};
+
+struct corpus {
+    struct object *v;
+    size_t len;
+};
+
+static struct corpus corpora[NUM_KINDS];
+
+/* Allowed CRL extensions, the same as in sqhl.c. */
+static struct goodoid goodoids[3];
+
+
+static struct casn *construct(
+    union decoded *d,
+    enum kind kind)
+{
+    switch (kind)
+    {
+    case KIND_CER:
+        Certificate(&d->cert, 0);
+        return &d->cert.self;
+    case KIND_CRL:
+        CertificateRevocationList(&d->crl, 0);
+        return &d->crl.self;
+    default:
+        CMS(&d->cms, 0);
+        return &d->cms.self;
+    }
+}
+
+static struct casn *decoded_self(
+    union decoded *d,
+    enum kind kind)
+{
+    switch (kind)
+    {
+    case KIND_CER:
+        return &d->cert.self;
+    case KIND_CRL:
+        return &d->crl.self;
+    default:
+        return &d->cms.self;
+    }
+}
+
+
+/*
+ * The kernels.  Each one processes a single object and returns
+ * whether the object passed.
+ */
+
+static bool k_decode_casn(
+    struct object *obj,
+    enum kind kind)
+{
+    union decoded d;
+    struct casn *casnp = construct(&d, kind);
+    bool ok = decode_casn(casnp, obj->der) == obj->len;
+    delete_casn(casnp);
+    return ok;
+}
+
+static bool k_encode_casn(
+    struct object *obj,
+    enum kind kind)
+{
+    struct casn *casnp = decoded_self(obj->decoded, kind);
+    int len = size_casn(casnp);
+    unsigned char *buf;
+    bool ok;
+
+    if (len <= 0)
+        return false;
+    buf = malloc(len);
+    if (buf == NULL)
+        return false;
+    ok = encode_casn(casnp, buf) == len;
+    free(buf);
+    return ok;
+}
+
+static bool k_get_casn_file(
+    struct object *obj,
+    enum kind kind)
+{
+    union decoded d;
+    struct casn *casnp = construct(&d, kind);
+    bool ok = get_casn_file(casnp, obj->path, 0) == obj->len;
+    delete_casn(casnp);
+    return ok;
+}
+
+static bool k_cert2fields(
+    struct object *obj,
+    enum kind kind)
+{
+    cert_fields *cf;
+    X509 *x = NULL;
+    err_code sta = 0;
+    int x509sta;
+
+    (void)kind;
+    cf = cert2fields((char *)obj->name, obj->path, OT_CER, &x, &sta,
+                     &x509sta);
+    if (cf != NULL)
+        freecf(cf);
+    if (x != NULL)
+        X509_free(x);
+    return cf != NULL && sta == 0;
+}
+
+static bool k_crl2fields(
+    struct object *obj,
+    enum kind kind)
+{
+    crl_fields *cf;
+    X509_CRL *x = NULL;
+    err_code sta = 0;
+    int crlsta;
+
+    (void)kind;
+    cf = crl2fields((char *)obj->name, obj->path, OT_CRL, &x, &sta, &crlsta,
+                    goodoids);
+    if (cf != NULL)
+        freecrf(cf);
+    if (x != NULL)
+        X509_CRL_free(x);
+    return cf != NULL && sta == 0;
+}
+
+static bool k_rescert_profile_chk(
+    struct object *obj,
+    enum kind kind)
+{
+    (void)kind;
+    return rescert_profile_chk(obj->x509, &obj->decoded->cert,
+                               obj->cert_type) == 0;
+}
+
+static bool k_crl_profile_chk(
+    struct object *obj,
+    enum kind kind)
+{
+    (void)kind;
+    return crl_profile_chk(&obj->decoded->crl) == 0;
+}
+
+static bool k_roaValidate(
+    struct object *obj,
+    enum kind kind)
+{
+    (void)kind;
+    return roaValidate(&obj->decoded->cms) == 0;
+}
+
+static bool k_manifestValidate(
+    struct object *obj,
+    enum kind kind)
+{
+    int stale;
+
+    (void)kind;
+    return manifestValidate(&obj->decoded->cms, &stale) == 0;
+}
+
+static bool k_checkIPAddrs(
+    struct object *obj,
+    enum kind kind)
+{
+    struct SignedData *sdp = &obj->decoded->cms.content.signedData;
+
+    (void)kind;
+    return checkIPAddrs(&sdp->certificates.certificate,
+                        &sdp->encapContentInfo.eContent.roa.ipAddrBlocks)
+        == 0;
+}
+
+static bool k_check_sig(
+    struct object *obj,
+    enum kind kind)
+{
+    struct CMS *cmsp = &obj->decoded->cms;
+
+    (void)kind;
+    return check_sig(cmsp, &cmsp->content.signedData.certificates.
+                     certificate) == 0;
+}
+
+static bool k_gen_hash(
+    struct object *obj,
+    enum kind kind)
+{
+    unsigned char hash[40];
+
+    (void)kind;
+    return gen_hash(obj->der, obj->len, hash, CRYPT_ALGO_SHA2) > 0;
+}
+
+#define K_ALL ((1 << NUM_KINDS) - 1)
+#define K(kind) (1 << (kind))
+
+static const struct kernel {
+    const char *name;
+    int kinds;                  /* bit mask of the kinds it applies to */
+    bool (*run)(struct object *, enum kind);
+} kernels[] = {
+    {"decode_casn", K_ALL, k_decode_casn},
+    {"encode_casn", K_ALL, k_encode_casn},
+    {"get_casn_file", K_ALL, k_get_casn_file},
+    {"cert2fields", K(KIND_CER), k_cert2fields},
+    {"crl2fields", K(KIND_CRL), k_crl2fields},
+    {"rescert_profile_chk", K(KIND_CER), k_rescert_profile_chk},
+    {"crl_profile_chk", K(KIND_CRL), k_crl_profile_chk},
+    {"roaValidate", K(KIND_ROA), k_roaValidate},
+    {"manifestValidate", K(KIND_MFT), k_manifestValidate},
+    {"checkIPAddrs", K(KIND_ROA), k_checkIPAddrs},
+    {"check_sig", K(KIND_ROA) | K(KIND_MFT), k_check_sig},
+    {"gen_hash", K_ALL, k_gen_hash},
+};
+
+
+static uint64_t now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void make_goodoids(
+    void)
+{
+    struct casn casn;
+    uchar oid[8];
+    int lth;
+
+    simple_constructor(&casn, (ushort) 0, ASN_OBJ_ID);
+    write_objid(&casn, id_cRLNumber);
+    lth = read_casn(&casn, oid);
+    goodoids[0].oid = (uchar *) calloc(1, lth + 1);
+    memcpy(goodoids[0].oid, oid, lth);
+    goodoids[0].lth = lth;
+    write_objid(&casn, id_authKeyId);
+    lth = read_casn(&casn, oid);
+    goodoids[1].oid = (uchar *) calloc(1, lth + 1);
+    memcpy(goodoids[1].oid, oid, lth);
+    goodoids[1].lth = lth;
+    goodoids[2].lth = 0;
+    goodoids[2].oid = NULL;
+    delete_casn(&casn);
+}
+
+static bool classify(
+    const char *path,
+    enum kind *kindp)
+{
+    const char *ext = strrchr(path, '.');
+
+    if (ext == NULL)
+        return false;
+    if (strcmp(ext, ".cer") == 0)
+        *kindp = KIND_CER;
+    else if (strcmp(ext, ".crl") == 0)
+        *kindp = KIND_CRL;
+    else if (strcmp(ext, ".roa") == 0)
+        *kindp = KIND_ROA;
+    else if (strcmp(ext, ".mft") == 0 || strcmp(ext, ".man") == 0)
+        *kindp = KIND_MFT;
+    else
+        return false;
+    return true;
+}
+
+static int cert_type(
+    struct Certificate *certp)
+{
+    struct Extension *extp;
+
+    extp = find_extension(&certp->toBeSigned.extensions, id_basicConstraints,
+                          false);
+    if (extp == NULL || size_casn(&extp->extnValue.basicConstraints.cA) == 0)
+        return EE_CERT;
+    if (diff_casn(&certp->toBeSigned.subject.self,
+                  &certp->toBeSigned.issuer.self) == 0)
+        return TA_CERT;
+    return CA_CERT;
+}
+
+/*
+ * Read and decode a corpus file.  The checks here are on the corpus,
+ * not on the kernels: every object must decode and re-encode to the
+ * same bytes, so that encode_casn() and the checks that take decoded
+ * objects see what is in the file.
+ */
+static bool load_object(
+    const char *path)
+{
+    struct corpus *corpus;
+    struct object *obj;
+    enum kind kind;
+    FILE *fp;
+    long len;
+    unsigned char *buf;
+
+    if (!classify(path, &kind))
+    {
+        fprintf(stderr, "%s: unknown object type\n", path);
+        return false;
+    }
+    corpus = &corpora[kind];
+    obj = realloc(corpus->v, (corpus->len + 1) * sizeof(*corpus->v));
+    TEST_BOOL(obj != NULL, true);
+    corpus->v = obj;
+    obj = &corpus->v[corpus->len++];
+    memset(obj, 0, sizeof(*obj));
+
+    obj->path = strdup(path);
+    TEST_BOOL(obj->path != NULL, true);
+    obj->name = strrchr(obj->path, '/');
+    obj->name = obj->name != NULL ? obj->name + 1 : obj->path;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    TEST(int, "%d", fseek(fp, 0, SEEK_END), ==, 0);
+    len = ftell(fp);
+    rewind(fp);
+    TEST(long, "%ld", len, >, 0);
+    obj->len = (int)len;
+    obj->der = malloc(obj->len);
+    TEST_BOOL(obj->der != NULL, true);
+    TEST(size_t, "%zu", fread(obj->der, 1, obj->len, fp), ==,
+         (size_t)obj->len);
+    fclose(fp);
+
+    obj->decoded = malloc(sizeof(*obj->decoded));
+    TEST_BOOL(obj->decoded != NULL, true);
+    TEST(int, "%d",
+         decode_casn(construct(obj->decoded, kind), obj->der), ==, obj->len);
+
+    buf = malloc(obj->len);
+    TEST_BOOL(buf != NULL, true);
+    TEST(int, "%d", encode_casn(decoded_self(obj->decoded, kind), buf), ==,
+         obj->len);
+    TEST_MEMCMP(buf, ==, obj->der, obj->len);
+    free(buf);
+
+    if (kind == KIND_CER)
+    {
+        const unsigned char *p = obj->der;
+
+        obj->x509 = d2i_X509(NULL, &p, obj->len);
+        TEST_BOOL(obj->x509 != NULL, true);
+        obj->cert_type = cert_type(&obj->decoded->cert);
+    }
+    return true;
+}
+
+static void free_corpora(
+    void)
+{
+    size_t i;
+    int kind;
+
+    for (kind = 0; kind < NUM_KINDS; kind++)
+    {
+        for (i = 0; i < corpora[kind].len; i++)
+        {
+            struct object *obj = &corpora[kind].v[i];
+
+            if (obj->decoded != NULL)
+            {
+                delete_casn(decoded_self(obj->decoded, kind));
+                free(obj->decoded);
+            }
+            if (obj->x509 != NULL)
+                X509_free(obj->x509);
+            free(obj->der);
+            free(obj->path);
+        }
+        free(corpora[kind].v);
+    }
+}
+
+static void bench(
+    const struct kernel *kernel,
+    enum kind kind,
+    uint64_t min_ns)
+{
+    struct corpus *corpus = &corpora[kind];
+    size_t failures = 0;
+    uint64_t runs = 0;
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t elapsed;
+    size_t i;
+
+    // one untimed pass to count rejected objects and warm up caches
+    for (i = 0; i < corpus->len; i++)
+    {
+        if (!kernel->run(&corpus->v[i], kind))
+            failures++;
+    }
+
+    allocs = alloc_count;
+    bytes = alloc_bytes;
+    start = now_ns();
+    do
+    {
+        for (i = 0; i < corpus->len; i++)
+            kernel->run(&corpus->v[i], kind);
+        runs += corpus->len;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ns);
+    allocs = alloc_count - allocs;
+    bytes = alloc_bytes - bytes;
+
+    printf("%s_%s_objects %zu\n", kernel->name, kind_names[kind],
+           corpus->len);
+    printf("%s_%s_failures %zu\n", kernel->name, kind_names[kind],
+           failures);
+    printf("%s_%s_ns_per_object %" PRIu64 "\n", kernel->name,
+           kind_names[kind], elapsed / runs);
+    if (COUNT_ALLOCS)
+    {
+        printf("%s_%s_allocs_per_object %.2f\n", kernel->name,
+               kind_names[kind], (double)allocs / runs);
+        printf("%s_%s_bytes_per_object %.2f\n", kernel->name,
+               kind_names[kind], (double)bytes / runs);
+    }
+    fflush(stdout);
+}
+
+static void usage(
+    const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-t seconds] file...\n", progname);
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    double seconds = 0.5;
+    int ret = EXIT_SUCCESS;
+    size_t k;
+    int kind;
+    int i;
+    int c;
+
+    OPEN_LOG("kernels-bench", LOG_USER);
+    while ((c = getopt(argc, argv, "ht:")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 't':
+            seconds = strtod(optarg, NULL);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc || seconds < 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't initialize configuration");
+        return EXIT_FAILURE;
+    }
+    make_goodoids();
+
+    for (i = optind; i < argc; i++)
+    {
+        if (!load_object(argv[i]))
+        {
+            fprintf(stderr, "%s: can't load corpus object\n", argv[i]);
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+    }
+
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        for (kind = 0; kind < NUM_KINDS; kind++)
+        {
+            if ((kernels[k].kinds & K(kind)) && corpora[kind].len > 0)
+                bench(&kernels[k], kind, (uint64_t)(seconds * 1e9));
+        }
+    }
+
+done:
+    free_corpora();
+    free(goodoids[0].oid);
+    free(goodoids[1].oid);
+    config_unload();
+    CLOSE_LOG();
+    return ret;
+}
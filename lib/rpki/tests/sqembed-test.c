@@ -0,0 +1,407 @@
+/*
+ * Exercise the scm layer on the "embedded" (SQLite) database backend:
+ * database and table creation, inserts and searches (including the
+ * MySQL quoting the scm layer writes), prepared statements, deletes,
+ * and the effective validity computation, whose UPDATEs differ by
+ * dialect.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config/config.h"
+#include "rpki/db_constants.h"
+#include "rpki/err.h"
+#include "rpki/querySupport.h"
+#include "rpki/scm.h"
+#include "rpki/scmf.h"
+#include "rpki/sqhl.h"
+#include "test/unittest.h"
+
+static char tmpdir[] = "/tmp/sqembed-test.XXXXXX";
+static char conffile[sizeof(tmpdir) + 16];
+static scm *scmp = NULL;
+static scmcon *conp = NULL;
+
+static const char quoted_dir[] = "/it's a \"dir\"\\";
+
+static bool
+setup(
+    void)
+{
+    FILE *fp;
+
+    TEST_BOOL(mkdtemp(tmpdir) != NULL, true);
+    snprintf(conffile, sizeof(conffile), "%s/rpstir.conf", tmpdir);
+    fp = fopen(conffile, "w");
+    TEST_BOOL(fp != NULL, true);
+    fprintf(fp,
+            "Database sqembed_test\n"
+            "DatabaseUser nobody\n"
+            "DatabasePassword none\n"
+            "DatabaseDSN none\n"
+            "DatabaseBackend embedded\n"
+            "DatabaseDir %s\n"
+            "TrustAnchorLocators\n",
+            tmpdir);
+    fclose(fp);
+    TEST(int, "%d", setenv("RPSTIR_CONFIG", conffile, 1), ==, 0);
+    TEST_BOOL(my_config_load(), true);
+    scmp = initscm();
+    TEST_BOOL(scmp != NULL, true);
+    return true;
+}
+
+static bool
+test_create(
+    void)
+{
+    char errmsg[1024];
+    char *dsn;
+    scmcon *testconp;
+
+    dsn = makedsnscm(scmp->dsnpref, "information_schema", scmp->dbuser,
+                     NULL);
+    TEST_BOOL(dsn != NULL, true);
+    testconp = connectscm(dsn, errmsg, sizeof(errmsg));
+    free(dsn);
+    TEST_BOOL(testconp != NULL, true);
+    TEST(int, "%d", scmdialect(testconp), ==, SCM_DIALECT_SQLITE);
+
+    // no database is selected yet
+    TEST(int, "%d", statementscm_no_data(testconp, "SELECT 1;"), ==,
+         ERR_SCM_SQL);
+    TEST_STR(geterrorscm(testconp), ==, "No database selected");
+
+    // the real database doesn't exist yet
+    TEST_BOOL(connectscm(scmp->dsn, errmsg, sizeof(errmsg)) == NULL, true);
+    TEST_STR(errmsg, ==, "Unknown database 'sqembed_test'");
+
+    TEST(int, "%d", createdbscm(testconp, scmp->db, scmp->dbuser), ==, 0);
+    TEST_BOOL(createdbscm(testconp, scmp->db, scmp->dbuser) < 0, true);
+    TEST(int, "%d", createalltablesscm(testconp, scmp), ==, 0);
+    disconnectscm(testconp);
+
+    conp = connectscm(scmp->dsn, errmsg, sizeof(errmsg));
+    TEST_BOOL(conp != NULL, true);
+    return true;
+}
+
+/*
+ * Value callback that counts rows and keeps the last one's first
+ * column as a string.
+ */
+struct lastrow {
+    int nrows;
+    char first[DNAMESIZE];
+};
+
+static err_code
+keeprow(
+    scmcon *conp,
+    scmsrcha *s,
+    ssize_t idx)
+{
+    struct lastrow *last = s->context;
+
+    (void)conp;
+    (void)idx;
+    last->nrows++;
+    if (s->vec[0].sqltype == SQL_C_ULONG)
+        snprintf(last->first, sizeof(last->first), "%u",
+                 *(unsigned int *)s->vec[0].valptr);
+    else
+        snprintf(last->first, sizeof(last->first), "%s",
+                 (char *)s->vec[0].valptr);
+    return 0;
+}
+
+/*
+ * Run a search with a WHERE string and return the number of rows
+ * found, leaving the last row in *last.
+ */
+static int
+search(
+    scmtab *tabp,
+    const char *col,
+    int sqltype,
+    const char *where,
+    struct lastrow *last)
+{
+    scmsrcha srch;
+    scmsrch vec[1];
+    char buf[DNAMESIZE];
+    err_code sta;
+
+    memset(last, 0, sizeof(*last));
+    vec[0] = (scmsrch){1, sqltype, (char *)col, buf, sizeof(buf), 0};
+    srch = (scmsrcha){vec, NULL, 1, 1, 0, NULL, (char *)where, last};
+    sta = searchscm(conp, tabp, &srch, NULL, keeprow,
+                    SCM_SRCH_DOVALUE_ALWAYS, NULL);
+    if (sta < 0 && sta != ERR_SCM_NODATA)
+        return sta;
+    return last->nrows;
+}
+
+static bool
+insert_cert(
+    const char *filename,
+    const char *subject,
+    const char *issuer,
+    const char *ski,
+    const char *aki,
+    unsigned int flags,
+    unsigned int local_id)
+{
+    char flagstr[16];
+    char lidstr[16];
+
+    snprintf(flagstr, sizeof(flagstr), "%u", flags);
+    snprintf(lidstr, sizeof(lidstr), "%u", local_id);
+    scmkv cols[] = {
+        {"filename", filename},
+        {"dir_id", "1"},
+        {"subject", subject},
+        {"issuer", issuer},
+        {"sn", "^x0a"},
+        {"flags", flagstr},
+        {"ski", ski},
+        {"aki", aki},
+        {"sig", filename},
+        {"valfrom", "2000-01-01 00:00:00"},
+        {"valto", "2999-01-01 00:00:00"},
+        {"local_id", lidstr},
+    };
+    scmkva row = {cols, ELTS(cols), ELTS(cols), 0};
+
+    TEST(int, "%d",
+         insertscm(conp, findtablescm(scmp, "CERTIFICATE"), &row), ==, 0);
+    return true;
+}
+
+static bool
+test_insert_search(
+    void)
+{
+    scmtab *dirtab = findtablescm(scmp, "DIRECTORY");
+    scmtab *certtab = findtablescm(scmp, "CERTIFICATE");
+    struct lastrow last;
+    char where[WHERESTR_SIZE];
+    scmkv dircols[] = {
+        {"dirname", quoted_dir},
+        {"dir_id", "1"},
+    };
+    scmkva dirrow = {dircols, ELTS(dircols), ELTS(dircols), 0};
+    scmkva dirwhere = {dircols, ELTS(dircols), 1, 0};
+    unsigned int maxid = 0;
+
+    TEST_BOOL(dirtab != NULL && certtab != NULL, true);
+    TEST(int, "%d", insertscm(conp, dirtab, &dirrow), ==, 0);
+    TEST(int, "%d", getrowsscm(conp), ==, 1);
+    // the primary key is enforced
+    TEST(int, "%d", insertscm(conp, dirtab, &dirrow), ==, ERR_SCM_SQL);
+
+    // quotes and backslashes escaped for MySQL come back unchanged
+    char dirname[DNAMESIZE];
+    scmsrch vec[1] = {{1, SQL_C_CHAR, "dirname", dirname, DNAMESIZE, 0}};
+    scmsrcha srch = {vec, NULL, 1, 1, 0, &dirwhere, NULL, &last};
+    memset(&last, 0, sizeof(last));
+    TEST(int, "%d", searchscm(conp, dirtab, &srch, NULL, keeprow,
+                              SCM_SRCH_DOVALUE_ALWAYS, NULL), ==, 0);
+    TEST(int, "%d", last.nrows, ==, 1);
+    TEST_STR(last.first, ==, quoted_dir);
+
+    TEST_BOOL(insert_cert("ta.cer", "CN=TA", "CN=TA", "01:02", "01:02",
+                          SCM_FLAG_CA | SCM_FLAG_TRUSTED | SCM_FLAG_VALID,
+                          1), true);
+    TEST_BOOL(insert_cert("ca.cer", "CN=CA", "CN=TA", "0a:0b", "01:02",
+                          SCM_FLAG_CA | SCM_FLAG_VALID | SCM_FLAG_ONMAN,
+                          2), true);
+    TEST_BOOL(insert_cert("orphan.cer", "CN=O", "CN=X", "0c:0d", "ff:ff",
+                          SCM_FLAG_VALID | SCM_FLAG_ONMAN, 3), true);
+
+    TEST(int, "%d", getmaxidscm(scmp, conp, "local_id", certtab, &maxid),
+         ==, 0);
+    TEST(unsigned int, "%u", maxid, ==, 3);
+
+    // generated columns, hex literals and keyid/digest lookups
+    TEST(int, "%d", search(certtab, "filename", SQL_C_CHAR,
+                           "is_ca AND NOT is_trusted AND is_onman", &last),
+         ==, 1);
+    TEST_STR(last.first, ==, "ca.cer");
+    TEST(int, "%d", search(certtab, "local_id", SQL_C_ULONG,
+                           "sn=0x0a AND is_valid=TRUE", &last), ==, 3);
+    where[0] = 0;
+    where_append_keyid(where, "ski", "0a:0b");
+    where_append(where, " AND ");
+    where_append_hashed(where, "subject", "CN=CA");
+    TEST(int, "%d", search(certtab, "local_id", SQL_C_ULONG, where, &last),
+         ==, 1);
+    TEST_STR(last.first, ==, "2");
+    TEST(int, "%d", search(certtab, "local_id", SQL_C_ULONG,
+                           "crldp IS NULL", &last), ==, 3);
+    TEST_STR(last.first, ==, "3");
+    TEST(int, "%d", search(certtab, "filename", SQL_C_CHAR,
+                           "\"x ca.cer y\" regexp binary filename", &last),
+         ==, 1);
+    TEST(int, "%d", search(certtab, "filename", SQL_C_CHAR,
+                           "\"x CA.CER y\" regexp binary filename", &last),
+         ==, 0);
+
+    // both kinds of prepared statement
+    scmparam dirparam = {SQL_C_CHAR, quoted_dir, SQL_NTS};
+    unsigned int dir_id = 0;
+    scmsrch idvec[1] = {{1, SQL_C_ULONG, "dir_id", &dir_id,
+                         sizeof(dir_id), 0}};
+    scmsrcha idsrch = {idvec, NULL, 1, 1, 0, NULL, NULL, &last};
+    memset(&last, 0, sizeof(last));
+    TEST(int, "%d", searchscm_prepared(conp, SCM_PSTMT_DIR_ID, &dirparam, 1,
+                                       &idsrch, NULL, keeprow,
+                                       SCM_SRCH_DOVALUE_ALWAYS), ==, 0);
+    TEST_STR(last.first, ==, "1");
+    unsigned int newflags = SCM_FLAG_CA | SCM_FLAG_VALID;
+    unsigned int lid = 2;
+    scmparam flagparams[] = {
+        {SQL_C_ULONG, &newflags, 0},
+        {SQL_C_ULONG, &lid, 0},
+    };
+    TEST(int, "%d", statementscm_prepared(conp, SCM_PSTMT_SET_FLAGS_CERT,
+                                          flagparams, ELTS(flagparams)),
+         ==, 0);
+    TEST(int, "%d", getrowsscm(conp), ==, 1);
+    TEST(int, "%d", search(certtab, "filename", SQL_C_CHAR,
+                           "is_onman=FALSE", &last), ==, 2);
+    newflags |= SCM_FLAG_ONMAN;
+    TEST(int, "%d", statementscm_prepared(conp, SCM_PSTMT_SET_FLAGS_CERT,
+                                          flagparams, ELTS(flagparams)),
+         ==, 0);
+    return true;
+}
+
+static bool
+test_effective_validity(
+    void)
+{
+    scmtab *certtab = findtablescm(scmp, "CERTIFICATE");
+    scmtab *roatab = findtablescm(scmp, "ROA");
+    struct lastrow last;
+    char chainok[WHERESTR_SIZE];
+    scmkv cols[] = {
+        {"filename", "a.roa"},
+        {"dir_id", "1"},
+        {"ski", "0a:0b"},
+        {"sig", "a.roa"},
+        {"asn", "64496"},
+        {"flags", "260"},
+        {"local_id", "7"},
+    };
+    scmkva row = {cols, ELTS(cols), ELTS(cols), 0};
+
+    TEST(int, "%d", insertscm(conp, roatab, &row), ==, 0);
+    TEST(int, "%d",
+         statementscm_no_data(conp,
+                              "INSERT INTO rpki_roa_prefix (roa_local_id,"
+                              " prefix, prefix_length, prefix_max_length)"
+                              " VALUES (7, 0xc0000200, 24, 24),"
+                              " (7, 0xc0000300, 24, 24);"), ==, 0);
+    TEST(int, "%d", getrowsscm(conp), ==, 2);
+
+    TEST(int, "%d", update_effective_validity(scmp, conp), ==, 0);
+    TEST(int, "%d", search(certtab, "ta_id", SQL_C_ULONG,
+                           "eff_valid AND local_id=2", &last), ==, 1);
+    TEST_STR(last.first, ==, "1");
+    TEST(int, "%d", search(certtab, "local_id", SQL_C_ULONG,
+                           "NOT eff_valid AND ta_id IS NULL", &last), ==, 1);
+    TEST_STR(last.first, ==, "3");
+    TEST(int, "%d", search(roatab, "ta_id", SQL_C_ULONG, "eff_valid", &last),
+         ==, 1);
+    TEST_STR(last.first, ==, "1");
+    TEST(int, "%d", search(roatab, "eff_valto", SQL_C_CHAR, "eff_valid",
+                           &last), ==, 1);
+    TEST_STR(last.first, ==, "2999-01-01 00:00:00");
+    TEST(int, "%d", effective_validity_predicate(chainok, sizeof(chainok)),
+         ==, 0);
+    TEST(int, "%d", search(roatab, "local_id", SQL_C_ULONG, chainok, &last),
+         ==, 1);
+    // walking the chain at query time agrees
+    TEST(int, "%d", checkValidity("0a:0b", 0, scmp, conp), ==, 1);
+    TEST(int, "%d", checkValidity(NULL, 3, scmp, conp), ==, 0);
+
+    // an expired certificate anywhere in the chain is caught when the
+    // object is queried, not when the loader last ran
+    TEST(int, "%d", statementscm_no_data(conp, "UPDATE rpki_cert"
+                                         " SET valto=\"2001-01-01 00:00:00\""
+                                         " WHERE local_id=1;"), ==, 0);
+    TEST(int, "%d", update_effective_validity(scmp, conp), ==, 0);
+    TEST(int, "%d", search(roatab, "eff_valto", SQL_C_CHAR, "eff_valid",
+                           &last), ==, 1);
+    TEST_STR(last.first, ==, "2001-01-01 00:00:00");
+    TEST(int, "%d", search(roatab, "local_id", SQL_C_ULONG, chainok, &last),
+         ==, 0);
+    TEST(int, "%d", checkValidity("0a:0b", 0, scmp, conp), ==, 0);
+
+    // the parent losing validity propagates down the chain
+    TEST(int, "%d", statementscm_no_data(conp, "UPDATE rpki_cert"
+                                         " SET flags=flags-4"
+                                         " WHERE local_id=1;"), ==, 0);
+    TEST(int, "%d", update_effective_validity(scmp, conp), ==, 0);
+    TEST(int, "%d", search(roatab, "ta_id", SQL_C_ULONG, "NOT eff_valid",
+                           &last), ==, 1);
+
+    // deleting a ROA deletes its prefixes
+    scmkva where = {cols, ELTS(cols), 1, 0};
+    TEST(int, "%d", deletescm(conp, roatab, &where), ==, 0);
+    TEST(int, "%d", search(findtablescm(scmp, "ROA_PREFIX"), "roa_local_id",
+                           SQL_C_ULONG, "1=1", &last), ==, 0);
+    return true;
+}
+
+static bool
+test_delete(
+    void)
+{
+    char errmsg[1024];
+    char path[sizeof(tmpdir) + 64];
+    char *dsn;
+    scmcon *testconp;
+
+    disconnectscm(conp);
+    conp = NULL;
+    dsn = makedsnscm(scmp->dsnpref, "information_schema", scmp->dbuser,
+                     NULL);
+    TEST_BOOL(dsn != NULL, true);
+    testconp = connectscm(dsn, errmsg, sizeof(errmsg));
+    free(dsn);
+    TEST_BOOL(testconp != NULL, true);
+    TEST(int, "%d", deletedbscm(testconp, scmp->db), ==, 0);
+    // like DROP DATABASE IF EXISTS
+    TEST(int, "%d", deletedbscm(testconp, scmp->db), ==, 0);
+    TEST(int, "%d", deletedbscm(testconp, "../x"), ==, ERR_SCM_INVALARG);
+    disconnectscm(testconp);
+    snprintf(path, sizeof(path), "%s/%s.db", tmpdir, scmp->db);
+    TEST(int, "%d", access(path, F_OK), !=, 0);
+    return true;
+}
+
+int
+main(
+    void)
+{
+    int ret = -1;
+
+    if (!setup())
+        return -1;
+    if (test_create() && test_insert_search() && test_effective_validity()
+        && test_delete())
+        ret = 0;
+    if (conp != NULL)
+        disconnectscm(conp);
+    freescm(scmp);
+    config_unload();
+    unlink(conffile);
+    rmdir(tmpdir);
+    return ret;
+}
@@ -0,0 +1,1283 @@
+#include "async_log.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "logging.h"
+
+
+/** Largest message that's written, after formatting. */
+#define MAX_MESSAGE 4096
+
+/** Most arguments (including '*' widths and precisions) in a format
+    whose formatting can be deferred. */
+#define MAX_ARGS 16
+
+/** Longest single conversion specification, e.g. "%-+08.3lld". */
+#define MAX_SPEC 32
+
+/** Each ring buffer's size is a power of two in this range, and at
+    most a sixteenth of the memory budget if possible. */
+#define MIN_RING_SIZE ((size_t)16 * 1024)
+#define MAX_RING_SIZE ((size_t)1024 * 1024)
+#define RINGS_PER_BUDGET 16
+
+/** How much console output the background thread collects before
+    writing it. */
+#define CONSOLE_BATCH_SIZE 65536
+
+
+/**
+    An argument copied from the caller's va_list.  Strings are copied
+    into the record after the arguments.
+*/
+union arg {
+    intmax_t i;
+    uintmax_t u;
+    double d;
+    long double ld;
+    const void *p;
+    struct {
+        size_t offset;          // from the start of the record
+        bool is_null;
+    } s;
+};
+
+struct arg_align {
+    char c;
+    union arg arg;
+};
+
+/** Alignment of records in a ring buffer. */
+#define RECORD_ALIGN (offsetof(struct arg_align, arg))
+
+#define ALIGN_UP(n) (((n) + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN)
+
+enum record_type {
+    /** Skip to the start of the ring buffer. */
+    RECORD_PADDING,
+
+    /** The message follows the header as a string. */
+    RECORD_FORMATTED,
+
+    /** The arguments for format follow the header. */
+    RECORD_DEFERRED,
+};
+
+struct record {
+    /** Bytes taken up in the ring buffer, a multiple of RECORD_ALIGN. */
+    size_t size;
+
+    /** Order in which messages were logged, across all threads. */
+    unsigned long seq;
+
+    const char *ident;
+    const char *format;
+    int priority;
+    enum record_type type;
+    size_t nargs;
+};
+
+#define RECORD_HEADER_SIZE ALIGN_UP(sizeof(struct record))
+
+/**
+    One thread's ring buffer.  The thread that owns it is the only
+    writer of head, and the background thread is the only writer of
+    tail, so neither needs a lock.
+*/
+struct ring {
+    struct ring *next;
+    unsigned char *buf;
+    size_t size;                // power of two
+
+    size_t head;
+    char pad[64];               // keep head and tail in separate cache lines
+    size_t tail;
+
+    /** Set when the owning thread exits, so that the background thread
+        frees the ring buffer once it's empty. */
+    int orphaned;
+};
+
+/**
+    Thread-specific data, kept in state.key.
+*/
+struct thread_log {
+    /** NULL if the memory budget didn't allow a ring buffer. */
+    struct ring *ring;
+
+    /** Value of state.generation when ring was allocated.  Ring buffers
+        from older generations have been freed. */
+    unsigned long generation;
+};
+
+enum arg_class {
+    ARG_NONE,                   // "%%"
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_LONG_DOUBLE,
+    ARG_POINTER,
+    ARG_STRING,
+    ARG_UNSUPPORTED,
+};
+
+enum arg_length {
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_J,
+    LEN_Z,
+    LEN_T,
+    LEN_BIG_L,
+};
+
+/** A parsed conversion specification. */
+struct spec {
+    size_t len;                 // characters, including the '%'
+    size_t stars;               // '*' widths and precisions
+    bool star_precision;
+    int precision;              // -1 if none or '*'
+    enum arg_length length;
+    enum arg_class class;
+};
+
+
+static struct {
+    pthread_key_t key;
+    bool key_created;
+    bool handlers_registered;
+
+    /** Whether the background thread is running.  When it isn't,
+        messages are written synchronously. */
+    int running;
+
+    /** Where messages go: a syslog() facility, or LOG_CONSOLE. */
+    int facility;
+
+    size_t ring_size;
+    size_t max_record;
+
+    /** Protects rings, budget_left, and generation. */
+    pthread_mutex_t rings_mutex;
+    struct ring *rings;
+    size_t budget;
+    size_t budget_left;
+    unsigned long generation;
+
+    /** Held by the background thread while it writes, so that fork()
+        doesn't happen in the middle of a syslog() call. */
+    pthread_mutex_t output_mutex;
+
+    pthread_t thread;
+
+    /** Protects stopping and the flush counters, and goes with
+        wake_cond and flushed_cond. */
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    pthread_cond_t flushed_cond;
+    int wake_pending;
+    bool stopping;
+    unsigned long flush_requested;
+    unsigned long flush_done;
+
+    unsigned long next_seq;
+    unsigned long dropped;
+    unsigned long dropped_reported;
+} state = {
+    .rings_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .output_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake_cond = PTHREAD_COND_INITIALIZER,
+    .flushed_cond = PTHREAD_COND_INITIALIZER,
+};
+
+
+/**
+    Parse the conversion specification starting with the '%' at fmt.
+*/
+static void parse_spec(
+    const char *fmt,
+    struct spec *spec)
+{
+    const char *p = fmt + 1;
+
+    spec->stars = 0;
+    spec->star_precision = false;
+    spec->precision = -1;
+    spec->length = LEN_NONE;
+    spec->class = ARG_UNSUPPORTED;
+
+    if (*p == '%')
+    {
+        spec->len = 2;
+        spec->class = ARG_NONE;
+        return;
+    }
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL)
+        ++p;
+
+    if (*p == '*')
+    {
+        ++spec->stars;
+        ++p;
+    }
+    else
+    {
+        while (*p >= '0' && *p <= '9')
+            ++p;
+    }
+    if (*p == '$')
+        goto unsupported;       // positional arguments
+
+    if (*p == '.')
+    {
+        ++p;
+        if (*p == '*')
+        {
+            ++spec->stars;
+            spec->star_precision = true;
+            ++p;
+        }
+        else
+        {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9')
+            {
+                if (spec->precision < MAX_MESSAGE)
+                    spec->precision = spec->precision * 10 + (*p - '0');
+                ++p;
+            }
+        }
+    }
+
+    switch (*p)
+    {
+    case 'h':
+        ++p;
+        spec->length = LEN_H;
+        if (*p == 'h')
+        {
+            ++p;
+            spec->length = LEN_HH;
+        }
+        break;
+    case 'l':
+        ++p;
+        spec->length = LEN_L;
+        if (*p == 'l')
+        {
+            ++p;
+            spec->length = LEN_LL;
+        }
+        break;
+    case 'j':
+        ++p;
+        spec->length = LEN_J;
+        break;
+    case 'z':
+        ++p;
+        spec->length = LEN_Z;
+        break;
+    case 't':
+        ++p;
+        spec->length = LEN_T;
+        break;
+    case 'L':
+        ++p;
+        spec->length = LEN_BIG_L;
+        break;
+    }
+
+    switch (*p)
+    {
+    case 'd':
+    case 'i':
+        spec->class = ARG_INT;
+        break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        spec->class = ARG_UINT;
+        break;
+    case 'c':
+        if (spec->length != LEN_NONE)
+            goto unsupported;   // wide character
+        spec->class = ARG_INT;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->class =
+            spec->length == LEN_BIG_L ? ARG_LONG_DOUBLE : ARG_DOUBLE;
+        break;
+    case 'p':
+        spec->class = ARG_POINTER;
+        break;
+    case 's':
+        if (spec->length != LEN_NONE)
+            goto unsupported;   // wide string
+        spec->class = ARG_STRING;
+        break;
+    default:
+        goto unsupported;       // %m, %n, or something unknown
+    }
+    spec->len = p + 1 - fmt;
+    if (spec->len >= MAX_SPEC)
+        goto unsupported;
+    return;
+
+  unsupported:
+    spec->class = ARG_UNSUPPORTED;
+    spec->len = (*p == '\0' ? p : p + 1) - fmt;
+}
+
+/**
+    @return The number of arguments format takes, or -1 if formatting
+        it can't be deferred.
+*/
+static int count_args(
+    const char *format)
+{
+    struct spec spec;
+    const char *p;
+    int nargs = 0;
+
+    for (p = strchr(format, '%'); p != NULL; p = strchr(p, '%'))
+    {
+        parse_spec(p, &spec);
+        if (spec.class == ARG_UNSUPPORTED)
+            return -1;
+        if (spec.class != ARG_NONE)
+            nargs += spec.stars + 1;
+        if (nargs > MAX_ARGS)
+            return -1;
+        p += spec.len;
+    }
+    return nargs;
+}
+
+/**
+    Copy the arguments for format from ap into args[], and the strings
+    they point to into strs[] and str_lens[].
+
+    @return Number of bytes needed for the strings.
+*/
+static size_t capture_args(
+    const char *format,
+    va_list ap,
+    union arg *args,
+    const char **strs,
+    size_t *str_lens)
+{
+    struct spec spec;
+    const char *p;
+    size_t n = 0;
+    size_t str_bytes = 0;
+    int precision;
+
+    for (p = strchr(format, '%'); p != NULL; p = strchr(p, '%'))
+    {
+        parse_spec(p, &spec);
+        p += spec.len;
+        if (spec.class == ARG_NONE)
+            continue;
+
+        precision = spec.precision;
+        if (spec.stars == 2 || (spec.stars == 1 && !spec.star_precision))
+        {
+            strs[n] = NULL;
+            args[n++].i = va_arg(ap, int);
+        }
+        if (spec.star_precision)
+        {
+            precision = va_arg(ap, int);
+            strs[n] = NULL;
+            args[n++].i = precision;
+        }
+
+        strs[n] = NULL;
+        switch (spec.class)
+        {
+        case ARG_INT:
+            switch (spec.length)
+            {
+            case LEN_L:
+                args[n].i = va_arg(ap, long);
+                break;
+            case LEN_LL:
+                args[n].i = va_arg(ap, long long);
+                break;
+            case LEN_J:
+                args[n].i = va_arg(ap, intmax_t);
+                break;
+            case LEN_Z:
+                args[n].i = va_arg(ap, ssize_t);
+                break;
+            case LEN_T:
+                args[n].i = va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                args[n].i = va_arg(ap, int);
+            }
+            break;
+        case ARG_UINT:
+            switch (spec.length)
+            {
+            case LEN_L:
+                args[n].u = va_arg(ap, unsigned long);
+                break;
+            case LEN_LL:
+                args[n].u = va_arg(ap, unsigned long long);
+                break;
+            case LEN_J:
+                args[n].u = va_arg(ap, uintmax_t);
+                break;
+            case LEN_Z:
+                args[n].u = va_arg(ap, size_t);
+                break;
+            case LEN_T:
+                args[n].u = va_arg(ap, ptrdiff_t);
+                break;
+            default:
+                args[n].u = va_arg(ap, unsigned int);
+            }
+            break;
+        case ARG_DOUBLE:
+            args[n].d = va_arg(ap, double);
+            break;
+        case ARG_LONG_DOUBLE:
+            args[n].ld = va_arg(ap, long double);
+            break;
+        case ARG_POINTER:
+            args[n].p = va_arg(ap, void *);
+            break;
+        case ARG_STRING:
+            strs[n] = va_arg(ap, const char *);
+            args[n].s.is_null = (strs[n] == NULL);
+            if (strs[n] == NULL)
+                str_lens[n] = 0;
+            else if (precision >= 0)
+                str_lens[n] = strnlen(strs[n], precision);
+            else
+                str_lens[n] = strlen(strs[n]);
+            str_bytes += str_lens[n] + 1;
+            break;
+        default:
+            break;
+        }
+        ++n;
+    }
+    return str_bytes;
+}
+
+/**
+    Format a deferred record into out, the same way vsnprintf() would
+    have formatted the original arguments.
+*/
+static void format_deferred(
+    const struct record *rec,
+    char *out,
+    size_t out_size)
+{
+    const union arg *args =
+        (const union arg *)((const char *)rec + RECORD_HEADER_SIZE);
+    const char *p = rec->format;
+    const char *pct;
+    char spec_str[MAX_SPEC];
+    struct spec spec;
+    size_t pos = 0;
+    size_t n = 0;
+    int stars[2];
+    size_t nstars;
+    int len;
+
+#define COPY_OUT(str, count)                                            \
+    do {                                                                \
+        size_t copy_out_count = (count);                                \
+        if (copy_out_count > out_size - 1 - pos)                        \
+            copy_out_count = out_size - 1 - pos;                        \
+        memcpy(out + pos, (str), copy_out_count);                       \
+        pos += copy_out_count;                                          \
+    } while (false)
+
+#define FORMAT_ARG(value)                                               \
+    do {                                                                \
+        if (nstars == 0)                                                \
+            len = snprintf(out + pos, out_size - pos, spec_str,         \
+                           (value));                                    \
+        else if (nstars == 1)                                           \
+            len = snprintf(out + pos, out_size - pos, spec_str,         \
+                           stars[0], (value));                          \
+        else                                                            \
+            len = snprintf(out + pos, out_size - pos, spec_str,         \
+                           stars[0], stars[1], (value));                \
+    } while (false)
+
+    while ((pct = strchr(p, '%')) != NULL && pos < out_size - 1)
+    {
+        COPY_OUT(p, pct - p);
+        parse_spec(pct, &spec);
+        p = pct + spec.len;
+        if (spec.class == ARG_NONE)
+        {
+            COPY_OUT("%", 1);
+            continue;
+        }
+
+        memcpy(spec_str, pct, spec.len);
+        spec_str[spec.len] = '\0';
+        for (nstars = 0; nstars < spec.stars; ++nstars)
+            stars[nstars] = (int)args[n++].i;
+
+        len = 0;
+        switch (spec.class)
+        {
+        case ARG_INT:
+            switch (spec.length)
+            {
+            case LEN_L:
+                FORMAT_ARG((long)args[n].i);
+                break;
+            case LEN_LL:
+                FORMAT_ARG((long long)args[n].i);
+                break;
+            case LEN_J:
+                FORMAT_ARG(args[n].i);
+                break;
+            case LEN_Z:
+                FORMAT_ARG((ssize_t)args[n].i);
+                break;
+            case LEN_T:
+                FORMAT_ARG((ptrdiff_t)args[n].i);
+                break;
+            default:
+                FORMAT_ARG((int)args[n].i);
+            }
+            break;
+        case ARG_UINT:
+            switch (spec.length)
+            {
+            case LEN_L:
+                FORMAT_ARG((unsigned long)args[n].u);
+                break;
+            case LEN_LL:
+                FORMAT_ARG((unsigned long long)args[n].u);
+                break;
+            case LEN_J:
+                FORMAT_ARG(args[n].u);
+                break;
+            case LEN_Z:
+                FORMAT_ARG((size_t)args[n].u);
+                break;
+            case LEN_T:
+                FORMAT_ARG((ptrdiff_t)args[n].u);
+                break;
+            default:
+                FORMAT_ARG((unsigned int)args[n].u);
+            }
+            break;
+        case ARG_DOUBLE:
+            FORMAT_ARG(args[n].d);
+            break;
+        case ARG_LONG_DOUBLE:
+            FORMAT_ARG(args[n].ld);
+            break;
+        case ARG_POINTER:
+            FORMAT_ARG(args[n].p);
+            break;
+        case ARG_STRING:
+            // passing NULL for %s is undefined, even if the caller did
+            FORMAT_ARG(args[n].s.is_null ? "(null)" :
+                       (const char *)rec + args[n].s.offset);
+            break;
+        default:
+            break;
+        }
+        ++n;
+        if (len > 0)
+            pos += ((size_t)len < out_size - pos ? (size_t)len :
+                    out_size - 1 - pos);
+    }
+    if (pct == NULL)
+        COPY_OUT(p, strlen(p));
+    out[pos] = '\0';
+
+#undef FORMAT_ARG
+#undef COPY_OUT
+}
+
+
+/**
+    Write one message.  The caller must hold output_mutex if the
+    background thread is running.
+*/
+static void write_message(
+    int priority,
+    const char *ident,
+    const char *msg,
+    char *batch,
+    size_t *batch_len)
+{
+    char line[MAX_MESSAGE + 128];
+    int len;
+
+    if (state.facility != LOG_CONSOLE)
+    {
+        syslog(priority, "%s: %s", LOG_LEVEL_TEXT[priority], msg);
+        return;
+    }
+
+    if (ident == NULL)
+        ident = "";
+    len = snprintf(line, sizeof(line), "%s%s%s: %s\n", ident,
+                   ident[0] == '\0' ? "" : ": ", LOG_LEVEL_TEXT[priority],
+                   msg);
+    if (len < 0)
+        return;
+    if ((size_t)len >= sizeof(line))
+    {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+
+    if (batch == NULL)
+    {
+        fwrite(line, 1, len, stderr);
+        return;
+    }
+    if (*batch_len + len > CONSOLE_BATCH_SIZE)
+    {
+        fwrite(batch, 1, *batch_len, stderr);
+        *batch_len = 0;
+    }
+    memcpy(batch + *batch_len, line, len);
+    *batch_len += len;
+}
+
+static void write_sync(
+    int priority,
+    const char *ident,
+    const char *format,
+    va_list ap)
+{
+    char msg[MAX_MESSAGE];
+
+    vsnprintf(msg, sizeof(msg), format, ap);
+    write_message(priority, ident, msg, NULL, NULL);
+}
+
+
+static void wake_thread(
+    void)
+{
+    if (__atomic_exchange_n(&state.wake_pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        pthread_mutex_lock(&state.wake_mutex);
+        pthread_cond_signal(&state.wake_cond);
+        pthread_mutex_unlock(&state.wake_mutex);
+    }
+}
+
+static void thread_log_destructor(
+    void *value)
+{
+    struct thread_log *tl = (struct thread_log *)value;
+
+    pthread_mutex_lock(&state.rings_mutex);
+    if (tl->ring != NULL && tl->generation == state.generation)
+    {
+        __atomic_store_n(&tl->ring->orphaned, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&state.rings_mutex);
+    free(tl);
+    wake_thread();
+}
+
+/**
+    @return The calling thread's ring buffer, or NULL if it can't have
+        one.
+*/
+static struct ring *thread_ring(
+    void)
+{
+    struct thread_log *tl = pthread_getspecific(state.key);
+    struct ring *ring;
+
+    if (tl != NULL && tl->generation == state.generation)
+        return tl->ring;
+
+    if (tl == NULL)
+    {
+        tl = malloc(sizeof(*tl));
+        if (tl == NULL)
+            return NULL;
+        if (pthread_setspecific(state.key, tl) != 0)
+        {
+            free(tl);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&state.rings_mutex);
+    tl->generation = state.generation;
+    tl->ring = NULL;
+    if (state.budget_left >= state.ring_size)
+    {
+        ring = calloc(1, sizeof(*ring));
+        if (ring != NULL)
+        {
+            ring->buf = malloc(state.ring_size);
+            if (ring->buf == NULL)
+            {
+                free(ring);
+                ring = NULL;
+            }
+        }
+        if (ring != NULL)
+        {
+            ring->size = state.ring_size;
+            ring->next = state.rings;
+            state.rings = ring;
+            state.budget_left -= state.ring_size;
+            tl->ring = ring;
+        }
+    }
+    pthread_mutex_unlock(&state.rings_mutex);
+
+    return tl->ring;
+}
+
+/**
+    Reserve size bytes in ring for a record.
+
+    @return Where to write the record, or NULL if the ring is full.
+        On success, *new_head is what to set ring->head to once the
+        record is written.
+*/
+static struct record *ring_reserve(
+    struct ring *ring,
+    size_t size,
+    size_t *new_head)
+{
+    size_t head = ring->head;
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size_t offset = head & (ring->size - 1);
+    size_t contiguous = ring->size - offset;
+    size_t padding = 0;
+    struct record *rec;
+
+    if (contiguous < size)
+        padding = contiguous;
+    if (head + padding + size - tail > ring->size)
+        return NULL;
+
+    if (padding >= RECORD_HEADER_SIZE)
+    {
+        rec = (struct record *)(ring->buf + offset);
+        rec->size = padding;
+        rec->type = RECORD_PADDING;
+    }
+
+    *new_head = head + padding + size;
+    return (struct record *)(ring->buf + ((head + padding) & (ring->size - 1)));
+}
+
+/**
+    The LOG_CUSTOM_BACKEND logging function.
+*/
+static void async_log_log(
+    int priority,
+    const char *restrict ident,
+    const char *restrict format,
+    ...)
+{
+    union arg args[MAX_ARGS];
+    const char *strs[MAX_ARGS];
+    size_t str_lens[MAX_ARGS];
+    struct ring *ring;
+    struct record *rec;
+    size_t new_head;
+    size_t size;
+    size_t offset;
+    size_t i;
+    int nargs;
+    int len;
+    va_list ap;
+
+    va_start(ap, format);
+
+    if (!__atomic_load_n(&state.running, __ATOMIC_ACQUIRE) ||
+        (ring = thread_ring()) == NULL)
+    {
+        write_sync(priority, ident, format, ap);
+        va_end(ap);
+        return;
+    }
+
+    nargs = count_args(format);
+    if (nargs >= 0)
+    {
+        va_list ap_copy;
+        va_copy(ap_copy, ap);
+        size = RECORD_HEADER_SIZE + nargs * sizeof(union arg) +
+            capture_args(format, ap_copy, args, strs, str_lens);
+        va_end(ap_copy);
+        size = ALIGN_UP(size);
+    }
+    if (nargs >= 0 && size <= state.max_record)
+    {
+        rec = ring_reserve(ring, size, &new_head);
+        if (rec == NULL)
+            goto drop;
+        rec->type = RECORD_DEFERRED;
+        rec->nargs = nargs;
+        offset = RECORD_HEADER_SIZE + nargs * sizeof(union arg);
+        for (i = 0; i < (size_t)nargs; ++i)
+        {
+            if (strs[i] != NULL)
+            {
+                args[i].s.offset = offset;
+                memcpy((char *)rec + offset, strs[i], str_lens[i]);
+                ((char *)rec)[offset + str_lens[i]] = '\0';
+                offset += str_lens[i] + 1;
+            }
+        }
+        memcpy((char *)rec + RECORD_HEADER_SIZE, args,
+               nargs * sizeof(union arg));
+    }
+    else
+    {
+        char msg[MAX_MESSAGE];
+
+        len = vsnprintf(msg, sizeof(msg), format, ap);
+        if (len < 0)
+            len = 0;
+        else if ((size_t)len >= sizeof(msg))
+            len = sizeof(msg) - 1;      // vsnprintf() truncated it
+        size = RECORD_HEADER_SIZE + (size_t)len + 1;
+        if (size > state.max_record)
+        {
+            size = state.max_record;
+            len = size - RECORD_HEADER_SIZE - 1;
+        }
+        size = ALIGN_UP(size);
+        rec = ring_reserve(ring, size, &new_head);
+        if (rec == NULL)
+            goto drop;
+        rec->type = RECORD_FORMATTED;
+        rec->nargs = 0;
+        memcpy((char *)rec + RECORD_HEADER_SIZE, msg, len);
+        ((char *)rec)[RECORD_HEADER_SIZE + len] = '\0';
+    }
+    va_end(ap);
+
+    rec->size = size;
+    rec->seq = __atomic_fetch_add(&state.next_seq, 1, __ATOMIC_RELAXED);
+    rec->ident = ident;
+    rec->format = format;
+    rec->priority = priority;
+    __atomic_store_n(&ring->head, new_head, __ATOMIC_RELEASE);
+    wake_thread();
+    return;
+
+  drop:
+    va_end(ap);
+    __atomic_fetch_add(&state.dropped, 1, __ATOMIC_RELAXED);
+    wake_thread();
+}
+
+
+/**
+    @return The next record in ring before limit, or NULL if there
+        isn't one.
+*/
+static struct record *ring_peek(
+    struct ring *ring,
+    size_t limit)
+{
+    size_t offset;
+    size_t contiguous;
+    struct record *rec;
+
+    while (ring->tail != limit)
+    {
+        offset = ring->tail & (ring->size - 1);
+        contiguous = ring->size - offset;
+        rec = (struct record *)(ring->buf + offset);
+        if (contiguous < RECORD_HEADER_SIZE || rec->type == RECORD_PADDING)
+        {
+            __atomic_store_n(&ring->tail,
+                             ring->tail + (contiguous < RECORD_HEADER_SIZE ?
+                                           contiguous : rec->size),
+                             __ATOMIC_RELEASE);
+            continue;
+        }
+        return rec;
+    }
+    return NULL;
+}
+
+/** @return Whether sequence number a comes before b. */
+static bool seq_before(
+    unsigned long a,
+    unsigned long b)
+{
+    return a - b > ULONG_MAX / 2;
+}
+
+/**
+    Write everything that's in the ring buffers now, in the order it
+    was logged, and free the ring buffers of threads that have exited.
+*/
+static void drain(
+    void)
+{
+    static struct ring **rings = NULL;
+    static size_t *limits = NULL;
+    static size_t rings_allocated = 0;
+    static char batch[CONSOLE_BATCH_SIZE];
+    size_t batch_len = 0;
+    char msg[MAX_MESSAGE];
+    size_t num_rings = 0;
+    struct ring *ring;
+    struct ring **ringp;
+    struct record *rec;
+    struct record *best;
+    size_t best_index;
+    size_t i;
+    unsigned long dropped;
+
+    // Take a snapshot of the rings and how far each one has been
+    // written, so that a busy thread can't keep this going forever.
+    pthread_mutex_lock(&state.rings_mutex);
+    for (ring = state.rings; ring != NULL; ring = ring->next)
+    {
+        if (num_rings == rings_allocated)
+        {
+            size_t new_allocated = rings_allocated ? 2 * rings_allocated : 16;
+            struct ring **new_rings =
+                realloc(rings, new_allocated * sizeof(*rings));
+            size_t *new_limits =
+                new_rings ? realloc(limits, new_allocated * sizeof(*limits))
+                : NULL;
+            if (new_rings != NULL)
+                rings = new_rings;
+            if (new_limits == NULL)
+                break;          // drain the rest next time
+            limits = new_limits;
+            rings_allocated = new_allocated;
+        }
+        rings[num_rings] = ring;
+        limits[num_rings] = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        ++num_rings;
+    }
+    pthread_mutex_unlock(&state.rings_mutex);
+
+    pthread_mutex_lock(&state.output_mutex);
+    for (;;)
+    {
+        best = NULL;
+        best_index = 0;
+        for (i = 0; i < num_rings; ++i)
+        {
+            rec = ring_peek(rings[i], limits[i]);
+            if (rec != NULL && (best == NULL || seq_before(rec->seq,
+                                                           best->seq)))
+            {
+                best = rec;
+                best_index = i;
+            }
+        }
+        if (best == NULL)
+            break;
+
+        if (best->type == RECORD_DEFERRED)
+        {
+            format_deferred(best, msg, sizeof(msg));
+            write_message(best->priority, best->ident, msg, batch,
+                          &batch_len);
+        }
+        else
+        {
+            write_message(best->priority, best->ident,
+                          (const char *)best + RECORD_HEADER_SIZE, batch,
+                          &batch_len);
+        }
+        ring = rings[best_index];
+        __atomic_store_n(&ring->tail, ring->tail + best->size,
+                         __ATOMIC_RELEASE);
+    }
+
+    dropped = __atomic_load_n(&state.dropped, __ATOMIC_RELAXED);
+    if (dropped != state.dropped_reported)
+    {
+        snprintf(msg, sizeof(msg),
+                 "dropped %lu log messages because the log buffer was full",
+                 dropped - state.dropped_reported);
+        write_message(LOG_WARNING, log_ident, msg, batch, &batch_len);
+        state.dropped_reported = dropped;
+    }
+
+    if (batch_len > 0)
+    {
+        fwrite(batch, 1, batch_len, stderr);
+    }
+    if (state.facility == LOG_CONSOLE)
+    {
+        fflush(stderr);
+    }
+    pthread_mutex_unlock(&state.output_mutex);
+
+    pthread_mutex_lock(&state.rings_mutex);
+    ringp = &state.rings;
+    while (*ringp != NULL)
+    {
+        ring = *ringp;
+        if (__atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE) &&
+            ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+        {
+            *ringp = ring->next;
+            state.budget_left += ring->size;
+            free(ring->buf);
+            free(ring);
+        }
+        else
+        {
+            ringp = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&state.rings_mutex);
+}
+
+static void *drain_thread(
+    void *unused)
+{
+    bool stopping;
+    unsigned long flush;
+
+    (void)unused;
+
+    do {
+        pthread_mutex_lock(&state.wake_mutex);
+        while (!__atomic_load_n(&state.wake_pending, __ATOMIC_ACQUIRE) &&
+               !state.stopping && state.flush_done == state.flush_requested)
+        {
+            pthread_cond_wait(&state.wake_cond, &state.wake_mutex);
+        }
+        stopping = state.stopping;
+        flush = state.flush_requested;
+        pthread_mutex_unlock(&state.wake_mutex);
+
+        // Anything logged after this wakes the thread again.
+        __atomic_exchange_n(&state.wake_pending, 0, __ATOMIC_ACQ_REL);
+        drain();
+
+        pthread_mutex_lock(&state.wake_mutex);
+        state.flush_done = flush;
+        pthread_cond_broadcast(&state.flushed_cond);
+        pthread_mutex_unlock(&state.wake_mutex);
+    } while (!stopping);
+
+    return NULL;
+}
+
+
+/**
+    The LOG_CUSTOM_BACKEND flush function: wait until everything logged
+    so far has been written.
+*/
+static void async_log_flush(
+    void)
+{
+    unsigned long ticket;
+
+    if (!__atomic_load_n(&state.running, __ATOMIC_ACQUIRE))
+    {
+        if (state.facility == LOG_CONSOLE)
+            fflush(stderr);
+        return;
+    }
+
+    pthread_mutex_lock(&state.wake_mutex);
+    ticket = ++state.flush_requested;
+    pthread_cond_signal(&state.wake_cond);
+    while (seq_before(state.flush_done, ticket))
+        pthread_cond_wait(&state.flushed_cond, &state.wake_mutex);
+    pthread_mutex_unlock(&state.wake_mutex);
+}
+
+static void free_rings(
+    void)
+{
+    struct ring *ring;
+
+    while (state.rings != NULL)
+    {
+        ring = state.rings;
+        state.rings = ring->next;
+        free(ring->buf);
+        free(ring);
+    }
+    state.budget_left = state.budget;
+    ++state.generation;
+}
+
+/**
+    The LOG_CUSTOM_BACKEND close function: write everything, stop the
+    background thread, and go back to logging the way OPEN_LOG() set
+    up.
+*/
+static void async_log_close(
+    void)
+{
+    if (__atomic_load_n(&state.running, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&state.wake_mutex);
+        state.stopping = true;
+        pthread_cond_signal(&state.wake_cond);
+        pthread_mutex_unlock(&state.wake_mutex);
+        pthread_join(state.thread, NULL);
+
+        __atomic_store_n(&state.running, 0, __ATOMIC_RELEASE);
+        pthread_mutex_lock(&state.rings_mutex);
+        free_rings();
+        pthread_mutex_unlock(&state.rings_mutex);
+    }
+
+    log_facility = state.facility;
+    if (state.facility == LOG_CONSOLE)
+        fflush(stderr);
+    else
+        closelog();
+}
+
+static void atexit_flush(
+    void)
+{
+    async_log_flush();
+}
+
+static void before_fork(
+    void)
+{
+    pthread_mutex_lock(&state.output_mutex);
+    pthread_mutex_lock(&state.rings_mutex);
+}
+
+static void after_fork_parent(
+    void)
+{
+    pthread_mutex_unlock(&state.rings_mutex);
+    pthread_mutex_unlock(&state.output_mutex);
+}
+
+static void after_fork_child(
+    void)
+{
+    // The background thread wasn't copied, and what's buffered is the
+    // parent's to write.
+    pthread_mutex_init(&state.rings_mutex, NULL);
+    pthread_mutex_init(&state.output_mutex, NULL);
+    pthread_mutex_init(&state.wake_mutex, NULL);
+    pthread_cond_init(&state.wake_cond, NULL);
+    pthread_cond_init(&state.flushed_cond, NULL);
+    free_rings();
+    state.running = 0;
+    state.stopping = false;
+    state.wake_pending = 0;
+    state.flush_requested = state.flush_done = 0;
+    state.dropped = state.dropped_reported = 0;
+}
+
+
+bool async_log_start(
+    size_t memory_budget)
+{
+    sigset_t all_signals;
+    sigset_t old_signals;
+    size_t ring_size;
+    int facility;
+    int ret;
+
+    if (__atomic_load_n(&state.running, __ATOMIC_ACQUIRE))
+        return true;
+
+    if (log_facility != LOG_CUSTOM_BACKEND)
+        facility = log_facility;
+    else if (log_custom_backend.log == &async_log_log)
+        facility = state.facility;      // restarting, e.g. after fork()
+    else
+        return false;           // some other backend is in use
+
+    ring_size = MAX_RING_SIZE;
+    while (ring_size > MIN_RING_SIZE &&
+           ring_size > memory_budget / RINGS_PER_BUDGET)
+        ring_size /= 2;
+    if (ring_size > memory_budget)
+        return false;
+
+    if (!state.key_created)
+    {
+        if (pthread_key_create(&state.key, &thread_log_destructor) != 0)
+            return false;
+        state.key_created = true;
+    }
+    if (!state.handlers_registered)
+    {
+        if (pthread_atfork(&before_fork, &after_fork_parent,
+                           &after_fork_child) != 0 ||
+            atexit(&atexit_flush) != 0)
+            return false;
+        state.handlers_registered = true;
+    }
+
+    pthread_mutex_lock(&state.rings_mutex);
+    state.facility = facility;
+    state.ring_size = ring_size;
+    state.max_record = ring_size / 4;
+    state.budget = memory_budget;
+    free_rings();
+    pthread_mutex_unlock(&state.rings_mutex);
+    state.stopping = false;
+    state.wake_pending = 0;
+
+    // Leave signals to the program's own threads.
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+    ret = pthread_create(&state.thread, NULL, &drain_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    if (ret != 0)
+        return false;
+
+    log_custom_backend.log = &async_log_log;
+    log_custom_backend.flush = &async_log_flush;
+    log_custom_backend.close = &async_log_close;
+    log_facility = LOG_CUSTOM_BACKEND;
+    __atomic_store_n(&state.running, 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+unsigned long async_log_dropped(
+    void)
+{
+    return __atomic_load_n(&state.dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,69 @@
+#ifndef _UTILS_ASYNC_LOG_H
+#define _UTILS_ASYNC_LOG_H
+
+/**
+    Asynchronous logging backend.
+
+    After async_log_start(), LOG() no longer calls syslog() or writes
+    to stderr on the calling thread.  Each thread that logs gets its
+    own ring buffer, which only it writes to and only a background
+    thread reads from, so logging takes no locks and never waits for
+    syslog or a slow stderr.  The background thread writes the
+    messages, in the order they were logged, to wherever the facility
+    passed to OPEN_LOG() says: syslog() or, for LOG_CONSOLE, stderr.
+
+    Where possible, the message isn't formatted by the thread that
+    logs it.  Instead, the arguments are copied into the ring buffer,
+    along with the contents of any strings, and the background thread
+    formats them.  This relies on the format and ident passed to the
+    backend being string literals, which LOG() and OPEN_LOG() ensure.
+    Formats that can't be deferred (%m, %n, positional arguments, wide
+    characters) are formatted right away.
+
+    All ring buffers together use at most the memory budget passed to
+    async_log_start().  A message that doesn't fit in its thread's ring
+    buffer is dropped and counted; the background thread logs how many
+    were dropped once there is room again.  A thread that can't get a
+    ring buffer at all because the budget is used up logs
+    synchronously.
+
+    Messages are only written in the background, so anything that has
+    to be on disk before something else happens needs FLUSH_LOG().
+    exit() flushes, but _exit() and crashes lose whatever is still
+    buffered.
+
+    After fork(), the child logs synchronously until it calls
+    async_log_start() again.  Messages buffered before the fork are
+    written only by the parent.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/**
+    Start logging asynchronously.
+
+    Call this after OPEN_LOG().  It takes over the facility passed to
+    OPEN_LOG() as where to write messages, and switches the facility to
+    LOG_CUSTOM_BACKEND.  CLOSE_LOG() stops the background thread after
+    writing everything buffered.
+
+    This is not thread-safe: call it before starting the threads that
+    log.
+
+    @param memory_budget Maximum number of bytes for all threads'
+        ring buffers together.
+    @return True on success.  On failure, logging stays synchronous.
+*/
+bool async_log_start(
+    size_t memory_budget);
+
+/**
+    @return The number of messages dropped so far because their
+        thread's ring buffer was full.
+*/
+unsigned long async_log_dropped(
+    void);
+
+#endif
@@ -1,4 +1,5 @@
 #include "hashutils.h"
+#include "sha256.h"
 
 #include <stdio.h>
 #include <util/cryptlib_compat.h>
@@ -16,7 +17,14 @@ int gen_hash(
     unsigned char hash[40];
     int ansr = -1;
 
-    if (alg != CRYPT_ALGO_SHA1 && alg != CRYPT_ALGO_SHA2)
+    if (alg == CRYPT_ALGO_SHA2)
+    {
+        if (bsize < 0)
+            return -1;
+        sha256(inbufp, bsize, outbufp);
+        return SHA256_DIGEST_LENGTH;
+    }
+    if (alg != CRYPT_ALGO_SHA1)
         return -1;
     memset(hash, 0, 40);
     if (cryptInit_wrapper() != CRYPT_OK)
@@ -0,0 +1,583 @@
+#include "sha256.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define SHA256_X86 0
+#endif
+
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+
+static inline uint32_t load_be32(
+    const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+        ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void store_be32(
+    uint8_t *p,
+    uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint32_t ror(
+    uint32_t x,
+    unsigned n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+/*
+ * Write the final one or two blocks of a message of length total,
+ * whose last total % 64 bytes are tail, into out.  Returns the number
+ * of blocks written.
+ */
+static size_t pad_tail(
+    uint8_t out[2 * SHA256_BLOCK_LENGTH],
+    const uint8_t *tail,
+    uint64_t total)
+{
+    size_t rem = total % SHA256_BLOCK_LENGTH;
+    size_t nblocks = rem + 9 > SHA256_BLOCK_LENGTH ? 2 : 1;
+    size_t end = nblocks * SHA256_BLOCK_LENGTH;
+    uint64_t bits = total * 8;
+    int i;
+
+    memcpy(out, tail, rem);
+    out[rem] = 0x80;
+    memset(out + rem + 1, 0, end - rem - 1);
+    for (i = 0; i < 8; ++i)
+        out[end - 1 - i] = bits >> (8 * i);
+    return nblocks;
+}
+
+
+/*
+ * Block functions.  Each one runs the compression function over
+ * nblocks consecutive 64-byte blocks.
+ */
+typedef void (*blocks_fn)(uint32_t state[8], const uint8_t *p,
+                          size_t nblocks);
+
+static void blocks_portable(
+    uint32_t state[8],
+    const uint8_t *p,
+    size_t nblocks)
+{
+    uint32_t W[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (; nblocks > 0; --nblocks, p += SHA256_BLOCK_LENGTH)
+    {
+        for (i = 0; i < 16; ++i)
+            W[i] = load_be32(p + 4 * i);
+        for (; i < 64; ++i)
+        {
+            uint32_t s0 = ror(W[i - 15], 7) ^ ror(W[i - 15], 18) ^
+                (W[i - 15] >> 3);
+            uint32_t s1 = ror(W[i - 2], 17) ^ ror(W[i - 2], 19) ^
+                (W[i - 2] >> 10);
+            W[i] = W[i - 16] + s0 + W[i - 7] + s1;
+        }
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+        for (i = 0; i < 64; ++i)
+        {
+            t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) +
+                ((e & f) ^ (~e & g)) + K[i] + W[i];
+            t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) +
+                ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if SHA256_X86
+
+/*
+ * SHA extensions.  The instructions keep the state as ABEF and CDGH
+ * rather than ABCD and EFGH, and each sha256rnds2 does two rounds.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void blocks_shani(
+    uint32_t state[8],
+    const uint8_t *p,
+    size_t nblocks)
+{
+    const __m128i bswap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, save0, save1, tmp, msg;
+    __m128i w[4];
+    int i;
+
+    tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+    state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);             /* CDAB */
+    state1 = _mm_shuffle_epi32(state1, 0x1B);       /* EFGH */
+    state0 = _mm_alignr_epi8(tmp, state1, 8);       /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);    /* CDGH */
+
+    for (; nblocks > 0; --nblocks, p += SHA256_BLOCK_LENGTH)
+    {
+        save0 = state0;
+        save1 = state1;
+        for (i = 0; i < 16; ++i)
+        {
+            if (i < 4)
+            {
+                w[i] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)(p + 16 * i)), bswap);
+            }
+            else
+            {
+                /* W[t-16] + s0(W[t-15]) + W[t-7], then + s1(W[t-2]) */
+                tmp = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(i + 3) & 3],
+                                                         w[(i + 2) & 3],
+                                                         4));
+                w[i & 3] = _mm_sha256msg2_epu32(tmp, w[(i + 3) & 3]);
+            }
+            msg = _mm_add_epi32(w[i & 3],
+                                _mm_loadu_si128((const __m128i *)&K[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+        state0 = _mm_add_epi32(state0, save0);
+        state1 = _mm_add_epi32(state1, save1);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);          /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xB1);       /* DCHG */
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);    /* DCBA */
+    state1 = _mm_alignr_epi8(state1, tmp, 8);       /* HGFE */
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+/*
+ * AVX2 multi-buffer: one block of eight independent messages at a
+ * time, one message per 32-bit lane.  state[j][lane] is word j of
+ * the lane's state.  This only helps batches; a single stream can't
+ * be split across lanes.
+ */
+#define MB_LANES 8
+
+#define MB_ROR(x, n) \
+    _mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+                    _mm256_slli_epi32((x), 32 - (n)))
+
+__attribute__((target("avx2")))
+static void block_avx2_x8(
+    uint32_t state[8][MB_LANES],
+    const uint8_t *const p[MB_LANES])
+{
+    __m256i W[16];
+    __m256i s[8];
+    __m256i a, b, c, d, e, f, g, h, t1, t2, w;
+    int i, j;
+
+    for (i = 0; i < 16; ++i)
+    {
+        W[i] = _mm256_set_epi32(
+            load_be32(p[7] + 4 * i), load_be32(p[6] + 4 * i),
+            load_be32(p[5] + 4 * i), load_be32(p[4] + 4 * i),
+            load_be32(p[3] + 4 * i), load_be32(p[2] + 4 * i),
+            load_be32(p[1] + 4 * i), load_be32(p[0] + 4 * i));
+    }
+    for (j = 0; j < 8; ++j)
+        s[j] = _mm256_loadu_si256((const __m256i *)state[j]);
+    a = s[0];
+    b = s[1];
+    c = s[2];
+    d = s[3];
+    e = s[4];
+    f = s[5];
+    g = s[6];
+    h = s[7];
+
+    for (i = 0; i < 64; ++i)
+    {
+        if (i < 16)
+        {
+            w = W[i];
+        }
+        else
+        {
+            __m256i w15 = W[(i - 15) & 15];
+            __m256i w2 = W[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(
+                _mm256_xor_si256(MB_ROR(w15, 7), MB_ROR(w15, 18)),
+                _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(
+                _mm256_xor_si256(MB_ROR(w2, 17), MB_ROR(w2, 19)),
+                _mm256_srli_epi32(w2, 10));
+            w = _mm256_add_epi32(
+                _mm256_add_epi32(W[i & 15], s0),
+                _mm256_add_epi32(W[(i - 7) & 15], s1));
+            W[i & 15] = w;
+        }
+
+        t1 = _mm256_add_epi32(
+            _mm256_add_epi32(h, _mm256_xor_si256(
+                                 _mm256_xor_si256(MB_ROR(e, 6),
+                                                  MB_ROR(e, 11)),
+                                 MB_ROR(e, 25))),
+            _mm256_add_epi32(
+                _mm256_xor_si256(_mm256_and_si256(e, f),
+                                 _mm256_andnot_si256(e, g)),
+                _mm256_add_epi32(_mm256_set1_epi32(K[i]), w)));
+        t2 = _mm256_add_epi32(
+            _mm256_xor_si256(_mm256_xor_si256(MB_ROR(a, 2), MB_ROR(a, 13)),
+                             MB_ROR(a, 22)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(a, b), c),
+                            _mm256_and_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a);
+    s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c);
+    s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e);
+    s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g);
+    s[7] = _mm256_add_epi32(s[7], h);
+    for (j = 0; j < 8; ++j)
+        _mm256_storeu_si256((__m256i *)state[j], s[j]);
+}
+
+#undef MB_ROR
+
+struct mb_lane {
+    struct sha256_job *job;     /* NULL if the lane is idle */
+    size_t block;               /* next block to hash */
+    size_t nfull;               /* blocks taken directly from the data */
+    size_t nblocks;             /* nfull plus the padding blocks */
+    uint8_t pad[2 * SHA256_BLOCK_LENGTH];
+};
+
+static void batch_avx2(
+    struct sha256_job *jobs,
+    size_t njobs)
+{
+    static const uint8_t zero_block[SHA256_BLOCK_LENGTH];
+    struct mb_lane lanes[MB_LANES];
+    uint32_t state[8][MB_LANES];
+    const uint8_t *p[MB_LANES];
+    size_t next = 0;
+    size_t active = 0;
+    int l, j;
+
+    for (l = 0; l < MB_LANES; ++l)
+        lanes[l].job = NULL;
+
+    for (;;)
+    {
+        /* give each idle lane the next job, if any */
+        for (l = 0; l < MB_LANES; ++l)
+        {
+            struct mb_lane *lane = &lanes[l];
+            const uint8_t *data;
+
+            if (lane->job != NULL || next >= njobs)
+                continue;
+            lane->job = &jobs[next++];
+            data = lane->job->data;
+            lane->block = 0;
+            lane->nfull = lane->job->len / SHA256_BLOCK_LENGTH;
+            lane->nblocks = lane->nfull +
+                pad_tail(lane->pad,
+                         data + lane->nfull * SHA256_BLOCK_LENGTH,
+                         lane->job->len);
+            for (j = 0; j < 8; ++j)
+                state[j][l] = IV[j];
+            ++active;
+        }
+        if (active == 0)
+            break;
+
+        for (l = 0; l < MB_LANES; ++l)
+        {
+            struct mb_lane *lane = &lanes[l];
+
+            if (lane->job == NULL)
+                p[l] = zero_block;
+            else if (lane->block < lane->nfull)
+                p[l] = (const uint8_t *)lane->job->data +
+                    lane->block * SHA256_BLOCK_LENGTH;
+            else
+                p[l] = lane->pad +
+                    (lane->block - lane->nfull) * SHA256_BLOCK_LENGTH;
+        }
+        block_avx2_x8(state, p);
+
+        for (l = 0; l < MB_LANES; ++l)
+        {
+            struct mb_lane *lane = &lanes[l];
+
+            if (lane->job == NULL || ++lane->block < lane->nblocks)
+                continue;
+            for (j = 0; j < 8; ++j)
+                store_be32(lane->job->digest + 4 * j, state[j][l]);
+            lane->job = NULL;
+            --active;
+        }
+    }
+}
+
+static bool cpu_has_shani(
+    void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    if (!(ecx & (1u << 9)) || !(ecx & (1u << 19)))  /* SSSE3, SSE4.1 */
+        return false;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1u << 29)) != 0;                 /* SHA */
+}
+
+static bool cpu_has_avx2(
+    void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif                          /* SHA256_X86 */
+
+
+/*
+ * Run-time dispatch.  blocks is used for streams and for batches
+ * unless the AVX2 multi-buffer code is selected.
+ */
+static pthread_once_t impl_once = PTHREAD_ONCE_INIT;
+static enum sha256_impl impl = SHA256_IMPL_PORTABLE;
+static blocks_fn blocks = blocks_portable;
+
+static bool impl_supported(
+    enum sha256_impl which)
+{
+    switch (which)
+    {
+    case SHA256_IMPL_PORTABLE:
+        return true;
+#if SHA256_X86
+    case SHA256_IMPL_SHANI:
+        return cpu_has_shani();
+    case SHA256_IMPL_AVX2:
+        return cpu_has_avx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+static void impl_use(
+    enum sha256_impl which)
+{
+    impl = which;
+#if SHA256_X86
+    if (which == SHA256_IMPL_SHANI)
+    {
+        blocks = blocks_shani;
+        return;
+    }
+#endif
+    blocks = blocks_portable;
+}
+
+static void impl_init(
+    void)
+{
+    if (impl_supported(SHA256_IMPL_SHANI))
+        impl_use(SHA256_IMPL_SHANI);
+    else if (impl_supported(SHA256_IMPL_AVX2))
+        impl_use(SHA256_IMPL_AVX2);
+    else
+        impl_use(SHA256_IMPL_PORTABLE);
+}
+
+bool sha256_set_impl(
+    enum sha256_impl which)
+{
+    pthread_once(&impl_once, impl_init);
+    if (which == SHA256_IMPL_AUTO)
+    {
+        impl_init();
+        return true;
+    }
+    if (!impl_supported(which))
+        return false;
+    impl_use(which);
+    return true;
+}
+
+const char *sha256_impl_name(
+    void)
+{
+    pthread_once(&impl_once, impl_init);
+    switch (impl)
+    {
+    case SHA256_IMPL_SHANI:
+        return "sha-ni";
+    case SHA256_IMPL_AVX2:
+        return "avx2";
+    default:
+        return "portable";
+    }
+}
+
+
+void sha256_init(
+    struct sha256_ctx *ctx)
+{
+    pthread_once(&impl_once, impl_init);
+    memcpy(ctx->state, IV, sizeof(ctx->state));
+    ctx->total = 0;
+    ctx->buflen = 0;
+}
+
+void sha256_update(
+    struct sha256_ctx *ctx,
+    const void *data,
+    size_t len)
+{
+    const uint8_t *p = data;
+    size_t n;
+
+    ctx->total += len;
+    if (ctx->buflen > 0)
+    {
+        n = SHA256_BLOCK_LENGTH - ctx->buflen;
+        if (n > len)
+            n = len;
+        memcpy(ctx->buf + ctx->buflen, p, n);
+        ctx->buflen += n;
+        p += n;
+        len -= n;
+        if (ctx->buflen < SHA256_BLOCK_LENGTH)
+            return;
+        blocks(ctx->state, ctx->buf, 1);
+        ctx->buflen = 0;
+    }
+    n = len / SHA256_BLOCK_LENGTH;
+    if (n > 0)
+    {
+        blocks(ctx->state, p, n);
+        p += n * SHA256_BLOCK_LENGTH;
+        len -= n * SHA256_BLOCK_LENGTH;
+    }
+    memcpy(ctx->buf, p, len);
+    ctx->buflen = len;
+}
+
+void sha256_final(
+    struct sha256_ctx *ctx,
+    uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    uint8_t pad[2 * SHA256_BLOCK_LENGTH];
+    int j;
+
+    blocks(ctx->state, pad, pad_tail(pad, ctx->buf, ctx->total));
+    for (j = 0; j < 8; ++j)
+        store_be32(digest + 4 * j, ctx->state[j]);
+}
+
+void sha256(
+    const void *data,
+    size_t len,
+    uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    struct sha256_ctx ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
+
+void sha256_batch(
+    struct sha256_job *jobs,
+    size_t njobs)
+{
+    size_t i;
+
+    pthread_once(&impl_once, impl_init);
+#if SHA256_X86
+    if (impl == SHA256_IMPL_AVX2 && njobs > 1)
+    {
+        batch_avx2(jobs, njobs);
+        return;
+    }
+#endif
+    for (i = 0; i < njobs; ++i)
+        sha256(jobs[i].data, jobs[i].len, jobs[i].digest);
+}
@@ -0,0 +1,100 @@
+#ifndef _UTIL_SHA256_H
+#define _UTIL_SHA256_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+   SHA-256 without a crypto library context.
+
+   The block function is chosen at run time: the SHA extensions on
+   x86 CPUs that have them, otherwise a portable implementation.
+   sha256_batch() hashes many independent messages at once and, on
+   CPUs with AVX2 but without the SHA extensions, runs eight of them
+   side by side in the vector lanes.
+
+   All functions are thread-safe as long as each context or job is
+   used by one thread at a time.
+*/
+
+#define SHA256_DIGEST_LENGTH 32
+#define SHA256_BLOCK_LENGTH 64
+
+
+struct sha256_ctx {
+    uint32_t state[8];
+    uint64_t total;             /**< bytes hashed so far */
+    uint8_t buf[SHA256_BLOCK_LENGTH];
+    size_t buflen;
+};
+
+/** Start a new hash. */
+void sha256_init(
+    struct sha256_ctx *ctx);
+
+/** Add @p len bytes of data to the hash. */
+void sha256_update(
+    struct sha256_ctx *ctx,
+    const void *data,
+    size_t len);
+
+/**
+   Finish the hash and write the digest.  The context must be
+   re-initialized with sha256_init() before it is used again.
+*/
+void sha256_final(
+    struct sha256_ctx *ctx,
+    uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+/** Hash a message in one call. */
+void sha256(
+    const void *data,
+    size_t len,
+    uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+
+/** One message of a batch. */
+struct sha256_job {
+    const void *data;
+    size_t len;
+    uint8_t digest[SHA256_DIGEST_LENGTH];  /**< output */
+};
+
+/**
+   Hash each of @p njobs messages into its job's digest.  This is
+   faster than calling sha256() in a loop when there are many small
+   messages.
+*/
+void sha256_batch(
+    struct sha256_job *jobs,
+    size_t njobs);
+
+
+enum sha256_impl {
+    SHA256_IMPL_AUTO,           /**< best one the CPU supports */
+    SHA256_IMPL_PORTABLE,
+    SHA256_IMPL_SHANI,          /**< x86 SHA extensions */
+    SHA256_IMPL_AVX2,           /**< portable, with 8-way AVX2 batches */
+};
+
+/**
+   Override the run-time choice of implementation.  This is meant
+   for tests and benchmarks and must not be called while other
+   threads are hashing.
+
+   @return
+       false if the CPU doesn't support @p impl, in which case the
+       choice is unchanged.
+*/
+bool sha256_set_impl(
+    enum sha256_impl impl);
+
+/** Name of the implementation in use, e.g. for logging. */
+const char *sha256_impl_name(
+    void);
+
+
+#endif
@@ -0,0 +1,292 @@
+// make sure strerror_r is the POSIX flavor
+#define _XOPEN_SOURCE 700
+
+#include "test/unittest.h"
+#include "util/async_log.h"
+#include "util/logging.h"
+#include "util/stringutils.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IDENT PACKAGE_NAME "-async_log-test"
+
+// longest message async_log.c writes, including the '\0'
+#define MAX_MESSAGE 4096
+
+static int saved_stderr = -1;
+static FILE *captured = NULL;
+
+/**
+    Send everything written to stderr to a temporary file until
+    end_capture().
+*/
+static void
+begin_capture(
+    void)
+{
+    fflush(stderr);
+    captured = tmpfile();
+    assert(captured != NULL);
+    saved_stderr = dup(STDERR_FILENO);
+    assert(saved_stderr >= 0);
+    int ret = dup2(fileno(captured), STDERR_FILENO);
+    assert(ret >= 0);
+    (void)ret;
+}
+
+/**
+    Restore stderr and return what was written to it, which the caller
+    must free().
+*/
+static char *
+end_capture(
+    void)
+{
+    fflush(stderr);
+    int ret = dup2(saved_stderr, STDERR_FILENO);
+    assert(ret >= 0);
+    (void)ret;
+    close(saved_stderr);
+
+    long size = ftell(captured);
+    if (size < 0)
+    {
+        // the file position is shared with the duplicated descriptor
+        size = lseek(fileno(captured), 0, SEEK_END);
+    }
+    assert(size >= 0);
+    char *text = malloc(size + 1);
+    assert(text != NULL);
+    rewind(captured);
+    size_t len = fread(text, 1, size, captured);
+    text[len] = '\0';
+    fclose(captured);
+    captured = NULL;
+    return text;
+}
+
+static char expected[16384];
+static size_t expected_offset;
+
+// Log the message, and append what it should look like to expected.
+#define CHECK_FORMAT(format, ...)                                       \
+    do {                                                                \
+        errno = EACCES;                                                 \
+        LOG(LOG_INFO, format, __VA_ARGS__);                             \
+        errno = EACCES;                                                 \
+        expected_offset += xsnprintf(                                   \
+            expected + expected_offset,                                 \
+            sizeof(expected) - expected_offset,                         \
+            IDENT ": INFO: " format "\n", __VA_ARGS__);                 \
+    } while (false)
+
+static _Bool
+test_formats(
+    void)
+{
+    char changing[] = "changed later";
+    char long_string[6000];
+    char long_message[2 * sizeof(long_string)];
+    int value = 42;
+
+    begin_capture();
+    OPEN_LOG("async_log-test", LOG_CONSOLE);
+    SET_LOG_LEVEL(LOG_INFO);
+    TEST(_Bool, "%d", 1, ==, async_log_start(1024 * 1024));
+    TEST(int, "%d", LOG_CUSTOM_BACKEND, ==, log_facility);
+
+    expected_offset = 0;
+    CHECK_FORMAT("int %d, padded %5d, negative %+d", 7, 12, -3);
+    CHECK_FORMAT("unsigned %u %o %x %#X", 4000000000u, 8u, 255u, 255u);
+    CHECK_FORMAT("char '%c' and 100%%", 'x');
+    CHECK_FORMAT("hh %hhd h %hu l %ld ll %lld", (signed char)-1,
+                 (unsigned short)65535, -123456789L, -1234567890123LL);
+    CHECK_FORMAT("j %jd z %zu t %td", (intmax_t)-9, (size_t)9,
+                 (ptrdiff_t)-99);
+    CHECK_FORMAT("double %f %.2e %g %5.1f", 3.14159, 12345.678, 0.0001,
+                 2.25);
+    CHECK_FORMAT("long double %Lf %.3Lg", (long double)1.5,
+                 (long double)2.0 / 3);
+    CHECK_FORMAT("pointer %p", (void *)&value);
+    CHECK_FORMAT("string '%s' '%-10s' '%10s' '%.3s'", changing, "left",
+                 "right", "truncated");
+    CHECK_FORMAT("star width '%*d' precision '%.*s' both '%*.*f'", 6, 42,
+                 2, "abcdef", 8, 3, 1.0 / 3);
+    CHECK_FORMAT("%s", "");
+    CHECK_FORMAT("errno %d: %m", EACCES);
+    CHECK_FORMAT("many %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+                 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17);
+
+    // a message that has to be formatted right away is truncated
+    memset(long_string, 'y', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+    errno = EACCES;
+    LOG(LOG_INFO, "long %s %m", long_string);
+    errno = EACCES;
+    xsnprintf(long_message, sizeof(long_message), "long %s %m",
+              long_string);
+    long_message[MAX_MESSAGE - 1] = '\0';
+    expected_offset += xsnprintf(
+        expected + expected_offset, sizeof(expected) - expected_offset,
+        IDENT ": INFO: %s\n", long_message);
+
+    // the string has to be copied when it's logged, not when it's written
+    strcpy(changing, "CHANGED LATER");
+
+    FLUSH_LOG();
+    CLOSE_LOG();
+    char *output = end_capture();
+
+    TEST(int, "%d", LOG_CONSOLE, ==, log_facility);
+    TEST(unsigned long, "%lu", 0, ==, async_log_dropped());
+    TEST_STR(output, ==, expected);
+    free(output);
+
+    return 1;
+}
+
+#define NUM_THREADS 4
+#define MESSAGES_PER_THREAD 1000
+
+static void *
+log_thread(
+    void *arg)
+{
+    int thread = (int)(intptr_t)arg;
+
+    for (int i = 0; i < MESSAGES_PER_THREAD; ++i)
+    {
+        LOG(LOG_NOTICE, "thread %d message %d %s", thread, i, "payload");
+    }
+    return NULL;
+}
+
+static _Bool
+test_threads(
+    void)
+{
+    pthread_t threads[NUM_THREADS];
+    int next[NUM_THREADS] = {0};
+
+    begin_capture();
+    OPEN_LOG("async_log-test", LOG_CONSOLE);
+    TEST(_Bool, "%d", 1, ==, async_log_start(4 * 1024 * 1024));
+
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+        int ret = pthread_create(&threads[t], NULL, &log_thread,
+                                 (void *)(intptr_t)t);
+        TEST(int, "%d", 0, ==, ret);
+    }
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    FLUSH_LOG();
+    char *output = end_capture();
+    TEST(unsigned long, "%lu", 0, ==, async_log_dropped());
+
+    // each thread's messages must all be there, in order
+    char *saveptr = NULL;
+    for (char *line = strtok_r(output, "\n", &saveptr); line != NULL;
+         line = strtok_r(NULL, "\n", &saveptr))
+    {
+        int thread;
+        int message;
+        int n = sscanf(line, IDENT ": NOTICE: thread %d message %d payload",
+                       &thread, &message);
+        TEST(int, "%d", 2, ==, n);
+        TEST(int, "%d", 0, <=, thread);
+        TEST(int, "%d", NUM_THREADS, >, thread);
+        TEST(int, "%d", next[thread], ==, message);
+        ++next[thread];
+    }
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+        TEST(int, "%d", MESSAGES_PER_THREAD, ==, next[t]);
+    }
+    free(output);
+
+    begin_capture();
+    CLOSE_LOG();
+    output = end_capture();
+    TEST_STR(output, ==, "");
+    free(output);
+
+    return 1;
+}
+
+#define BURST_MESSAGES 20000
+
+static _Bool
+test_dropped(
+    void)
+{
+    char payload[200];
+    unsigned long dropped_before = async_log_dropped();
+
+    memset(payload, 'x', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+
+    begin_capture();
+    OPEN_LOG("async_log-test", LOG_CONSOLE);
+    TEST(_Bool, "%d", 0, ==, async_log_start(1024));
+    TEST(_Bool, "%d", 1, ==, async_log_start(16 * 1024));
+    for (int i = 0; i < BURST_MESSAGES; ++i)
+    {
+        LOG(LOG_NOTICE, "burst %d %s", i, payload);
+    }
+    FLUSH_LOG();
+    CLOSE_LOG();
+    char *output = end_capture();
+
+    // every message is either written or counted as dropped
+    unsigned long written = 0;
+    unsigned long reported = 0;
+    char *saveptr = NULL;
+    for (char *line = strtok_r(output, "\n", &saveptr); line != NULL;
+         line = strtok_r(NULL, "\n", &saveptr))
+    {
+        unsigned long n;
+        if (sscanf(line, IDENT ": WARN: dropped %lu", &n) == 1)
+            reported += n;
+        else
+            ++written;
+    }
+    free(output);
+
+    unsigned long dropped = async_log_dropped() - dropped_before;
+    TEST(unsigned long, "%lu", 0, <, dropped);
+    TEST(unsigned long, "%lu", dropped, ==, reported);
+    TEST(unsigned long, "%lu", BURST_MESSAGES, ==, written + dropped);
+
+    return 1;
+}
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    if (!test_formats())
+        return EXIT_FAILURE;
+
+    if (!test_threads())
+        return EXIT_FAILURE;
+
+    if (!test_dropped())
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
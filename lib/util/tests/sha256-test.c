@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/sha256.h"
+#include "test/unittest.h"
+
+static const struct {
+    const char *msg;
+    size_t repeat;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+} vectors[] = {
+    /* FIPS 180-2 examples */
+    {"abc", 1,
+     {0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+      0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+      0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+      0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad}},
+    {"", 1,
+     {0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+      0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+      0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+      0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55}},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     {0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+      0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+      0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+      0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1}},
+    {"a", 1000000,
+     {0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+      0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+      0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+      0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0}},
+};
+
+#define NVECTORS (sizeof(vectors) / sizeof(vectors[0]))
+
+/* messages for the batch tests: every length around the padding edges */
+#define NJOBS 300
+static uint8_t data[NJOBS + 4096];
+
+static bool test_vectors(
+    void)
+{
+    struct sha256_ctx ctx;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    size_t i, r;
+
+    for (i = 0; i < NVECTORS; ++i)
+    {
+        size_t len = strlen(vectors[i].msg);
+
+        sha256_init(&ctx);
+        for (r = 0; r < vectors[i].repeat; ++r)
+            sha256_update(&ctx, vectors[i].msg, len);
+        sha256_final(&ctx, digest);
+        TEST_MEMCMP(digest, ==, vectors[i].digest, SHA256_DIGEST_LENGTH);
+
+        if (vectors[i].repeat == 1)
+        {
+            sha256(vectors[i].msg, len, digest);
+            TEST_MEMCMP(digest, ==, vectors[i].digest,
+                        SHA256_DIGEST_LENGTH);
+        }
+    }
+    return true;
+}
+
+static bool test_split(
+    void)
+{
+    struct sha256_ctx ctx;
+    uint8_t whole[SHA256_DIGEST_LENGTH];
+    uint8_t parts[SHA256_DIGEST_LENGTH];
+    size_t len = 1000;
+    size_t split;
+
+    sha256(data, len, whole);
+    for (split = 0; split <= len; split += 7)
+    {
+        sha256_init(&ctx);
+        sha256_update(&ctx, data, split);
+        sha256_update(&ctx, data + split, len - split);
+        sha256_final(&ctx, parts);
+        TEST_MEMCMP(parts, ==, whole, SHA256_DIGEST_LENGTH);
+    }
+    return true;
+}
+
+static bool test_batch(
+    const uint8_t expected[NJOBS][SHA256_DIGEST_LENGTH])
+{
+    static struct sha256_job jobs[NJOBS];
+    size_t i;
+
+    for (i = 0; i < NJOBS; ++i)
+    {
+        /* mix lengths so lanes finish at different times */
+        jobs[i].data = data + i % 13;
+        jobs[i].len = (i * 37) % NJOBS + (i % 50 == 0 ? 4000 : 0);
+        memset(jobs[i].digest, 0, SHA256_DIGEST_LENGTH);
+    }
+    sha256_batch(jobs, NJOBS);
+    for (i = 0; i < NJOBS; ++i)
+    {
+        TEST_MEMCMP(jobs[i].digest, ==, expected[i], SHA256_DIGEST_LENGTH);
+    }
+
+    sha256_batch(jobs, 1);
+    TEST_MEMCMP(jobs[0].digest, ==, expected[0], SHA256_DIGEST_LENGTH);
+    sha256_batch(jobs, 0);
+    return true;
+}
+
+int main(
+    void)
+{
+    static const enum sha256_impl impls[] = {
+        SHA256_IMPL_PORTABLE,
+        SHA256_IMPL_SHANI,
+        SHA256_IMPL_AVX2,
+        SHA256_IMPL_AUTO,
+    };
+    static uint8_t expected[NJOBS][SHA256_DIGEST_LENGTH];
+    size_t i;
+
+    for (i = 0; i < sizeof(data); ++i)
+        data[i] = (uint8_t)(i * 131 + 7);
+
+    /* reference digests from the portable code */
+    if (!sha256_set_impl(SHA256_IMPL_PORTABLE))
+        return -1;
+    for (i = 0; i < NJOBS; ++i)
+        sha256(data + i % 13, (i * 37) % NJOBS + (i % 50 == 0 ? 4000 : 0),
+               expected[i]);
+
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+    {
+        if (!sha256_set_impl(impls[i]))
+        {
+            printf("skipping unsupported implementation %d\n",
+                   (int)impls[i]);
+            continue;
+        }
+        printf("testing %s\n", sha256_impl_name());
+        if (!test_vectors())
+            return -1;
+        if (!test_split())
+            return -1;
+        if (!test_batch((const uint8_t (*)[SHA256_DIGEST_LENGTH])expected))
+            return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+## Handle $(BENCHMARKS)
+
+## Benchmarks are run by "make bench", never by "make check".  Each one
+## is run like a test, with the test configuration and database, and
+## prints its results as "name value" lines.
+.PHONY: bench
+bench: all $(LOG_COMPILER_DEPS) tests/test.conf $(BENCHMARKS) $(BENCHMARK_DEPS)
+	@for bench in $(BENCHMARKS); do \
+		echo "+++ $$bench"; \
+		$(LOG_COMPILER) "$$bench" || exit 1; \
+	done
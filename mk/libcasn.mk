@@ -63,3 +63,10 @@ lib_casn_tests_readcasnnum_test_LDADD = \
 	$(LDADD_LIBCASN)
 
 TESTS += lib/casn/tests/readcasnnum-test
+
+check_PROGRAMS += lib/casn/tests/objid-test
+
+lib_casn_tests_objid_test_LDADD = \
+	$(LDADD_LIBCASN)
+
+TESTS += lib/casn/tests/objid-test
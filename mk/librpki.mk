@@ -19,8 +19,14 @@ lib_rpki_librpki_a_SOURCES = \
 	lib/rpki/err.h \
 	lib/rpki/globals.h \
 	lib/rpki/initscm.c \
+	lib/rpki/loadqueue.c \
+	lib/rpki/loadqueue.h \
+	lib/rpki/loadstate.c \
+	lib/rpki/loadstate.h \
 	lib/rpki/myssl.c \
 	lib/rpki/myssl.h \
+	lib/rpki/perf.c \
+	lib/rpki/perf.h \
 	lib/rpki/querySupport.c \
 	lib/rpki/querySupport.h \
 	lib/rpki/rpwork.h \
@@ -28,6 +34,30 @@ lib_rpki_librpki_a_SOURCES = \
 	lib/rpki/scmf.h \
 	lib/rpki/scm.h \
 	lib/rpki/scmmain.h \
+	lib/rpki/sqbackend.h \
 	lib/rpki/sqcon.c \
 	lib/rpki/sqhl.c \
-	lib/rpki/sqhl.h
+	lib/rpki/sqhl.h \
+	lib/rpki/sqmysql.c \
+	lib/rpki/sqodbc.c
+
+if HAVE_SQLITE
+lib_rpki_librpki_a_SOURCES += \
+	lib/rpki/sqembed.c
+endif
+
+
+## Not in TESTS; run by tests/bench/kernels/kernels.sh from "make bench".
+check_PROGRAMS += lib/rpki/tests/kernels-bench
+
+lib_rpki_tests_kernels_bench_LDADD = \
+	$(LDADD_LIBRPKI)
+
+if HAVE_SQLITE
+check_PROGRAMS += lib/rpki/tests/sqembed-test
+
+lib_rpki_tests_sqembed_test_LDADD = \
+	$(LDADD_LIBRPKI)
+
+TESTS += lib/rpki/tests/sqembed-test
+endif
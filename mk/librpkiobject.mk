@@ -13,5 +13,15 @@ lib_rpki_object_librpkiobject_a_SOURCES = \
 	lib/rpki-object/crl.h \
 	lib/rpki-object/keyfile.c \
 	lib/rpki-object/keyfile.h \
+	lib/rpki-object/resources.c \
+	lib/rpki-object/resources.h \
 	lib/rpki-object/signature.c \
 	lib/rpki-object/signature.h
+
+
+check_PROGRAMS += lib/rpki-object/tests/resources-test
+
+lib_rpki_object_tests_resources_test_LDADD = \
+	$(LDADD_LIBRPKIOBJECT)
+
+TESTS += lib/rpki-object/tests/resources-test
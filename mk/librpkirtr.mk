@@ -4,5 +4,7 @@ LDADD_LIBRPKIRTR = \
 	lib/rpki-rtr/librpkirtr.a
 
 lib_rpki_rtr_librpkirtr_a_SOURCES = \
+	lib/rpki-rtr/notify.c \
+	lib/rpki-rtr/notify.h \
 	lib/rpki-rtr/pdu.c \
 	lib/rpki-rtr/pdu.h
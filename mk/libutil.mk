@@ -4,6 +4,8 @@ LDADD_LIBUTIL = \
 	lib/util/libutil.a
 
 lib_util_libutil_a_SOURCES = \
+	lib/util/async_log.c \
+	lib/util/async_log.h \
 	lib/util/bag.c \
 	lib/util/bag.h \
 	lib/util/cryptlib_compat.c \
@@ -23,6 +25,8 @@ lib_util_libutil_a_SOURCES = \
 	lib/util/queue.h \
 	lib/util/semaphore_compat.c \
 	lib/util/semaphore_compat.h \
+	lib/util/sha256.c \
+	lib/util/sha256.h \
 	lib/util/stringutils.c \
 	lib/util/stringutils.h
 
@@ -37,6 +41,14 @@ lib_util_libutildebug_a_CPPFLAGS = \
 	-DDEBUG
 
 
+check_PROGRAMS += lib/util/tests/async_log-test
+
+lib_util_tests_async_log_test_LDADD = \
+	lib/util/libutildebug.a
+
+TESTS += lib/util/tests/async_log-test
+
+
 check_PROGRAMS += lib/util/tests/bag-test
 
 lib_util_tests_bag_test_LDADD = \
@@ -53,6 +65,14 @@ lib_util_tests_queue_test_LDADD = \
 TESTS += lib/util/tests/queue-test
 
 
+check_PROGRAMS += lib/util/tests/sha256-test
+
+lib_util_tests_sha256_test_LDADD = \
+	lib/util/libutildebug.a
+
+TESTS += lib/util/tests/sha256-test
+
+
 check_PROGRAMS += lib/util/tests/stringutils-test
 
 lib_util_tests_stringutils_test_LDADD = \
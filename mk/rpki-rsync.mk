@@ -25,5 +25,51 @@ pkglibexec_SCRIPTS += bin/rpki-rsync/rsync_cord.py
 MK_SUBST_FILES_EXEC += bin/rpki-rsync/rsync_cord.py
 bin/rpki-rsync/rsync_cord.py: $(srcdir)/bin/rpki-rsync/rsync_cord.py.in
 
+pkglibexec_SCRIPTS += bin/rpki-rsync/fetch_schedule.py
+MK_SUBST_FILES_EXEC += bin/rpki-rsync/fetch_schedule.py
+bin/rpki-rsync/fetch_schedule.py: $(srcdir)/bin/rpki-rsync/fetch_schedule.py.in
+
+check_SCRIPTS += tests/subsystem/fetch-schedule/test.sh
+MK_SUBST_FILES_EXEC += tests/subsystem/fetch-schedule/test.sh
+tests/subsystem/fetch-schedule/test.sh: $(srcdir)/tests/subsystem/fetch-schedule/test.sh.in
+
+TESTS += tests/subsystem/fetch-schedule/test.sh
+
+EXTRA_DIST += \
+	tests/subsystem/fetch-schedule/response.all.log.correct \
+	tests/subsystem/fetch-schedule/response.schedule.log.correct
+
+CLEANFILES += \
+	tests/subsystem/fetch-schedule/*.diff \
+	tests/subsystem/fetch-schedule/*.log \
+	tests/subsystem/fetch-schedule/history \
+	tests/subsystem/fetch-schedule/next-update
+
+pkglibexec_SCRIPTS += bin/rpki-rsync/rrdp_fetch.py
+MK_SUBST_FILES_EXEC += bin/rpki-rsync/rrdp_fetch.py
+bin/rpki-rsync/rrdp_fetch.py: $(srcdir)/bin/rpki-rsync/rrdp_fetch.py.in
+
+check_SCRIPTS += tests/subsystem/rrdp/test.sh
+MK_SUBST_FILES_EXEC += tests/subsystem/rrdp/test.sh
+tests/subsystem/rrdp/test.sh: $(srcdir)/tests/subsystem/rrdp/test.sh.in
+
+TESTS += tests/subsystem/rrdp/test.sh
+
+EXTRA_DIST += \
+	tests/subsystem/rrdp/response.bad_delta.log.correct \
+	tests/subsystem/rrdp/response.bad_hash.log.correct \
+	tests/subsystem/rrdp/response.delta.log.correct \
+	tests/subsystem/rrdp/response.new_directory.log.correct \
+	tests/subsystem/rrdp/response.new_session.log.correct \
+	tests/subsystem/rrdp/response.snapshot.log.correct \
+	tests/subsystem/rrdp/response.too_big.log.correct \
+	tests/subsystem/rrdp/response.unchanged.log.correct
+
+CLEANFILES += \
+	tests/subsystem/rrdp/*.diff \
+	tests/subsystem/rrdp/*.log
+
+CLEANDIRS += tests/subsystem/rrdp/work
+
 
 EXTRA_DIST += doc/AUR.readme
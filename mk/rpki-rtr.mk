@@ -11,6 +11,8 @@ bin_rpki_rtr_rpki_rtr_daemon_SOURCES = \
 	bin/rpki-rtr/connection_control.h \
 	bin/rpki-rtr/db.c \
 	bin/rpki-rtr/db.h \
+	bin/rpki-rtr/db_scheduler.c \
+	bin/rpki-rtr/db_scheduler.h \
 	bin/rpki-rtr/main.c \
 	bin/rpki-rtr/semaphores.h \
 	bin/rpki-rtr/signals.c \
@@ -22,6 +24,17 @@ bin_rpki_rtr_rpki_rtr_daemon_LDADD = \
 	$(LDADD_LIBUTIL)
 
 
+pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-load-client
+PACKAGE_NAME_BINS += rpki-rtr-load-client
+
+bin_rpki_rtr_rpki_rtr_load_client_SOURCES = \
+	bin/rpki-rtr/load-client.c
+
+bin_rpki_rtr_rpki_rtr_load_client_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+
 pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-test-client
 PACKAGE_NAME_BINS += rpki-rtr-test-client
 
@@ -40,7 +53,8 @@ bin_rpki_rtr_rpki_rtr_update_SOURCES = \
 	bin/rpki-rtr/rtr-update.c
 
 bin_rpki_rtr_rpki_rtr_update_LDADD = \
-	$(LDADD_LIBDB)
+	$(LDADD_LIBDB) \
+	$(LDADD_LIBRPKIRTR)
 
 
 pkglibexec_SCRIPTS += bin/rpki-rtr/rpki-rtr-clear
@@ -60,6 +74,11 @@ EXTRA_DIST += \
 	doc/rpki-rtr-notes
 
 
+BENCHMARKS += tests/bench/rtr/load.sh
+MK_SUBST_FILES_EXEC += tests/bench/rtr/load.sh
+tests/bench/rtr/load.sh: $(srcdir)/tests/bench/rtr/load.sh.in
+
+
 check_SCRIPTS += tests/subsystem/rtr/badPDUs.py
 MK_SUBST_FILES_EXEC += tests/subsystem/rtr/badPDUs.py
 tests/subsystem/rtr/badPDUs.py: $(srcdir)/tests/subsystem/rtr/badPDUs.py.in
@@ -93,6 +112,7 @@ EXTRA_DIST += \
 	tests/subsystem/rtr/response.reset_query_last.log.correct \
 	tests/subsystem/rtr/response.serial_notify.log.correct \
 	tests/subsystem/rtr/response.serial_queries.log.correct \
+	tests/subsystem/rtr/response.version_1.log.correct \
 	tests/subsystem/rtr/root.options \
 	tests/subsystem/rtr/test.conf
 
@@ -300,6 +300,13 @@ bin/rpki/initialize: $(srcdir)/bin/rpki/initialize.in
 PACKAGE_NAME_BINS += initialize
 
 
+pkglibexec_PROGRAMS += bin/rpki/offline-validate
+PACKAGE_NAME_BINS += offline-validate
+
+bin_rpki_offline_validate_LDADD = \
+	$(LDADD_LIBRPKI)
+
+
 pkglibexec_PROGRAMS += bin/rpki/query
 PACKAGE_NAME_BINS += query
 
@@ -313,16 +320,12 @@ bin_rpki_rcli_LDADD = \
 	$(LDADD_LIBRPKI)
 
 
-pkglibexec_SCRIPTS += bin/rpki/results.py
-MK_SUBST_FILES_EXEC += bin/rpki/results.py
-bin/rpki/results.py: $(srcdir)/bin/rpki/results.py.in
-
-
-pkglibexec_SCRIPTS += bin/rpki/results
-MK_SUBST_FILES_EXEC += bin/rpki/results
-bin/rpki/results: $(srcdir)/bin/rpki/results.in
+pkglibexec_PROGRAMS += bin/rpki/results
 PACKAGE_NAME_BINS += results
 
+bin_rpki_results_LDADD = \
+	$(LDADD_LIBRPKI)
+
 
 pkglibexec_SCRIPTS += bin/rpki/synchronize
 MK_SUBST_FILES_EXEC += bin/rpki/synchronize
@@ -2268,3 +2271,26 @@ TESTS += \
 	tests/subsystem/runSubsystemTest1.tap \
 	tests/subsystem/runSubsystemTest2.tap \
 	tests/subsystem/runSubsystemTest3.tap
+
+
+BENCHMARKS += tests/bench/loader/load.sh
+BENCHMARK_DEPS += tests/bench/loader/make_repo.py
+MK_SUBST_FILES_EXEC += \
+	tests/bench/loader/load.sh \
+	tests/bench/loader/make_repo.py
+tests/bench/loader/load.sh: $(srcdir)/tests/bench/loader/load.sh.in
+tests/bench/loader/make_repo.py: $(srcdir)/tests/bench/loader/make_repo.py.in
+
+CLEANDIRS += \
+	tests/bench/loader/cache \
+	tests/bench/loader/synth
+
+
+BENCHMARKS += tests/bench/kernels/kernels.sh
+BENCHMARK_DEPS += lib/rpki/tests/kernels-bench
+MK_SUBST_FILES_EXEC += tests/bench/kernels/kernels.sh
+tests/bench/kernels/kernels.sh: $(srcdir)/tests/bench/kernels/kernels.sh.in
+
+CLEANDIRS += \
+	tests/bench/kernels/corpus \
+	tests/bench/kernels/synth